@@ -5,13 +5,33 @@
  * Blinks the built-in LED on GPIO 2.
  * Works in QEMU (GPIO state is tracked in emulation).
  *
+ * The LED is a periodic job of the CoopScheduler library
+ * (arduino/libraries/CoopScheduler) instead of two delay(1000) calls, so
+ * loop() stays free for more jobs. Every 10 s the scheduler prints how
+ * late the blink ran (SCHED / JOB lines).
+ *
  * To run in QEMU:
  *   cd esp32-qemu
  *   ./run-arduino-example.sh 01-blink
  */
 
+#include <CoopScheduler.h>
+
 #define LED_PIN 2
 
+CoopScheduler sched;
+bool ledOn = false;
+
+void blink(void *arg) {
+    ledOn = !ledOn;
+    digitalWrite(LED_PIN, ledOn ? HIGH : LOW);
+    Serial.println(ledOn ? "LED ON  (GPIO 2 = HIGH)" : "LED OFF (GPIO 2 = LOW)");
+}
+
+void report(void *arg) {
+    sched.printStats();
+}
+
 void setup() {
     Serial.begin(115200);
     pinMode(LED_PIN, OUTPUT);
@@ -22,14 +42,11 @@ void setup() {
     Serial.println("  IoT Course - Spring 2026");
     Serial.println("==========================================");
     Serial.println();
+
+    sched.every(1000, blink, NULL, "blink", 0);
+    sched.every(10000, report, NULL, "stats");
 }
 
 void loop() {
-    digitalWrite(LED_PIN, HIGH);
-    Serial.println("LED ON  (GPIO 2 = HIGH)");
-    delay(1000);
-
-    digitalWrite(LED_PIN, LOW);
-    Serial.println("LED OFF (GPIO 2 = LOW)");
-    delay(1000);
+    sched.run();
 }
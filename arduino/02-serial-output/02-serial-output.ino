@@ -5,37 +5,32 @@
  * Demonstrates Serial (UART) output, chip info, and timing functions.
  * All output is visible in the QEMU console.
  *
+ * The counter and a faster simulated ADC sampler are two CoopScheduler jobs
+ * (arduino/libraries/CoopScheduler) running side by side without delay().
+ * When the counter reaches 10 the scheduler prints its statistics, both
+ * jobs are cancelled, and loop() keeps calling sched.run(), which now just
+ * sleeps.
+ *
  * To run in QEMU:
  *   cd esp32-qemu
  *   ./run-arduino-example.sh 02-serial-output
  */
 
-void setup() {
-    Serial.begin(115200);
+#include <CoopScheduler.h>
 
-    Serial.println();
-    Serial.println("==========================================");
-    Serial.println("  Arduino Serial Output (ESP32 QEMU)");
-    Serial.println("  IoT Course - Spring 2026");
-    Serial.println("==========================================");
-    Serial.println();
+CoopScheduler sched;
+CoopJobId counterJob;
+CoopJobId samplerJob;
 
-    // Print chip information
-    Serial.printf("ESP32 Chip Model:    %s\n", ESP.getChipModel());
-    Serial.printf("Chip Revision:       %d\n", ESP.getChipRevision());
-    Serial.printf("CPU Frequency:       %d MHz\n", ESP.getCpuFreqMHz());
-    Serial.printf("Flash Size:          %d bytes\n", ESP.getFlashChipSize());
-    Serial.printf("Free Heap:           %d bytes\n", ESP.getFreeHeap());
-    Serial.printf("SDK Version:         %s\n", ESP.getSdkVersion());
-    Serial.println();
+int counter = 0;
+int simulated = 0;
 
-    Serial.println("Starting counter (10 iterations)...");
-    Serial.println();
+// Simulated sensor reading, 10x faster than the counter prints it
+void sample(void *arg) {
+    simulated = random(200, 300);
 }
 
-int counter = 0;
-
-void loop() {
+void count(void *arg) {
     unsigned long uptime = millis();
 
     Serial.printf("[%8lu ms] Counter: %d", uptime, counter);
@@ -47,26 +42,54 @@ void loop() {
         Serial.print("  (odd)");
     }
 
-    // Simulated sensor reading using analogRead noise
-    int simulated = random(200, 300);
     float voltage = simulated * (3.3 / 4095.0);
     Serial.printf("  | Simulated ADC: %d (%.2fV)", simulated, voltage);
 
     Serial.println();
 
     counter++;
-    delay(1000);
 
     if (counter >= 10) {
+        Serial.println();
+        sched.printStats();
+        sched.cancel(counterJob);
+        sched.cancel(samplerJob);
         Serial.println();
         Serial.println("==========================================");
         Serial.println("  Demo complete!");
         Serial.println("  Press Ctrl+A then X to exit QEMU");
         Serial.println("==========================================");
-
-        // Stop looping
-        while (true) {
-            delay(1000);
-        }
     }
 }
+
+void setup() {
+    Serial.begin(115200);
+
+    Serial.println();
+    Serial.println("==========================================");
+    Serial.println("  Arduino Serial Output (ESP32 QEMU)");
+    Serial.println("  IoT Course - Spring 2026");
+    Serial.println("==========================================");
+    Serial.println();
+
+    // Print chip information
+    Serial.printf("ESP32 Chip Model:    %s\n", ESP.getChipModel());
+    Serial.printf("Chip Revision:       %d\n", ESP.getChipRevision());
+    Serial.printf("CPU Frequency:       %d MHz\n", ESP.getCpuFreqMHz());
+    Serial.printf("Flash Size:          %d bytes\n", ESP.getFlashChipSize());
+    Serial.printf("Free Heap:           %d bytes\n", ESP.getFreeHeap());
+    Serial.printf("SDK Version:         %s\n", ESP.getSdkVersion());
+    Serial.println();
+
+    Serial.println("Starting counter (10 iterations)...");
+    Serial.println();
+
+    sample(NULL);
+    samplerJob = sched.every(100, sample, NULL, "sampler");
+    counterJob = sched.every(1000, count, NULL, "counter", 0);
+}
+
+void loop() {
+    // Nothing left to do after the demo: run() sleeps up to 1 s at a time
+    sched.run();
+}
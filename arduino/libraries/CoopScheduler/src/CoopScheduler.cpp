@@ -0,0 +1,369 @@
+/*
+ * CoopScheduler - cooperative scheduler for ESP32 Arduino sketches
+ * IoT Course - Spring 2026
+ */
+
+#include "CoopScheduler.h"
+
+/* ----------------------------------------------------------------
+ * Events
+ * ---------------------------------------------------------------- */
+void CoopEvent::signal()
+{
+    pending_ = true;
+    if (sched_ != nullptr) {
+        sched_->wake();
+    }
+}
+
+void IRAM_ATTR CoopEvent::signalFromISR()
+{
+    pending_ = true;
+    if (sched_ != nullptr && sched_->loop_task_ != nullptr) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(sched_->loop_task_, &woken);
+        if (woken) {
+            portYIELD_FROM_ISR();
+        }
+    }
+}
+
+void CoopScheduler::wake()
+{
+    if (loop_task_ != nullptr) {
+        xTaskNotifyGive(loop_task_);
+    }
+}
+
+/* ----------------------------------------------------------------
+ * Deadline heap: heap_[0] is the job due first
+ * ---------------------------------------------------------------- */
+bool CoopScheduler::heapLess(uint8_t i, uint8_t j) const
+{
+    return before(jobs_[heap_[i]].due_us, jobs_[heap_[j]].due_us);
+}
+
+void CoopScheduler::siftUp(uint8_t pos)
+{
+    while (pos > 0) {
+        uint8_t parent = (pos - 1) / 2;
+        if (!heapLess(pos, parent)) {
+            break;
+        }
+        uint8_t tmp = heap_[pos];
+        heap_[pos] = heap_[parent];
+        heap_[parent] = tmp;
+        jobs_[heap_[pos]].heap_pos = pos;
+        jobs_[heap_[parent]].heap_pos = parent;
+        pos = parent;
+    }
+}
+
+void CoopScheduler::siftDown(uint8_t pos)
+{
+    while (true) {
+        uint8_t left = 2 * pos + 1;
+        uint8_t right = left + 1;
+        uint8_t smallest = pos;
+        if (left < heap_len_ && heapLess(left, smallest)) {
+            smallest = left;
+        }
+        if (right < heap_len_ && heapLess(right, smallest)) {
+            smallest = right;
+        }
+        if (smallest == pos) {
+            break;
+        }
+        uint8_t tmp = heap_[pos];
+        heap_[pos] = heap_[smallest];
+        heap_[smallest] = tmp;
+        jobs_[heap_[pos]].heap_pos = pos;
+        jobs_[heap_[smallest]].heap_pos = smallest;
+        pos = smallest;
+    }
+}
+
+void CoopScheduler::heapPush(uint8_t id)
+{
+    uint8_t pos = heap_len_++;
+    heap_[pos] = id;
+    jobs_[id].heap_pos = pos;
+    jobs_[id].in_heap = true;
+    siftUp(pos);
+}
+
+void CoopScheduler::heapRemove(uint8_t id)
+{
+    Job &job = jobs_[id];
+    if (!job.in_heap) {
+        return;
+    }
+    uint8_t pos = job.heap_pos;
+    job.in_heap = false;
+    heap_len_--;
+    if (pos == heap_len_) {
+        return;
+    }
+    /* Move the last entry into the hole and restore the heap around it */
+    uint8_t moved = heap_[heap_len_];
+    heap_[pos] = moved;
+    jobs_[moved].heap_pos = pos;
+    siftUp(pos);
+    siftDown(jobs_[moved].heap_pos);
+}
+
+/* ----------------------------------------------------------------
+ * Adding and removing jobs
+ * ---------------------------------------------------------------- */
+CoopJobId CoopScheduler::add(Kind kind, uint32_t delay_us, CoopJobFn fn,
+                             void *arg, const char *name)
+{
+    for (int id = 0; id < COOP_SCHEDULER_MAX_JOBS; id++) {
+        /* The running job's slot is still in use until run() is done with it */
+        if (jobs_[id].kind != FREE || id == running_) {
+            continue;
+        }
+        Job &job = jobs_[id];
+        job = Job{};
+        job.kind = kind;
+        job.fn = fn;
+        job.arg = arg;
+        job.name = name;
+        job.due_us = micros() + delay_us;
+        if (kind != EVENT) {
+            heapPush(id);
+        }
+        wake();
+        return id;
+    }
+    log_e("CoopScheduler: no free job slot for %s (COOP_SCHEDULER_MAX_JOBS=%d)",
+          name, COOP_SCHEDULER_MAX_JOBS);
+    return -1;
+}
+
+CoopJobId CoopScheduler::every(uint32_t period_ms, CoopJobFn fn, void *arg,
+                               const char *name, int32_t first_ms)
+{
+    uint32_t first_us = (first_ms < 0 ? period_ms : (uint32_t)first_ms) * 1000UL;
+    CoopJobId id = add(PERIODIC, first_us, fn, arg, name);
+    if (id >= 0) {
+        jobs_[id].period_us = period_ms * 1000UL;
+    }
+    return id;
+}
+
+CoopJobId CoopScheduler::after(uint32_t delay_ms, CoopJobFn fn, void *arg,
+                               const char *name)
+{
+    return add(ONESHOT, delay_ms * 1000UL, fn, arg, name);
+}
+
+CoopJobId CoopScheduler::onEvent(CoopEvent &ev, CoopJobFn fn, void *arg,
+                                 const char *name, uint32_t timeout_ms)
+{
+    ev.sched_ = this;
+    CoopJobId id = add(EVENT, timeout_ms * 1000UL, fn, arg, name);
+    if (id >= 0) {
+        jobs_[id].event = &ev;
+        if (timeout_ms > 0) {
+            heapPush(id);
+        }
+    }
+    return id;
+}
+
+void CoopScheduler::cancel(CoopJobId id)
+{
+    if (id < 0 || id >= COOP_SCHEDULER_MAX_JOBS) {
+        return;
+    }
+    heapRemove(id);
+    jobs_[id].kind = FREE;
+}
+
+void CoopScheduler::setPeriod(CoopJobId id, uint32_t period_ms)
+{
+    if (id >= 0 && id < COOP_SCHEDULER_MAX_JOBS && jobs_[id].kind == PERIODIC) {
+        jobs_[id].period_us = period_ms * 1000UL;
+    }
+}
+
+int CoopScheduler::active() const
+{
+    int n = 0;
+    for (const Job &job : jobs_) {
+        n += job.kind != FREE;
+    }
+    return n;
+}
+
+/* ----------------------------------------------------------------
+ * FreeRTOS handoff
+ * ---------------------------------------------------------------- */
+struct SpawnCtx {
+    CoopJobFn fn;
+    void *arg;
+    CoopEvent *done;
+};
+
+static void spawn_trampoline(void *param)
+{
+    SpawnCtx *ctx = static_cast<SpawnCtx *>(param);
+    ctx->fn(ctx->arg);
+    if (ctx->done != nullptr) {
+        ctx->done->signal();
+    }
+    delete ctx;
+    vTaskDelete(NULL);
+}
+
+bool CoopScheduler::spawn(const char *name, CoopJobFn fn, void *arg,
+                          CoopEvent *done, uint32_t stack_bytes, UBaseType_t priority)
+{
+    SpawnCtx *ctx = new SpawnCtx{fn, arg, done};
+    if (xTaskCreate(spawn_trampoline, name, stack_bytes, ctx, priority, NULL) != pdPASS) {
+        delete ctx;
+        return false;
+    }
+    return true;
+}
+
+/* ----------------------------------------------------------------
+ * Main loop
+ * ---------------------------------------------------------------- */
+void CoopScheduler::runJob(uint8_t id, uint32_t due_us, bool timed_out)
+{
+    Job &job = jobs_[id];
+    uint32_t start = micros();
+    uint32_t late = before(due_us, start) ? start - due_us : 0;
+
+    running_ = id;
+    timed_out_ = timed_out;
+    job.fn(job.arg);
+    timed_out_ = false;
+    running_ = -1;
+
+    uint32_t took = micros() - start;
+    job.runs++;
+    job.late_sum_us += late;
+    if (late > job.late_max_us) {
+        job.late_max_us = late;
+    }
+    if (took > job.run_max_us) {
+        job.run_max_us = took;
+    }
+}
+
+void CoopScheduler::run(uint32_t max_sleep_ms)
+{
+    if (loop_task_ == nullptr) {
+        loop_task_ = xTaskGetCurrentTaskHandle();
+        stats_since_us_ = micros();
+    }
+    loops_++;
+    uint32_t start = micros();
+
+    /* Signalled events first: they are already late */
+    for (int id = 0; id < COOP_SCHEDULER_MAX_JOBS; id++) {
+        Job &job = jobs_[id];
+        if (job.kind == EVENT && job.event->pending_) {
+            job.event->pending_ = false;
+            heapRemove(id);
+            runJob(id, start, false);
+            job.kind = FREE;
+        }
+    }
+
+    /* Every deadline that has passed, earliest first */
+    while (heap_len_ > 0 && !before(micros(), jobs_[heap_[0]].due_us)) {
+        uint8_t id = heap_[0];
+        Job &job = jobs_[id];
+        heapRemove(id);
+        uint32_t due = job.due_us;
+
+        if (job.kind == PERIODIC) {
+            runJob(id, due, false);
+            if (job.kind != PERIODIC) {
+                continue;   /* Cancelled itself */
+            }
+            /* Stay on the grid; skip whole periods that are already over */
+            job.due_us = due + job.period_us;
+            uint32_t now = micros();
+            if (job.period_us > 0 && before(job.due_us, now)) {
+                uint32_t missed = (now - job.due_us) / job.period_us + 1;
+                job.skipped += missed;
+                job.due_us += missed * job.period_us;
+            }
+            heapPush(id);
+        } else {
+            runJob(id, due, job.kind == EVENT);
+            job.kind = FREE;
+        }
+    }
+
+    uint32_t busy = micros() - start;
+    busy_us_ += busy;
+    if (busy > run_max_us_) {
+        run_max_us_ = busy;
+    }
+
+    /* Sleep until the next deadline; an event wakes us early */
+    uint32_t sleep_us = max_sleep_ms * 1000UL;
+    if (heap_len_ > 0) {
+        uint32_t now = micros();
+        uint32_t due = jobs_[heap_[0]].due_us;
+        uint32_t until = before(now, due) ? due - now : 0;
+        if (until < sleep_us) {
+            sleep_us = until;
+        }
+    }
+    for (const Job &job : jobs_) {
+        if (job.kind == EVENT && job.event->pending_) {
+            sleep_us = 0;
+        }
+    }
+    /* Below one tick, return and let loop() call us again */
+    TickType_t ticks = pdMS_TO_TICKS(sleep_us / 1000);
+    if (ticks > 0) {
+        wakeups_++;
+        ulTaskNotifyTake(pdTRUE, ticks);
+    }
+}
+
+/* ----------------------------------------------------------------
+ * Statistics
+ * ---------------------------------------------------------------- */
+void CoopScheduler::printStats(Print &out)
+{
+    uint32_t elapsed = micros() - stats_since_us_;
+    out.printf("SCHED loops=%lu busy_pct=%.1f run_max_us=%lu wakeups=%lu jobs=%d\n",
+               (unsigned long)loops_,
+               elapsed ? 100.0 * busy_us_ / elapsed : 0.0,
+               (unsigned long)run_max_us_, (unsigned long)wakeups_, active());
+    for (const Job &job : jobs_) {
+        if (job.kind == FREE) {
+            continue;
+        }
+        out.printf("JOB %s runs=%lu late_avg_us=%lu late_max_us=%lu run_max_us=%lu skipped=%lu\n",
+                   job.name, (unsigned long)job.runs,
+                   (unsigned long)(job.runs ? job.late_sum_us / job.runs : 0),
+                   (unsigned long)job.late_max_us, (unsigned long)job.run_max_us,
+                   (unsigned long)job.skipped);
+    }
+}
+
+void CoopScheduler::resetStats()
+{
+    loops_ = 0;
+    wakeups_ = 0;
+    busy_us_ = 0;
+    run_max_us_ = 0;
+    stats_since_us_ = micros();
+    for (Job &job : jobs_) {
+        job.runs = 0;
+        job.skipped = 0;
+        job.late_sum_us = 0;
+        job.late_max_us = 0;
+        job.run_max_us = 0;
+    }
+}
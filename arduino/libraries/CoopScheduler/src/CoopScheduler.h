@@ -0,0 +1,162 @@
+/*
+ * CoopScheduler - cooperative scheduler for ESP32 Arduino sketches
+ * IoT Course - Spring 2026
+ *
+ * delay() in loop() stalls everything else the sketch does. With this
+ * library each activity is a short job, and loop() only runs the scheduler:
+ *
+ *   CoopScheduler sched;
+ *
+ *   void blink(void *arg)  { digitalWrite(LED_PIN, !digitalRead(LED_PIN)); }
+ *   void report(void *arg) { Serial.println(analogRead(34)); }
+ *
+ *   void setup() {
+ *       sched.every(500, blink, NULL, "blink");
+ *       sched.every(2000, report, NULL, "report");
+ *   }
+ *   void loop() { sched.run(); }
+ *
+ * Job kinds:
+ *   every(period)        periodic, on a fixed grid (no drift from run time)
+ *   after(delay)         one shot
+ *   onEvent(ev, timeout) runs when ev.signal() is called (from code, a
+ *                        FreeRTOS task or an ISR), or after timeout_ms
+ *                        with timedOut() true
+ *   spawn(...)           runs a long or blocking function in its own
+ *                        FreeRTOS task and signals an event when done
+ *
+ * Deadlines live in a min-heap keyed by micros(), so run() only looks at
+ * the earliest one. When nothing is due, run() sleeps on a task
+ * notification until the next deadline; CoopEvent::signal() wakes it early.
+ * Other FreeRTOS tasks and the idle task get the CPU meanwhile.
+ *
+ * Jobs must return quickly: a job that takes 50 ms delays every other job
+ * by 50 ms. printStats() shows how late each job ran and how long it took:
+ *
+ *   SCHED loops=1234 busy_pct=0.4 run_max_us=812 wakeups=40 jobs=2
+ *   JOB blink runs=20 late_avg_us=35 late_max_us=190 run_max_us=102 skipped=0
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifndef COOP_SCHEDULER_MAX_JOBS
+#define COOP_SCHEDULER_MAX_JOBS 16
+#endif
+
+typedef void (*CoopJobFn)(void *arg);
+typedef int8_t CoopJobId;   /* -1 = no job */
+
+class CoopScheduler;
+
+/* A flag that a job can wait for; signal() is safe from tasks and ISRs */
+class CoopEvent {
+public:
+    void signal();
+    void IRAM_ATTR signalFromISR();
+
+private:
+    friend class CoopScheduler;
+    volatile bool pending_ = false;
+    CoopScheduler *sched_ = nullptr;
+};
+
+class CoopScheduler {
+public:
+    /** Run fn every period_ms, first after first_ms (default: one period) */
+    CoopJobId every(uint32_t period_ms, CoopJobFn fn, void *arg = nullptr,
+                    const char *name = "job", int32_t first_ms = -1);
+
+    /** Run fn once, delay_ms from now */
+    CoopJobId after(uint32_t delay_ms, CoopJobFn fn, void *arg = nullptr,
+                    const char *name = "once");
+
+    /**
+     * Run fn once when ev is signalled, or after timeout_ms (0 = never).
+     * Inside fn, timedOut() tells which one happened.
+     */
+    CoopJobId onEvent(CoopEvent &ev, CoopJobFn fn, void *arg = nullptr,
+                      const char *name = "event", uint32_t timeout_ms = 0);
+
+    /**
+     * Run fn(arg) in a new FreeRTOS task (for blocking work such as a
+     * network request) and signal done, if given, when it returns.
+     * Returns false if the task could not be created.
+     */
+    bool spawn(const char *name, CoopJobFn fn, void *arg = nullptr,
+               CoopEvent *done = nullptr, uint32_t stack_bytes = 4096,
+               UBaseType_t priority = 1);
+
+    /** Stop a job; safe from inside the job itself */
+    void cancel(CoopJobId id);
+
+    /** Change a periodic job's period from its next run on */
+    void setPeriod(CoopJobId id, uint32_t period_ms);
+
+    /** True inside an onEvent() job that ran because of its timeout */
+    bool timedOut() const { return timed_out_; }
+
+    /** Jobs currently scheduled or waiting for an event */
+    int active() const;
+
+    /**
+     * Run every job that is due, then sleep until the next deadline or
+     * event, at most max_sleep_ms. Call it from loop().
+     */
+    void run(uint32_t max_sleep_ms = 1000);
+
+    /** Print one SCHED line and one JOB line per job */
+    void printStats(Print &out = Serial);
+    void resetStats();
+
+private:
+    friend class CoopEvent;
+
+    enum Kind : uint8_t { FREE, PERIODIC, ONESHOT, EVENT };
+
+    struct Job {
+        Kind kind;
+        bool in_heap;
+        uint8_t heap_pos;         /* Index in heap_ while in_heap */
+        CoopJobFn fn;
+        void *arg;
+        const char *name;
+        CoopEvent *event;
+        uint32_t period_us;
+        uint32_t due_us;          /* Next deadline (micros) */
+        /* Statistics */
+        uint32_t runs;
+        uint32_t skipped;         /* Periods missed because the job ran late */
+        uint64_t late_sum_us;
+        uint32_t late_max_us;
+        uint32_t run_max_us;
+    };
+
+    Job jobs_[COOP_SCHEDULER_MAX_JOBS] = {};
+    uint8_t heap_[COOP_SCHEDULER_MAX_JOBS];
+    uint8_t heap_len_ = 0;
+    bool timed_out_ = false;
+    CoopJobId running_ = -1;
+    TaskHandle_t loop_task_ = nullptr;
+
+    uint32_t loops_ = 0;
+    uint32_t wakeups_ = 0;
+    uint64_t busy_us_ = 0;
+    uint32_t run_max_us_ = 0;
+    uint32_t stats_since_us_ = 0;
+
+    CoopJobId add(Kind kind, uint32_t delay_us, CoopJobFn fn, void *arg,
+                  const char *name);
+    void runJob(uint8_t id, uint32_t due_us, bool timed_out);
+    void wake();
+
+    static bool before(uint32_t a, uint32_t b) { return (int32_t)(a - b) < 0; }
+    bool heapLess(uint8_t i, uint8_t j) const;
+    void heapPush(uint8_t id);
+    void heapRemove(uint8_t id);
+    void siftUp(uint8_t pos);
+    void siftDown(uint8_t pos);
+};
@@ -5,26 +5,769 @@ IoT Course - Spring 2026
 Endpoints:
   GET  /api/sensors           - List all sensor readings
   POST /api/sensors           - Submit a new sensor reading
-  GET  /api/sensors/latest    - Get the most recent reading
-  GET  /api/config            - Get device configuration
+  GET  /api/sensors/latest    - Get the most recent reading (any device)
+  GET  /api/devices           - Per-device summary: last seen, last values, rates
+  GET  /api/devices/<id>/latest - Most recent reading of one device
+  GET  /api/config            - Get device configuration (ETag / If-None-Match)
+  PATCH /api/config           - Change configuration values, push delta over MQTT
+  POST /api/telemetry         - Submit a resource profiler snapshot (?device=<id>)
+  GET  /api/telemetry         - Latest profiler snapshot of every device
+  POST /api/samples           - Submit a binary sample block frame (?device=<id>)
+  GET  /api/samples           - Latest decoded block per device and source
+  GET  /api/stream            - Live readings as Server-Sent Events (?device=a,b)
+  GET  /api/stream/stats      - Subscribers, queued and dropped events
+  POST /api/ota/images        - Upload a firmware release (?project=&version=)
+  GET  /api/ota/images        - Releases per project, patch bytes served
+  GET  /api/ota/patch         - Delta patch to the latest release (?project=&from=)
+  GET  /api/trace/report      - Latency per stage of traced readings (?device=&transport=)
+  GET  /api/trace/<id>        - Timestamps of one traced reading
   GET  /health                - Health check
+
+Configuration sync:
+  Every change bumps device_config["version"]. GET /api/config returns
+  ETag "v<version>" and answers 304 Not Modified to a matching
+  If-None-Match. PATCH /api/config publishes the change as a retained
+  MQTT message on esp32/config:
+      {"version": 7, "base": 6, "set": {"sample_interval_ms": 2000}}
+  Devices at version 6 apply it directly; others re-fetch /api/config.
+  The document and the last delta are saved to CONFIG_FILE on every
+  change and loaded at startup, so a restarted server continues the
+  version sequence: devices drop any version they already have, and a
+  server that started again from v1 would never reach them.
+
+Sample frames:
+  components/sample_block uploads whole blocks of samples as one binary,
+  little-endian frame: a 24-byte header (magic "SB", version, channels,
+  source, count, seq, sample rate, t0_us), the timestamp column as uint32
+  microseconds from t0, then one int16 column per channel.
+
+Live stream:
+  GET /api/stream keeps the response open and pushes every reading as it
+  is ingested, as a "reading" event (and a "samples" event per sample
+  block), instead of clients polling /api/sensors/latest:
+      curl -N localhost:5000/api/stream?device=esp32-qemu-01
+  Each event is serialized once and the same bytes are queued for every
+  matching subscriber. A subscriber's queue holds STREAM_QUEUE_LEN events;
+  when a slow client falls behind, the oldest event is dropped (or, with
+  ?drop=newest, the new one) and counted, so one stuck client never holds
+  up ingestion or the others. scripts/sse-bench.py measures how many
+  subscribers one instance keeps up with.
+
+Delta OTA:
+  Releases are app .bin files from the build, stored under OTA_DIR per
+  project (the project() name, e.g. rest-api). An image is identified by
+  the SHA-256 the build appends to it, which is also what
+  esp_partition_get_sha256() returns on the device for the running slot.
+  GET /api/ota/patch?project=rest-api&from=<sha> answers 304 when <sha> is
+  the latest release, otherwise a zlib-compressed patch that rebuilds the
+  latest image from the device's one (format in
+  components/delta_ota/include/delta_ota.h): exact copies, byte deltas
+  against the old image, and new bytes. A device whose image the server
+  does not know, or a patch that would be larger, gets the whole image in
+  the same format. Patches are built once per (from, to) pair, checked by
+  applying them, and cached on disk.
+
+Latency tracing:
+  Readings from components/latency_trace carry "trace" (an ID), "ts" (Unix
+  us when the value was read) and "tp" (when it was handed to the network),
+  from a device clock synced to the ntp-server service. Readings arrive
+  over HTTP (POST /api/sensors) or MQTT: the bridge here subscribes to
+  esp32/sensors/# and stores those too. The server adds when a reading was
+  received, stored and first returned by GET /api/sensors[/latest], and
+  /api/trace/report splits the latency into
+      sample_publish   ts -> tp        device: queueing before the send
+      publish_broker   tp -> receive   network + broker (or HTTP request)
+      broker_store     receive -> store
+      store_query      store -> first query
+  with count, p50/p95/p99/max in ms. A negative difference means the clocks
+  disagree (not synced yet); it is counted as "skewed" and left out.
+  scripts/latency-report.py prints the report.
+
+Device summaries:
+  Every stored reading also updates its device's entry in device_index:
+  the reading itself, the last non-null value of each field (so
+  temperature and humidity published as separate MQTT messages appear
+  together), a reading count and reading rates. Both device endpoints
+  read only these entries, so their cost depends on the number of
+  devices, never on the length of the history. Rates are readings per
+  minute, exponentially weighted over 1 and 10 minutes like the Unix load
+  average: they approach the true rate over the first window and decay
+  towards 0 when a device goes quiet.
+
+TLS:
+  If TLS_CERT / TLS_KEY exist (scripts/gen-certs.sh, mounted at /certs),
+  the same app is also served over HTTPS on TLS_PORT (default 5443).
+  OpenSSL keeps a server-side session cache and issues session tickets,
+  so devices can resume sessions instead of doing a full handshake.
 """
 
-from flask import Flask, request, jsonify
+import hashlib
+import json
+import math
+import os
+import queue
+import re
+import ssl
+import struct
+import threading
+import time
+import zlib
+
+from collections import OrderedDict
+from flask import Flask, Response, request, jsonify
 from datetime import datetime
+from werkzeug.serving import make_server
+
+try:
+    import paho.mqtt.client as mqtt
+except ImportError:  # Config push is optional; HTTP sync still works
+    mqtt = None
 
 app = Flask(__name__)
 
-# In-memory storage for sensor readings
+MQTT_HOST = os.environ.get("MQTT_HOST", "mqtt-broker")
+MQTT_PORT = int(os.environ.get("MQTT_PORT", "1883"))
+TOPIC_CONFIG = "esp32/config"
+TOPIC_SENSORS = "esp32/sensors/"     # esp32/sensors/<kind>, bridged into the readings
+
+TLS_CERT = os.environ.get("TLS_CERT", "/certs/server.crt")
+TLS_KEY = os.environ.get("TLS_KEY", "/certs/server.key")
+TLS_PORT = int(os.environ.get("TLS_PORT", "5443"))
+
+# In-memory storage for sensor readings (POST /api/sensors and the MQTT bridge)
 sensor_readings = []
+readings_lock = threading.Lock()
+
+# Latest resource profiler snapshot per device
+device_telemetry = {}
 
 # Device configuration
 device_config = {
+    "version": 1,
     "sample_interval_ms": 5000,
     "device_name": "esp32-qemu-01",
     "firmware_version": "1.0.0",
     "sensors_enabled": ["temperature", "humidity"]
 }
+config_lock = threading.Lock()
+
+# Last delta pushed, re-published (retained) whenever we (re)connect
+config_delta = {
+    "version": 1,
+    "base": 0,
+    "set": {k: v for k, v in device_config.items() if k != "version"},
+}
+
+mqtt_client = None
+
+# Latest decoded sample block per "<device>/<source>"
+sample_blocks = {}
+
+SAMPLE_FRAME = struct.Struct("<HBBBBHIIq")
+SAMPLE_FRAME_MAGIC = 0x4253
+
+STREAM_QUEUE_LEN = int(os.environ.get("STREAM_QUEUE_LEN", "64"))
+STREAM_KEEPALIVE_S = 15
+
+TRACE_KEEP = int(os.environ.get("TRACE_KEEP", "5000"))
+TRACE_MIN_US = 10 ** 15     # Device times before 2001: clock not synced yet
+
+CONFIG_FILE = os.environ.get("CONFIG_FILE", "/data/config/config.json")
+OTA_DIR = os.environ.get("OTA_DIR", "/data/ota")
+OTA_HEADER = struct.Struct("<4sI32sI32sI")   # magic, source size/sha, target size/sha, flags
+OTA_MAGIC = b"EDLT"
+OTA_KEY = 16            # bytes hashed to find matches in the old image
+OTA_MIN_MATCH = 16      # shortest exact match worth a copy
+ESP_IMAGE_MAGIC = 0xE9
+
+
+class Subscriber:
+    def __init__(self, devices, drop_newest):
+        self.devices = devices          # None = every device
+        self.drop_newest = drop_newest
+        self.events = queue.Queue(maxsize=STREAM_QUEUE_LEN)
+        self.dropped = 0
+
+
+class StreamHub:
+    """Fan-out of ingested readings to live SSE subscribers"""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.subscribers = set()
+        self.published = 0
+        self.queued = 0
+        self.dropped = 0
+
+    def subscribe(self, devices, drop_newest):
+        sub = Subscriber(devices, drop_newest)
+        with self.lock:
+            self.subscribers.add(sub)
+        return sub
+
+    def unsubscribe(self, sub):
+        with self.lock:
+            self.subscribers.discard(sub)
+
+    def publish(self, event, device, payload):
+        """Serialize once, then queue the same bytes for every match"""
+        data = (f"event: {event}\n"
+                f"data: {json.dumps(payload, separators=(',', ':'))}\n\n"
+                ).encode()
+        with self.lock:
+            self.published += 1
+            for sub in self.subscribers:
+                if sub.devices is not None and device not in sub.devices:
+                    continue
+                try:
+                    sub.events.put_nowait(data)
+                except queue.Full:
+                    sub.dropped += 1
+                    self.dropped += 1
+                    if sub.drop_newest:
+                        continue
+                    try:
+                        sub.events.get_nowait()
+                    except queue.Empty:
+                        pass
+                    sub.events.put_nowait(data)
+                self.queued += 1
+
+    def stats(self):
+        with self.lock:
+            return {
+                "subscribers": len(self.subscribers),
+                "queue_len": STREAM_QUEUE_LEN,
+                "published": self.published,
+                "queued": self.queued,
+                "dropped": self.dropped,
+                "backlog_max": max((s.events.qsize() for s in self.subscribers),
+                                   default=0),
+            }
+
+
+stream_hub = StreamHub()
+
+
+# ----------------------------------------------------------------
+# Latency tracing
+# ----------------------------------------------------------------
+def now_us():
+    return time.time_ns() // 1000
+
+
+def percentile(sorted_values, pct):
+    """Nearest-rank percentile of an already sorted list"""
+    index = max(0, -(-len(sorted_values) * pct // 100) - 1)
+    return sorted_values[index]
+
+
+class TraceLog:
+    """Hop timestamps of the last TRACE_KEEP traced readings"""
+
+    STAGES = (
+        ("sample_publish", "sample", "publish"),
+        ("publish_broker", "publish", "receive"),
+        ("broker_store", "receive", "store"),
+        ("store_query", "store", "query"),
+    )
+
+    def __init__(self, keep):
+        self.keep = keep
+        self.lock = threading.Lock()
+        self.records = OrderedDict()
+        self.unqueried = OrderedDict()  # Stored, not yet returned by a query
+
+    def add(self, data, device, transport, received):
+        """Record a stored reading; returns its trace ID or None"""
+        trace = data.get("trace")
+        if not isinstance(trace, str):
+            return None
+
+        def device_time(key):
+            value = data.get(key)
+            return value if isinstance(value, int) and value >= TRACE_MIN_US else None
+
+        record = {
+            "trace": trace,
+            "device": device,
+            "transport": transport,
+            "sample": device_time("ts"),
+            "publish": device_time("tp"),
+            "receive": received,
+            "store": now_us(),
+            "query": None,
+        }
+        with self.lock:
+            self.records[trace] = record
+            self.records.move_to_end(trace)
+            self.unqueried[trace] = None
+            while len(self.records) > self.keep:
+                old, _ = self.records.popitem(last=False)
+                self.unqueried.pop(old, None)
+        return trace
+
+    def queried(self, trace=None):
+        """Stamp the first query of one reading, or of all pending ones"""
+        t = now_us()
+        with self.lock:
+            if trace is None:
+                pending, self.unqueried = list(self.unqueried), OrderedDict()
+            elif trace in self.unqueried:
+                del self.unqueried[trace]
+                pending = [trace]
+            else:
+                return
+            for trace in pending:
+                record = self.records.get(trace)
+                if record is not None and record["query"] is None:
+                    record["query"] = t
+
+    def get(self, trace):
+        with self.lock:
+            record = self.records.get(trace)
+            return dict(record) if record else None
+
+    def report(self, device=None, transport=None):
+        with self.lock:
+            records = [r for r in self.records.values()
+                       if (device is None or r["device"] == device)
+                       and (transport is None or r["transport"] == transport)]
+        stages = {}
+        for name, start, end in self.STAGES:
+            values = []
+            skewed = 0
+            for r in records:
+                if r[start] is None or r[end] is None:
+                    continue
+                delta = r[end] - r[start]
+                if delta < 0:
+                    skewed += 1
+                else:
+                    values.append(delta)
+            values.sort()
+            stage = {"n": len(values), "skewed": skewed}
+            if values:
+                stage.update({
+                    "p50_ms": round(percentile(values, 50) / 1000, 3),
+                    "p95_ms": round(percentile(values, 95) / 1000, 3),
+                    "p99_ms": round(percentile(values, 99) / 1000, 3),
+                    "max_ms": round(values[-1] / 1000, 3),
+                })
+            stages[name] = stage
+        return {
+            "traces": len(records),
+            "untimed": sum(1 for r in records if r["sample"] is None),
+            "stages": stages,
+        }
+
+
+trace_log = TraceLog(TRACE_KEEP)
+
+
+# ----------------------------------------------------------------
+# Device summaries
+# ----------------------------------------------------------------
+READING_META = ("id", "received_at", "device", "trace", "reading_id")
+RATE_WINDOWS_S = (60, 600)
+
+
+class DeviceIndex:
+    """Latest reading, last values and reading rates of every device,
+    kept up to date on ingest so queries never scan the history"""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.devices = {}
+
+    def update(self, reading):
+        now = time.monotonic()
+        with self.lock:
+            entry = self.devices.get(reading["device"])
+            if entry is None:
+                entry = self.devices[reading["device"]] = {
+                    "first_seen": reading["received_at"],
+                    "readings": 0,
+                    "rates": [0.0] * len(RATE_WINDOWS_S),
+                    "values": {},
+                    "updated": now,
+                }
+            # Decay each rate to now, then count this reading
+            elapsed = now - entry["updated"]
+            entry["rates"] = [rate * math.exp(-elapsed / window) + 1.0 / window
+                              for rate, window in zip(entry["rates"], RATE_WINDOWS_S)]
+            entry["updated"] = now
+            entry["readings"] += 1
+            entry["latest"] = reading
+            for key, value in reading.items():
+                if key not in READING_META and value is not None:
+                    entry["values"][key] = value
+
+    def latest(self, device):
+        with self.lock:
+            entry = self.devices.get(device)
+            return entry["latest"] if entry else None
+
+    def summary(self):
+        now = time.monotonic()
+        with self.lock:
+            devices = []
+            for device, entry in sorted(self.devices.items()):
+                elapsed = now - entry["updated"]
+                devices.append({
+                    "device": device,
+                    "first_seen": entry["first_seen"],
+                    "last_seen": entry["latest"]["received_at"],
+                    "idle_s": round(elapsed, 1),
+                    "readings": entry["readings"],
+                    "values": dict(entry["values"]),
+                    "per_min": {
+                        f"{window // 60}m": round(60 * rate * math.exp(-elapsed / window), 2)
+                        for rate, window in zip(entry["rates"], RATE_WINDOWS_S)
+                    },
+                })
+        return devices
+
+
+device_index = DeviceIndex()
+
+
+def store_reading(data, transport, received, **values):
+    """Append a reading, push it to the live stream and record its trace"""
+    device = data.get("device", "unknown")
+    with readings_lock:
+        reading = {
+            "id": len(sensor_readings) + 1,
+            "received_at": datetime.now().isoformat(),
+            "device": device,
+            **values,
+        }
+        trace = trace_log.add(data, device, transport, received)
+        if trace is not None:
+            reading["trace"] = trace
+        sensor_readings.append(reading)
+        device_index.update(reading)
+    stream_hub.publish("reading", device, reading)
+    return reading
+
+
+# ----------------------------------------------------------------
+# Delta OTA
+# ----------------------------------------------------------------
+def image_id(image):
+    """SHA-256 the device reports for this image (the appended digest)"""
+    if len(image) > 32 and hashlib.sha256(image[:-32]).digest() == image[-32:]:
+        return image[-32:].hex()
+    return hashlib.sha256(image).hexdigest()
+
+
+def _match_forward(a, i, b, j):
+    """Length of the common run of a[i:] and b[j:], compared in chunks"""
+    n = min(len(a) - i, len(b) - j)
+    k = 0
+    step = 64
+    while k < n:
+        m = min(step, n - k)
+        if a[i + k:i + k + m] == b[j + k:j + k + m]:
+            k += m
+            step = min(step * 2, 1 << 16)
+        elif m > 8:
+            step = m // 2
+        else:
+            while k < n and a[i + k] == b[j + k]:
+                k += 1
+            break
+    return k
+
+
+def _approx_forward(src, s, dst, d):
+    """Longest run from (s, d) where most bytes still match (bsdiff's idea:
+    relinked code differs from the old image in a few bytes per word)"""
+    n = min(len(src) - s, len(dst) - d)
+    score = best_score = best = 0
+    for i in range(n):
+        score += 1 if src[s + i] == dst[d + i] else -1
+        if score > best_score:
+            best_score, best = score, i + 1
+        elif i - best > 64:
+            break
+    return best
+
+
+def make_delta_ops(src, dst):
+    """Operations that rebuild dst from src, front to back"""
+    index = {}
+    for off in range(0, len(src) - OTA_KEY + 1, 4):
+        index.setdefault(src[off:off + OTA_KEY], off)
+
+    ops = bytearray()
+
+    def literal(start, end, cursor):
+        # Bytes without an exact match: a delta against the old image where
+        # the previous copy left off, unless they are unrelated to it
+        while start < end:
+            n = end - start
+            delta = None
+            if 0 <= cursor < len(src):
+                n = min(n, len(src) - cursor)
+                delta = bytes((dst[start + i] - src[cursor + i]) & 0xFF
+                              for i in range(n))
+                if delta.count(0) * 2 < n:
+                    delta = None
+            if delta is not None:
+                ops.extend(struct.pack("<cII", b"D", cursor, n))
+                ops.extend(delta)
+                cursor += n
+            else:
+                ops.extend(struct.pack("<cI", b"I", n))
+                ops.extend(dst[start:start + n])
+            start += n
+
+    pos = pending = cursor = 0
+    while pos <= len(dst) - OTA_KEY:
+        s = index.get(dst[pos:pos + OTA_KEY])
+        if s is None:
+            pos += 1
+            continue
+        back = 0
+        while (pos - back > pending and s - back > 0
+               and dst[pos - back - 1] == src[s - back - 1]):
+            back += 1
+        length = back + OTA_KEY + _match_forward(src, s + OTA_KEY,
+                                                 dst, pos + OTA_KEY)
+        if length < OTA_MIN_MATCH:
+            pos += 1
+            continue
+        start, s = pos - back, s - back
+        literal(pending, start, cursor)
+        ops.extend(struct.pack("<cII", b"C", s, length))
+        pos, cursor = start + length, s + length
+        approx = _approx_forward(src, cursor, dst, pos)
+        if approx:
+            literal(pos, pos + approx, cursor)
+            pos += approx
+            cursor += approx
+        pending = pos
+    literal(pending, len(dst), cursor)
+    return bytes(ops)
+
+
+def apply_delta(src, patch):
+    """Rebuild the target image; the device does the same in delta_ota.c"""
+    data = zlib.decompress(patch)
+    magic, src_size, _, dst_size, _, _ = OTA_HEADER.unpack_from(data)
+    if magic != OTA_MAGIC:
+        raise ValueError("bad magic")
+    out = bytearray()
+    i = OTA_HEADER.size
+    while i < len(data):
+        op = data[i:i + 1]
+        if op == b"I":
+            (n,) = struct.unpack_from("<I", data, i + 1)
+            out += data[i + 5:i + 5 + n]
+            i += 5 + n
+            continue
+        s, n = struct.unpack_from("<II", data, i + 1)
+        if op == b"C":
+            out += src[s:s + n]
+            i += 9
+        elif op == b"D":
+            out += bytes((a + b) & 0xFF
+                         for a, b in zip(src[s:s + n], data[i + 9:i + 9 + n]))
+            i += 9 + n
+        else:
+            raise ValueError(f"unknown op {op!r}")
+    if len(out) != dst_size:
+        raise ValueError("wrong output size")
+    return bytes(out)
+
+
+def build_patch(src, dst):
+    """Delta from src to dst, or the full image when src is None"""
+    dst_sha = bytes.fromhex(image_id(dst))
+    if src is None:
+        header = OTA_HEADER.pack(OTA_MAGIC, 0, bytes(32), len(dst), dst_sha, 0)
+        return zlib.compress(header + struct.pack("<cI", b"I", len(dst)) + dst, 9)
+    header = OTA_HEADER.pack(OTA_MAGIC, len(src), bytes.fromhex(image_id(src)),
+                             len(dst), dst_sha, 0)
+    return zlib.compress(header + make_delta_ops(src, dst), 9)
+
+
+# One directory level under OTA_DIR; no dots, so never "." or ".."
+OTA_PROJECT_RE = re.compile(r"[A-Za-z0-9][A-Za-z0-9_-]{0,63}")
+
+
+class OtaStore:
+    """Firmware releases and cached patches under OTA_DIR/<project>/"""
+
+    def __init__(self, root):
+        self.root = root
+        self.lock = threading.Lock()
+        self.patches_served = 0
+        self.patch_bytes = 0
+        self.image_bytes = 0     # What the same updates cost as full images
+
+    def _dir(self, project):
+        if not project or not OTA_PROJECT_RE.fullmatch(project):
+            raise ValueError("bad project name")
+        return os.path.join(self.root, project)
+
+    def _meta(self, project):
+        try:
+            with open(os.path.join(self._dir(project), "releases.json")) as f:
+                return json.load(f)
+        except FileNotFoundError:
+            return {"latest": None, "images": {}}
+
+    def add(self, project, version, image):
+        sha = image_id(image)
+        path = self._dir(project)
+        with self.lock:
+            os.makedirs(os.path.join(path, "patches"), exist_ok=True)
+            with open(os.path.join(path, f"{sha}.bin"), "wb") as f:
+                f.write(image)
+            meta = self._meta(project)
+            meta["images"][sha] = {"version": version, "size": len(image),
+                                   "uploaded": datetime.now().isoformat()}
+            meta["latest"] = sha
+            with open(os.path.join(path, "releases.json"), "w") as f:
+                json.dump(meta, f, indent=1)
+        return sha
+
+    def listing(self):
+        projects = {}
+        if os.path.isdir(self.root):
+            for project in sorted(os.listdir(self.root)):
+                # Stray files and names add() would not create
+                if (not OTA_PROJECT_RE.fullmatch(project) or
+                        not os.path.isdir(os.path.join(self.root, project))):
+                    continue
+                projects[project] = self._meta(project)
+        return {"projects": projects,
+                "served": {"patches": self.patches_served,
+                           "patch_bytes": self.patch_bytes,
+                           "image_bytes": self.image_bytes}}
+
+    def patch(self, project, from_sha):
+        """(patch bytes, kind, latest sha, latest release) or None if no
+        release; patch is None when from_sha is already the latest"""
+        path = self._dir(project)
+        meta = self._meta(project)
+        latest = meta["latest"]
+        if latest is None:
+            return None
+        release = meta["images"][latest]
+        if from_sha == latest:
+            return None, "none", latest, release
+
+        known = from_sha in meta["images"]
+        cache = os.path.join(path, "patches",
+                             f"{from_sha if known else 'full'}-{latest}.patch")
+        with self.lock:
+            if os.path.exists(cache):
+                with open(cache, "rb") as f:
+                    patch = f.read()
+            else:
+                with open(os.path.join(path, f"{latest}.bin"), "rb") as f:
+                    dst = f.read()
+                patch = build_patch(None, dst)
+                if known:
+                    with open(os.path.join(path, f"{from_sha}.bin"), "rb") as f:
+                        src = f.read()
+                    delta = build_patch(src, dst)
+                    if apply_delta(src, delta) != dst:
+                        raise RuntimeError("delta does not reproduce the image")
+                    if len(delta) < len(patch):
+                        patch = delta
+                with open(cache, "wb") as f:
+                    f.write(patch)
+            self.patches_served += 1
+            self.patch_bytes += len(patch)
+            self.image_bytes += release["size"]
+        header = zlib.decompressobj().decompress(patch, 8)
+        kind = "delta" if struct.unpack_from("<I", header, 4)[0] else "full"
+        return patch, kind, latest, release
+
+
+ota_store = OtaStore(OTA_DIR)
+
+
+def config_etag():
+    return f'"v{device_config["version"]}"'
+
+
+def load_config():
+    """Restore the config document and last delta saved by save_config()"""
+    global config_delta
+    try:
+        with open(CONFIG_FILE) as f:
+            saved = json.load(f)
+    except FileNotFoundError:
+        return
+    except ValueError as e:
+        print(f"[CONFIG] Ignoring unreadable {CONFIG_FILE}: {e}")
+        return
+    device_config.clear()
+    device_config.update(saved["config"])
+    config_delta = saved["delta"]
+    print(f"[CONFIG] v{device_config['version']} loaded from {CONFIG_FILE}")
+
+
+def save_config():
+    """Write the config document and last delta (config_lock held)"""
+    os.makedirs(os.path.dirname(CONFIG_FILE), exist_ok=True)
+    tmp = CONFIG_FILE + ".tmp"
+    with open(tmp, "w") as f:
+        json.dump({"config": device_config, "delta": config_delta}, f, indent=1)
+    os.replace(tmp, CONFIG_FILE)
+
+
+def publish_config_delta():
+    if mqtt_client is None:
+        return
+    mqtt_client.publish(TOPIC_CONFIG, json.dumps(config_delta,
+                                                 separators=(",", ":")),
+                        qos=1, retain=True)
+
+
+def on_sensor_message(client, userdata, msg):
+    """Bridge: store esp32/sensors/<kind> messages like POSTed readings"""
+    received = now_us()
+    if not msg.topic.startswith(TOPIC_SENSORS):
+        return
+    try:
+        data = json.loads(msg.payload)
+    except ValueError:
+        return
+    if not isinstance(data, dict) or "value" not in data:
+        return
+    kind = msg.topic[len(TOPIC_SENSORS):]
+    reading = store_reading(data, "mqtt", received,
+                            **{kind: data["value"], "reading_id": data.get("reading")})
+    print(f"[SENSOR DATA] Device={reading['device']} {kind}={data['value']} (mqtt)")
+
+
+def start_mqtt():
+    """Connect to the broker in the background; retry forever."""
+    global mqtt_client
+    if mqtt is None:
+        print("[MQTT] paho-mqtt not installed, config push disabled")
+        return
+
+    client = mqtt.Client(client_id="iot-api-server")
+
+    def on_connect(client, userdata, flags, rc):
+        print(f"[MQTT] Connected to {MQTT_HOST}:{MQTT_PORT} (rc={rc})")
+        with config_lock:
+            publish_config_delta()
+        client.subscribe(TOPIC_SENSORS + "#", qos=0)
+
+    client.on_connect = on_connect
+    client.on_message = on_sensor_message
+    client.reconnect_delay_set(min_delay=1, max_delay=30)
+    client.connect_async(MQTT_HOST, MQTT_PORT, keepalive=60)
+    client.loop_start()
+    mqtt_client = client
 
 
 @app.route("/health", methods=["GET"])
@@ -34,28 +777,55 @@ def health():
 
 @app.route("/api/config", methods=["GET"])
 def get_config():
-    return jsonify(device_config)
+    with config_lock:
+        etag = config_etag()
+        if etag in request.headers.get("If-None-Match", ""):
+            return "", 304, {"ETag": etag}
+        response = jsonify(device_config)
+    response.headers["ETag"] = etag
+    return response
+
+
+@app.route("/api/config", methods=["PATCH"])
+def patch_config():
+    global config_delta
+    data = request.get_json(silent=True)
+    if not isinstance(data, dict):
+        return jsonify({"error": "Invalid JSON body"}), 400
+    data.pop("version", None)
+
+    with config_lock:
+        changed = {k: v for k, v in data.items() if device_config.get(k) != v}
+        if changed:
+            base = device_config["version"]
+            device_config.update(changed)
+            device_config["version"] = base + 1
+            config_delta = {"version": base + 1, "base": base, "set": changed}
+            save_config()
+            publish_config_delta()
+            print(f"[CONFIG] v{base + 1}: {changed}")
+        response = jsonify(device_config)
+        response.headers["ETag"] = config_etag()
+    return response
 
 
 @app.route("/api/sensors", methods=["GET"])
 def get_sensors():
+    trace_log.queried()
     return jsonify({"readings": sensor_readings, "count": len(sensor_readings)})
 
 
 @app.route("/api/sensors", methods=["POST"])
 def post_sensor():
+    received = now_us()
     data = request.get_json(silent=True)
     if not data:
         return jsonify({"error": "Invalid JSON body"}), 400
 
-    reading = {
-        "id": len(sensor_readings) + 1,
-        "received_at": datetime.now().isoformat(),
-        "device": data.get("device", "unknown"),
-        "temperature": data.get("temperature"),
-        "humidity": data.get("humidity"),
-    }
-    sensor_readings.append(reading)
+    reading = store_reading(data, "http", received,
+                            temperature=data.get("temperature"),
+                            humidity=data.get("humidity"),
+                            reading_id=data.get("reading_id"))
 
     print(f"[SENSOR DATA] Device={reading['device']} "
           f"Temp={reading['temperature']} Humidity={reading['humidity']}")
@@ -63,16 +833,218 @@ def post_sensor():
     return jsonify(reading), 201
 
 
+@app.route("/api/telemetry", methods=["POST"])
+def post_telemetry():
+    data = request.get_json(silent=True)
+    if not data:
+        return jsonify({"error": "Invalid JSON body"}), 400
+
+    device = request.args.get("device", "unknown")
+    device_telemetry[device] = {
+        "received_at": datetime.now().isoformat(),
+        "profile": data,
+    }
+
+    heap = data.get("heap", [])
+    if len(heap) == 4:
+        print(f"[TELEMETRY] Device={device} HeapFree={heap[0]} "
+              f"Largest={heap[2]} Frag={heap[3]}%")
+
+    return "", 204
+
+
+@app.route("/api/telemetry", methods=["GET"])
+def get_telemetry():
+    return jsonify(device_telemetry)
+
+
+def decode_sample_frame(data):
+    """Decode a sample_block frame into columns; raise ValueError if malformed"""
+    if len(data) < SAMPLE_FRAME.size:
+        raise ValueError("short header")
+    (magic, version, channels, source, _, count,
+     seq, rate_hz, t0_us) = SAMPLE_FRAME.unpack_from(data)
+    if magic != SAMPLE_FRAME_MAGIC or version != 1:
+        raise ValueError("bad magic or version")
+    if len(data) != SAMPLE_FRAME.size + count * (4 + 2 * channels):
+        raise ValueError("length does not match header")
+    offset = SAMPLE_FRAME.size
+    t_offset_us = list(struct.unpack_from(f"<{count}I", data, offset))
+    offset += 4 * count
+    columns = []
+    for _ in range(channels):
+        columns.append(list(struct.unpack_from(f"<{count}h", data, offset)))
+        offset += 2 * count
+    return {
+        "source": source,
+        "seq": seq,
+        "sample_rate_hz": rate_hz,
+        "t0_us": t0_us,
+        "count": count,
+        "t_offset_us": t_offset_us,
+        "channels": columns,
+    }
+
+
+@app.route("/api/samples", methods=["POST"])
+def post_samples():
+    try:
+        block = decode_sample_frame(request.get_data())
+    except (ValueError, struct.error) as e:
+        return jsonify({"error": f"Invalid sample frame: {e}"}), 400
+
+    device = request.args.get("device", "unknown")
+    block["received_at"] = datetime.now().isoformat()
+    sample_blocks[f"{device}/{block['source']}"] = block
+    stream_hub.publish("samples", device, {
+        "device": device,
+        **{k: v for k, v in block.items()
+           if k not in ("t_offset_us", "channels")},
+        "channels": len(block["channels"]),
+    })
+
+    print(f"[SAMPLES] Device={device} Source={block['source']} "
+          f"Seq={block['seq']} Samples={block['count']}x{len(block['channels'])} "
+          f"Bytes={request.content_length}")
+    return "", 204
+
+
+@app.route("/api/samples", methods=["GET"])
+def get_samples():
+    return jsonify(sample_blocks)
+
+
+@app.route("/api/stream", methods=["GET"])
+def stream():
+    devices = request.args.get("device")
+    devices = set(devices.split(",")) if devices else None
+    sub = stream_hub.subscribe(devices, request.args.get("drop") == "newest")
+
+    def events():
+        try:
+            yield b": connected\n\n"
+            while True:
+                try:
+                    yield sub.events.get(timeout=STREAM_KEEPALIVE_S)
+                except queue.Empty:
+                    # Comment line: keeps proxies open, detects closed clients
+                    yield b": keepalive\n\n"
+        finally:
+            stream_hub.unsubscribe(sub)
+
+    return Response(events(), mimetype="text/event-stream",
+                    headers={"Cache-Control": "no-cache",
+                             "X-Accel-Buffering": "no"})
+
+
+@app.route("/api/stream/stats", methods=["GET"])
+def stream_stats():
+    return jsonify(stream_hub.stats())
+
+
+@app.route("/api/ota/images", methods=["POST"])
+def post_ota_image():
+    image = request.get_data()
+    if not image or image[0] != ESP_IMAGE_MAGIC:
+        return jsonify({"error": "Not an ESP32 app image (.bin)"}), 400
+    project = request.args.get("project", "")
+    version = request.args.get("version", "")
+    try:
+        sha = ota_store.add(project, version, image)
+    except ValueError as e:
+        return jsonify({"error": str(e)}), 400
+    print(f"[OTA] Release project={project} version={version} "
+          f"sha={sha[:8]} bytes={len(image)}")
+    return jsonify({"project": project, "version": version,
+                    "sha256": sha, "size": len(image)}), 201
+
+
+@app.route("/api/ota/images", methods=["GET"])
+def get_ota_images():
+    return jsonify(ota_store.listing())
+
+
+@app.route("/api/ota/patch", methods=["GET"])
+def get_ota_patch():
+    project = request.args.get("project", "")
+    from_sha = request.args.get("from", "").lower()
+    try:
+        result = ota_store.patch(project, from_sha)
+    except ValueError as e:
+        return jsonify({"error": str(e)}), 400
+    if result is None:
+        return jsonify({"error": f"No release for {project}"}), 404
+    patch, kind, latest, release = result
+    if patch is None:
+        return "", 304
+    print(f"[OTA] Patch project={project} from={from_sha[:8]} to={latest[:8]} "
+          f"kind={kind} bytes={len(patch)} image_bytes={release['size']}")
+    return Response(patch, mimetype="application/octet-stream",
+                    headers={"X-Patch-Kind": kind,
+                             "X-Image-Sha256": latest,
+                             "X-Image-Version": release["version"]})
+
+
 @app.route("/api/sensors/latest", methods=["GET"])
 def get_latest():
     if not sensor_readings:
         return jsonify({"error": "No readings yet"}), 404
-    return jsonify(sensor_readings[-1])
+    reading = sensor_readings[-1]
+    if "trace" in reading:
+        trace_log.queried(reading["trace"])
+    return jsonify(reading)
+
+
+@app.route("/api/devices", methods=["GET"])
+def get_devices():
+    devices = device_index.summary()
+    return jsonify({"devices": devices, "count": len(devices)})
+
+
+@app.route("/api/devices/<device>/latest", methods=["GET"])
+def get_device_latest(device):
+    reading = device_index.latest(device)
+    if reading is None:
+        return jsonify({"error": f"No readings from {device}"}), 404
+    if "trace" in reading:
+        trace_log.queried(reading["trace"])
+    return jsonify(reading)
+
+
+@app.route("/api/trace/report", methods=["GET"])
+def get_trace_report():
+    return jsonify(trace_log.report(request.args.get("device"),
+                                    request.args.get("transport")))
+
+
+@app.route("/api/trace/<trace>", methods=["GET"])
+def get_trace(trace):
+    record = trace_log.get(trace)
+    if record is None:
+        return jsonify({"error": f"Unknown trace {trace}"}), 404
+    return jsonify(record)
+
+
+def start_tls():
+    """Serve the app over HTTPS as well, if certificates are mounted"""
+    if not (os.path.exists(TLS_CERT) and os.path.exists(TLS_KEY)):
+        print(f"No certificate at {TLS_CERT}, HTTPS disabled "
+              "(run scripts/gen-certs.sh)")
+        return
+    context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+    context.load_cert_chain(TLS_CERT, TLS_KEY)
+    server = make_server("0.0.0.0", TLS_PORT, app, threaded=True,
+                         ssl_context=context)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    print(f"  Listening on https://0.0.0.0:{TLS_PORT}")
 
 
 if __name__ == "__main__":
     print("=" * 50)
     print("  IoT Sensor API Server")
     print("  Listening on http://0.0.0.0:5000")
+    load_config()
+    start_tls()
     print("=" * 50)
+    start_mqtt()
     app.run(host="0.0.0.0", port=5000, debug=False)
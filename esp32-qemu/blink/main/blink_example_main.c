@@ -7,12 +7,16 @@
    CONDITIONS OF ANY KIND, either express or implied.
 */
 #include <stdio.h>
+#include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
 #include "led_strip.h"
 #include "sdkconfig.h"
+#if CONFIG_BLINK_LED_STRIP_ANIM
+#include "led_anim.h"
+#endif
 
 static const char *TAG = "example";
 
@@ -57,6 +61,63 @@ static void configure_led(void)
     led_strip_clear(led_strip);
 }
 
+#elif CONFIG_BLINK_LED_STRIP_ANIM
+
+/* Hue (0..255) to a fully saturated color, integer only */
+static led_rgb_t hue_to_rgb(uint8_t hue)
+{
+    uint8_t sector = hue / 43;
+    uint8_t rise = (hue - sector * 43) * 6;
+    uint8_t fall = 255 - rise;
+    switch (sector) {
+    case 0:  return (led_rgb_t){ 255, rise, 0 };
+    case 1:  return (led_rgb_t){ fall, 255, 0 };
+    case 2:  return (led_rgb_t){ 0, 255, rise };
+    case 3:  return (led_rgb_t){ 0, fall, 255 };
+    case 4:  return (led_rgb_t){ rise, 0, 255 };
+    default: return (led_rgb_t){ 255, 0, fall };
+    }
+}
+
+/* Called by led_anim once per frame: a rainbow scrolling along the strip
+   while the LED is "on"; one dark frame when it turns "off", then nothing
+   changes and led_anim skips sending until it turns on again. */
+static bool render_rainbow(led_rgb_t *pixels, size_t n, uint32_t frame, int64_t now_us, void *ctx)
+{
+    static bool was_on;
+    if (!s_led_state) {
+        bool changed = was_on;
+        if (changed) {
+            memset(pixels, 0, n * sizeof(*pixels));
+        }
+        was_on = false;
+        return changed;
+    }
+    was_on = true;
+    uint8_t offset = frame * 2;
+    for (size_t i = 0; i < n; i++) {
+        pixels[i] = hue_to_rgb(offset + (i * 256) / n);
+    }
+    return true;
+}
+
+static void blink_led(void)
+{
+    /* The animation task picks up s_led_state on its next frame */
+}
+
+static void configure_led(void)
+{
+    ESP_LOGI(TAG, "Example configured to animate a %d LED strip!", CONFIG_BLINK_STRIP_LEDS);
+    led_anim_config_t cfg = {
+        .gpio = BLINK_GPIO,
+        .num_leds = CONFIG_BLINK_STRIP_LEDS,
+        .fps = CONFIG_BLINK_STRIP_FPS,
+        .brightness = 64,
+    };
+    ESP_ERROR_CHECK(led_anim_start(&cfg, render_rainbow, NULL));
+}
+
 #elif CONFIG_BLINK_LED_GPIO
 
 static void blink_led(void)
@@ -0,0 +1,328 @@
+/**
+ * Accelerometer DSP: filtered statistics and a vibration spectrum per block
+ * IoT Course - Spring 2026
+ */
+
+#include "accel_dsp.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N       ACCEL_DSP_N
+#define LOG2N   CONFIG_ACCEL_DSP_LOG2_BLOCK
+#define HALF    (N / 2)
+
+/* FFT input is scaled so the largest sample fits 14 bits: with a halving
+ * per stage no butterfly can overflow int16_t */
+#define FFT_INPUT_BITS 14
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Q15 tables, shared by every accel_dsp_t */
+static int16_t twiddle_cos[HALF];      /* cos(2 pi k / N) */
+static int16_t twiddle_sin[HALF];      /* -sin(2 pi k / N) */
+static int16_t hann_q15[N];
+static uint16_t bitrev[N];
+static int tables_ready;
+
+static int16_t to_q15(double v)
+{
+    long q = lround(v * 32767.0);
+    return (int16_t)(q > 32767 ? 32767 : q < -32768 ? -32768 : q);
+}
+
+static void build_tables(void)
+{
+    if (tables_ready) {
+        return;
+    }
+    for (int k = 0; k < HALF; k++) {
+        twiddle_cos[k] = to_q15(cos(2 * M_PI * k / N));
+        twiddle_sin[k] = to_q15(-sin(2 * M_PI * k / N));
+    }
+    for (int n = 0; n < N; n++) {
+        hann_q15[n] = to_q15(0.5 - 0.5 * cos(2 * M_PI * n / N));
+        unsigned r = 0;
+        for (int b = 0; b < LOG2N; b++) {
+            r |= ((n >> b) & 1) << (LOG2N - 1 - b);
+        }
+        bitrev[n] = r;
+    }
+    tables_ready = 1;
+}
+
+void accel_dsp_init(accel_dsp_t *d)
+{
+    memset(d, 0, sizeof(*d));
+    build_tables();
+}
+
+/* ----------------------------------------------------------------
+ * Shared feature extraction from a one-sided power spectrum
+ * power[k] for k = 1 .. N/2-1 (DC is removed by the high-pass)
+ * ---------------------------------------------------------------- */
+static int band_of(int k)
+{
+    int b = (k - 1) * ACCEL_DSP_BANDS / (HALF - 1);
+    return b < ACCEL_DSP_BANDS ? b : ACCEL_DSP_BANDS - 1;
+}
+
+/* ----------------------------------------------------------------
+ * Fixed point
+ * ---------------------------------------------------------------- */
+static uint32_t isqrt_u64(uint64_t v)
+{
+    uint64_t res = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+    while (bit > v) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (v >= res + bit) {
+            v -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)res;
+}
+
+/* In-place radix-2 decimation-in-time FFT, Q15, output scaled by 1/N */
+static void fft_q15(int16_t *re, int16_t *im)
+{
+    for (int n = 0; n < N; n++) {
+        int r = bitrev[n];
+        if (r > n) {
+            int16_t t = re[n];
+            re[n] = re[r];
+            re[r] = t;
+            t = im[n];
+            im[n] = im[r];
+            im[r] = t;
+        }
+    }
+
+    for (int size = 2, step = HALF; size <= N; size <<= 1, step >>= 1) {
+        int half = size >> 1;
+        for (int start = 0; start < N; start += size) {
+            for (int k = 0; k < half; k++) {
+                int32_t wr = twiddle_cos[k * step];
+                int32_t wi = twiddle_sin[k * step];
+                int i = start + k;
+                int j = i + half;
+                int32_t tr = (re[j] * wr - im[j] * wi) >> 15;
+                int32_t ti = (re[j] * wi + im[j] * wr) >> 15;
+                int32_t ar = re[i];
+                int32_t ai = im[i];
+                re[j] = (int16_t)((ar - tr) >> 1);
+                im[j] = (int16_t)((ai - ti) >> 1);
+                re[i] = (int16_t)((ar + tr) >> 1);
+                im[i] = (int16_t)((ai + ti) >> 1);
+            }
+        }
+    }
+}
+
+void accel_dsp_process(accel_dsp_t *d, const sample_block_t *block, accel_features_t *out)
+{
+    memset(out, 0, sizeof(*out));
+
+    /* Gravity low-pass, high-pass residue, RMS and peak: one pass per axis */
+    int32_t max_abs = 0;
+    for (int a = 0; a < ACCEL_AXES; a++) {
+        const int16_t *x = block->data[a];
+        int16_t *hp = d->hp[a];
+        if (!d->primed) {
+            d->lp_q8[a] = (int32_t)x[0] << 8;
+        }
+        int32_t lp = d->lp_q8[a];
+        uint64_t sum_sq = 0;
+        int32_t peak = 0;
+        for (int n = 0; n < N; n++) {
+            lp += (((int32_t)x[n] << 8) - lp) >> CONFIG_ACCEL_DSP_LP_SHIFT;
+            int32_t v = x[n] - (lp >> 8);
+            hp[n] = (int16_t)v;
+            sum_sq += (uint64_t)(v * v);
+            int32_t mag = v < 0 ? -v : v;
+            if (mag > peak) {
+                peak = mag;
+            }
+        }
+        d->lp_q8[a] = lp;
+        out->gravity_mg[a] = (int16_t)(lp >> 8);
+        out->rms_mg[a] = (uint16_t)isqrt_u64(sum_sq / N);
+        out->peak_mg[a] = (uint16_t)(peak > 65535 ? 65535 : peak);
+        if (peak > max_abs) {
+            max_abs = peak;
+        }
+    }
+    d->primed = 1;
+
+    /* Block floating point: one shift for all axes so powers add up */
+    int shift = 0;
+    if (max_abs > 0) {
+        while ((max_abs << (shift + 1)) < (1 << FFT_INPUT_BITS)) {
+            shift++;
+        }
+        while ((max_abs >> -shift) >= (1 << FFT_INPUT_BITS)) {
+            shift--;
+        }
+    }
+
+    memset(d->power, 0, sizeof(d->power));
+    for (int a = 0; a < ACCEL_AXES; a++) {
+        const int16_t *hp = d->hp[a];
+        for (int n = 0; n < N; n++) {
+            int32_t v = shift >= 0 ? hp[n] * (1 << shift) : hp[n] >> -shift;
+            d->re[n] = (int16_t)((v * hann_q15[n]) >> 15);
+            d->im[n] = 0;
+        }
+        fft_q15(d->re, d->im);
+        for (int k = 1; k < HALF; k++) {
+            d->power[k] += (uint32_t)(d->re[k] * d->re[k] + d->im[k] * d->im[k]);
+        }
+    }
+
+    uint64_t total = 0;
+    uint64_t band[ACCEL_DSP_BANDS] = { 0 };
+    int peak_k = 1;
+    for (int k = 1; k < HALF; k++) {
+        total += d->power[k];
+        band[band_of(k)] += d->power[k];
+        if (d->power[k] > d->power[peak_k]) {
+            peak_k = k;
+        }
+    }
+    for (int b = 0; b < ACCEL_DSP_BANDS; b++) {
+        out->band_permille[b] = total ? (uint16_t)(band[b] * 1000 / total) : 0;
+    }
+
+    /* A sine of amplitude A shows as A/4 per bin: half goes to the
+     * negative frequency, the Hann window's coherent gain is 1/2, and the
+     * stages divided by N */
+    out->dominant_hz_x10 = (uint16_t)(peak_k * block->sample_rate_hz * 10 / N);
+    uint32_t amp = 4 * isqrt_u64(d->power[peak_k]);
+    out->dominant_mg = (uint16_t)(shift >= 0 ? amp >> shift : amp << -shift);
+}
+
+/* ----------------------------------------------------------------
+ * Float reference: the same features written the obvious way
+ * ---------------------------------------------------------------- */
+static void fft_float(float *re, float *im)
+{
+    for (int n = 0, r = 0; n < N; n++) {
+        if (r > n) {
+            float t = re[n];
+            re[n] = re[r];
+            re[r] = t;
+            t = im[n];
+            im[n] = im[r];
+            im[r] = t;
+        }
+        int bit = HALF;
+        while (r & bit) {
+            r ^= bit;
+            bit >>= 1;
+        }
+        r |= bit;
+    }
+
+    for (int size = 2; size <= N; size <<= 1) {
+        int half = size >> 1;
+        for (int start = 0; start < N; start += size) {
+            for (int k = 0; k < half; k++) {
+                float wr = cosf(2.0f * (float)M_PI * k / size);
+                float wi = -sinf(2.0f * (float)M_PI * k / size);
+                int i = start + k;
+                int j = i + half;
+                float tr = re[j] * wr - im[j] * wi;
+                float ti = re[j] * wi + im[j] * wr;
+                re[j] = re[i] - tr;
+                im[j] = im[i] - ti;
+                re[i] += tr;
+                im[i] += ti;
+            }
+        }
+    }
+}
+
+void accel_dsp_process_float(accel_dsp_t *d, const sample_block_t *block, accel_features_t *out)
+{
+    const float alpha = 1.0f / (1 << CONFIG_ACCEL_DSP_LP_SHIFT);
+    float *hp = d->work_f[0];
+    float *re = d->work_f[1];
+    float *im = d->work_f[2];
+
+    memset(out, 0, sizeof(*out));
+    memset(d->power_f, 0, sizeof(d->power_f));
+
+    for (int a = 0; a < ACCEL_AXES; a++) {
+        const int16_t *x = block->data[a];
+        if (!d->primed) {
+            d->lp_f[a] = x[0];
+        }
+        float sum_sq = 0;
+        float peak = 0;
+        for (int n = 0; n < N; n++) {
+            d->lp_f[a] += (x[n] - d->lp_f[a]) * alpha;
+            hp[n] = x[n] - d->lp_f[a];
+            sum_sq += hp[n] * hp[n];
+            if (fabsf(hp[n]) > peak) {
+                peak = fabsf(hp[n]);
+            }
+        }
+        out->gravity_mg[a] = (int16_t)lroundf(d->lp_f[a]);
+        out->rms_mg[a] = (uint16_t)lroundf(sqrtf(sum_sq / N));
+        out->peak_mg[a] = (uint16_t)lroundf(peak);
+
+        for (int n = 0; n < N; n++) {
+            re[n] = hp[n] * (0.5f - 0.5f * cosf(2.0f * (float)M_PI * n / N));
+            im[n] = 0;
+        }
+        fft_float(re, im);
+        for (int k = 1; k < HALF; k++) {
+            d->power_f[k] += re[k] * re[k] + im[k] * im[k];
+        }
+    }
+    d->primed = 1;
+
+    float total = 0;
+    float band[ACCEL_DSP_BANDS] = { 0 };
+    int peak_k = 1;
+    for (int k = 1; k < HALF; k++) {
+        total += d->power_f[k];
+        band[band_of(k)] += d->power_f[k];
+        if (d->power_f[k] > d->power_f[peak_k]) {
+            peak_k = k;
+        }
+    }
+    for (int b = 0; b < ACCEL_DSP_BANDS; b++) {
+        out->band_permille[b] = total > 0 ? (uint16_t)(band[b] * 1000 / total) : 0;
+    }
+    out->dominant_hz_x10 = (uint16_t)(peak_k * block->sample_rate_hz * 10 / N);
+    /* Unscaled FFT: a sine of amplitude A gives A * N / 4 per bin */
+    out->dominant_mg = (uint16_t)lroundf(4.0f * sqrtf(d->power_f[peak_k]) / N);
+}
+
+/* ----------------------------------------------------------------
+ * Upload format
+ * ---------------------------------------------------------------- */
+int accel_features_to_json(const accel_features_t *f, char *buf, size_t len)
+{
+    return snprintf(buf, len,
+                    "{\"gravity_mg\":[%d,%d,%d],\"rms_mg\":[%u,%u,%u],"
+                    "\"peak_mg\":[%u,%u,%u],\"dom_hz\":%u.%u,\"dom_mg\":%u,"
+                    "\"bands\":[%u,%u,%u,%u]}",
+                    f->gravity_mg[0], f->gravity_mg[1], f->gravity_mg[2],
+                    f->rms_mg[0], f->rms_mg[1], f->rms_mg[2],
+                    f->peak_mg[0], f->peak_mg[1], f->peak_mg[2],
+                    f->dominant_hz_x10 / 10, f->dominant_hz_x10 % 10, f->dominant_mg,
+                    f->band_permille[0], f->band_permille[1],
+                    f->band_permille[2], f->band_permille[3]);
+}
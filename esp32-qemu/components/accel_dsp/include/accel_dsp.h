@@ -0,0 +1,82 @@
+/**
+ * Accelerometer DSP: filtered statistics and a vibration spectrum per block
+ * IoT Course - Spring 2026
+ *
+ * Streaming raw X/Y/Z at 100 Hz is 600 bytes/s of binary data, several KB/s
+ * as JSON text. What a vibration monitor actually needs fits in one short
+ * message per block:
+ *
+ *   - gravity per axis     first-order IIR low-pass (orientation)
+ *   - RMS and peak         of the high-passed signal x - lowpass (vibration)
+ *   - dominant frequency   and its amplitude, from a Hann-windowed FFT
+ *   - band energies        share of the spectrum in 4 equal bands, permille
+ *
+ * Samples arrive as a sample_block_t (components/sample_block) with X, Y, Z
+ * in channels 0-2, so every kernel walks one contiguous int16_t column.
+ * The block must hold ACCEL_DSP_N rows.
+ *
+ * accel_dsp_process() is the fixed-point pipeline: shift-based IIR, 64-bit
+ * sum of squares with an integer square root, and a Q15 radix-2 FFT with
+ * block floating point (the block is scaled to 14 bits first, every stage
+ * halves). accel_dsp_process_float() computes the same features with plain
+ * float loops; projects/05-benchmarks times both per block.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "sample_block.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ACCEL_DSP_N      (1 << CONFIG_ACCEL_DSP_LOG2_BLOCK)
+#define ACCEL_DSP_BANDS  4
+#define ACCEL_AXES       3
+
+_Static_assert(ACCEL_DSP_N <= SAMPLE_BLOCK_CAPACITY,
+               "CONFIG_SAMPLE_BLOCK_CAPACITY must hold one DSP block");
+
+typedef struct {
+    int16_t gravity_mg[ACCEL_AXES];     /* Low-pass at the end of the block */
+    uint16_t rms_mg[ACCEL_AXES];        /* Of the high-passed signal */
+    uint16_t peak_mg[ACCEL_AXES];
+    uint16_t dominant_hz_x10;           /* Strongest bin above DC, 0.1 Hz */
+    uint16_t dominant_mg;               /* Its amplitude (all axes combined) */
+    uint16_t band_permille[ACCEL_DSP_BANDS];
+} accel_features_t;
+
+/** Filter state and work buffers; keep one per sensor, not on a stack */
+typedef struct {
+    int32_t lp_q8[ACCEL_AXES];          /* Low-pass, mg << 8 */
+    float lp_f[ACCEL_AXES];             /* State of the float pipeline */
+    int primed;                         /* Low-pass started at a first sample */
+    int16_t hp[ACCEL_AXES][ACCEL_DSP_N];
+    int16_t re[ACCEL_DSP_N];
+    int16_t im[ACCEL_DSP_N];
+    uint32_t power[ACCEL_DSP_N / 2];
+    float work_f[3][ACCEL_DSP_N];       /* Float pipeline: hp, re, im */
+    float power_f[ACCEL_DSP_N / 2];
+} accel_dsp_t;
+
+/** Reset the filters and build the twiddle and window tables */
+void accel_dsp_init(accel_dsp_t *d);
+
+/** Fixed-point pipeline over the first ACCEL_DSP_N rows of a block (milli-g) */
+void accel_dsp_process(accel_dsp_t *d, const sample_block_t *block, accel_features_t *out);
+
+/** The same features with naive float loops (reference and benchmark) */
+void accel_dsp_process_float(accel_dsp_t *d, const sample_block_t *block, accel_features_t *out);
+
+/**
+ * Format the features as a compact JSON object. Returns the length, or
+ * the length needed (as snprintf) if buf is too small.
+ */
+int accel_features_to_json(const accel_features_t *f, char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,208 @@
+/**
+ * Adaptive sampling rate
+ * IoT Course - Spring 2026
+ */
+
+#include "adaptive_rate.h"
+
+#include <math.h>
+#include <stdio.h>
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#define EWMA_ALPHA (CONFIG_ADAPTIVE_RATE_EWMA_PCT / 100.0f)
+
+/* ----------------------------------------------------------------
+ * Budget
+ * ---------------------------------------------------------------- */
+void adaptive_budget_init(adaptive_budget_t *b, const char *name, uint32_t limit_per_s)
+{
+    b->name = name;
+    b->limit = limit_per_s;
+    b->spent = 0;
+    b->capped = 0;
+    portMUX_INITIALIZE(&b->lock);
+}
+
+void adaptive_budget_log(adaptive_budget_t *b)
+{
+    portENTER_CRITICAL(&b->lock);
+    uint32_t spent = b->spent;
+    uint32_t capped = b->capped;
+    portEXIT_CRITICAL(&b->lock);
+
+    printf("ADAPTIVE_BUDGET name=%s limit=%lu spent=%lu pct=%lu capped=%lu\n",
+           b->name, (unsigned long)b->limit, (unsigned long)spent,
+           (unsigned long)(b->limit ? spent * 100 / b->limit : 0),
+           (unsigned long)capped);
+}
+
+/* Budget units per second at this period (0 = not sampling yet) */
+static uint32_t share(const adaptive_rate_t *r, uint32_t period_ms)
+{
+    return period_ms ? r->cfg.cost * 1000 / period_ms : 0;
+}
+
+/*
+ * Move r to want_ms, or to the shortest period the budget still has room
+ * for. Always within the bounds: a sensor at its max period stays there
+ * even if the other sensors have used up the budget.
+ */
+static uint32_t apply_period(adaptive_rate_t *r, uint32_t want_ms)
+{
+    adaptive_budget_t *b = r->cfg.budget;
+    uint32_t ms = want_ms;
+
+    if (b == NULL || r->cfg.cost == 0) {
+        r->period_ms = ms;
+        return ms;
+    }
+
+    portENTER_CRITICAL(&b->lock);
+    uint32_t others = b->spent - share(r, r->period_ms);
+    if (others + share(r, ms) > b->limit) {
+        uint32_t room = b->limit > others ? b->limit - others : 0;
+        ms = room ? (r->cfg.cost * 1000 + room - 1) / room : r->cfg.max_period_ms;
+        if (ms > r->cfg.max_period_ms) {
+            ms = r->cfg.max_period_ms;
+        }
+        if (ms > want_ms) {
+            b->capped++;
+            r->capped++;
+        }
+    }
+    b->spent = others + share(r, ms);
+    portEXIT_CRITICAL(&b->lock);
+
+    r->period_ms = ms;
+    return ms;
+}
+
+static uint32_t clamp_period(const adaptive_rate_t *r, uint32_t ms)
+{
+    if (ms < r->cfg.min_period_ms) {
+        ms = r->cfg.min_period_ms;
+    }
+    if (ms > r->cfg.max_period_ms) {
+        ms = r->cfg.max_period_ms;
+    }
+    return ms;
+}
+
+/* ----------------------------------------------------------------
+ * Controller
+ * ---------------------------------------------------------------- */
+void adaptive_rate_init(adaptive_rate_t *r, const adaptive_rate_config_t *cfg)
+{
+    r->cfg = *cfg;
+    if (r->cfg.min_period_ms == 0) {
+        r->cfg.min_period_ms = 1;
+    }
+    if (r->cfg.max_period_ms < r->cfg.min_period_ms) {
+        r->cfg.max_period_ms = r->cfg.min_period_ms;
+    }
+    r->period_ms = 0;
+    r->primed = false;
+    r->mean = 0;
+    r->var = 0;
+    r->ref_value = 0;
+    r->ref_us = 0;
+    r->slope = 0;
+    r->quiet_run = 0;
+    r->samples = 0;
+    r->raises = 0;
+    r->lowers = 0;
+    r->capped = 0;
+    r->window_start_us = esp_timer_get_time();
+    r->window_samples = 0;
+
+    uint32_t start = cfg->start_period_ms ? cfg->start_period_ms : r->cfg.max_period_ms;
+    apply_period(r, clamp_period(r, start));
+}
+
+uint32_t adaptive_rate_update(adaptive_rate_t *r, float value)
+{
+    int64_t now = esp_timer_get_time();
+
+    if (!r->primed) {
+        r->mean = value;
+        r->var = 0;
+        r->slope = 0;
+        r->ref_value = value;
+        r->ref_us = now;
+        r->primed = true;
+    } else {
+        /* Exponentially weighted mean and variance */
+        float diff = value - r->mean;
+        float incr = EWMA_ALPHA * diff;
+        r->mean += incr;
+        r->var = (1.0f - EWMA_ALPHA) * (r->var + diff * incr);
+
+        int64_t dt_us = now - r->ref_us;
+        if (dt_us > 0 && dt_us >= (int64_t)CONFIG_ADAPTIVE_RATE_SLOPE_WINDOW_MS * 1000) {
+            r->slope = (value - r->ref_value) * 1e6f / dt_us;
+            r->ref_value = value;
+            r->ref_us = now;
+        }
+    }
+    r->samples++;
+    r->window_samples++;
+
+    float slope = fabsf(r->slope);
+    float sd = sqrtf(r->var);
+    bool active = (r->cfg.change_per_s > 0 && slope > r->cfg.change_per_s) ||
+                  (r->cfg.stddev > 0 && sd > r->cfg.stddev);
+    /* Half the thresholds, so a signal right at one does not flap; a
+     * disabled (0) threshold never holds the rate up */
+    bool quiet = (r->cfg.change_per_s <= 0 || slope <= r->cfg.change_per_s / 2) &&
+                 (r->cfg.stddev <= 0 || sd <= r->cfg.stddev / 2);
+
+    uint32_t period = r->period_ms;
+    if (active) {
+        r->quiet_run = 0;
+        uint32_t want = clamp_period(r, period / 2);
+        if (want < period && apply_period(r, want) < period) {
+            r->raises++;
+        }
+    } else if (quiet) {
+        if (++r->quiet_run >= CONFIG_ADAPTIVE_RATE_QUIET_SAMPLES) {
+            r->quiet_run = 0;
+            uint32_t want = clamp_period(
+                r, period + period * CONFIG_ADAPTIVE_RATE_SLOWDOWN_PCT / 100);
+            if (want > period) {
+                apply_period(r, want);
+                r->lowers++;
+            }
+        }
+    } else {
+        r->quiet_run = 0;
+    }
+    return r->period_ms;
+}
+
+void adaptive_rate_set_bounds(adaptive_rate_t *r, uint32_t min_period_ms,
+                              uint32_t max_period_ms)
+{
+    r->cfg.min_period_ms = min_period_ms ? min_period_ms : 1;
+    r->cfg.max_period_ms = max_period_ms < r->cfg.min_period_ms
+                               ? r->cfg.min_period_ms : max_period_ms;
+    apply_period(r, clamp_period(r, r->period_ms));
+}
+
+void adaptive_rate_log(adaptive_rate_t *r)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t window_us = now - r->window_start_us;
+    float eff_hz = window_us > 0 ? r->window_samples * 1e6f / window_us : 0;
+
+    printf("ADAPTIVE_RATE name=%s period_ms=%lu eff_hz=%.2f min_ms=%lu max_ms=%lu "
+           "samples=%lu raises=%lu lowers=%lu capped=%lu slope=%.3f stddev=%.3f\n",
+           r->cfg.name, (unsigned long)r->period_ms, eff_hz,
+           (unsigned long)r->cfg.min_period_ms, (unsigned long)r->cfg.max_period_ms,
+           (unsigned long)r->samples, (unsigned long)r->raises,
+           (unsigned long)r->lowers, (unsigned long)r->capped,
+           r->slope, sqrtf(r->var));
+
+    r->window_start_us = now;
+    r->window_samples = 0;
+}
@@ -0,0 +1,113 @@
+/**
+ * Adaptive sampling rate
+ * IoT Course - Spring 2026
+ *
+ * A sensor sampled at a fixed period has to use the period its fastest
+ * events need, and then spends most of its reads (CPU, bus time, radio,
+ * battery) on a flat signal. adaptive_rate_t instead picks the next period
+ * from the samples themselves:
+ *
+ *   active  |slope| > change_per_s  or  running std dev > stddev
+ *           (slope over at least CONFIG_ADAPTIVE_RATE_SLOPE_WINDOW_MS)
+ *           -> period halves at once (down to min_period_ms)
+ *   quiet   both below half their threshold for
+ *           CONFIG_ADAPTIVE_RATE_QUIET_SAMPLES samples in a row
+ *           -> period grows by CONFIG_ADAPTIVE_RATE_SLOWDOWN_PCT (up to max)
+ *
+ * A threshold of 0 disables that test: it never makes the signal active
+ * and never keeps it from being quiet.
+ *
+ * Fast attack, slow decay: a change is caught within one sample, and a
+ * short pause in the middle of it does not drop the rate.
+ *
+ * Several sensors can share an adaptive_budget_t: each sample costs
+ * `cost` units (e.g. microseconds of CPU, or microjoules), and the sum of
+ * cost per second over all sensors stays under the budget's limit. A
+ * sensor that wants to speed up gets the shortest period that still fits;
+ * those cases are counted as capped.
+ *
+ *   adaptive_rate_update(&temp_rate, celsius);
+ *   xTaskDelayUntil(&last_wake, pdMS_TO_TICKS(adaptive_rate_period_ms(&temp_rate)));
+ *
+ * adaptive_rate_log() prints the effective rate since the previous call:
+ *   ADAPTIVE_RATE name=temp period_ms=250 eff_hz=2.80 min_ms=200 max_ms=5000
+ *       samples=28 raises=3 lowers=5 capped=1 slope=0.412 stddev=0.081
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Shared sampling budget of several adaptive_rate_t */
+typedef struct {
+    const char *name;
+    uint32_t limit;             /* Cost units per second */
+    uint32_t spent;             /* Cost per second at the current periods */
+    uint32_t capped;            /* Speed-ups the budget cut short */
+    portMUX_TYPE lock;
+} adaptive_budget_t;
+
+typedef struct {
+    const char *name;
+    uint32_t min_period_ms;
+    uint32_t max_period_ms;
+    uint32_t start_period_ms;
+    float change_per_s;         /* Slope that counts as activity (units/s), 0: off */
+    float stddev;               /* Running std dev that counts as activity, 0: off */
+    uint32_t cost;              /* Budget units per sample */
+    adaptive_budget_t *budget;  /* NULL: no budget */
+} adaptive_rate_config_t;
+
+typedef struct {
+    adaptive_rate_config_t cfg;
+    uint32_t period_ms;
+    bool primed;                /* Has a previous sample */
+    float mean;
+    float var;
+    float ref_value;            /* Sample the slope is measured from */
+    int64_t ref_us;
+    float slope;                /* Units per second */
+    uint32_t quiet_run;
+    uint32_t samples;
+    uint32_t raises;
+    uint32_t lowers;
+    uint32_t capped;
+    int64_t window_start_us;    /* Effective rate since the last log */
+    uint32_t window_samples;
+} adaptive_rate_t;
+
+void adaptive_budget_init(adaptive_budget_t *b, const char *name, uint32_t limit_per_s);
+
+/** Print one ADAPTIVE_BUDGET line: limit, spent, share used, capped */
+void adaptive_budget_log(adaptive_budget_t *b);
+
+/** Start at cfg->start_period_ms (clamped to the bounds and the budget) */
+void adaptive_rate_init(adaptive_rate_t *r, const adaptive_rate_config_t *cfg);
+
+/**
+ * Feed the sample just read; returns the period until the next one. Call
+ * from one task (or one esp_timer callback) per controller.
+ */
+uint32_t adaptive_rate_update(adaptive_rate_t *r, float value);
+
+static inline uint32_t adaptive_rate_period_ms(const adaptive_rate_t *r)
+{
+    return r->period_ms;
+}
+
+/** Change the bounds at run time (e.g. from device config); keeps the state */
+void adaptive_rate_set_bounds(adaptive_rate_t *r, uint32_t min_period_ms,
+                              uint32_t max_period_ms);
+
+/** Print one ADAPTIVE_RATE line and start a new effective-rate window */
+void adaptive_rate_log(adaptive_rate_t *r);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,443 @@
+/**
+ * Continuous-mode ADC acquisition into sample blocks
+ * IoT Course - Spring 2026
+ */
+
+#include "adc_stream.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_adc/adc_continuous.h"
+#include "esp_attr.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "soc/soc_caps.h"
+
+#include "static_alloc.h"
+
+static const char *TAG = "adc_stream";
+
+#define POOL_FRAMES      CONFIG_ADC_STREAM_POOL_FRAMES
+#define RESULT_BYTES     SOC_ADC_DIGI_RESULT_BYTES
+#define FRAME_BYTES_MAX  (SAMPLE_BLOCK_CAPACITY * ADC_STREAM_MAX_CHANNELS * RESULT_BYTES)
+
+#if CONFIG_ADC_STREAM_EMULATED
+#define BACKEND          "emulated"
+#else
+#define BACKEND          "dma"
+#endif
+
+/* The ESP32 writes TYPE1 results: 12-bit data, 4-bit channel */
+_Static_assert(sizeof(adc_digi_output_data_t) == RESULT_BYTES,
+               "adc_stream decodes the ESP32's TYPE1 result format");
+
+static adc_stream_config_t config;
+static uint8_t channel_list[ADC_STREAM_MAX_CHANNELS];
+static int8_t column_of[16];          /* ADC channel -> block column, -1 if unused */
+static sample_pipe_t *out_pipe;
+static size_t frame_bytes;
+static uint8_t frame_buf[FRAME_BYTES_MAX];   /* The task's copy of one frame */
+
+STATIC_TASK_DEFINE(stream_task_def, "adc_stream", 3072);
+static TaskHandle_t stream_task_handle;
+
+static volatile bool running;
+static volatile uint32_t generation;  /* Bumped by start(); the task restarts its rows */
+static volatile int64_t start_us;
+
+/* Running totals; adc_stream_log() prints the difference to `logged` */
+typedef struct {
+    uint32_t frames;
+    uint32_t wakeups;
+    uint32_t samples;       /* Conversions decoded */
+    uint32_t blocks;        /* Blocks submitted */
+    uint32_t dropped;       /* Rows with no free block */
+    uint32_t overflows;     /* Frames lost with the pool full */
+    uint32_t misaligned;    /* Conversions skipped to find the start of a row */
+    uint32_t task_us;
+    uint32_t emul_us;
+    uint32_t run_us;        /* Time between start and stop */
+} stream_counters_t;
+
+static stream_counters_t counters;
+static stream_counters_t logged;
+
+/* ----------------------------------------------------------------
+ * Emulated backend: an esp_timer writes the frames the DMA would
+ * ---------------------------------------------------------------- */
+#if CONFIG_ADC_STREAM_EMULATED
+
+#define HUM_HZ           50
+#define HUM_STEPS        64
+#define EMU_NOISE        CONFIG_ADC_STREAM_EMU_NOISE_COUNTS
+
+static uint8_t pool[POOL_FRAMES][FRAME_BYTES_MAX];
+static int pool_head;
+static int pool_count;
+static portMUX_TYPE pool_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static esp_timer_handle_t dma_timer;
+static uint64_t emu_rows;             /* Rows converted since start */
+static int16_t hum_table[HUM_STEPS];
+static volatile int16_t emu_level[ADC_STREAM_MAX_CHANNELS];
+static uint32_t emu_seed = 2026;
+
+/** One frame of conversions, in the order the pattern converts them */
+static void emu_fill(uint8_t *buf)
+{
+    adc_digi_output_data_t *d = (adc_digi_output_data_t *)buf;
+    for (int r = 0; r < SAMPLE_BLOCK_CAPACITY; r++, emu_rows++) {
+        int hum = hum_table[(emu_rows * HUM_HZ * HUM_STEPS / config.sample_rate_hz) % HUM_STEPS];
+        for (int c = 0; c < config.num_channels; c++, d++) {
+            emu_seed = emu_seed * 1103515245u + 12345u;
+            int noise = (int)((emu_seed >> 16) % (2 * EMU_NOISE + 1)) - EMU_NOISE;
+            int v = emu_level[c] + hum + noise;
+            d->type1.channel = channel_list[c];
+            d->type1.data = v < 0 ? 0 : v > 4095 ? 4095 : v;
+        }
+    }
+}
+
+static void emu_dma_tick(void *arg)
+{
+    int64_t t0 = esp_timer_get_time();
+    /* Every frame due by now at the nominal rate, so a late tick does not
+     * lower the rate; with the pool full the frame is lost, as on hardware */
+    uint64_t due = (uint64_t)(t0 - start_us) * config.sample_rate_hz / 1000000;
+    bool produced = false;
+
+    while (emu_rows + SAMPLE_BLOCK_CAPACITY <= due) {
+        portENTER_CRITICAL(&pool_lock);
+        int slot = pool_count < POOL_FRAMES ? (pool_head + pool_count) % POOL_FRAMES : -1;
+        portEXIT_CRITICAL(&pool_lock);
+        if (slot < 0) {
+            counters.overflows++;
+            emu_rows += SAMPLE_BLOCK_CAPACITY;
+            continue;
+        }
+        emu_fill(pool[slot]);
+        portENTER_CRITICAL(&pool_lock);
+        pool_count++;
+        portEXIT_CRITICAL(&pool_lock);
+        produced = true;
+    }
+    if (produced) {
+        xTaskNotifyGive(stream_task_handle);
+    }
+    counters.emul_us += (uint32_t)(esp_timer_get_time() - t0);
+}
+
+static bool frame_read(uint8_t *buf, uint32_t *len)
+{
+    portENTER_CRITICAL(&pool_lock);
+    int slot = pool_count > 0 ? pool_head : -1;
+    portEXIT_CRITICAL(&pool_lock);
+    if (slot < 0) {
+        return false;
+    }
+    memcpy(buf, pool[slot], frame_bytes);
+    portENTER_CRITICAL(&pool_lock);
+    pool_head = (pool_head + 1) % POOL_FRAMES;
+    pool_count--;
+    portEXIT_CRITICAL(&pool_lock);
+    *len = frame_bytes;
+    return true;
+}
+
+static esp_err_t backend_init(void)
+{
+    for (int i = 0; i < HUM_STEPS; i++) {
+        hum_table[i] = (int16_t)lroundf(CONFIG_ADC_STREAM_EMU_HUM_COUNTS *
+                                        sinf(2.0f * (float)M_PI * i / HUM_STEPS));
+    }
+    const esp_timer_create_args_t timer_args = {
+        .callback = emu_dma_tick,
+        .name = "adc_dma",
+    };
+    return esp_timer_create(&timer_args, &dma_timer);
+}
+
+static esp_err_t backend_start(void)
+{
+    portENTER_CRITICAL(&pool_lock);
+    pool_head = 0;
+    pool_count = 0;
+    portEXIT_CRITICAL(&pool_lock);
+    emu_rows = 0;
+    uint64_t period_us = (uint64_t)SAMPLE_BLOCK_CAPACITY * 1000000 / config.sample_rate_hz;
+    return esp_timer_start_periodic(dma_timer, period_us < 100 ? 100 : period_us);
+}
+
+static esp_err_t backend_stop(void)
+{
+    esp_err_t err = esp_timer_stop(dma_timer);
+    portENTER_CRITICAL(&pool_lock);
+    pool_count = 0;
+    portEXIT_CRITICAL(&pool_lock);
+    return err;
+}
+
+/* ----------------------------------------------------------------
+ * Hardware backend: adc_continuous driver, DMA into the driver's pool
+ * ---------------------------------------------------------------- */
+#else
+
+static adc_continuous_handle_t adc_handle;
+
+static bool IRAM_ATTR on_conv_done(adc_continuous_handle_t handle,
+                                   const adc_continuous_evt_data_t *edata, void *ctx)
+{
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(stream_task_handle, &woken);
+    return woken == pdTRUE;
+}
+
+static bool IRAM_ATTR on_pool_ovf(adc_continuous_handle_t handle,
+                                  const adc_continuous_evt_data_t *edata, void *ctx)
+{
+    counters.overflows++;
+    return false;
+}
+
+static bool frame_read(uint8_t *buf, uint32_t *len)
+{
+    return adc_continuous_read(adc_handle, buf, frame_bytes, len, 0) == ESP_OK && *len > 0;
+}
+
+static esp_err_t backend_init(void)
+{
+    adc_continuous_handle_cfg_t handle_cfg = {
+        .max_store_buf_size = POOL_FRAMES * frame_bytes,
+        .conv_frame_size = frame_bytes,
+    };
+    ESP_RETURN_ON_ERROR(adc_continuous_new_handle(&handle_cfg, &adc_handle), TAG, "handle");
+
+    adc_digi_pattern_config_t pattern[ADC_STREAM_MAX_CHANNELS] = {0};
+    for (int c = 0; c < config.num_channels; c++) {
+        pattern[c].atten = config.atten;
+        pattern[c].channel = channel_list[c];
+        pattern[c].unit = ADC_UNIT_1;
+        pattern[c].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    }
+    adc_continuous_config_t adc_cfg = {
+        .pattern_num = config.num_channels,
+        .adc_pattern = pattern,
+        .sample_freq_hz = config.sample_rate_hz * config.num_channels,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = ADC_DIGI_OUTPUT_FORMAT_TYPE1,
+    };
+    ESP_RETURN_ON_ERROR(adc_continuous_config(adc_handle, &adc_cfg), TAG, "config");
+
+    adc_continuous_evt_cbs_t cbs = {
+        .on_conv_done = on_conv_done,
+        .on_pool_ovf = on_pool_ovf,
+    };
+    return adc_continuous_register_event_callbacks(adc_handle, &cbs, NULL);
+}
+
+static esp_err_t backend_start(void)
+{
+    return adc_continuous_start(adc_handle);
+}
+
+static esp_err_t backend_stop(void)
+{
+    esp_err_t err = adc_continuous_stop(adc_handle);
+    /* Empty the pool so the next start does not begin with old frames */
+    uint8_t scratch[64];
+    uint32_t len;
+    while (adc_continuous_read(adc_handle, scratch, sizeof(scratch), &len, 0) == ESP_OK && len > 0) {
+    }
+    return err;
+}
+
+#endif
+
+/* ----------------------------------------------------------------
+ * Stream task: one wake-up per frame, frames -> block rows
+ * ---------------------------------------------------------------- */
+static void stream_task(void *arg)
+{
+    sample_block_t *block = NULL;
+    int16_t row[ADC_STREAM_MAX_CHANNELS];
+    int next_col = 0;
+    uint64_t rows = 0;
+    uint32_t gen = generation;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t t0 = esp_timer_get_time();
+        counters.wakeups++;
+
+        if (gen != generation) {
+            gen = generation;
+            rows = 0;
+            next_col = 0;
+            if (block != NULL) {
+                sample_block_clear(block);
+            }
+        }
+
+        uint32_t len;
+        while (frame_read(frame_buf, &len)) {
+            const adc_digi_output_data_t *d = (const adc_digi_output_data_t *)frame_buf;
+            size_t n = len / RESULT_BYTES;
+            counters.frames++;
+            counters.samples += n;
+
+            for (size_t i = 0; i < n; i++) {
+                int col = column_of[d[i].type1.channel];
+                if (col != next_col) {
+                    /* A lost or foreign conversion: resume at the next row start */
+                    counters.misaligned++;
+                    next_col = 0;
+                    if (col != 0) {
+                        continue;
+                    }
+                }
+                row[col] = d[i].type1.data;
+                if (++next_col < config.num_channels) {
+                    continue;
+                }
+                next_col = 0;
+
+                int64_t t = start_us + (int64_t)(rows++ * 1000000 / config.sample_rate_hz);
+                if (block == NULL && (block = sample_pipe_acquire(out_pipe, 0)) == NULL) {
+                    counters.dropped++;
+                    continue;
+                }
+                sample_block_push(block, t, row);
+                if (sample_block_full(block)) {
+                    sample_pipe_submit(out_pipe, block);
+                    counters.blocks++;
+                    block = NULL;
+                }
+            }
+        }
+        counters.task_us += (uint32_t)(esp_timer_get_time() - t0);
+    }
+}
+
+/* ----------------------------------------------------------------
+ * Public API
+ * ---------------------------------------------------------------- */
+esp_err_t adc_stream_init(const adc_stream_config_t *cfg, sample_pipe_t *pipe)
+{
+    uint32_t conversions = cfg->sample_rate_hz * cfg->num_channels;
+#if CONFIG_ADC_STREAM_EMULATED
+    bool rate_ok = conversions > 0 && conversions <= SOC_ADC_SAMPLE_FREQ_THRES_HIGH;
+#else
+    bool rate_ok = conversions >= SOC_ADC_SAMPLE_FREQ_THRES_LOW &&
+                   conversions <= SOC_ADC_SAMPLE_FREQ_THRES_HIGH;
+#endif
+    if (cfg->num_channels == 0 || cfg->num_channels > ADC_STREAM_MAX_CHANNELS || !rate_ok) {
+        ESP_LOGE(TAG, "%u channels at %lu Hz not supported (%d-%d conversions/s)",
+                 cfg->num_channels, (unsigned long)cfg->sample_rate_hz,
+                 SOC_ADC_SAMPLE_FREQ_THRES_LOW, SOC_ADC_SAMPLE_FREQ_THRES_HIGH);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (out_pipe != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    config = *cfg;
+    memset(column_of, -1, sizeof(column_of));
+    for (int c = 0; c < cfg->num_channels; c++) {
+        if (cfg->channels[c] >= sizeof(column_of)) {
+            ESP_LOGE(TAG, "no ADC channel %u", cfg->channels[c]);
+            return ESP_ERR_INVALID_ARG;
+        }
+        channel_list[c] = cfg->channels[c];
+        column_of[cfg->channels[c]] = c;
+    }
+    config.channels = channel_list;
+    frame_bytes = SAMPLE_BLOCK_CAPACITY * cfg->num_channels * RESULT_BYTES;
+    out_pipe = pipe;
+
+    stream_task_handle = static_task_create(&stream_task_def, stream_task, NULL, 6,
+                                            TASK_ROLE_SENSING);
+    if (stream_task_handle == NULL) {
+        return ESP_FAIL;
+    }
+    ESP_RETURN_ON_ERROR(backend_init(), TAG, "backend");
+
+    ESP_LOGI(TAG, "%u channels at %lu Hz, %u-byte frames, pool of %d frames, %s",
+             cfg->num_channels, (unsigned long)cfg->sample_rate_hz,
+             (unsigned)frame_bytes, POOL_FRAMES, BACKEND);
+    return ESP_OK;
+}
+
+esp_err_t adc_stream_start(void)
+{
+    if (out_pipe == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (running) {
+        return ESP_OK;
+    }
+    start_us = esp_timer_get_time();
+    generation++;
+    running = true;
+    return backend_start();
+}
+
+esp_err_t adc_stream_stop(void)
+{
+    if (!running) {
+        return ESP_OK;
+    }
+    esp_err_t err = backend_stop();
+    running = false;
+    counters.run_us += (uint32_t)(esp_timer_get_time() - start_us);
+    return err;
+}
+
+void adc_stream_emulate_level(uint8_t column, int counts)
+{
+#if CONFIG_ADC_STREAM_EMULATED
+    if (column < ADC_STREAM_MAX_CHANNELS) {
+        emu_level[column] = counts < 0 ? 0 : counts > 4095 ? 4095 : counts;
+    }
+#else
+    (void)column;
+    (void)counts;
+#endif
+}
+
+void adc_stream_log(void)
+{
+    stream_counters_t now = counters;
+    if (running) {
+        now.run_us += (uint32_t)(esp_timer_get_time() - start_us);
+    }
+    stream_counters_t d = {
+        .frames = now.frames - logged.frames,
+        .wakeups = now.wakeups - logged.wakeups,
+        .samples = now.samples - logged.samples,
+        .blocks = now.blocks - logged.blocks,
+        .dropped = now.dropped - logged.dropped,
+        .overflows = now.overflows - logged.overflows,
+        .misaligned = now.misaligned - logged.misaligned,
+        .task_us = now.task_us - logged.task_us,
+        .emul_us = now.emul_us - logged.emul_us,
+        .run_us = now.run_us - logged.run_us,
+    };
+    logged = now;
+
+    double secs = d.run_us / 1e6;
+    printf("ADC_STREAM backend=%s channels=%u rate_hz=%lu run_s=%.2f sps=%.0f fps=%.1f "
+           "wakeups=%lu blocks=%lu dropped=%lu overflows=%lu misaligned=%lu "
+           "frame_us=%lu cpu_pct=%.1f emul_pct=%.1f\n",
+           BACKEND, config.num_channels, (unsigned long)config.sample_rate_hz, secs,
+           secs > 0 ? d.samples / secs : 0, secs > 0 ? d.frames / secs : 0,
+           (unsigned long)d.wakeups, (unsigned long)d.blocks, (unsigned long)d.dropped,
+           (unsigned long)d.overflows, (unsigned long)d.misaligned,
+           (unsigned long)(d.frames ? d.task_us / d.frames : 0),
+           d.run_us ? 100.0 * d.task_us / d.run_us : 0,
+           d.run_us ? 100.0 * d.emul_us / d.run_us : 0);
+}
@@ -0,0 +1,102 @@
+/**
+ * Continuous-mode ADC acquisition into sample blocks
+ * IoT Course - Spring 2026
+ *
+ * Reading the ADC one conversion at a time (adc1_get_raw() in a loop, or a
+ * task woken per sample) costs a call, a wake-up and a context switch per
+ * sample, which caps the rate at a few kHz and keeps a core busy. In
+ * continuous mode the ADC's digital controller converts on its own clock
+ * and DMA writes the results into frames; the CPU is involved once per
+ * frame:
+ *
+ *   ADC + DMA             conversion results -> frame in the driver's pool
+ *   on_conv_done (ISR)    notify the stream task, one wake-up per frame
+ *   adc_stream task       decode the frame (channel, 12-bit value) into
+ *                         rows of a sample_block_t, one column per channel
+ *   sample_pipe_submit()  full block to the consumer, by pointer
+ *
+ * One frame holds SAMPLE_BLOCK_CAPACITY rows, so a frame normally becomes
+ * exactly one block. Rows are timestamped from the nominal rate (the DMA
+ * does not timestamp conversions), counted from adc_stream_start().
+ *
+ * QEMU has no ADC. With CONFIG_ADC_STREAM_EMULATED an esp_timer stands in
+ * for the DMA: it writes the same frames (same format, same size, same
+ * rate) into a pool of the same depth and wakes the task the same way, so
+ * everything after the frame is the code that runs on hardware. The
+ * emulated signal is a level per channel (adc_stream_emulate_level())
+ * plus 50 Hz hum and noise.
+ *
+ *   static sample_block_t blocks[4];
+ *   static sample_pipe_t pipe;
+ *   static const uint8_t chans[] = { ADC_CHANNEL_6 };     // GPIO34
+ *   adc_stream_config_t cfg = { .channels = chans, .num_channels = 1,
+ *                               .sample_rate_hz = 20000, .atten = ADC_ATTEN_DB_11 };
+ *   sample_pipe_init(&pipe, "adc", blocks, 4, 0, 1, 20000);
+ *   adc_stream_init(&cfg, &pipe);
+ *   adc_stream_start();
+ *   sample_block_t *b = sample_pipe_receive(&pipe, portMAX_DELAY);
+ *   ... b->data[0][0..b->count) ...
+ *   sample_block_release(b);
+ *
+ * adc_stream_log() prints what was sustained since its previous call:
+ *
+ *   ADC_STREAM backend=emulated channels=1 rate_hz=20000 run_s=5.00
+ *       sps=20000 fps=156.2 wakeups=781 blocks=781 dropped=0 overflows=0
+ *       misaligned=0 frame_us=38 cpu_pct=0.6 emul_pct=2.1
+ *
+ * sps is conversions per second (all channels) over the time the stream
+ * ran; dropped counts rows lost because the consumer held every block,
+ * overflows frames lost because the task did not read the pool in time.
+ * cpu_pct is the share of one core spent in the stream task (frame_us per
+ * frame); emul_pct is the emulated DMA's own cost, which hardware does
+ * not have. The conversion-done ISR itself is not timed.
+ *
+ * There is one ADC digital controller, so there is one stream.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "sample_block.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ADC_STREAM_MAX_CHANNELS  SAMPLE_BLOCK_MAX_CHANNELS
+
+typedef struct {
+    const uint8_t *channels;      /* ADC1 channels (adc_channel_t), one column each */
+    uint8_t num_channels;
+    uint32_t sample_rate_hz;      /* Rows per second; each row converts every channel */
+    uint8_t atten;                /* adc_atten_t, for all channels */
+} adc_stream_config_t;
+
+/**
+ * Set up the ADC (or its emulation) and the stream task (SENSING role).
+ * Blocks come from `pipe`, which the caller has initialised with
+ * cfg->num_channels channels and cfg->sample_rate_hz; the stream is
+ * stopped until adc_stream_start().
+ */
+esp_err_t adc_stream_init(const adc_stream_config_t *cfg, sample_pipe_t *pipe);
+
+/** Start converting; row times restart from now */
+esp_err_t adc_stream_start(void);
+
+/**
+ * Stop converting. The block being filled is discarded, frames still in
+ * the pool are dropped, and the ADC can be powered down (light sleep).
+ */
+esp_err_t adc_stream_stop(void);
+
+/** Emulated backend: the level (0-4095) channel column `column` reads; no-op on hardware */
+void adc_stream_emulate_level(uint8_t column, int counts);
+
+/** Print an "ADC_STREAM ..." line for the time since the previous call */
+void adc_stream_log(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,241 @@
+/**
+ * Connection manager: endpoint selection, jittered backoff and rate limits
+ * IoT Course - Spring 2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_log.h"
+
+#include "conn_manager.h"
+
+static const char *TAG = "conn_manager";
+
+/* ----------------------------------------------------------------
+ * Token bucket
+ * ---------------------------------------------------------------- */
+void token_bucket_init(token_bucket_t *tb, uint32_t capacity, uint32_t refill_ms)
+{
+    tb->capacity = capacity;
+    tb->refill_ms = refill_ms ? refill_ms : 1;
+    tb->tokens = capacity;
+    tb->last_refill_us = esp_timer_get_time();
+    portMUX_INITIALIZE(&tb->lock);
+}
+
+/* Caller holds tb->lock */
+static void refill(token_bucket_t *tb, int64_t now)
+{
+    int64_t refill_us = (int64_t)tb->refill_ms * 1000;
+    int64_t added = (now - tb->last_refill_us) / refill_us;
+    if (added <= 0) {
+        return;
+    }
+    if (tb->tokens + added >= (int64_t)tb->capacity) {
+        tb->tokens = tb->capacity;
+        tb->last_refill_us = now;
+    } else {
+        tb->tokens += added;
+        tb->last_refill_us += added * refill_us;
+    }
+}
+
+/* Caller holds tb->lock */
+static uint32_t wait_ms_locked(token_bucket_t *tb, uint32_t n, int64_t now)
+{
+    if (tb->tokens >= (int32_t)n) {
+        return 0;
+    }
+    int64_t missing = (int64_t)n - tb->tokens;
+    int64_t wait_us = missing * tb->refill_ms * 1000 - (now - tb->last_refill_us);
+    return wait_us > 0 ? (uint32_t)((wait_us + 999) / 1000) : 0;
+}
+
+bool token_bucket_take(token_bucket_t *tb, uint32_t n)
+{
+    bool ok = false;
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&tb->lock);
+    refill(tb, now);
+    if (tb->tokens >= (int32_t)n) {
+        tb->tokens -= n;
+        ok = true;
+    }
+    portEXIT_CRITICAL(&tb->lock);
+    return ok;
+}
+
+uint32_t token_bucket_wait_ms(token_bucket_t *tb, uint32_t n)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&tb->lock);
+    refill(tb, now);
+    uint32_t ms = wait_ms_locked(tb, n, now);
+    portEXIT_CRITICAL(&tb->lock);
+    return ms;
+}
+
+/* Take one token now or promise the next one; returns how long to wait */
+static uint32_t token_bucket_reserve(token_bucket_t *tb)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&tb->lock);
+    refill(tb, now);
+    uint32_t ms = wait_ms_locked(tb, 1, now);
+    tb->tokens -= 1;
+    portEXIT_CRITICAL(&tb->lock);
+    return ms;
+}
+
+/* ----------------------------------------------------------------
+ * Jittered exponential backoff
+ * ---------------------------------------------------------------- */
+void conn_backoff_init(conn_backoff_t *b, uint32_t base_ms, uint32_t max_ms, uint32_t min_ms)
+{
+    b->base_ms = base_ms;
+    b->max_ms = max_ms;
+    b->min_ms = min_ms < max_ms ? min_ms : max_ms;
+    b->attempt = 0;
+}
+
+uint32_t conn_backoff_next_ms(conn_backoff_t *b)
+{
+    uint64_t cap = (uint64_t)b->base_ms << (b->attempt < 32 ? b->attempt : 32);
+    if (cap > b->max_ms) {
+        cap = b->max_ms;
+    }
+    if (cap < b->min_ms) {
+        cap = b->min_ms;
+    }
+    b->attempt++;
+    /* Full jitter: anywhere from the floor up to the cap */
+    return b->min_ms + esp_random() % ((uint32_t)cap - b->min_ms + 1);
+}
+
+void conn_backoff_reset(conn_backoff_t *b)
+{
+    b->attempt = 0;
+}
+
+/* ----------------------------------------------------------------
+ * Connection manager
+ * ---------------------------------------------------------------- */
+void conn_manager_init(conn_manager_t *cm, const char *name,
+                       const char *const *uris, int count)
+{
+    memset(cm, 0, sizeof(*cm));
+    cm->name = name;
+    if (count > CONFIG_CONN_MANAGER_MAX_ENDPOINTS) {
+        ESP_LOGW(TAG, "%s: %d endpoints, only the first %d are used",
+                 name, count, CONFIG_CONN_MANAGER_MAX_ENDPOINTS);
+        count = CONFIG_CONN_MANAGER_MAX_ENDPOINTS;
+    }
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < count; i++) {
+        cm->endpoints[i].uri = uris[i];
+        cm->endpoints[i].score = CONN_SCORE_MAX;
+        cm->endpoints[i].scored_us = now;
+    }
+    cm->count = count;
+    cm->current = 0;
+    conn_backoff_init(&cm->backoff, CONFIG_CONN_MANAGER_BACKOFF_BASE_MS,
+                      CONFIG_CONN_MANAGER_BACKOFF_MAX_MS,
+                      CONFIG_CONN_MANAGER_BACKOFF_MIN_MS);
+    token_bucket_init(&cm->reconnects, CONFIG_CONN_MANAGER_RECONNECT_BURST,
+                      CONFIG_CONN_MANAGER_RECONNECT_REFILL_MS);
+    portMUX_INITIALIZE(&cm->lock);
+}
+
+/* Score including what has been earned back since the last change */
+static int effective_score(const conn_endpoint_t *ep, int64_t now)
+{
+    int64_t recovered = (now - ep->scored_us) /
+                        ((int64_t)CONFIG_CONN_MANAGER_SCORE_RECOVERY_MS * 1000);
+    int64_t score = ep->score + recovered;
+    return score > CONN_SCORE_MAX ? CONN_SCORE_MAX : (int)score;
+}
+
+const char *conn_manager_select(conn_manager_t *cm)
+{
+    if (cm->count == 0) {
+        return NULL;
+    }
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&cm->lock);
+    int previous = cm->current;
+    int best = 0;
+    int best_score = -1;
+    for (int i = 0; i < cm->count; i++) {
+        int score = effective_score(&cm->endpoints[i], now);
+        if (score > best_score) {
+            best = i;
+            best_score = score;
+        }
+    }
+    cm->current = best;
+    portEXIT_CRITICAL(&cm->lock);
+
+    if (best != previous) {
+        ESP_LOGW(TAG, "%s: switching to %s (score %d)",
+                 cm->name, cm->endpoints[best].uri, best_score);
+    }
+    return cm->endpoints[best].uri;
+}
+
+const char *conn_manager_current(conn_manager_t *cm)
+{
+    return cm->count ? cm->endpoints[cm->current].uri : NULL;
+}
+
+void conn_manager_report(conn_manager_t *cm, bool success)
+{
+    if (cm->count == 0) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&cm->lock);
+    conn_endpoint_t *ep = &cm->endpoints[cm->current];
+    if (success) {
+        ep->score = CONN_SCORE_MAX;
+        ep->successes++;
+        conn_backoff_reset(&cm->backoff);
+    } else {
+        ep->score = effective_score(ep, now) / 2;
+        ep->failures++;
+    }
+    ep->scored_us = now;
+    portEXIT_CRITICAL(&cm->lock);
+}
+
+uint32_t conn_manager_next_delay_ms(conn_manager_t *cm)
+{
+    portENTER_CRITICAL(&cm->lock);
+    uint32_t backoff_ms = conn_backoff_next_ms(&cm->backoff);
+    uint32_t attempt = cm->backoff.attempt;
+    portEXIT_CRITICAL(&cm->lock);
+
+    /* Devices that lost the same server at the same moment also refill
+     * their buckets in step, so when the bucket is empty the jittered delay
+     * goes on top of the wait rather than retrying as the token arrives */
+    uint32_t bucket_ms = token_bucket_reserve(&cm->reconnects);
+    uint32_t delay_ms = bucket_ms ? bucket_ms + backoff_ms : backoff_ms;
+
+    ESP_LOGI(TAG, "%s: retry %u in %u ms (backoff %u ms, rate limit %u ms)",
+             cm->name, (unsigned)attempt, (unsigned)delay_ms,
+             (unsigned)backoff_ms, (unsigned)bucket_ms);
+    return delay_ms;
+}
+
+void conn_manager_log(conn_manager_t *cm)
+{
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < cm->count; i++) {
+        const conn_endpoint_t *ep = &cm->endpoints[i];
+        printf("CONN %s uri=%s score=%d ok=%u fail=%u%s\n", cm->name, ep->uri,
+               effective_score(ep, now), (unsigned)ep->successes,
+               (unsigned)ep->failures, i == cm->current ? " current" : "");
+    }
+}
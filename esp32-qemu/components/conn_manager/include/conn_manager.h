@@ -0,0 +1,137 @@
+/**
+ * Connection manager: endpoint selection, jittered backoff and rate limits
+ * IoT Course - Spring 2026
+ *
+ * When a broker or API server restarts, every device loses its connection
+ * at the same moment. With a fixed reconnect delay they all come back at
+ * the same moment too, again and again, and the server restarting under
+ * that load may fail again. This component spreads the fleet out:
+ *
+ *   - Jittered exponential backoff: retry n waits a random time in
+ *     [min, min(max, base * 2^n)] ("full jitter"). A success resets it.
+ *
+ *   - Ordered endpoints with health scores: the list order is the
+ *     preference. Every endpoint starts at 100 points, loses half per
+ *     failure and slowly earns them back, so a dead primary is skipped
+ *     while it keeps failing and retried once it has had time to recover.
+ *
+ *   - Token buckets: a reconnect bucket caps attempts on top of the
+ *     backoff, and token_bucket_t can rate-limit anything else (publishes)
+ *     the same way.
+ *
+ * Typical loop:
+ *
+ *   const char *uri = conn_manager_select(&cm);
+ *   ... connect to uri ...
+ *   conn_manager_report(&cm, ok);
+ *   if (!ok) vTaskDelay(pdMS_TO_TICKS(conn_manager_next_delay_ms(&cm)));
+ *
+ * All functions are safe to call from several tasks (e.g. the esp-mqtt
+ * event handler reports, a supervisor task selects and waits).
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CONN_SCORE_MAX 100
+
+/* ----------------------------------------------------------------
+ * Token bucket
+ * ---------------------------------------------------------------- */
+typedef struct {
+    uint32_t capacity;        /* Tokens, i.e. the largest burst */
+    uint32_t refill_ms;       /* One token is added every refill_ms */
+    int32_t tokens;           /* Negative = already promised to a caller */
+    int64_t last_refill_us;
+    portMUX_TYPE lock;
+} token_bucket_t;
+
+/** Start full: a device may use the whole burst right after boot */
+void token_bucket_init(token_bucket_t *tb, uint32_t capacity, uint32_t refill_ms);
+
+/** Take n tokens if available; returns false (and takes none) otherwise */
+bool token_bucket_take(token_bucket_t *tb, uint32_t n);
+
+/** Milliseconds until n tokens will be available (0 = now) */
+uint32_t token_bucket_wait_ms(token_bucket_t *tb, uint32_t n);
+
+/* ----------------------------------------------------------------
+ * Jittered exponential backoff
+ * ---------------------------------------------------------------- */
+typedef struct {
+    uint32_t base_ms;
+    uint32_t max_ms;
+    uint32_t min_ms;
+    uint32_t attempt;         /* Failures since the last success */
+} conn_backoff_t;
+
+void conn_backoff_init(conn_backoff_t *b, uint32_t base_ms, uint32_t max_ms, uint32_t min_ms);
+
+/** Delay before the next attempt; each call counts one more failure */
+uint32_t conn_backoff_next_ms(conn_backoff_t *b);
+
+void conn_backoff_reset(conn_backoff_t *b);
+
+/* ----------------------------------------------------------------
+ * Connection manager
+ * ---------------------------------------------------------------- */
+typedef struct {
+    const char *uri;
+    int score;                /* Health, 0..CONN_SCORE_MAX */
+    int64_t scored_us;        /* When score was last changed */
+    uint32_t successes;
+    uint32_t failures;
+} conn_endpoint_t;
+
+typedef struct {
+    const char *name;         /* For log lines */
+    conn_endpoint_t endpoints[CONFIG_CONN_MANAGER_MAX_ENDPOINTS];
+    int count;
+    int current;              /* Index returned by the last select */
+    conn_backoff_t backoff;
+    token_bucket_t reconnects;
+    portMUX_TYPE lock;
+} conn_manager_t;
+
+/**
+ * Set up a manager for `count` endpoints in order of preference, with the
+ * backoff and reconnect bucket from Kconfig. The URI strings are not
+ * copied. Extra endpoints beyond CONFIG_CONN_MANAGER_MAX_ENDPOINTS are
+ * ignored with a warning.
+ */
+void conn_manager_init(conn_manager_t *cm, const char *name,
+                       const char *const *uris, int count);
+
+/** Pick the healthiest endpoint (ties go to the earlier one) and return its URI */
+const char *conn_manager_select(conn_manager_t *cm);
+
+/** URI of the endpoint picked by the last conn_manager_select() */
+const char *conn_manager_current(conn_manager_t *cm);
+
+/**
+ * Report the outcome of using the current endpoint. A success restores
+ * its score and resets the backoff; a failure halves its score.
+ */
+void conn_manager_report(conn_manager_t *cm, bool success);
+
+/**
+ * Delay before the next connection attempt: the jittered backoff, plus the
+ * wait for a token if the reconnect bucket is empty. Takes a reconnect token and counts a
+ * backoff step, so call it once per attempt.
+ */
+uint32_t conn_manager_next_delay_ms(conn_manager_t *cm);
+
+/** Print "CONN <name> uri=... score=... ok=... fail=..." per endpoint */
+void conn_manager_log(conn_manager_t *cm);
+
+#ifdef __cplusplus
+}
+#endif
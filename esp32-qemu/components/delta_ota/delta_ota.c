@@ -0,0 +1,450 @@
+/**
+ * Delta OTA updates from the api-server
+ * IoT Course - Spring 2026
+ */
+
+#include "delta_ota.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_app_desc.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "rom/miniz.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "delta_ota";
+
+#define DICT_BYTES  TINFL_LZ_DICT_SIZE      /* 32 KB, the deflate window */
+#define BUF_BYTES   CONFIG_DELTA_OTA_BUF_BYTES
+#define SHA_BYTES   32
+
+static const char *server_ca_pem;
+
+/* Everything an update needs, allocated for its duration only */
+typedef struct {
+    uint8_t dict[DICT_BYTES];
+    tinfl_decompressor inflator;
+    uint8_t net[BUF_BYTES];
+    uint8_t work[BUF_BYTES];
+} update_mem_t;
+
+typedef enum { PHASE_HEADER, PHASE_OP, PHASE_ARGS, PHASE_DATA } phase_t;
+
+/* Patch interpreter: fed the inflated stream in pieces of any size */
+typedef struct {
+    update_mem_t *mem;
+    const esp_partition_t *src;
+    const esp_partition_t *dst;
+    esp_ota_handle_t ota;
+    bool ota_begun;
+    uint8_t running_sha[SHA_BYTES];
+
+    phase_t phase;
+    uint8_t head[DELTA_OTA_HEADER_BYTES];
+    size_t head_len;
+    uint32_t source_size;
+    uint32_t target_size;
+    uint8_t target_sha[SHA_BYTES];
+
+    uint8_t op;
+    uint8_t args[8];
+    size_t args_have;
+    size_t args_need;
+    uint32_t src_off;
+    uint32_t remaining;
+
+    uint32_t written;
+    uint32_t copy_bytes;
+    uint32_t diff_bytes;
+    uint32_t insert_bytes;
+} patch_t;
+
+void delta_ota_set_ca_cert(const char *ca_pem)
+{
+    server_ca_pem = ca_pem;
+}
+
+static void sha_hex(char *out, const uint8_t *sha, int bytes)
+{
+    for (int i = 0; i < bytes; i++) {
+        sprintf(out + 2 * i, "%02x", sha[i]);
+    }
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* ----------------------------------------------------------------
+ * Patch interpreter
+ * ---------------------------------------------------------------- */
+static esp_err_t write_out(patch_t *p, const uint8_t *data, size_t len)
+{
+    p->written += len;
+    return esp_ota_write(p->ota, data, len);
+}
+
+/* `len` bytes of the running image at p->src_off, plus delta if given */
+static esp_err_t copy_source(patch_t *p, const uint8_t *delta, size_t len)
+{
+    while (len > 0) {
+        size_t n = len < BUF_BYTES ? len : BUF_BYTES;
+        esp_err_t err = esp_partition_read(p->src, p->src_off, p->mem->work, n);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (delta != NULL) {
+            for (size_t i = 0; i < n; i++) {
+                p->mem->work[i] += delta[i];
+            }
+            delta += n;
+        }
+        err = write_out(p, p->mem->work, n);
+        if (err != ESP_OK) {
+            return err;
+        }
+        p->src_off += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t parse_header(patch_t *p)
+{
+    const uint8_t *h = p->head;
+    if (memcmp(h, DELTA_OTA_MAGIC, 4) != 0) {
+        ESP_LOGE(TAG, "Not a patch (bad magic)");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    p->source_size = get_u32(h + 4);
+    p->target_size = get_u32(h + 40);
+    memcpy(p->target_sha, h + 44, SHA_BYTES);
+
+    if (p->source_size > 0 &&
+        (memcmp(h + 8, p->running_sha, SHA_BYTES) != 0 || p->source_size > p->src->size)) {
+        ESP_LOGE(TAG, "Patch is for a different image than the running one");
+        return ESP_ERR_INVALID_VERSION;
+    }
+    if (p->target_size > p->dst->size) {
+        ESP_LOGE(TAG, "New image (%lu bytes) does not fit %s (%lu bytes)",
+                 (unsigned long)p->target_size, p->dst->label, (unsigned long)p->dst->size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    esp_err_t err = esp_ota_begin(p->dst, OTA_WITH_SEQUENTIAL_WRITES, &p->ota);
+    if (err == ESP_OK) {
+        p->ota_begun = true;
+    }
+    return err;
+}
+
+/* Check an operation's arguments and start it */
+static esp_err_t start_op(patch_t *p)
+{
+    uint32_t len;
+    if (p->op == 'I') {
+        len = get_u32(p->args);
+    } else {
+        p->src_off = get_u32(p->args);
+        len = get_u32(p->args + 4);
+        if (p->src_off > p->source_size || len > p->source_size - p->src_off) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+    }
+    if (len > p->target_size - p->written) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    switch (p->op) {
+    case 'C':
+        p->copy_bytes += len;
+        p->phase = PHASE_OP;
+        return copy_source(p, NULL, len);
+    case 'D':
+        p->diff_bytes += len;
+        break;
+    default:
+        p->insert_bytes += len;
+        break;
+    }
+    p->remaining = len;
+    p->phase = len > 0 ? PHASE_DATA : PHASE_OP;
+    return ESP_OK;
+}
+
+static esp_err_t patch_feed(patch_t *p, const uint8_t *data, size_t len)
+{
+    esp_err_t err = ESP_OK;
+    while (len > 0 && err == ESP_OK) {
+        size_t n;
+        switch (p->phase) {
+        case PHASE_HEADER:
+            n = DELTA_OTA_HEADER_BYTES - p->head_len;
+            n = n < len ? n : len;
+            memcpy(p->head + p->head_len, data, n);
+            p->head_len += n;
+            if (p->head_len == DELTA_OTA_HEADER_BYTES) {
+                err = parse_header(p);
+                p->phase = PHASE_OP;
+            }
+            break;
+
+        case PHASE_OP:
+            n = 1;
+            p->op = data[0];
+            if (p->op != 'C' && p->op != 'D' && p->op != 'I') {
+                ESP_LOGE(TAG, "Unknown operation 0x%02x", p->op);
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            p->args_have = 0;
+            p->args_need = p->op == 'I' ? 4 : 8;
+            p->phase = PHASE_ARGS;
+            break;
+
+        case PHASE_ARGS:
+            n = p->args_need - p->args_have;
+            n = n < len ? n : len;
+            memcpy(p->args + p->args_have, data, n);
+            p->args_have += n;
+            if (p->args_have == p->args_need) {
+                err = start_op(p);
+            }
+            break;
+
+        case PHASE_DATA:
+        default:
+            n = p->remaining < len ? p->remaining : len;
+            if (p->op == 'D') {
+                err = copy_source(p, data, n);
+            } else {
+                err = write_out(p, data, n);
+            }
+            p->remaining -= n;
+            if (p->remaining == 0) {
+                p->phase = PHASE_OP;
+            }
+            break;
+        }
+        data += n;
+        len -= n;
+    }
+    return err;
+}
+
+/* ----------------------------------------------------------------
+ * Download, inflate, apply
+ * ---------------------------------------------------------------- */
+static esp_err_t inflate_into(patch_t *p, esp_http_client_handle_t client, uint32_t *patch_bytes)
+{
+    update_mem_t *mem = p->mem;
+    const uint8_t *in = NULL;
+    size_t in_len = 0;
+    size_t dict_ofs = 0;
+    bool eof = false;
+    tinfl_status status;
+
+    tinfl_init(&mem->inflator);
+    do {
+        if (in_len == 0 && !eof) {
+            int n = esp_http_client_read(client, (char *)mem->net, BUF_BYTES);
+            if (n < 0) {
+                return ESP_FAIL;
+            }
+            eof = (n == 0);
+            in = mem->net;
+            in_len = n;
+            *patch_bytes += n;
+        }
+
+        size_t in_used = in_len;
+        size_t out_len = DICT_BYTES - dict_ofs;
+        status = tinfl_decompress(&mem->inflator, in, &in_used, mem->dict, mem->dict + dict_ofs,
+                                  &out_len, TINFL_FLAG_PARSE_ZLIB_HEADER |
+                                  (eof ? 0 : TINFL_FLAG_HAS_MORE_INPUT));
+        in += in_used;
+        in_len -= in_used;
+
+        if (out_len > 0) {
+            esp_err_t err = patch_feed(p, mem->dict + dict_ofs, out_len);
+            if (err != ESP_OK) {
+                return err;
+            }
+            dict_ofs = (dict_ofs + out_len) & (DICT_BYTES - 1);
+        }
+        if (status < TINFL_STATUS_DONE ||
+            (status == TINFL_STATUS_NEEDS_MORE_INPUT && eof)) {
+            ESP_LOGE(TAG, "Patch stream corrupt or truncated (%d)", (int)status);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+    } while (status != TINFL_STATUS_DONE);
+
+    if (p->phase != PHASE_OP || p->head_len < DELTA_OTA_HEADER_BYTES ||
+        p->written != p->target_size) {
+        ESP_LOGE(TAG, "Patch ended early (%lu of %lu bytes)",
+                 (unsigned long)p->written, (unsigned long)p->target_size);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return ESP_OK;
+}
+
+/* Read the new slot back and compare with the hash the server promised */
+static esp_err_t verify_and_swap(patch_t *p)
+{
+    esp_err_t err = esp_ota_end(p->ota);
+    p->ota_begun = false;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "New image failed validation: %s", esp_err_to_name(err));
+        return err;
+    }
+    uint8_t sha[SHA_BYTES];
+    err = esp_partition_get_sha256(p->dst, sha);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (memcmp(sha, p->target_sha, SHA_BYTES) != 0) {
+        ESP_LOGE(TAG, "New image hash does not match the patch header");
+        return ESP_ERR_INVALID_CRC;
+    }
+    return esp_ota_set_boot_partition(p->dst);
+}
+
+esp_err_t delta_ota_update(const char *url)
+{
+    int64_t start = esp_timer_get_time();
+    patch_t patch = { .phase = PHASE_HEADER };
+    patch.src = esp_ota_get_running_partition();
+    patch.dst = esp_ota_get_next_update_partition(NULL);
+    if (patch.dst == NULL) {
+        ESP_LOGE(TAG, "No inactive OTA slot: use partitions-ota.csv");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    esp_err_t err = esp_partition_get_sha256(patch.src, patch.running_sha);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    char from[2 * SHA_BYTES + 1];
+    sha_hex(from, patch.running_sha, SHA_BYTES);
+    char full_url[256];
+    snprintf(full_url, sizeof(full_url), "%s&from=%s", url, from);
+
+    esp_http_client_config_t config = {
+        .url = full_url,
+        .cert_pem = server_ca_pem,
+        .timeout_ms = CONFIG_DELTA_OTA_TIMEOUT_MS,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (client == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint32_t patch_bytes = 0;
+    err = esp_http_client_open(client, 0);
+    if (err != ESP_OK) {
+        goto out;
+    }
+    esp_http_client_fetch_headers(client);
+
+    int status = esp_http_client_get_status_code(client);
+    if (status == 304 || status == 404) {
+        printf("DELTA_OTA result=%s from=%.8s\n",
+               status == 304 ? "up_to_date" : "no_release", from);
+        err = ESP_ERR_NOT_FOUND;
+        goto out;
+    }
+    if (status != 200) {
+        ESP_LOGW(TAG, "Patch request: HTTP %d", status);
+        err = ESP_FAIL;
+        goto out;
+    }
+
+    patch.mem = malloc(sizeof(update_mem_t));
+    if (patch.mem == NULL) {
+        err = ESP_ERR_NO_MEM;
+        goto out;
+    }
+    ESP_LOGI(TAG, "Writing %s from %s", patch.dst->label, patch.src->label);
+    err = inflate_into(&patch, client, &patch_bytes);
+    if (err == ESP_OK) {
+        err = verify_and_swap(&patch);
+    }
+
+out:
+    if (patch.ota_begun) {
+        esp_ota_abort(patch.ota);
+    }
+    free(patch.mem);
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+
+    if (err == ESP_OK) {
+        char to[9];
+        sha_hex(to, patch.target_sha, 4);
+        printf("DELTA_OTA result=applied from=%.8s to=%s slot=%s patch_bytes=%lu "
+               "image_bytes=%lu copy=%lu diff=%lu insert=%lu ms=%lld ram=%u\n",
+               from, to, patch.dst->label, (unsigned long)patch_bytes,
+               (unsigned long)patch.target_size, (unsigned long)patch.copy_bytes,
+               (unsigned long)patch.diff_bytes, (unsigned long)patch.insert_bytes,
+               (esp_timer_get_time() - start) / 1000, (unsigned)sizeof(update_mem_t));
+#if CONFIG_DELTA_OTA_RESTART
+        fflush(stdout);
+        esp_restart();
+#endif
+    } else if (err != ESP_ERR_NOT_FOUND) {
+        printf("DELTA_OTA result=failed from=%.8s error=%s\n", from, esp_err_to_name(err));
+    }
+    return err;
+}
+
+/* ----------------------------------------------------------------
+ * Boot state and rollback
+ * ---------------------------------------------------------------- */
+static const char *state_name(esp_ota_img_states_t state)
+{
+    switch (state) {
+    case ESP_OTA_IMG_NEW:            return "new";
+    case ESP_OTA_IMG_PENDING_VERIFY: return "pending_verify";
+    case ESP_OTA_IMG_VALID:          return "valid";
+    case ESP_OTA_IMG_INVALID:        return "invalid";
+    case ESP_OTA_IMG_ABORTED:        return "aborted";
+    default:                         return "undefined";
+    }
+}
+
+void delta_ota_log_boot(void)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    esp_ota_img_states_t state = ESP_OTA_IMG_UNDEFINED;
+    esp_ota_get_state_partition(running, &state);
+
+    uint8_t sha[SHA_BYTES] = {0};
+    esp_partition_get_sha256(running, sha);
+    char hex[9];
+    sha_hex(hex, sha, 4);
+
+    printf("DELTA_OTA boot slot=%s version=%s state=%s sha=%s\n",
+           running->label, esp_app_get_description()->version, state_name(state), hex);
+}
+
+esp_err_t delta_ota_confirm(void)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    esp_ota_img_states_t state;
+    if (esp_ota_get_state_partition(running, &state) != ESP_OK ||
+        state != ESP_OTA_IMG_PENDING_VERIFY) {
+        return ESP_OK;
+    }
+    esp_err_t err = esp_ota_mark_app_valid_cancel_rollback();
+    if (err == ESP_OK) {
+        printf("DELTA_OTA confirmed slot=%s version=%s\n",
+               running->label, esp_app_get_description()->version);
+    }
+    return err;
+}
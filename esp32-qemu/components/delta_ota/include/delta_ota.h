@@ -0,0 +1,77 @@
+/**
+ * Delta OTA updates from the api-server
+ * IoT Course - Spring 2026
+ *
+ * The flash holds two app slots (partitions-ota.csv): the running image and
+ * an inactive one. Instead of downloading a whole 1 MB+ image, the device
+ * asks for a patch against what it runs now:
+ *
+ *   GET /api/ota/patch?project=<name>&from=<running image sha256>
+ *     304  already on the latest release
+ *     404  no release for this project
+ *     200  zlib-compressed patch
+ *
+ * The patch is a stream of operations that rebuild the new image from the
+ * running one, front to back:
+ *
+ *   header  "EDLT" u32 source_size u8 source_sha256[32]
+ *                  u32 target_size u8 target_sha256[32] u32 flags
+ *   'C'     u32 src_offset u32 len               copy from the running image
+ *   'D'     u32 src_offset u32 len, len bytes    running image bytes + delta
+ *   'I'     u32 len, len bytes                   new bytes
+ *
+ * (little-endian). Code changes shift addresses, so most of an image is
+ * either unchanged (C) or differs in a few bytes here and there (D, mostly
+ * zero bytes that compress to almost nothing). A patch with source_size 0
+ * is a full image and applies to any device.
+ *
+ * delta_ota_update() inflates the patch as it arrives (the ROM's tinfl with
+ * a 32 KB window) and writes the result straight into the inactive slot,
+ * so RAM use does not depend on the image size. It then reads the slot
+ * back to check the SHA-256 from the header, marks it for boot and
+ * restarts. With CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE the new image boots
+ * on probation: it must call delta_ota_confirm() once it reaches the
+ * server, or the next reset goes back to the previous slot.
+ *
+ * Images are identified by the SHA-256 that esp_partition_get_sha256()
+ * returns for an app slot, the digest appended to the .bin by the build.
+ */
+
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DELTA_OTA_MAGIC         "EDLT"
+#define DELTA_OTA_HEADER_BYTES  80
+
+/** CA certificate for https:// URLs (tls_session_ca_pem()); NULL for http */
+void delta_ota_set_ca_cert(const char *ca_pem);
+
+/**
+ * Print the running slot, version and state, e.g.
+ *   DELTA_OTA boot slot=ota_1 version=2.0.0 state=pending_verify sha=1a2b3c4d
+ */
+void delta_ota_log_boot(void);
+
+/**
+ * Fetch and apply the patch from `url` (".../api/ota/patch?project=<name>";
+ * the running image's hash is appended). Prints one line:
+ *   DELTA_OTA result=applied patch_bytes=.. image_bytes=.. copy=.. diff=..
+ *       insert=.. ms=.. ram=..
+ * On success restarts into the new image (does not return) unless
+ * CONFIG_DELTA_OTA_RESTART=n, then returns ESP_OK. Returns
+ * ESP_ERR_NOT_FOUND when there is nothing to install, or an error; the
+ * running image is never touched.
+ */
+esp_err_t delta_ota_update(const char *url);
+
+/** Keep the running image after an update (cancels the pending rollback) */
+esp_err_t delta_ota_confirm(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,305 @@
+/**
+ * Device configuration with NVS cache, conditional fetch and pushed deltas
+ * IoT Course - Spring 2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "esp_http_client.h"
+#include "cJSON.h"
+#include "sdkconfig.h"
+
+#include "device_config.h"
+
+static const char *TAG = "device_config";
+
+#define NVS_NAMESPACE "devcfg"
+#define NVS_KEY       "cfg"
+
+static device_config_t current;
+static device_config_cb_t change_cb = NULL;
+static void *change_ctx = NULL;
+static const char *server_ca_pem = NULL;
+
+/* lock guards `current` and is never held across network I/O;
+ * fetch_lock serializes fetches, which share doc_buffer */
+static StaticSemaphore_t lock_buffer;
+static SemaphoreHandle_t lock = NULL;
+static StaticSemaphore_t fetch_lock_buffer;
+static SemaphoreHandle_t fetch_lock = NULL;
+
+/* Response body of the last fetch (guarded by fetch_lock) */
+static char doc_buffer[CONFIG_DEVICE_CONFIG_MAX_DOC_BYTES];
+
+static void load_defaults(device_config_t *c)
+{
+    memset(c, 0, sizeof(*c));
+    c->version = 0;
+    c->sample_interval_ms = CONFIG_DEVICE_CONFIG_DEFAULT_SAMPLE_INTERVAL_MS;
+    strlcpy(c->device_name, "esp32-qemu-01", sizeof(c->device_name));
+    c->temperature_enabled = true;
+    c->humidity_enabled = true;
+}
+
+static void save_to_nvs(const device_config_t *c)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "NVS open failed: %s", esp_err_to_name(err));
+        return;
+    }
+    err = nvs_set_blob(nvs, NVS_KEY, c, sizeof(*c));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "NVS save failed: %s", esp_err_to_name(err));
+    }
+    nvs_close(nvs);
+}
+
+/* ----------------------------------------------------------------
+ * Apply the known fields present in obj; unknown keys are ignored
+ * ---------------------------------------------------------------- */
+static void apply_fields(const cJSON *obj, device_config_t *c)
+{
+    const cJSON *item = cJSON_GetObjectItem(obj, "sample_interval_ms");
+    if (cJSON_IsNumber(item)) {
+        int ms = item->valueint;
+        if (ms < CONFIG_DEVICE_CONFIG_MIN_SAMPLE_INTERVAL_MS) {
+            ESP_LOGW(TAG, "sample_interval_ms=%d too small, clamped", ms);
+            ms = CONFIG_DEVICE_CONFIG_MIN_SAMPLE_INTERVAL_MS;
+        }
+        c->sample_interval_ms = ms;
+    }
+
+    item = cJSON_GetObjectItem(obj, "device_name");
+    if (cJSON_IsString(item)) {
+        strlcpy(c->device_name, item->valuestring, sizeof(c->device_name));
+    }
+
+    item = cJSON_GetObjectItem(obj, "sensors_enabled");
+    if (cJSON_IsArray(item)) {
+        c->temperature_enabled = false;
+        c->humidity_enabled = false;
+        const cJSON *sensor;
+        cJSON_ArrayForEach(sensor, item) {
+            if (!cJSON_IsString(sensor)) {
+                continue;
+            }
+            if (strcmp(sensor->valuestring, "temperature") == 0) {
+                c->temperature_enabled = true;
+            } else if (strcmp(sensor->valuestring, "humidity") == 0) {
+                c->humidity_enabled = true;
+            }
+        }
+    }
+}
+
+/* Publish a new configuration: store, persist, notify (lock must be held) */
+static void commit_locked(const device_config_t *c, device_config_t *copy)
+{
+    current = *c;
+    save_to_nvs(&current);
+    *copy = current;
+    ESP_LOGI(TAG, "Config v%u applied: sample_interval_ms=%u",
+             (unsigned)current.version, (unsigned)current.sample_interval_ms);
+}
+
+static void notify(const device_config_t *copy)
+{
+    if (change_cb) {
+        change_cb(copy, change_ctx);
+    }
+}
+
+esp_err_t device_config_init(void)
+{
+    if (lock == NULL) {
+        lock = xSemaphoreCreateMutexStatic(&lock_buffer);
+        fetch_lock = xSemaphoreCreateMutexStatic(&fetch_lock_buffer);
+    }
+    load_defaults(&current);
+
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        ESP_LOGI(TAG, "No cached config, using defaults");
+        return ESP_OK;
+    }
+
+    device_config_t cached;
+    size_t len = sizeof(cached);
+    esp_err_t err = nvs_get_blob(nvs, NVS_KEY, &cached, &len);
+    nvs_close(nvs);
+
+    /* A blob of a different size was written by an older firmware layout */
+    if (err == ESP_OK && len == sizeof(cached)) {
+        cached.device_name[DEVICE_CONFIG_NAME_LEN - 1] = '\0';
+        current = cached;
+        ESP_LOGI(TAG, "Config v%u loaded from NVS: sample_interval_ms=%u",
+                 (unsigned)current.version, (unsigned)current.sample_interval_ms);
+    } else {
+        ESP_LOGI(TAG, "No usable cached config, using defaults");
+    }
+    return ESP_OK;
+}
+
+void device_config_get(device_config_t *out)
+{
+    xSemaphoreTake(lock, portMAX_DELAY);
+    *out = current;
+    xSemaphoreGive(lock);
+}
+
+void device_config_on_change(device_config_cb_t cb, void *ctx)
+{
+    change_cb = cb;
+    change_ctx = ctx;
+}
+
+void device_config_set_ca_cert(const char *ca_pem)
+{
+    server_ca_pem = ca_pem;
+}
+
+/* ----------------------------------------------------------------
+ * Conditional fetch
+ * ---------------------------------------------------------------- */
+esp_err_t device_config_fetch(const char *url)
+{
+    esp_http_client_config_t config = {
+        .url = url,
+        .cert_pem = server_ca_pem,
+        .timeout_ms = 5000,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (client == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    xSemaphoreTake(fetch_lock, portMAX_DELAY);
+
+    /* Only the version is needed for the request; the exchange itself runs
+     * without `lock`, so device_config_get() never waits on the network */
+    xSemaphoreTake(lock, portMAX_DELAY);
+    uint32_t have = current.version;
+    xSemaphoreGive(lock);
+
+    char etag[16];
+    if (have > 0) {
+        snprintf(etag, sizeof(etag), "\"v%u\"", (unsigned)have);
+        esp_http_client_set_header(client, "If-None-Match", etag);
+    }
+
+    device_config_t copy;
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err != ESP_OK) {
+        goto out;
+    }
+    esp_http_client_fetch_headers(client);
+
+    int status = esp_http_client_get_status_code(client);
+    if (status == 304) {
+        ESP_LOGI(TAG, "Config v%u is current (304 Not Modified)", (unsigned)have);
+        err = ESP_ERR_NOT_FOUND;
+        goto out;
+    }
+    if (status != 200) {
+        ESP_LOGW(TAG, "Config fetch: HTTP %d", status);
+        err = ESP_FAIL;
+        goto out;
+    }
+
+    int total = 0;
+    int n;
+    while ((n = esp_http_client_read(client, doc_buffer + total,
+                                     sizeof(doc_buffer) - 1 - total)) > 0) {
+        total += n;
+        if (total >= (int)sizeof(doc_buffer) - 1) {
+            break;
+        }
+    }
+    doc_buffer[total] = '\0';
+
+    cJSON *root = cJSON_ParseWithLength(doc_buffer, total);
+    const cJSON *version = cJSON_GetObjectItem(root, "version");
+    if (!cJSON_IsNumber(version)) {
+        ESP_LOGW(TAG, "Config document without version ignored");
+        cJSON_Delete(root);
+        err = ESP_ERR_INVALID_RESPONSE;
+        goto out;
+    }
+
+    /* A delta may have moved `current` on while the request was running */
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if ((uint32_t)version->valueint <= current.version) {
+        ESP_LOGI(TAG, "Fetched config v%d, already at v%u",
+                 version->valueint, (unsigned)current.version);
+        err = ESP_ERR_NOT_FOUND;
+    } else {
+        device_config_t next = current;
+        apply_fields(root, &next);
+        next.version = version->valueint;
+        commit_locked(&next, &copy);
+        err = ESP_OK;
+    }
+    xSemaphoreGive(lock);
+    cJSON_Delete(root);
+
+out:
+    xSemaphoreGive(fetch_lock);
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    if (err == ESP_OK) {
+        notify(&copy);
+    } else if (err != ESP_ERR_NOT_FOUND) {
+        ESP_LOGW(TAG, "Config fetch failed: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+/* ----------------------------------------------------------------
+ * Pushed delta
+ * ---------------------------------------------------------------- */
+esp_err_t device_config_apply_delta(const char *json, int len)
+{
+    cJSON *root = cJSON_ParseWithLength(json, len);
+    const cJSON *version = cJSON_GetObjectItem(root, "version");
+    const cJSON *base = cJSON_GetObjectItem(root, "base");
+    const cJSON *set = cJSON_GetObjectItem(root, "set");
+    if (!cJSON_IsNumber(version) || !cJSON_IsNumber(base) || !cJSON_IsObject(set)) {
+        ESP_LOGW(TAG, "Malformed config delta ignored");
+        cJSON_Delete(root);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err;
+    device_config_t copy;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if ((uint32_t)version->valueint <= current.version) {
+        err = ESP_ERR_NOT_FOUND;
+    } else if ((uint32_t)base->valueint > current.version) {
+        ESP_LOGW(TAG, "Config delta v%d needs base v%d, have v%u",
+                 version->valueint, base->valueint, (unsigned)current.version);
+        err = ESP_ERR_INVALID_VERSION;
+    } else {
+        device_config_t next = current;
+        apply_fields(set, &next);
+        next.version = version->valueint;
+        commit_locked(&next, &copy);
+        err = ESP_OK;
+    }
+    xSemaphoreGive(lock);
+    cJSON_Delete(root);
+
+    if (err == ESP_OK) {
+        notify(&copy);
+    }
+    return err;
+}
@@ -0,0 +1,80 @@
+/**
+ * Device configuration with NVS cache, conditional fetch and pushed deltas
+ * IoT Course - Spring 2026
+ *
+ * The API server versions its configuration. A device keeps the last
+ * configuration it saw in NVS, so after a reboot it starts sampling with
+ * those values immediately, before the network is even up.
+ *
+ * Two ways to stay in sync:
+ *
+ *   1. Conditional fetch (HTTP):
+ *        GET /api/config   If-None-Match: "v<version>"
+ *      The server answers 304 Not Modified with no body when nothing
+ *      changed, or 200 with the full document and its "version".
+ *
+ *   2. Pushed deltas (MQTT, retained on esp32/config):
+ *        {"version":7,"base":6,"set":{"sample_interval_ms":2000}}
+ *      A device at version 6 applies "set" directly. A device that
+ *      missed an update (version < base) gets ESP_ERR_INVALID_VERSION
+ *      and should fall back to a conditional fetch.
+ *
+ * Values are applied at run time: tasks call device_config_get() each
+ * period instead of using compile-time constants.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DEVICE_CONFIG_NAME_LEN 32
+
+typedef struct {
+    uint32_t version;            /* 0 = compiled-in defaults, never synced */
+    uint32_t sample_interval_ms;
+    char device_name[DEVICE_CONFIG_NAME_LEN];
+    bool temperature_enabled;
+    bool humidity_enabled;
+} device_config_t;
+
+/** Called after a new configuration has been applied */
+typedef void (*device_config_cb_t)(const device_config_t *cfg, void *ctx);
+
+/**
+ * Load the compiled-in defaults, then the cached configuration from NVS if
+ * there is one. nvs_flash_init() must have been called.
+ */
+esp_err_t device_config_init(void);
+
+/** Copy the current configuration */
+void device_config_get(device_config_t *out);
+
+/** Register a single callback for configuration changes */
+void device_config_on_change(device_config_cb_t cb, void *ctx);
+
+/** CA certificate (PEM) that https:// fetch URLs must chain to */
+void device_config_set_ca_cert(const char *ca_pem);
+
+/**
+ * Conditional GET of the full configuration document.
+ * Returns ESP_OK if a new version was applied, ESP_ERR_NOT_FOUND on
+ * 304 Not Modified, or an error from the HTTP client / parser.
+ */
+esp_err_t device_config_fetch(const char *url);
+
+/**
+ * Apply a pushed delta document (see above).
+ * Returns ESP_OK if applied, ESP_ERR_NOT_FOUND if it is not newer than the
+ * current version, or ESP_ERR_INVALID_VERSION if updates were missed.
+ */
+esp_err_t device_config_apply_delta(const char *json, int len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,84 @@
+/**
+ * End-to-end latency tracing of sensor readings
+ * IoT Course - Spring 2026
+ *
+ * The server stamps readings when they arrive, which says nothing about
+ * how old a value was by then. With the device clock synced over SNTP
+ * (CONFIG_LATENCY_TRACE_SNTP_SERVER, the compose ntp-server service), each
+ * reading carries a trace ID and two device timestamps, and every later
+ * hop adds its own:
+ *
+ *   ts     sample   value read from the sensor                 (device)
+ *   tp     publish  handed to esp-mqtt / esp_http_client       (device)
+ *          receive  MQTT bridge or POST handler gets it        (api-server)
+ *          store    appended to the readings                   (api-server)
+ *          query    first served by GET /api/sensors[/latest]  (api-server)
+ *
+ * GET /api/trace/report breaks the latency into sample->publish,
+ * publish->broker (network and broker forwarding, or the HTTP request),
+ * broker->store and store->query; scripts/latency-report.py prints it.
+ * All times are Unix microseconds; device and server clocks agree to
+ * within the SNTP error (about a millisecond on the local network).
+ *
+ *   latency_trace_t t;
+ *   latency_trace_begin(&t);                       // right after the read
+ *   msg_printf(m, "{\"value\":%.1f," LATENCY_TRACE_JSON_FMT "}",
+ *              v, LATENCY_TRACE_JSON_ARGS(&t));
+ *   ...
+ *   m->len = latency_trace_stamp_publish(m->data, m->len, msg_capacity(m));
+ *   esp_mqtt_client_publish(...);                  // in the sender task
+ *
+ * Until the first sync, timestamps are 0 and the server leaves those
+ * readings out of the device-side stages.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint64_t id;        /* Boot-random upper half, sequence number lower half */
+    int64_t sample_us;  /* Unix time of the sample, 0 if not synced yet */
+} latency_trace_t;
+
+/* JSON members for a trace, to splice into a payload format string */
+#define LATENCY_TRACE_JSON_FMT      "\"trace\":\"%016llx\",\"ts\":%lld"
+#define LATENCY_TRACE_JSON_ARGS(t)  (unsigned long long)(t)->id, (long long)(t)->sample_us
+
+/**
+ * Start SNTP against CONFIG_LATENCY_TRACE_SNTP_SERVER. Call once the
+ * network is up; does not block. Each sync prints
+ *   TIME_SYNC server=10.0.2.2 step_ms=... unix=...
+ * with how far the clock was moved.
+ */
+esp_err_t latency_trace_start_sync(void);
+
+/** Wait up to timeout_ms for the first sync; true once the clock is set */
+bool latency_trace_wait_sync(uint32_t timeout_ms);
+
+bool latency_trace_synced(void);
+
+/** Unix time in microseconds, or 0 before the first sync */
+int64_t latency_trace_now_us(void);
+
+/** New trace ID, sampled now */
+void latency_trace_begin(latency_trace_t *t);
+
+/**
+ * Add the publish time ("tp") as the last member of the JSON object in
+ * json[0..len), just before it is sent. cap is the buffer size. Returns
+ * the new length, or len unchanged if the payload is not an object or the
+ * member does not fit.
+ */
+size_t latency_trace_stamp_publish(char *json, size_t len, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,100 @@
+/**
+ * End-to-end latency tracing of sensor readings
+ * IoT Course - Spring 2026
+ */
+
+#include "latency_trace.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include "esp_netif_sntp.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "latency_trace";
+
+static volatile bool synced;
+static uint32_t sync_count;
+static int64_t clock_offset_us;     /* Unix time - esp_timer, at the last sync */
+static uint32_t boot_id;
+static uint32_t next_seq;
+
+/* Runs in the lwIP task right after SNTP set the clock */
+static void on_time_sync(struct timeval *tv)
+{
+    int64_t unix_us = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+    int64_t offset = unix_us - esp_timer_get_time();
+    /* How far this sync moved the clock; the first one sets it from 1970 */
+    int64_t step_us = sync_count > 0 ? offset - clock_offset_us : 0;
+
+    clock_offset_us = offset;
+    sync_count++;
+    synced = true;
+    printf("TIME_SYNC server=%s n=%lu step_ms=%.3f unix_ms=%lld\n",
+           CONFIG_LATENCY_TRACE_SNTP_SERVER, (unsigned long)sync_count,
+           step_us / 1000.0, unix_us / 1000);
+}
+
+esp_err_t latency_trace_start_sync(void)
+{
+    esp_sntp_config_t config = ESP_NETIF_SNTP_DEFAULT_CONFIG(CONFIG_LATENCY_TRACE_SNTP_SERVER);
+    config.sync_cb = on_time_sync;
+    esp_err_t err = esp_netif_sntp_init(&config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "SNTP init failed: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+bool latency_trace_wait_sync(uint32_t timeout_ms)
+{
+    if (!synced && esp_netif_sntp_sync_wait(pdMS_TO_TICKS(timeout_ms)) != ESP_OK) {
+        ESP_LOGW(TAG, "No time from %s after %lu ms, readings go untimed",
+                 CONFIG_LATENCY_TRACE_SNTP_SERVER, (unsigned long)timeout_ms);
+    }
+    return synced;
+}
+
+bool latency_trace_synced(void)
+{
+    return synced;
+}
+
+int64_t latency_trace_now_us(void)
+{
+    if (!synced) {
+        return 0;
+    }
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+void latency_trace_begin(latency_trace_t *t)
+{
+    if (boot_id == 0) {
+        boot_id = esp_random() | 1;
+    }
+    uint32_t seq = __atomic_fetch_add(&next_seq, 1, __ATOMIC_RELAXED);
+    t->id = ((uint64_t)boot_id << 32) | seq;
+    t->sample_us = latency_trace_now_us();
+}
+
+size_t latency_trace_stamp_publish(char *json, size_t len, size_t cap)
+{
+    if (len == 0 || json[len - 1] != '}') {
+        return len;
+    }
+    char member[32];
+    int n = snprintf(member, sizeof(member), ",\"tp\":%lld}",
+                     (long long)latency_trace_now_us());
+    if (len - 1 + n >= cap) {
+        return len;
+    }
+    memcpy(json + len - 1, member, n + 1);
+    return len - 1 + n;
+}
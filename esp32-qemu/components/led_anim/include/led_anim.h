@@ -0,0 +1,76 @@
+/**
+ * Double-buffered LED strip animation
+ * IoT Course - Spring 2026
+ *
+ * The blink example sets one pixel with led_strip_set_pixel() and then
+ * waits in led_strip_refresh() while the frame is clocked out. On a strip
+ * of hundreds of pixels that wait is most of a frame (30 us per WS2812
+ * pixel). led_anim instead keeps the RMT peripheral and the CPU busy at
+ * the same time:
+ *
+ *   frame tick (esp_timer, fixed rate)
+ *     render(pixels)          application draws linear RGB, in place
+ *     LUT pass                gamma + brightness, one table lookup per
+ *                             byte, into the back wire buffer (GRB)
+ *     wait front done         normally already finished
+ *     rmt_transmit(back)      returns at once; back becomes front
+ *
+ * While frame N goes out over RMT, frame N+1 is rendered into the other
+ * buffer. A render callback that returns false (nothing changed) skips the
+ * LUT pass and the transmit: a static strip costs one callback per tick.
+ *
+ * The animation task runs on the PRO_CPU (TASK_ROLE_DISPLAY) so sensing
+ * tasks on the APP_CPU are not disturbed. Every CONFIG_LED_ANIM_REPORT_S
+ * seconds it prints:
+ *
+ *   LED_ANIM leds=300 target_fps=60 fps=60.0 sent_fps=31.2 skipped=172
+ *       late=0 render_us=180 lut_us=95 tx_us=9290 cpu_pct=1.6
+ *
+ * fps counts frame ticks handled, sent_fps frames put on the wire; late
+ * counts ticks missed because a frame took longer than the period.
+ * cpu_pct is the share of one core spent in render + LUT; the RMT refill
+ * interrupts (without DMA) are not included.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint8_t r, g, b;
+} led_rgb_t;
+
+/**
+ * Draw frame number `frame` at time now_us into pixels[0..n). The buffer
+ * keeps the previous frame, so only changed pixels need writing. Return
+ * false when nothing changed to skip sending the frame.
+ */
+typedef bool (*led_anim_render_t)(led_rgb_t *pixels, size_t n, uint32_t frame,
+                                  int64_t now_us, void *ctx);
+
+typedef struct {
+    int gpio;               /* Strip data pin */
+    size_t num_leds;        /* <= CONFIG_LED_ANIM_MAX_LEDS */
+    uint32_t fps;           /* Frame ticks per second */
+    uint8_t brightness;     /* 0..255, applied after gamma */
+} led_anim_config_t;
+
+/**
+ * Set up the RMT channel and start the animation task. render is called
+ * from that task once per frame tick.
+ */
+esp_err_t led_anim_start(const led_anim_config_t *cfg, led_anim_render_t render, void *ctx);
+
+/** Change the global brightness; the next frame is sent even if unchanged */
+void led_anim_set_brightness(uint8_t brightness);
+
+#ifdef __cplusplus
+}
+#endif
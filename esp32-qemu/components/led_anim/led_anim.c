@@ -0,0 +1,334 @@
+/**
+ * Double-buffered LED strip animation
+ * IoT Course - Spring 2026
+ */
+
+#include "led_anim.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "driver/rmt_tx.h"
+#include "esp_attr.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#include "static_alloc.h"
+
+static const char *TAG = "led_anim";
+
+#define MAX_LEDS        CONFIG_LED_ANIM_MAX_LEDS
+#define TICKS_PER_US    (CONFIG_LED_ANIM_RESOLUTION_HZ / 1000000)
+
+#if CONFIG_LED_ANIM_RMT_DMA
+#define RMT_FEED        "DMA"
+#else
+#define RMT_FEED        "refill ISR"
+#endif
+
+/* Frame buffers: what the application draws, and the two wire images */
+static led_rgb_t pixels[MAX_LEDS];
+static uint8_t wire[2][MAX_LEDS * 3];
+static uint8_t lut[256];
+
+static led_anim_config_t config;
+static led_anim_render_t render_fn;
+static void *render_ctx;
+static volatile uint8_t brightness;
+
+STATIC_TASK_DEFINE(anim_task_def, "led_anim", 3072);
+static TaskHandle_t anim_task_handle;
+static esp_timer_handle_t frame_timer;
+
+static rmt_channel_handle_t channel;
+static SemaphoreHandle_t tx_done;
+static StaticSemaphore_t tx_done_buffer;
+static volatile int64_t tx_end_us;
+
+/* ----------------------------------------------------------------
+ * WS2812 encoder: the pixel bytes, then one latch symbol
+ * ---------------------------------------------------------------- */
+typedef struct {
+    rmt_encoder_t base;
+    rmt_encoder_handle_t bytes;
+    rmt_encoder_handle_t copy;
+    int state;
+    rmt_symbol_word_t reset_code;
+} ws2812_encoder_t;
+
+static ws2812_encoder_t encoder;
+
+static size_t IRAM_ATTR ws2812_encode(rmt_encoder_t *base, rmt_channel_handle_t ch,
+                                      const void *data, size_t size,
+                                      rmt_encode_state_t *ret_state)
+{
+    ws2812_encoder_t *enc = __containerof(base, ws2812_encoder_t, base);
+    rmt_encode_state_t session = RMT_ENCODING_RESET;
+    rmt_encode_state_t state = RMT_ENCODING_RESET;
+    size_t symbols = 0;
+
+    switch (enc->state) {
+    case 0:
+        symbols += enc->bytes->encode(enc->bytes, ch, data, size, &session);
+        if (session & RMT_ENCODING_COMPLETE) {
+            enc->state = 1;
+        }
+        if (session & RMT_ENCODING_MEM_FULL) {
+            state |= RMT_ENCODING_MEM_FULL;
+            break;
+        }
+        /* fall through */
+    case 1:
+        symbols += enc->copy->encode(enc->copy, ch, &enc->reset_code,
+                                     sizeof(enc->reset_code), &session);
+        if (session & RMT_ENCODING_COMPLETE) {
+            enc->state = RMT_ENCODING_RESET;
+            state |= RMT_ENCODING_COMPLETE;
+        }
+        if (session & RMT_ENCODING_MEM_FULL) {
+            state |= RMT_ENCODING_MEM_FULL;
+        }
+        break;
+    }
+    *ret_state = state;
+    return symbols;
+}
+
+static esp_err_t ws2812_reset(rmt_encoder_t *base)
+{
+    ws2812_encoder_t *enc = __containerof(base, ws2812_encoder_t, base);
+    rmt_encoder_reset(enc->bytes);
+    rmt_encoder_reset(enc->copy);
+    enc->state = RMT_ENCODING_RESET;
+    return ESP_OK;
+}
+
+static esp_err_t ws2812_del(rmt_encoder_t *base)
+{
+    ws2812_encoder_t *enc = __containerof(base, ws2812_encoder_t, base);
+    rmt_del_encoder(enc->bytes);
+    rmt_del_encoder(enc->copy);
+    return ESP_OK;
+}
+
+static esp_err_t ws2812_encoder_init(void)
+{
+    /* T0H 0.3 us, T0L 0.9 us, T1H 0.9 us, T1L 0.3 us, MSB first */
+    rmt_bytes_encoder_config_t bytes_cfg = {
+        .bit0 = { .level0 = 1, .duration0 = 3 * TICKS_PER_US / 10,
+                  .level1 = 0, .duration1 = 9 * TICKS_PER_US / 10 },
+        .bit1 = { .level0 = 1, .duration0 = 9 * TICKS_PER_US / 10,
+                  .level1 = 0, .duration1 = 3 * TICKS_PER_US / 10 },
+        .flags.msb_first = 1,
+    };
+    rmt_copy_encoder_config_t copy_cfg = {};
+    uint32_t reset_ticks = CONFIG_LED_ANIM_RESET_US * TICKS_PER_US / 2;
+
+    encoder.base.encode = ws2812_encode;
+    encoder.base.reset = ws2812_reset;
+    encoder.base.del = ws2812_del;
+    encoder.reset_code = (rmt_symbol_word_t) {
+        .level0 = 0, .duration0 = reset_ticks,
+        .level1 = 0, .duration1 = reset_ticks,
+    };
+    ESP_RETURN_ON_ERROR(rmt_new_bytes_encoder(&bytes_cfg, &encoder.bytes), TAG, "bytes encoder");
+    ESP_RETURN_ON_ERROR(rmt_new_copy_encoder(&copy_cfg, &encoder.copy), TAG, "copy encoder");
+    return ESP_OK;
+}
+
+static bool IRAM_ATTR on_tx_done(rmt_channel_handle_t ch,
+                                 const rmt_tx_done_event_data_t *event, void *ctx)
+{
+    BaseType_t woken = pdFALSE;
+    tx_end_us = esp_timer_get_time();
+    xSemaphoreGiveFromISR(tx_done, &woken);
+    return woken == pdTRUE;
+}
+
+/* ----------------------------------------------------------------
+ * Gamma + brightness
+ * ---------------------------------------------------------------- */
+static void build_lut(uint8_t level)
+{
+    /* Gamma 2.2 so that equal steps in pixel values look like equal steps
+     * in brightness; the brightness scale is folded into the same table */
+    for (int v = 0; v < 256; v++) {
+        float g = powf(v / 255.0f, 2.2f) * 255.0f;
+        lut[v] = (uint8_t)((g * (level + 1)) / 256.0f + 0.5f);
+    }
+}
+
+/** One pass over the whole frame: RGB pixels -> GRB wire bytes */
+static void apply_lut(uint8_t *restrict dst, const led_rgb_t *restrict src, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        dst[0] = lut[src[i].g];
+        dst[1] = lut[src[i].r];
+        dst[2] = lut[src[i].b];
+        dst += 3;
+    }
+}
+
+/* ----------------------------------------------------------------
+ * Frame loop
+ * ---------------------------------------------------------------- */
+typedef struct {
+    int64_t since_us;
+    uint32_t ticks;         /* Frame ticks handled */
+    uint32_t sent;          /* Frames transmitted */
+    uint32_t skipped;       /* Render reported no change */
+    uint32_t late;          /* Ticks missed while a frame was still busy */
+    int64_t render_us;
+    int64_t lut_us;
+    int64_t tx_us;
+    uint32_t tx_count;
+} anim_stats_t;
+
+static void report(anim_stats_t *s, int64_t now)
+{
+    double secs = (now - s->since_us) / 1e6;
+    printf("LED_ANIM leds=%u target_fps=%lu fps=%.1f sent_fps=%.1f skipped=%lu late=%lu "
+           "render_us=%lld lut_us=%lld tx_us=%lld cpu_pct=%.1f\n",
+           (unsigned)config.num_leds, (unsigned long)config.fps,
+           s->ticks / secs, s->sent / secs,
+           (unsigned long)s->skipped, (unsigned long)s->late,
+           s->ticks ? s->render_us / s->ticks : 0,
+           s->sent ? s->lut_us / s->sent : 0,
+           s->tx_count ? s->tx_us / s->tx_count : 0,
+           100.0 * (s->render_us + s->lut_us) / (now - s->since_us));
+    memset(s, 0, sizeof(*s));
+    s->since_us = now;
+}
+
+static void frame_tick(void *arg)
+{
+    xTaskNotifyGive(anim_task_handle);
+}
+
+static void anim_task(void *arg)
+{
+    rmt_transmit_config_t tx_cfg = { .loop_count = 0 };
+    size_t bytes = config.num_leds * 3;
+    uint8_t lut_level = brightness;
+    int back = 0;
+    uint32_t frame = 0;
+    bool force_send = true;     /* The strip's state is unknown until the first frame */
+    int64_t tx_start_us = 0;
+    anim_stats_t stats = { .since_us = esp_timer_get_time() };
+
+    build_lut(lut_level);
+
+    while (1) {
+        uint32_t pending = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (pending > 1) {
+            stats.late += pending - 1;
+        }
+        stats.ticks++;
+
+        int64_t t0 = esp_timer_get_time();
+        bool dirty = render_fn(pixels, config.num_leds, frame++, t0, render_ctx);
+        int64_t t1 = esp_timer_get_time();
+        stats.render_us += t1 - t0;
+
+        if (brightness != lut_level) {
+            lut_level = brightness;
+            build_lut(lut_level);
+            force_send = true;
+        }
+        if (!dirty && !force_send) {
+            stats.skipped++;
+        } else {
+            force_send = false;
+
+            /* The front buffer may still be on the wire; the back one is ours */
+            apply_lut(wire[back], pixels, config.num_leds);
+            int64_t t2 = esp_timer_get_time();
+            stats.lut_us += t2 - t1;
+
+            xSemaphoreTake(tx_done, portMAX_DELAY);
+            if (tx_start_us != 0) {
+                stats.tx_us += tx_end_us - tx_start_us;
+                stats.tx_count++;
+            }
+            tx_start_us = esp_timer_get_time();
+            esp_err_t err = rmt_transmit(channel, &encoder.base, wire[back], bytes, &tx_cfg);
+            if (err != ESP_OK) {
+                ESP_LOGW(TAG, "rmt_transmit: %s", esp_err_to_name(err));
+                xSemaphoreGive(tx_done);
+                tx_start_us = 0;
+            } else {
+                stats.sent++;
+                back ^= 1;
+            }
+        }
+
+#if CONFIG_LED_ANIM_REPORT_S > 0
+        int64_t now = esp_timer_get_time();
+        if (now - stats.since_us >= CONFIG_LED_ANIM_REPORT_S * 1000000LL) {
+            report(&stats, now);
+        }
+#endif
+    }
+}
+
+/* ----------------------------------------------------------------
+ * Public API
+ * ---------------------------------------------------------------- */
+esp_err_t led_anim_start(const led_anim_config_t *cfg, led_anim_render_t render, void *ctx)
+{
+    if (cfg->num_leds == 0 || cfg->num_leds > MAX_LEDS || cfg->fps == 0 || render == NULL) {
+        ESP_LOGE(TAG, "%u LEDs at %lu fps not supported (max %d LEDs)",
+                 (unsigned)cfg->num_leds, (unsigned long)cfg->fps, MAX_LEDS);
+        return ESP_ERR_INVALID_ARG;
+    }
+    config = *cfg;
+    render_fn = render;
+    render_ctx = ctx;
+    brightness = cfg->brightness;
+
+    rmt_tx_channel_config_t chan_cfg = {
+        .gpio_num = cfg->gpio,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = CONFIG_LED_ANIM_RESOLUTION_HZ,
+        .mem_block_symbols = CONFIG_LED_ANIM_RMT_MEM_SYMBOLS,
+        .trans_queue_depth = 2,
+#if CONFIG_LED_ANIM_RMT_DMA
+        .flags.with_dma = 1,
+#endif
+    };
+    ESP_RETURN_ON_ERROR(rmt_new_tx_channel(&chan_cfg, &channel), TAG, "RMT channel");
+    ESP_RETURN_ON_ERROR(ws2812_encoder_init(), TAG, "encoder");
+
+    tx_done = xSemaphoreCreateBinaryStatic(&tx_done_buffer);
+    xSemaphoreGive(tx_done);
+    rmt_tx_event_callbacks_t cbs = { .on_trans_done = on_tx_done };
+    ESP_RETURN_ON_ERROR(rmt_tx_register_event_callbacks(channel, &cbs, NULL), TAG, "callbacks");
+    ESP_RETURN_ON_ERROR(rmt_enable(channel), TAG, "enable");
+
+    anim_task_handle = static_task_create(&anim_task_def, anim_task, NULL, 4, TASK_ROLE_DISPLAY);
+    if (anim_task_handle == NULL) {
+        return ESP_FAIL;
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = frame_tick,
+        .name = "led_frame",
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&timer_args, &frame_timer), TAG, "timer");
+    ESP_RETURN_ON_ERROR(esp_timer_start_periodic(frame_timer, 1000000 / cfg->fps), TAG, "timer");
+
+    ESP_LOGI(TAG, "%u LEDs on GPIO %d at %lu fps, %u bytes per frame, RMT %s",
+             (unsigned)cfg->num_leds, cfg->gpio, (unsigned long)cfg->fps,
+             (unsigned)(cfg->num_leds * 3), RMT_FEED);
+    return ESP_OK;
+}
+
+void led_anim_set_brightness(uint8_t level)
+{
+    brightness = level;
+}
@@ -0,0 +1,81 @@
+/**
+ * Local HTTP API: pull recent readings and metrics from the device
+ * IoT Course - Spring 2026
+ *
+ * The devices push everything to the api-server. While the backend is
+ * down, or while a device is being commissioned, there is nothing to ask.
+ * local_api runs a small esp_http_server on the device instead:
+ *
+ *   GET /readings?since=<seq>&limit=<n>   readings after seq, oldest first
+ *   GET /metrics                          Prometheus text format
+ *   GET /config                           the active device_config
+ *
+ *   {"device":"esp32-qemu-01","oldest":1,"readings":[
+ *     {"seq":1,"uptime_ms":8123,"ts":1767225600123,"temperature":21.4,...},
+ *     ...],"next":5}
+ *
+ * A poller passes the last "next" as since= and only gets what is new.
+ * Sequence numbers restart at 1 when the device reboots; a since= beyond
+ * the last reading then answers with "next" set to that reading, lower
+ * than since, and the poller continues from there.
+ * Readings live in a fixed ring of CONFIG_LOCAL_API_RING_READINGS; "oldest"
+ * tells a client that fell behind where the ring starts now.
+ *
+ * RAM is fixed at start: the ring, one server task whose stack holds the
+ * chunk buffer, and at most CONFIG_LOCAL_API_MAX_SOCKETS connections (the
+ * least recently used one is closed for a new client). Every response is
+ * written in CONFIG_LOCAL_API_CHUNK_BYTES chunks with chunked transfer
+ * encoding, so none is built in memory as a whole.
+ *
+ *   static const char *const names[] = {"temperature", "humidity"};
+ *   local_api_start("esp32-qemu-01", names, 2, my_metrics, NULL);
+ *   ...
+ *   local_api_record(unix_ms, (float[]){temp, humidity});
+ *
+ * local_api_log() prints one line per endpoint:
+ *   LOCAL_API path=/readings requests=.. errors=.. bytes=.. avg_ms=.. max_ms=..
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LOCAL_API_MAX_VALUES 4
+
+/** A response being written; passed to the metrics callback */
+typedef struct local_api_writer local_api_writer_t;
+
+/** Adds application metrics to GET /metrics with local_api_metric() */
+typedef void (*local_api_metrics_cb_t)(local_api_writer_t *w, void *ctx);
+
+/**
+ * Start the server on CONFIG_LOCAL_API_PORT, pinned to the network core.
+ * Readings have n_values values, named by value_names (kept, not copied).
+ * metrics may be NULL. Prints
+ *   LOCAL_API port=80 max_sockets=3 stack=4096 chunk=512 ring=256 ring_bytes=..
+ */
+esp_err_t local_api_start(const char *device_id, const char *const *value_names,
+                          int n_values, local_api_metrics_cb_t metrics, void *ctx);
+
+/** Add a reading to the ring (any task). unix_ms is 0 if the clock is not set. */
+void local_api_record(int64_t unix_ms, const float *values);
+
+/** Append one metric line: name{labels} value (labels may be NULL) */
+void local_api_metric(local_api_writer_t *w, const char *name, const char *labels,
+                      double value);
+
+/** Append printf-formatted text to the response */
+void local_api_printf(local_api_writer_t *w, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/** Print the per-endpoint LOCAL_API lines */
+void local_api_log(void);
+
+#ifdef __cplusplus
+}
+#endif
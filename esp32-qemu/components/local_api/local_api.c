@@ -0,0 +1,338 @@
+/**
+ * Local HTTP API: pull recent readings and metrics from the device
+ * IoT Course - Spring 2026
+ */
+
+#include "local_api.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_http_server.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "device_config.h"
+#include "task_placement.h"
+
+static const char *TAG = "local_api";
+
+#define RING_READINGS CONFIG_LOCAL_API_RING_READINGS
+
+/* Readings copied out of the ring per lock, so the lock is never held
+ * while a chunk goes out */
+#define READINGS_BATCH 8
+
+typedef struct {
+    uint32_t seq;
+    int64_t uptime_ms;
+    int64_t unix_ms;
+    float value[LOCAL_API_MAX_VALUES];
+} reading_t;
+
+/* ----------------------------------------------------------------
+ * Reading ring: seq n lives in ring[n % RING_READINGS], seq starts at 1
+ * ---------------------------------------------------------------- */
+static reading_t ring[RING_READINGS];
+static uint32_t next_seq = 1;
+static portMUX_TYPE ring_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *device;
+static const char *const *names;
+static int value_count;
+static local_api_metrics_cb_t metrics_cb;
+static void *metrics_ctx;
+static httpd_handle_t server;
+
+/* ----------------------------------------------------------------
+ * Per-endpoint statistics (written by the server task only)
+ * ---------------------------------------------------------------- */
+typedef enum { EP_READINGS, EP_METRICS, EP_CONFIG, EP_COUNT } endpoint_t;
+
+static const char *const endpoint_path[EP_COUNT] = { "/readings", "/metrics", "/config" };
+
+typedef struct {
+    uint32_t requests;
+    uint32_t errors;
+    uint64_t bytes;
+    int64_t total_us;
+    int64_t max_us;
+} endpoint_stats_t;
+
+static endpoint_stats_t stats[EP_COUNT];
+
+/* ----------------------------------------------------------------
+ * Chunked response writer
+ * Text is formatted into buf; a full buffer goes out as one chunk. After
+ * a failed send the rest of the response is skipped.
+ * ---------------------------------------------------------------- */
+struct local_api_writer {
+    httpd_req_t *req;
+    size_t len;
+    uint64_t bytes;
+    esp_err_t err;
+    char buf[CONFIG_LOCAL_API_CHUNK_BYTES];
+};
+
+static void writer_flush(local_api_writer_t *w)
+{
+    if (w->len > 0 && w->err == ESP_OK) {
+        w->err = httpd_resp_send_chunk(w->req, w->buf, w->len);
+        w->bytes += w->len;
+    }
+    w->len = 0;
+}
+
+void local_api_printf(local_api_writer_t *w, const char *fmt, ...)
+{
+    for (int attempt = 0; attempt < 2 && w->err == ESP_OK; attempt++) {
+        size_t room = sizeof(w->buf) - w->len;
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(w->buf + w->len, room, fmt, args);
+        va_end(args);
+        if (n >= 0 && (size_t)n < room) {
+            w->len += n;
+            return;
+        }
+        /* Did not fit: send what is there and retry in an empty buffer */
+        writer_flush(w);
+    }
+    if (w->err == ESP_OK) {
+        w->err = ESP_ERR_INVALID_SIZE;   /* One piece larger than a chunk */
+    }
+}
+
+void local_api_metric(local_api_writer_t *w, const char *name, const char *labels,
+                      double value)
+{
+    if (labels != NULL) {
+        local_api_printf(w, "%s{%s} %.15g\n", name, labels, value);
+    } else {
+        local_api_printf(w, "%s %.15g\n", name, value);
+    }
+}
+
+/* Send the last chunk and the terminating empty one, then count the request */
+static esp_err_t writer_finish(local_api_writer_t *w, endpoint_t ep, int64_t start_us)
+{
+    writer_flush(w);
+    if (w->err == ESP_OK) {
+        w->err = httpd_resp_send_chunk(w->req, NULL, 0);
+    }
+
+    endpoint_stats_t *s = &stats[ep];
+    int64_t us = esp_timer_get_time() - start_us;
+    s->requests++;
+    s->bytes += w->bytes;
+    s->total_us += us;
+    if (us > s->max_us) {
+        s->max_us = us;
+    }
+    if (w->err != ESP_OK) {
+        s->errors++;
+        ESP_LOGW(TAG, "%s: %s", endpoint_path[ep], esp_err_to_name(w->err));
+    }
+    /* An error closes the connection */
+    return w->err;
+}
+
+/* ----------------------------------------------------------------
+ * GET /readings?since=<seq>&limit=<n>
+ * ---------------------------------------------------------------- */
+static uint32_t query_u32(const char *query, const char *key, uint32_t fallback)
+{
+    char value[12];
+    if (query != NULL && httpd_query_key_value(query, key, value, sizeof(value)) == ESP_OK) {
+        return strtoul(value, NULL, 10);
+    }
+    return fallback;
+}
+
+static esp_err_t readings_handler(httpd_req_t *req)
+{
+    int64_t start_us = esp_timer_get_time();
+    char query[48];
+    bool has_query = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK;
+    uint32_t since = query_u32(has_query ? query : NULL, "since", 0);
+    uint32_t limit = query_u32(has_query ? query : NULL, "limit", RING_READINGS);
+
+    local_api_writer_t w = { .req = req };
+    httpd_resp_set_type(req, "application/json");
+
+    portENTER_CRITICAL(&ring_lock);
+    uint32_t oldest = next_seq > RING_READINGS ? next_seq - RING_READINGS : 1;
+    /* A since beyond the last reading comes from before a reboot: answer
+     * with the current last seq, so "next" < since tells the client */
+    if (since > next_seq - 1) {
+        since = next_seq - 1;
+    }
+    portEXIT_CRITICAL(&ring_lock);
+    local_api_printf(&w, "{\"device\":\"%s\",\"oldest\":%u,\"readings\":[",
+                     device, (unsigned)oldest);
+
+    uint32_t seq = since + 1;
+    uint32_t sent = 0;
+    reading_t batch[READINGS_BATCH];
+    while (sent < limit && w.err == ESP_OK) {
+        int n = 0;
+        portENTER_CRITICAL(&ring_lock);
+        /* Readings overwritten meanwhile (or before since) are skipped */
+        if (next_seq > RING_READINGS && seq < next_seq - RING_READINGS) {
+            seq = next_seq - RING_READINGS;
+        }
+        while (n < READINGS_BATCH && seq + n < next_seq && sent + n < limit) {
+            batch[n] = ring[(seq + n) % RING_READINGS];
+            n++;
+        }
+        portEXIT_CRITICAL(&ring_lock);
+        if (n == 0) {
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            const reading_t *r = &batch[i];
+            local_api_printf(&w, "%s{\"seq\":%u,\"uptime_ms\":%lld,\"ts\":%lld",
+                             sent + i == 0 ? "" : ",", (unsigned)r->seq,
+                             (long long)r->uptime_ms, (long long)r->unix_ms);
+            for (int v = 0; v < value_count; v++) {
+                local_api_printf(&w, ",\"%s\":%.2f", names[v], r->value[v]);
+            }
+            local_api_printf(&w, "}");
+        }
+        seq += n;
+        sent += n;
+    }
+    local_api_printf(&w, "],\"next\":%u}", (unsigned)(seq - 1));
+    return writer_finish(&w, EP_READINGS, start_us);
+}
+
+/* ----------------------------------------------------------------
+ * GET /metrics
+ * ---------------------------------------------------------------- */
+static esp_err_t metrics_handler(httpd_req_t *req)
+{
+    int64_t start_us = esp_timer_get_time();
+    local_api_writer_t w = { .req = req };
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+
+    portENTER_CRITICAL(&ring_lock);
+    uint32_t total = next_seq - 1;
+    portEXIT_CRITICAL(&ring_lock);
+
+    local_api_metric(&w, "uptime_seconds", NULL, esp_timer_get_time() / 1e6);
+    local_api_metric(&w, "heap_free_bytes", NULL, esp_get_free_heap_size());
+    local_api_metric(&w, "heap_min_free_bytes", NULL, esp_get_minimum_free_heap_size());
+    local_api_metric(&w, "readings_total", NULL, total);
+    local_api_metric(&w, "readings_buffered", NULL,
+                     total < RING_READINGS ? total : RING_READINGS);
+
+    char labels[32];
+    for (int ep = 0; ep < EP_COUNT; ep++) {
+        snprintf(labels, sizeof(labels), "path=\"%s\"", endpoint_path[ep]);
+        local_api_metric(&w, "local_api_requests_total", labels, stats[ep].requests);
+        local_api_metric(&w, "local_api_errors_total", labels, stats[ep].errors);
+        local_api_metric(&w, "local_api_sent_bytes_total", labels, (double)stats[ep].bytes);
+        local_api_metric(&w, "local_api_request_seconds_max", labels, stats[ep].max_us / 1e6);
+    }
+
+    if (metrics_cb != NULL) {
+        metrics_cb(&w, metrics_ctx);
+    }
+    return writer_finish(&w, EP_METRICS, start_us);
+}
+
+/* ----------------------------------------------------------------
+ * GET /config
+ * ---------------------------------------------------------------- */
+static esp_err_t config_handler(httpd_req_t *req)
+{
+    int64_t start_us = esp_timer_get_time();
+    local_api_writer_t w = { .req = req };
+    httpd_resp_set_type(req, "application/json");
+
+    device_config_t cfg;
+    device_config_get(&cfg);
+    char etag[16];
+    snprintf(etag, sizeof(etag), "\"v%u\"", (unsigned)cfg.version);
+    httpd_resp_set_hdr(req, "ETag", etag);
+
+    local_api_printf(&w, "{\"version\":%u,\"sample_interval_ms\":%u,\"device_name\":\"%s\","
+                     "\"temperature_enabled\":%s,\"humidity_enabled\":%s}",
+                     (unsigned)cfg.version, (unsigned)cfg.sample_interval_ms,
+                     cfg.device_name, cfg.temperature_enabled ? "true" : "false",
+                     cfg.humidity_enabled ? "true" : "false");
+    return writer_finish(&w, EP_CONFIG, start_us);
+}
+
+/* ----------------------------------------------------------------
+ * Public API
+ * ---------------------------------------------------------------- */
+esp_err_t local_api_start(const char *device_id, const char *const *value_names,
+                          int n_values, local_api_metrics_cb_t metrics, void *ctx)
+{
+    device = device_id;
+    names = value_names;
+    value_count = n_values < LOCAL_API_MAX_VALUES ? n_values : LOCAL_API_MAX_VALUES;
+    metrics_cb = metrics;
+    metrics_ctx = ctx;
+
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = CONFIG_LOCAL_API_PORT;
+    config.max_open_sockets = CONFIG_LOCAL_API_MAX_SOCKETS;
+    config.stack_size = CONFIG_LOCAL_API_STACK_BYTES;
+    config.max_uri_handlers = EP_COUNT;
+    config.lru_purge_enable = true;
+    config.recv_wait_timeout = 5;
+    config.send_wait_timeout = 5;
+    config.core_id = task_placement_core(TASK_ROLE_NETWORK);
+
+    esp_err_t err = httpd_start(&server, &config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Server start failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    static const httpd_uri_t uris[EP_COUNT] = {
+        { .uri = "/readings", .method = HTTP_GET, .handler = readings_handler },
+        { .uri = "/metrics",  .method = HTTP_GET, .handler = metrics_handler },
+        { .uri = "/config",   .method = HTTP_GET, .handler = config_handler },
+    };
+    for (int ep = 0; ep < EP_COUNT; ep++) {
+        httpd_register_uri_handler(server, &uris[ep]);
+    }
+
+    printf("LOCAL_API port=%d max_sockets=%d stack=%d chunk=%d ring=%d ring_bytes=%u\n",
+           CONFIG_LOCAL_API_PORT, CONFIG_LOCAL_API_MAX_SOCKETS, CONFIG_LOCAL_API_STACK_BYTES,
+           CONFIG_LOCAL_API_CHUNK_BYTES, RING_READINGS, (unsigned)sizeof(ring));
+    return ESP_OK;
+}
+
+void local_api_record(int64_t unix_ms, const float *values)
+{
+    int64_t uptime_ms = esp_timer_get_time() / 1000;
+
+    portENTER_CRITICAL(&ring_lock);
+    reading_t *r = &ring[next_seq % RING_READINGS];
+    r->seq = next_seq++;
+    r->uptime_ms = uptime_ms;
+    r->unix_ms = unix_ms;
+    for (int v = 0; v < value_count; v++) {
+        r->value[v] = values[v];
+    }
+    portEXIT_CRITICAL(&ring_lock);
+}
+
+void local_api_log(void)
+{
+    for (int ep = 0; ep < EP_COUNT; ep++) {
+        const endpoint_stats_t *s = &stats[ep];
+        printf("LOCAL_API path=%s requests=%u errors=%u bytes=%llu avg_ms=%.1f max_ms=%.1f\n",
+               endpoint_path[ep], (unsigned)s->requests, (unsigned)s->errors,
+               (unsigned long long)s->bytes,
+               s->requests ? s->total_us / 1000.0 / s->requests : 0.0, s->max_us / 1000.0);
+    }
+}
@@ -0,0 +1,54 @@
+/**
+ * Cycle-counting microbenchmarks
+ * IoT Course - Spring 2026
+ *
+ * Times a piece of code with the CPU cycle counter (esp_cpu_get_cycle_count)
+ * and prints one machine-readable line per benchmark:
+ *
+ *   BENCH {"name":"fmt_snprintf_float","iters":200,"reps":11,
+ *          "cyc_min":4210,"cyc_med":4302,"cyc_max":5120,"ns_med":17925}
+ *
+ * cyc_* are cycles per iteration. A benchmark function runs `iters`
+ * iterations of the code under test in a loop, so call overhead is amortised;
+ * "loop_overhead" in projects/05-benchmarks shows the cost of an empty loop.
+ *
+ * The cycle counter is per core: call bench_run() from a task pinned to one
+ * core. In QEMU the counter follows virtual time, so compare numbers between
+ * runs of the same emulator rather than with real hardware.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Runs `iters` iterations of the code under test */
+typedef void (*bench_fn_t)(void *arg, uint32_t iters);
+
+typedef struct {
+    const char *name;
+    uint32_t iters;
+    uint32_t reps;
+    uint32_t cyc_min;   /* Cycles per iteration */
+    uint32_t cyc_med;
+    uint32_t cyc_max;
+    uint32_t ns_med;    /* cyc_med converted with the CPU clock */
+} bench_result_t;
+
+/**
+ * Warm up, then time CONFIG_MICROBENCH_REPS calls of fn(arg, iters), print
+ * a BENCH line and optionally return the result in out (may be NULL).
+ */
+esp_err_t bench_run(const char *name, bench_fn_t fn, void *arg, uint32_t iters,
+                    bench_result_t *out);
+
+/** Print "BENCH_DONE count=<n>" after the last benchmark of a suite */
+void bench_done(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,86 @@
+/**
+ * Cycle-counting microbenchmarks
+ * IoT Course - Spring 2026
+ */
+
+#include <stdio.h>
+
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#include "microbench.h"
+
+static const char *TAG = "microbench";
+
+#define REPS CONFIG_MICROBENCH_REPS
+
+static uint32_t bench_count = 0;
+
+static void sort_u32(uint32_t *v, int n)
+{
+    for (int i = 1; i < n; i++) {
+        uint32_t x = v[i];
+        int j = i - 1;
+        while (j >= 0 && v[j] > x) {
+            v[j + 1] = v[j];
+            j--;
+        }
+        v[j + 1] = x;
+    }
+}
+
+esp_err_t bench_run(const char *name, bench_fn_t fn, void *arg, uint32_t iters,
+                    bench_result_t *out)
+{
+    if (iters == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (int i = 0; i < CONFIG_MICROBENCH_WARMUP_REPS; i++) {
+        fn(arg, iters);
+    }
+
+    uint32_t per_iter[REPS];
+    for (int i = 0; i < REPS; i++) {
+        /* Unsigned difference stays correct across one counter wrap
+         * (~17 s at 240 MHz, far longer than a repetition) */
+        uint32_t start = esp_cpu_get_cycle_count();
+        fn(arg, iters);
+        uint32_t cycles = esp_cpu_get_cycle_count() - start;
+        per_iter[i] = cycles / iters;
+    }
+    sort_u32(per_iter, REPS);
+
+    bench_result_t r = {
+        .name = name,
+        .iters = iters,
+        .reps = REPS,
+        .cyc_min = per_iter[0],
+        .cyc_med = per_iter[REPS / 2],
+        .cyc_max = per_iter[REPS - 1],
+    };
+    r.ns_med = (uint32_t)((uint64_t)r.cyc_med * 1000 / esp_rom_get_cpu_ticks_per_us());
+
+    printf("BENCH {\"name\":\"%s\",\"iters\":%u,\"reps\":%u,"
+           "\"cyc_min\":%u,\"cyc_med\":%u,\"cyc_max\":%u,\"ns_med\":%u}\n",
+           r.name, (unsigned)r.iters, (unsigned)r.reps,
+           (unsigned)r.cyc_min, (unsigned)r.cyc_med, (unsigned)r.cyc_max,
+           (unsigned)r.ns_med);
+    bench_count++;
+
+    if (r.cyc_max > 2 * r.cyc_min + 100) {
+        ESP_LOGW(TAG, "%s: max is %u cycles vs min %u, results are noisy",
+                 name, (unsigned)r.cyc_max, (unsigned)r.cyc_min);
+    }
+    if (out) {
+        *out = r;
+    }
+    return ESP_OK;
+}
+
+void bench_done(void)
+{
+    printf("BENCH_DONE count=%u\n", (unsigned)bench_count);
+}
@@ -0,0 +1,114 @@
+/**
+ * Fixed-block pool for outbound MQTT/HTTP messages
+ * IoT Course - Spring 2026
+ *
+ * Formatting every message into a fresh stack array and handing it to a
+ * client that copies it again costs stack in every publishing task and
+ * a copy per message. A msg_pool_t reserves N blocks of the same size at
+ * compile time instead:
+ *
+ *   MSG_POOL_DEFINE(tx_pool, "mqtt_tx", 8, 160);
+ *
+ *   msg_pool_init(&tx_pool);
+ *   msg_t *m = msg_alloc(&tx_pool);          // NULL when all 8 are in use
+ *   msg_printf(m, "{\"value\":%d}", v);       // built in place
+ *   xQueueSend(outbox, &m, 0);                // the receiver owns it now
+ *   ...
+ *   msg_free(m);                              // back to its pool
+ *
+ * Allocation and free are O(1) (a free list under a spinlock, safe from
+ * either core). Nothing touches the heap, and a message travels as one
+ * pointer; whoever holds the pointer owns the block and must free it
+ * exactly once.
+ *
+ * msg_pool_log() prints occupancy and exhaustion counts:
+ *   MSG_POOL name=mqtt_tx blocks=8 block_bytes=160 in_use=1 peak=3 allocs=21 exhausted=0
+ */
+
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct msg_pool;
+
+/** One pool block: header, then `len` bytes of payload in data[] */
+typedef struct msg {
+    struct msg *next;           /* Free list link while in the pool */
+    struct msg_pool *pool;
+    const char *topic;          /* Destination, for MQTT senders */
+    uint8_t qos;
+    uint8_t retain;
+    uint16_t len;               /* Payload bytes (without the NUL) */
+    char data[];                /* block_bytes, NUL-terminated by msg_printf */
+} msg_t;
+
+typedef struct msg_pool {
+    const char *name;
+    uint16_t blocks;
+    uint16_t block_bytes;       /* Payload capacity of each block */
+    uint8_t *storage;
+    msg_t *free_list;
+    uint16_t in_use;
+    uint16_t peak_in_use;
+    uint32_t allocs;
+    uint32_t exhausted;         /* msg_alloc() calls that returned NULL */
+    portMUX_TYPE lock;
+} msg_pool_t;
+
+typedef struct {
+    uint16_t blocks;
+    uint16_t in_use;
+    uint16_t peak_in_use;
+    uint32_t allocs;
+    uint32_t exhausted;
+} msg_pool_stats_t;
+
+/* Stride of one block, rounded up to keep the headers aligned */
+#define MSG_POOL_STRIDE(bytes) \
+    ((sizeof(msg_t) + (bytes) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+#define MSG_POOL_DEFINE(var, pool_name, count, bytes)                       \
+    static uint8_t var##_storage[(count) * MSG_POOL_STRIDE(bytes)]          \
+        __attribute__((aligned(sizeof(void *))));                           \
+    static msg_pool_t var = {                                               \
+        .name = (pool_name), .blocks = (count), .block_bytes = (bytes),     \
+        .storage = var##_storage, .lock = portMUX_INITIALIZER_UNLOCKED,     \
+    }
+
+/** Put every block on the free list. Call once before the first msg_alloc() */
+void msg_pool_init(msg_pool_t *p);
+
+/** Take a block (topic NULL, qos 0, len 0); NULL if the pool is exhausted */
+msg_t *msg_alloc(msg_pool_t *p);
+
+/** Return a block to the pool it came from. NULL is ignored */
+void msg_free(msg_t *m);
+
+/**
+ * Format the payload in place and set m->len. Returns the length, or -1
+ * (and len 0) if it did not fit in block_bytes.
+ */
+int msg_printf(msg_t *m, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+int msg_vprintf(msg_t *m, const char *fmt, va_list args);
+
+/** Payload capacity of a block from this message's pool */
+static inline size_t msg_capacity(const msg_t *m)
+{
+    return m->pool->block_bytes;
+}
+
+void msg_pool_get_stats(msg_pool_t *p, msg_pool_stats_t *out);
+
+/** Print one MSG_POOL line */
+void msg_pool_log(msg_pool_t *p);
+
+#ifdef __cplusplus
+}
+#endif
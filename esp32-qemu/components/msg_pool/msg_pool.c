@@ -0,0 +1,116 @@
+/**
+ * Fixed-block pool for outbound MQTT/HTTP messages
+ * IoT Course - Spring 2026
+ */
+
+#include "msg_pool.h"
+
+#include <stdio.h>
+#include "esp_log.h"
+
+static const char *TAG = "msg_pool";
+
+void msg_pool_init(msg_pool_t *p)
+{
+    const size_t stride = MSG_POOL_STRIDE(p->block_bytes);
+
+    portENTER_CRITICAL(&p->lock);
+    p->free_list = NULL;
+    /* Link from the end so blocks come out in address order */
+    for (int i = p->blocks - 1; i >= 0; i--) {
+        msg_t *m = (msg_t *)(p->storage + i * stride);
+        m->pool = p;
+        m->next = p->free_list;
+        p->free_list = m;
+    }
+    p->in_use = 0;
+    p->peak_in_use = 0;
+    p->allocs = 0;
+    p->exhausted = 0;
+    portEXIT_CRITICAL(&p->lock);
+}
+
+msg_t *msg_alloc(msg_pool_t *p)
+{
+    portENTER_CRITICAL(&p->lock);
+    msg_t *m = p->free_list;
+    if (m) {
+        p->free_list = m->next;
+        p->allocs++;
+        if (++p->in_use > p->peak_in_use) {
+            p->peak_in_use = p->in_use;
+        }
+    } else {
+        p->exhausted++;
+    }
+    portEXIT_CRITICAL(&p->lock);
+
+    if (m == NULL) {
+        ESP_LOGW(TAG, "%s exhausted (%u blocks in use)", p->name, p->blocks);
+        return NULL;
+    }
+    m->next = NULL;
+    m->topic = NULL;
+    m->qos = 0;
+    m->retain = 0;
+    m->len = 0;
+    m->data[0] = '\0';
+    return m;
+}
+
+void msg_free(msg_t *m)
+{
+    if (m == NULL) {
+        return;
+    }
+    msg_pool_t *p = m->pool;
+    portENTER_CRITICAL(&p->lock);
+    m->next = p->free_list;
+    p->free_list = m;
+    p->in_use--;
+    portEXIT_CRITICAL(&p->lock);
+}
+
+int msg_vprintf(msg_t *m, const char *fmt, va_list args)
+{
+    int n = vsnprintf(m->data, m->pool->block_bytes, fmt, args);
+    if (n < 0 || n >= m->pool->block_bytes) {
+        ESP_LOGW(TAG, "%s: message of %d bytes does not fit in %u",
+                 m->pool->name, n, m->pool->block_bytes);
+        m->len = 0;
+        m->data[0] = '\0';
+        return -1;
+    }
+    m->len = (uint16_t)n;
+    return n;
+}
+
+int msg_printf(msg_t *m, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int n = msg_vprintf(m, fmt, args);
+    va_end(args);
+    return n;
+}
+
+void msg_pool_get_stats(msg_pool_t *p, msg_pool_stats_t *out)
+{
+    portENTER_CRITICAL(&p->lock);
+    out->blocks = p->blocks;
+    out->in_use = p->in_use;
+    out->peak_in_use = p->peak_in_use;
+    out->allocs = p->allocs;
+    out->exhausted = p->exhausted;
+    portEXIT_CRITICAL(&p->lock);
+}
+
+void msg_pool_log(msg_pool_t *p)
+{
+    msg_pool_stats_t s;
+    msg_pool_get_stats(p, &s);
+    printf("MSG_POOL name=%s blocks=%u block_bytes=%u in_use=%u peak=%u "
+           "allocs=%lu exhausted=%lu\n",
+           p->name, s.blocks, p->block_bytes, s.in_use, s.peak_in_use,
+           (unsigned long)s.allocs, (unsigned long)s.exhausted);
+}
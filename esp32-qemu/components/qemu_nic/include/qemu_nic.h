@@ -0,0 +1,36 @@
+/**
+ * Per-instance MAC address for QEMU's open_eth NIC
+ * IoT Course - Spring 2026
+ *
+ * Every QEMU instance starts with the same (empty) efuse, so every emulated
+ * ESP32 derives the same Ethernet MAC from it. Behind slirp that does not
+ * matter, each instance has a private network. On the shared virtual switch
+ * (scripts/vnet.sh) it does: the bridge and the DHCP server tell devices
+ * apart by MAC.
+ *
+ * QEMU loads the address given with "-nic ...,mac=" into the open_eth
+ * MAC_ADDR registers at reset, the way a real NIC would come up with the
+ * address from its EEPROM. The esp_eth driver overwrites those registers
+ * with the efuse MAC during esp_eth_driver_install(), so
+ * qemu_nic_use_nic_mac() must run before it.
+ */
+
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Use the MAC address QEMU assigned to the open_eth NIC as the Ethernet MAC.
+ *
+ * @return ESP_OK if the NIC address is now used, ESP_ERR_NOT_FOUND if the
+ *         NIC has no usable address (the efuse MAC stays in use)
+ */
+esp_err_t qemu_nic_use_nic_mac(void);
+
+#ifdef __cplusplus
+}
+#endif
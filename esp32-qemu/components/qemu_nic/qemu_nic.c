@@ -0,0 +1,48 @@
+/**
+ * Per-instance MAC address for QEMU's open_eth NIC
+ * IoT Course - Spring 2026
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_mac.h"
+#include "esp_log.h"
+#include "soc/soc.h"
+
+#include "qemu_nic.h"
+
+static const char *TAG = "qemu_nic";
+
+/* open_eth registers, same layout as esp_eth/src/openeth.h (private header).
+ * MAC_ADDR0 holds bytes 2..5, MAC_ADDR1 bytes 0..1, most significant first. */
+#define OPENETH_BASE            DR_REG_EMAC_BASE
+#define OPENETH_MAC_ADDR0_REG   (OPENETH_BASE + 0x40)
+#define OPENETH_MAC_ADDR1_REG   (OPENETH_BASE + 0x44)
+
+esp_err_t qemu_nic_use_nic_mac(void)
+{
+    uint32_t addr0 = REG_READ(OPENETH_MAC_ADDR0_REG);
+    uint32_t addr1 = REG_READ(OPENETH_MAC_ADDR1_REG);
+
+    uint8_t mac[6] = {
+        (addr1 >> 8) & 0xff, addr1 & 0xff,
+        (addr0 >> 24) & 0xff, (addr0 >> 16) & 0xff,
+        (addr0 >> 8) & 0xff, addr0 & 0xff,
+    };
+
+    static const uint8_t zero[6] = { 0 };
+    if (memcmp(mac, zero, sizeof(mac)) == 0 || (mac[0] & 0x01)) {
+        /* No NIC, or not a unicast address */
+        ESP_LOGW(TAG, "open_eth has no MAC address, keeping the efuse MAC");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    esp_err_t err = esp_iface_mac_addr_set(mac, ESP_MAC_ETH);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Cannot set Ethernet MAC: %s", esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "Ethernet MAC from QEMU NIC: " MACSTR, MAC2STR(mac));
+    return ESP_OK;
+}
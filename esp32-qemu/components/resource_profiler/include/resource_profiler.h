@@ -0,0 +1,83 @@
+/**
+ * Runtime resource profiler
+ * IoT Course - Spring 2026
+ *
+ * Periodically samples where CPU time and RAM are going on a running device:
+ *   - Per-task CPU share from the FreeRTOS run-time counters
+ *     (uxTaskGetSystemState, needs CONFIG_FREERTOS_USE_TRACE_FACILITY and
+ *     CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS)
+ *   - Per-task stack high-water marks
+ *   - Heap free / minimum free / largest free block and fragmentation
+ *   - Per-ISR hit counts for interrupts that register a counter
+ *
+ * Each snapshot is a compact JSON document:
+ *
+ *   {"up_s":120,
+ *    "heap":[free,min_free,largest_block,frag_pct],
+ *    "tasks":[[name,cpu_permille,stack_free_bytes],...],
+ *    "isr":[[name,count],...]}
+ *
+ * cpu_permille is the share of one core since the previous snapshot, so on
+ * the dual-core ESP32 all tasks (including IDLE0/IDLE1) add up to ~2000.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_attr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Receives each periodic snapshot; runs in the profiler task */
+typedef void (*resource_profiler_sink_t)(const char *json, size_t len, void *ctx);
+
+/* ----------------------------------------------------------------
+ * ISR counters
+ * ---------------------------------------------------------------- */
+typedef struct {
+    const char *name;
+    volatile uint32_t count;
+} profiler_isr_counter_t;
+
+#define PROFILER_ISR_COUNTER_DEFINE(var, isr_name) \
+    static profiler_isr_counter_t var = { .name = (isr_name), .count = 0 }
+
+/** Count one interrupt. Safe to call from an IRAM ISR. */
+static inline IRAM_ATTR void profiler_isr_hit(profiler_isr_counter_t *c)
+{
+    c->count++;
+}
+
+/** Include a counter in snapshots. Call once at init, before the ISR fires. */
+esp_err_t resource_profiler_register_isr(profiler_isr_counter_t *c);
+
+/* ----------------------------------------------------------------
+ * Snapshots
+ * ---------------------------------------------------------------- */
+
+/**
+ * Start the profiler task (LOGGING role, statically allocated). Every
+ * CONFIG_RESOURCE_PROFILER_PERIOD_MS it builds a snapshot and passes it to
+ * sink, or prints a "PROFILE {...}" line when sink is NULL.
+ */
+esp_err_t resource_profiler_start(resource_profiler_sink_t sink, void *ctx);
+
+/**
+ * Build a snapshot now into buf. CPU shares cover the time since the
+ * previous snapshot. Returns the JSON length, or 0 if buf was too small.
+ */
+size_t resource_profiler_snapshot(char *buf, size_t len);
+
+/**
+ * Copy the most recent periodic snapshot into buf without sampling again,
+ * e.g. to answer a status request. Returns the length, or 0 if none yet.
+ */
+size_t resource_profiler_last(char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,247 @@
+/**
+ * Runtime resource profiler
+ * IoT Course - Spring 2026
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#include "static_alloc.h"
+#include "resource_profiler.h"
+
+static const char *TAG = "profiler";
+
+#define MAX_TASKS      CONFIG_RESOURCE_PROFILER_MAX_TASKS
+#define SNAPSHOT_BYTES CONFIG_RESOURCE_PROFILER_SNAPSHOT_BYTES
+
+#ifdef configRUN_TIME_COUNTER_TYPE
+typedef configRUN_TIME_COUNTER_TYPE run_time_t;
+#else
+typedef uint32_t run_time_t;
+#endif
+
+/* Run-time counters from the previous snapshot, to compute deltas */
+typedef struct {
+    TaskHandle_t handle;
+    run_time_t counter;
+} prev_counter_t;
+
+static TaskStatus_t task_status[MAX_TASKS];
+static prev_counter_t prev_counters[MAX_TASKS];
+static int prev_count = 0;
+static run_time_t prev_total = 0;
+
+static profiler_isr_counter_t *isr_counters[CONFIG_RESOURCE_PROFILER_MAX_ISRS];
+static int isr_count = 0;
+
+/* Most recent periodic snapshot, for resource_profiler_last() */
+static char last_snapshot[SNAPSHOT_BYTES];
+static size_t last_len = 0;
+
+static StaticSemaphore_t lock_buffer;
+static SemaphoreHandle_t lock = NULL;
+static portMUX_TYPE init_mux = portMUX_INITIALIZER_UNLOCKED;
+
+STATIC_TASK_DEFINE(profiler_task_def, "profiler", 3072);
+static resource_profiler_sink_t profiler_sink = NULL;
+static void *profiler_ctx = NULL;
+
+static void ensure_lock(void)
+{
+    portENTER_CRITICAL(&init_mux);
+    if (lock == NULL) {
+        lock = xSemaphoreCreateMutexStatic(&lock_buffer);
+    }
+    portEXIT_CRITICAL(&init_mux);
+}
+
+/* ----------------------------------------------------------------
+ * Bounded JSON writer: appends until the buffer is full, then sticks
+ * ---------------------------------------------------------------- */
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;
+    bool overflow;
+} json_out_t;
+
+static void out_printf(json_out_t *o, const char *fmt, ...)
+{
+    if (o->overflow) {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(o->buf + o->len, o->cap - o->len, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= o->cap - o->len) {
+        o->overflow = true;
+        return;
+    }
+    o->len += n;
+}
+
+static run_time_t prev_counter_for(TaskHandle_t handle)
+{
+    for (int i = 0; i < prev_count; i++) {
+        if (prev_counters[i].handle == handle) {
+            return prev_counters[i].counter;
+        }
+    }
+    return 0;  /* New task: its whole counter is new run time */
+}
+
+static size_t build_snapshot(char *buf, size_t len)
+{
+    json_out_t o = { .buf = buf, .cap = len, .len = 0, .overflow = false };
+
+    /* Heap: fragmentation is how much of the free memory is NOT in the
+     * largest block, i.e. unusable for one big allocation */
+    size_t free_bytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    size_t min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    unsigned frag_pct = free_bytes ? 100 - (unsigned)(largest * 100 / free_bytes) : 0;
+
+    out_printf(&o, "{\"up_s\":%lld,\"heap\":[%u,%u,%u,%u],\"tasks\":[",
+               esp_timer_get_time() / 1000000,
+               (unsigned)free_bytes, (unsigned)min_free, (unsigned)largest, frag_pct);
+
+    run_time_t total = 0;
+    UBaseType_t n = uxTaskGetSystemState(task_status, MAX_TASKS, &total);
+    run_time_t total_delta = total - prev_total;
+    if (n == 0) {
+        /* The array is too small: FreeRTOS fills in nothing at all */
+        ESP_LOGW(TAG, "%u tasks, only %d fit: raise RESOURCE_PROFILER_MAX_TASKS",
+                 (unsigned)uxTaskGetNumberOfTasks(), MAX_TASKS);
+    }
+
+    for (UBaseType_t i = 0; i < n; i++) {
+        TaskStatus_t *t = &task_status[i];
+        run_time_t delta = t->ulRunTimeCounter - prev_counter_for(t->xHandle);
+        unsigned permille = total_delta ? (unsigned)((uint64_t)delta * 1000 / total_delta) : 0;
+        /* usStackHighWaterMark is in bytes on ESP-IDF */
+        out_printf(&o, "%s[\"%s\",%u,%u]", i ? "," : "",
+                   t->pcTaskName, permille, (unsigned)t->usStackHighWaterMark);
+    }
+
+    out_printf(&o, "],\"isr\":[");
+    for (int i = 0; i < isr_count; i++) {
+        out_printf(&o, "%s[\"%s\",%u]", i ? "," : "",
+                   isr_counters[i]->name, (unsigned)isr_counters[i]->count);
+    }
+    out_printf(&o, "]}");
+
+    /* Remember counters for the next delta */
+    for (UBaseType_t i = 0; i < n; i++) {
+        prev_counters[i].handle = task_status[i].xHandle;
+        prev_counters[i].counter = task_status[i].ulRunTimeCounter;
+    }
+    prev_count = n;
+    prev_total = total;
+
+    if (o.overflow) {
+        ESP_LOGW(TAG, "Snapshot truncated: raise RESOURCE_PROFILER_SNAPSHOT_BYTES");
+        return 0;
+    }
+    return o.len;
+}
+
+size_t resource_profiler_snapshot(char *buf, size_t len)
+{
+    ensure_lock();
+    xSemaphoreTake(lock, portMAX_DELAY);
+    size_t n = build_snapshot(buf, len);
+    xSemaphoreGive(lock);
+    return n;
+}
+
+size_t resource_profiler_last(char *buf, size_t len)
+{
+    ensure_lock();
+    size_t n = 0;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (last_len > 0 && last_len < len) {
+        memcpy(buf, last_snapshot, last_len + 1);
+        n = last_len;
+    }
+    xSemaphoreGive(lock);
+    return n;
+}
+
+esp_err_t resource_profiler_register_isr(profiler_isr_counter_t *c)
+{
+    ensure_lock();
+    xSemaphoreTake(lock, portMAX_DELAY);
+    esp_err_t err = ESP_ERR_NO_MEM;
+    if (isr_count < CONFIG_RESOURCE_PROFILER_MAX_ISRS) {
+        isr_counters[isr_count++] = c;
+        err = ESP_OK;
+    }
+    xSemaphoreGive(lock);
+    return err;
+}
+
+/* ----------------------------------------------------------------
+ * Periodic profiler task
+ * ---------------------------------------------------------------- */
+static void profiler_task(void *arg)
+{
+    static char snapshot[SNAPSHOT_BYTES];
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (1) {
+        xTaskDelayUntil(&last_wake, pdMS_TO_TICKS(CONFIG_RESOURCE_PROFILER_PERIOD_MS));
+
+        xSemaphoreTake(lock, portMAX_DELAY);
+        size_t n = build_snapshot(snapshot, sizeof(snapshot));
+        if (n > 0) {
+            memcpy(last_snapshot, snapshot, n + 1);
+            last_len = n;
+        }
+        xSemaphoreGive(lock);
+
+        if (n == 0) {
+            continue;
+        }
+        if (profiler_sink) {
+            profiler_sink(snapshot, n, profiler_ctx);
+        } else {
+            printf("PROFILE %s\n", snapshot);
+        }
+    }
+}
+
+esp_err_t resource_profiler_start(resource_profiler_sink_t sink, void *ctx)
+{
+    ensure_lock();
+    profiler_sink = sink;
+    profiler_ctx = ctx;
+
+    /* Prime the counters so the first snapshot covers one full period */
+    xSemaphoreTake(lock, portMAX_DELAY);
+    run_time_t total = 0;
+    UBaseType_t n = uxTaskGetSystemState(task_status, MAX_TASKS, &total);
+    for (UBaseType_t i = 0; i < n; i++) {
+        prev_counters[i].handle = task_status[i].xHandle;
+        prev_counters[i].counter = task_status[i].ulRunTimeCounter;
+    }
+    prev_count = n;
+    prev_total = total;
+    xSemaphoreGive(lock);
+
+    if (static_task_create(&profiler_task_def, profiler_task, NULL, 2,
+                           TASK_ROLE_LOGGING) == NULL) {
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Profiling every %d ms", CONFIG_RESOURCE_PROFILER_PERIOD_MS);
+    return ESP_OK;
+}
@@ -0,0 +1,172 @@
+/**
+ * Sample blocks: structure-of-arrays buffers passed between pipeline stages
+ * IoT Course - Spring 2026
+ *
+ * The examples used to read a sensor into a few scalars and format them to
+ * text right away, one printf or one JSON message per sample. A
+ * sample_block_t collects many samples instead:
+ *
+ *   t_offset_us[]   shared timestamp column (us since t0_us)
+ *   data[0][]       channel 0, e.g. accelerometer X, in the sensor's unit
+ *   data[1][]       channel 1
+ *   ...
+ *
+ * Each column is a contiguous int16_t array, so a filter or FFT walks one
+ * channel without striding over the others. The block is 32-byte aligned
+ * (a cache line), which also suits DMA and PSRAM.
+ *
+ * A sample_pipe_t owns a set of blocks and moves pointers, never samples,
+ * between a producer and a consumer:
+ *
+ *   producer (task or ISR)            consumer
+ *   b = sample_pipe_acquire()         b = sample_pipe_receive()
+ *   sample_block_push(b, t, v) ...    process b->data[..]
+ *   sample_pipe_submit(b)  --------->  sample_block_release(b)  (back to free)
+ *
+ * A consumer may pass the block on to further stages through its own queue
+ * of sample_block_t *; whoever finishes with it calls
+ * sample_block_release().
+ *
+ * sample_block_encode() writes a block as one binary upload frame
+ * (little-endian, the ESP32's own byte order, so the columns are copied
+ * as they are); api-server decodes it at POST /api/samples.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SAMPLE_BLOCK_CAPACITY      CONFIG_SAMPLE_BLOCK_CAPACITY
+#define SAMPLE_BLOCK_MAX_CHANNELS  CONFIG_SAMPLE_BLOCK_MAX_CHANNELS
+#define SAMPLE_BLOCK_ALIGN         32
+
+/* Upload frame header, followed by count x uint32 t_offset_us and
+ * channels x count x int16 samples */
+#define SAMPLE_FRAME_MAGIC         0x4253   /* "SB" little-endian */
+#define SAMPLE_FRAME_VERSION       1
+#define SAMPLE_FRAME_HEADER_BYTES  24
+
+struct sample_pipe;
+
+typedef struct {
+    int16_t data[SAMPLE_BLOCK_MAX_CHANNELS][SAMPLE_BLOCK_CAPACITY]
+        __attribute__((aligned(SAMPLE_BLOCK_ALIGN)));
+    uint32_t t_offset_us[SAMPLE_BLOCK_CAPACITY];
+    int64_t t0_us;                /* Time of the first sample */
+    uint32_t seq;                 /* Assigned by sample_pipe_submit() */
+    uint32_t sample_rate_hz;      /* Nominal rate (the column has the real times) */
+    uint16_t count;               /* Rows filled */
+    uint8_t channels;             /* Columns in use */
+    uint8_t source;               /* Stream id chosen by the application */
+    struct sample_pipe *owner;    /* Pipe the block returns to */
+} __attribute__((aligned(SAMPLE_BLOCK_ALIGN))) sample_block_t;
+
+typedef struct sample_pipe {
+    const char *name;
+    QueueHandle_t free_queue;
+    QueueHandle_t full_queue;
+    StaticQueue_t free_buffer;
+    StaticQueue_t full_buffer;
+    sample_block_t *free_storage[CONFIG_SAMPLE_PIPE_MAX_BLOCKS];
+    sample_block_t *full_storage[CONFIG_SAMPLE_PIPE_MAX_BLOCKS];
+    uint32_t next_seq;
+    uint32_t submitted;
+    uint32_t overruns;            /* Acquires that found no free block */
+} sample_pipe_t;
+
+/* ----------------------------------------------------------------
+ * Filling a block (task or ISR, one producer per block)
+ * ---------------------------------------------------------------- */
+
+/** Empty the block, keeping its stream description */
+static inline void sample_block_clear(sample_block_t *b)
+{
+    b->count = 0;
+}
+
+static inline bool sample_block_full(const sample_block_t *b)
+{
+    return b->count >= SAMPLE_BLOCK_CAPACITY;
+}
+
+/**
+ * Append one row: b->channels values taken from `values`, at time t_us
+ * (esp_timer_get_time()). No locks and no calls, so it can run in an ISR.
+ * Returns false, dropping the row, if the block is full.
+ */
+static inline bool sample_block_push(sample_block_t *b, int64_t t_us, const int16_t *values)
+{
+    uint16_t i = b->count;
+    if (i >= SAMPLE_BLOCK_CAPACITY) {
+        return false;
+    }
+    if (i == 0) {
+        b->t0_us = t_us;
+    }
+    b->t_offset_us[i] = (uint32_t)(t_us - b->t0_us);
+    for (int c = 0; c < b->channels; c++) {
+        b->data[c][i] = values[c];
+    }
+    b->count = i + 1;
+    return true;
+}
+
+/* ----------------------------------------------------------------
+ * Pointer handoff
+ * ---------------------------------------------------------------- */
+
+/**
+ * Set up a pipe over `n` caller-owned blocks (n <= CONFIG_SAMPLE_PIPE_MAX_BLOCKS),
+ * all describing the same stream. Every block starts out free.
+ */
+esp_err_t sample_pipe_init(sample_pipe_t *p, const char *name,
+                           sample_block_t *blocks, size_t n,
+                           uint8_t source, uint8_t channels, uint32_t sample_rate_hz);
+
+/** Take an empty block to fill; NULL (and one overrun) if none in `wait` */
+sample_block_t *sample_pipe_acquire(sample_pipe_t *p, TickType_t wait);
+sample_block_t *sample_pipe_acquire_from_isr(sample_pipe_t *p, BaseType_t *woken);
+
+/** Hand a filled block to the consumer; stamps b->seq */
+void sample_pipe_submit(sample_pipe_t *p, sample_block_t *b);
+void sample_pipe_submit_from_isr(sample_pipe_t *p, sample_block_t *b, BaseType_t *woken);
+
+/** Wait for the next filled block; NULL on timeout */
+sample_block_t *sample_pipe_receive(sample_pipe_t *p, TickType_t wait);
+
+/** Return a block to its pipe's free list, from any stage */
+void sample_block_release(sample_block_t *b);
+
+/** Print "SAMPLE_PIPE name=.. submitted=.. overruns=.. free=.." */
+void sample_pipe_log(const sample_pipe_t *p);
+
+/* ----------------------------------------------------------------
+ * Upload frames
+ * ---------------------------------------------------------------- */
+
+/** Bytes sample_block_encode() writes for this block */
+size_t sample_block_frame_size(const sample_block_t *b);
+
+/**
+ * Write the block as a binary frame:
+ *   u16 magic  u8 version  u8 channels  u8 source  u8 reserved  u16 count
+ *   u32 seq    u32 sample_rate_hz       i64 t0_us
+ *   u32 t_offset_us[count]
+ *   i16 data[channels][count]
+ * Returns the frame length, or 0 if `len` is too small.
+ */
+size_t sample_block_encode(const sample_block_t *b, uint8_t *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
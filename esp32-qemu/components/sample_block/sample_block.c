@@ -0,0 +1,145 @@
+/**
+ * Sample blocks: structure-of-arrays buffers passed between pipeline stages
+ * IoT Course - Spring 2026
+ */
+
+#include "sample_block.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+
+static const char *TAG = "sample_block";
+
+_Static_assert(sizeof(sample_block_t) % SAMPLE_BLOCK_ALIGN == 0,
+               "sample blocks must tile whole cache lines");
+
+/* ----------------------------------------------------------------
+ * Pointer handoff
+ * ---------------------------------------------------------------- */
+esp_err_t sample_pipe_init(sample_pipe_t *p, const char *name,
+                           sample_block_t *blocks, size_t n,
+                           uint8_t source, uint8_t channels, uint32_t sample_rate_hz)
+{
+    if (n == 0 || n > CONFIG_SAMPLE_PIPE_MAX_BLOCKS ||
+        channels == 0 || channels > SAMPLE_BLOCK_MAX_CHANNELS) {
+        ESP_LOGE(TAG, "%s: %u blocks of %u channels not supported",
+                 name, (unsigned)n, channels);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(p, 0, sizeof(*p));
+    p->name = name;
+    p->free_queue = xQueueCreateStatic(CONFIG_SAMPLE_PIPE_MAX_BLOCKS, sizeof(sample_block_t *),
+                                       (uint8_t *)p->free_storage, &p->free_buffer);
+    p->full_queue = xQueueCreateStatic(CONFIG_SAMPLE_PIPE_MAX_BLOCKS, sizeof(sample_block_t *),
+                                       (uint8_t *)p->full_storage, &p->full_buffer);
+
+    for (size_t i = 0; i < n; i++) {
+        sample_block_t *b = &blocks[i];
+        b->channels = channels;
+        b->source = source;
+        b->sample_rate_hz = sample_rate_hz;
+        b->owner = p;
+        sample_block_clear(b);
+        xQueueSend(p->free_queue, &b, 0);
+    }
+    return ESP_OK;
+}
+
+sample_block_t *sample_pipe_acquire(sample_pipe_t *p, TickType_t wait)
+{
+    sample_block_t *b;
+    if (xQueueReceive(p->free_queue, &b, wait) != pdTRUE) {
+        p->overruns++;
+        return NULL;
+    }
+    return b;
+}
+
+sample_block_t *sample_pipe_acquire_from_isr(sample_pipe_t *p, BaseType_t *woken)
+{
+    sample_block_t *b;
+    if (xQueueReceiveFromISR(p->free_queue, &b, woken) != pdTRUE) {
+        p->overruns++;
+        return NULL;
+    }
+    return b;
+}
+
+void sample_pipe_submit(sample_pipe_t *p, sample_block_t *b)
+{
+    b->seq = p->next_seq++;
+    p->submitted++;
+    /* Cannot block: the pipe has no more blocks than the queue holds */
+    xQueueSend(p->full_queue, &b, 0);
+}
+
+void sample_pipe_submit_from_isr(sample_pipe_t *p, sample_block_t *b, BaseType_t *woken)
+{
+    b->seq = p->next_seq++;
+    p->submitted++;
+    xQueueSendFromISR(p->full_queue, &b, woken);
+}
+
+sample_block_t *sample_pipe_receive(sample_pipe_t *p, TickType_t wait)
+{
+    sample_block_t *b;
+    if (xQueueReceive(p->full_queue, &b, wait) != pdTRUE) {
+        return NULL;
+    }
+    return b;
+}
+
+void sample_block_release(sample_block_t *b)
+{
+    sample_block_clear(b);
+    xQueueSend(b->owner->free_queue, &b, 0);
+}
+
+void sample_pipe_log(const sample_pipe_t *p)
+{
+    printf("SAMPLE_PIPE name=%s submitted=%lu overruns=%lu free=%u\n",
+           p->name, (unsigned long)p->submitted, (unsigned long)p->overruns,
+           (unsigned)uxQueueMessagesWaiting(p->free_queue));
+}
+
+/* ----------------------------------------------------------------
+ * Upload frames
+ * ---------------------------------------------------------------- */
+size_t sample_block_frame_size(const sample_block_t *b)
+{
+    return SAMPLE_FRAME_HEADER_BYTES +
+           (size_t)b->count * (sizeof(uint32_t) + b->channels * sizeof(int16_t));
+}
+
+static uint8_t *put(uint8_t *p, const void *src, size_t n)
+{
+    memcpy(p, src, n);
+    return p + n;
+}
+
+size_t sample_block_encode(const sample_block_t *b, uint8_t *buf, size_t len)
+{
+    size_t need = sample_block_frame_size(b);
+    if (len < need) {
+        return 0;
+    }
+
+    /* Xtensa is little-endian: fields and columns go out as they are */
+    uint16_t magic = SAMPLE_FRAME_MAGIC;
+    uint8_t head[4] = { SAMPLE_FRAME_VERSION, b->channels, b->source, 0 };
+    uint8_t *p = buf;
+    p = put(p, &magic, sizeof(magic));
+    p = put(p, head, sizeof(head));
+    p = put(p, &b->count, sizeof(b->count));
+    p = put(p, &b->seq, sizeof(b->seq));
+    p = put(p, &b->sample_rate_hz, sizeof(b->sample_rate_hz));
+    p = put(p, &b->t0_us, sizeof(b->t0_us));
+
+    p = put(p, b->t_offset_us, b->count * sizeof(uint32_t));
+    for (int c = 0; c < b->channels; c++) {
+        p = put(p, b->data[c], b->count * sizeof(int16_t));
+    }
+    return (size_t)(p - buf);
+}
@@ -0,0 +1,141 @@
+/**
+ * Sensor replay: recorded traces in place of esp_random() sensors
+ * IoT Course - Spring 2026
+ *
+ * The examples make up their readings (esp_random(), sine tables, counters),
+ * so no two runs see the same data and none of it looks like a real
+ * sensor. A sensor_replay_t reads a recorded trace instead and hands it out
+ * like a driver would, one reading per call:
+ *
+ *   SENSOR_REPLAY_STEP      the next record on every read, whatever the
+ *                           time: a benchmark sees exactly the same samples
+ *                           on every run, at any rate
+ *   SENSOR_REPLAY_REALTIME  the record for the current time, with the
+ *                           trace running `speed` times faster than the
+ *                           wall clock: a 24 h trace at speed 1440 is a
+ *                           day per minute, and a task that samples
+ *                           faster or slower sees the same signal
+ *
+ * Both modes loop at the end of the trace.
+ *
+ * Traces come in a pack made by scripts/sensor-trace.py (synthetic traces
+ * with a fixed seed, or CSV recordings), each found by name:
+ *
+ *   header    "SRPL" u16 version u16 channels char name[16]
+ *             u32 records u32 tick_us u32 record_bytes u32 total_bytes
+ *   channels  char name[12] char unit[4] f32 scale f32 offset
+ *   records   u32 t (ticks) i16 raw[channels], padded to record_bytes
+ *
+ * (little-endian; value = raw * scale + offset; the next trace starts
+ * total_bytes after this header, the pack ends at erased flash.)
+ *
+ * The pack is read from the "trace" flash partition (memory-mapped, so a
+ * read is a few loads) or, with CONFIG_SENSOR_REPLAY_SEMIHOST, from a file
+ * on the host through QEMU semihosting. The run scripts write the file
+ * named by SENSOR_TRACE into the flash image.
+ *
+ *   sensor_replay_t env;
+ *   if (sensor_replay_open(&env, "env", SENSOR_REPLAY_REALTIME, 60) == ESP_OK) {
+ *       int temp = sensor_replay_channel(&env, "temp");
+ *       sensor_reading_t r;
+ *       sensor_replay_next(&env, &r);    // r.value[temp] in r.unit
+ *   }
+ *
+ * Without a pack, open returns ESP_ERR_NOT_FOUND and the examples keep
+ * their simulated readings.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SENSOR_REPLAY_MAGIC          "SRPL"
+#define SENSOR_REPLAY_VERSION        1
+#define SENSOR_REPLAY_SUBTYPE        0x40
+#define SENSOR_REPLAY_HEADER_BYTES   40
+#define SENSOR_REPLAY_CHANNEL_BYTES  24
+#define SENSOR_REPLAY_MAX_CHANNELS   4
+
+typedef enum {
+    SENSOR_REPLAY_STEP,
+    SENSOR_REPLAY_REALTIME,
+} sensor_replay_mode_t;
+
+typedef struct {
+    char name[13];
+    char unit[5];
+    float scale;
+    float offset;
+} sensor_replay_channel_t;
+
+typedef struct {
+    int64_t t_us;                               /* Trace time, counting loops */
+    int16_t raw[SENSOR_REPLAY_MAX_CHANNELS];
+    float value[SENSOR_REPLAY_MAX_CHANNELS];    /* raw * scale + offset */
+} sensor_reading_t;
+
+typedef struct {
+    char name[17];
+    uint16_t channels;
+    sensor_replay_channel_t channel[SENSOR_REPLAY_MAX_CHANNELS];
+    uint32_t records;
+    uint32_t tick_us;
+    uint32_t record_bytes;
+    uint64_t duration_ticks;    /* One loop, last record + average step */
+    sensor_replay_mode_t mode;
+    uint32_t speed;
+    uint32_t index;             /* Next (STEP) or current (REALTIME) record */
+    uint32_t loops;
+    uint32_t reads;
+    int64_t start_us;           /* REALTIME: wall time of trace time 0 */
+
+    /* Flash: the records, memory-mapped */
+    const uint8_t *data;
+    esp_partition_mmap_handle_t map;
+
+    /* Host file: a window of records */
+    FILE *file;
+    long file_records;          /* File offset of record 0 */
+    uint8_t *window;
+    uint32_t window_first;
+    uint32_t window_count;
+    uint32_t window_cap;
+} sensor_replay_t;
+
+/**
+ * Find trace `name` in the pack and start at its first record. `speed` is
+ * for SENSOR_REPLAY_REALTIME (0 counts as 1). ESP_ERR_NOT_FOUND if there is
+ * no pack or no such trace.
+ */
+esp_err_t sensor_replay_open(sensor_replay_t *r, const char *name,
+                             sensor_replay_mode_t mode, uint32_t speed);
+
+/** Index of the channel called `name`, or -1 */
+int sensor_replay_channel(const sensor_replay_t *r, const char *name);
+
+/** The next reading (see the modes above) */
+esp_err_t sensor_replay_next(sensor_replay_t *r, sensor_reading_t *out);
+
+/** Back to the first record (and, in REALTIME, to trace time 0 now) */
+void sensor_replay_rewind(sensor_replay_t *r);
+
+/**
+ * Print one line, e.g.
+ *   SENSOR_REPLAY trace=accel source=flash mode=step speed=1 records=6000
+ *       rate_hz=100.0 reads=1234 loops=0
+ */
+void sensor_replay_log(const sensor_replay_t *r);
+
+void sensor_replay_close(sensor_replay_t *r);
+
+#ifdef __cplusplus
+}
+#endif
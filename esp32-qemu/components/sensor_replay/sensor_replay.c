@@ -0,0 +1,324 @@
+/**
+ * Sensor replay: recorded traces in place of esp_random() sensors
+ * IoT Course - Spring 2026
+ */
+
+#include "sensor_replay.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_flash.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#if CONFIG_SENSOR_REPLAY_SEMIHOST
+#include "esp_vfs_semihost.h"
+#endif
+
+static const char *TAG = "sensor_replay";
+
+static uint16_t rd16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint32_t rd32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+           (uint32_t)p[3] << 24;
+}
+
+/* ----------------------------------------------------------------
+ * Where the pack is
+ * ---------------------------------------------------------------- */
+typedef struct {
+    const esp_partition_t *part;
+    FILE *file;
+} pack_t;
+
+static esp_err_t pack_read(const pack_t *p, size_t offset, void *buf, size_t len)
+{
+    if (p->file) {
+        if (fseek(p->file, (long)offset, SEEK_SET) != 0 ||
+            fread(buf, 1, len, p->file) != len) {
+            return ESP_ERR_NOT_FOUND;
+        }
+        return ESP_OK;
+    }
+    if (offset + len > p->part->size) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return esp_partition_read(p->part, offset, buf, len);
+}
+
+#if CONFIG_SENSOR_REPLAY_SEMIHOST
+static esp_err_t pack_open(pack_t *p)
+{
+    static bool mounted;
+    if (!mounted) {
+        esp_err_t err = esp_vfs_semihost_register("/host");
+        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+            ESP_LOGW(TAG, "Semihosting not available: %s", esp_err_to_name(err));
+            return ESP_ERR_NOT_FOUND;
+        }
+        mounted = true;
+    }
+    p->file = fopen(CONFIG_SENSOR_REPLAY_HOST_PATH, "rb");
+    if (p->file == NULL) {
+        ESP_LOGW(TAG, "No trace pack at %s", CONFIG_SENSOR_REPLAY_HOST_PATH);
+        return ESP_ERR_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+#else
+/* The "trace" partition, or the Kconfig range registered under its label */
+static esp_err_t pack_open(pack_t *p)
+{
+    p->part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, SENSOR_REPLAY_SUBTYPE,
+                                       CONFIG_SENSOR_REPLAY_PARTITION);
+    if (p->part == NULL) {
+        esp_err_t err = esp_partition_register_external(
+            esp_flash_default_chip, CONFIG_SENSOR_REPLAY_FLASH_OFFSET,
+            CONFIG_SENSOR_REPLAY_FLASH_SIZE, CONFIG_SENSOR_REPLAY_PARTITION,
+            ESP_PARTITION_TYPE_DATA, SENSOR_REPLAY_SUBTYPE, &p->part);
+        if (err != ESP_OK) {
+            /* Another task may have registered it in the meantime */
+            p->part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                               SENSOR_REPLAY_SUBTYPE,
+                                               CONFIG_SENSOR_REPLAY_PARTITION);
+        }
+        if (p->part == NULL) {
+            ESP_LOGW(TAG, "No room for a trace at 0x%x: %s",
+                     CONFIG_SENSOR_REPLAY_FLASH_OFFSET, esp_err_to_name(err));
+            return ESP_ERR_NOT_FOUND;
+        }
+    }
+    return ESP_OK;
+}
+#endif
+
+/* ----------------------------------------------------------------
+ * Records
+ * ---------------------------------------------------------------- */
+static const uint8_t *record(sensor_replay_t *r, uint32_t i)
+{
+    if (r->data) {
+        return r->data + (size_t)i * r->record_bytes;
+    }
+    if (i < r->window_first || i >= r->window_first + r->window_count) {
+        uint32_t n = r->records - i < r->window_cap ? r->records - i : r->window_cap;
+        r->window_first = i;
+        r->window_count = 0;
+        if (fseek(r->file, r->file_records + (long)i * r->record_bytes, SEEK_SET) == 0) {
+            r->window_count = fread(r->window, r->record_bytes, n, r->file);
+        }
+        if (r->window_count == 0) {
+            return NULL;
+        }
+    }
+    return r->window + (size_t)(i - r->window_first) * r->record_bytes;
+}
+
+static uint32_t record_ticks(sensor_replay_t *r, uint32_t i)
+{
+    const uint8_t *p = record(r, i);
+    return p ? rd32(p) : UINT32_MAX;
+}
+
+/* Last record at or before pos, searching forward from r->index */
+static uint32_t seek_ticks(sensor_replay_t *r, uint64_t pos)
+{
+    uint32_t lo = r->index;
+    uint32_t step = 1;
+
+    /* Gallop, then bisect: a reader polling often moves a record or two */
+    while (lo + step < r->records && record_ticks(r, lo + step) <= pos) {
+        lo += step;
+        step *= 2;
+    }
+    uint32_t hi = lo + step < r->records ? lo + step : r->records;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (record_ticks(r, mid) <= pos) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* ----------------------------------------------------------------
+ * API
+ * ---------------------------------------------------------------- */
+esp_err_t sensor_replay_open(sensor_replay_t *r, const char *name,
+                             sensor_replay_mode_t mode, uint32_t speed)
+{
+    memset(r, 0, sizeof(*r));
+    r->mode = mode;
+    r->speed = speed ? speed : 1;
+
+    pack_t pack = { 0 };
+    if (pack_open(&pack) != ESP_OK) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    /* Walk the pack for the trace */
+    uint8_t hdr[SENSOR_REPLAY_HEADER_BYTES];
+    size_t offset = 0;
+    bool found = false;
+    while (pack_read(&pack, offset, hdr, sizeof(hdr)) == ESP_OK &&
+           memcmp(hdr, SENSOR_REPLAY_MAGIC, 4) == 0) {
+        uint32_t total = rd32(hdr + 36);
+        if (rd16(hdr + 4) == SENSOR_REPLAY_VERSION &&
+            strncmp((const char *)hdr + 8, name, 16) == 0) {
+            found = true;
+            break;
+        }
+        if (total < sizeof(hdr)) {
+            break;
+        }
+        offset += total;
+    }
+
+    if (found) {
+        memcpy(r->name, hdr + 8, 16);
+        r->channels = rd16(hdr + 6);
+        r->records = rd32(hdr + 24);
+        r->tick_us = rd32(hdr + 28);
+        r->record_bytes = rd32(hdr + 32);
+        if (r->channels == 0 || r->channels > SENSOR_REPLAY_MAX_CHANNELS ||
+            r->records == 0 || r->tick_us == 0 ||
+            r->record_bytes < 4 + 2u * r->channels) {
+            ESP_LOGE(TAG, "Trace %s: bad header (%u channels, %lu records)",
+                     name, r->channels, (unsigned long)r->records);
+            found = false;
+        }
+    }
+    if (!found) {
+        if (pack.file) {
+            fclose(pack.file);
+        }
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    uint8_t ch[SENSOR_REPLAY_CHANNEL_BYTES];
+    for (int c = 0; c < r->channels; c++) {
+        pack_read(&pack, offset + sizeof(hdr) + c * sizeof(ch), ch, sizeof(ch));
+        memcpy(r->channel[c].name, ch, 12);
+        memcpy(r->channel[c].unit, ch + 12, 4);
+        memcpy(&r->channel[c].scale, ch + 16, 4);
+        memcpy(&r->channel[c].offset, ch + 20, 4);
+    }
+
+    size_t first = offset + sizeof(hdr) + r->channels * sizeof(ch);
+    esp_err_t err;
+#if CONFIG_SENSOR_REPLAY_SEMIHOST
+    r->file = pack.file;
+    r->file_records = (long)first;
+    r->window_cap = CONFIG_SENSOR_REPLAY_HOST_WINDOW_BYTES / r->record_bytes;
+    if (r->window_cap == 0) {
+        r->window_cap = 1;
+    }
+    r->window = malloc((size_t)r->window_cap * r->record_bytes);
+    err = r->window ? ESP_OK : ESP_ERR_NO_MEM;
+#else
+    size_t bytes = (size_t)r->records * r->record_bytes;
+    if (first + bytes > pack.part->size) {
+        err = ESP_ERR_INVALID_SIZE;
+    } else {
+        err = esp_partition_mmap(pack.part, first, bytes, ESP_PARTITION_MMAP_DATA,
+                                 (const void **)&r->data, &r->map);
+    }
+#endif
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Trace %s: %s", name, esp_err_to_name(err));
+        sensor_replay_close(r);
+        return err;
+    }
+
+    uint32_t last = record_ticks(r, r->records - 1);
+    uint32_t step = r->records > 1 ? last / (r->records - 1) : 1;
+    r->duration_ticks = (uint64_t)last + (step ? step : 1);
+    r->start_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+int sensor_replay_channel(const sensor_replay_t *r, const char *name)
+{
+    for (int c = 0; c < r->channels; c++) {
+        if (strcmp(r->channel[c].name, name) == 0) {
+            return c;
+        }
+    }
+    return -1;
+}
+
+esp_err_t sensor_replay_next(sensor_replay_t *r, sensor_reading_t *out)
+{
+    uint32_t i;
+    uint64_t loop_ticks;
+
+    if (r->mode == SENSOR_REPLAY_STEP) {
+        i = r->index;
+        loop_ticks = r->loops * r->duration_ticks;
+        if (++r->index == r->records) {
+            r->index = 0;
+            r->loops++;
+        }
+    } else {
+        uint64_t elapsed_us = esp_timer_get_time() - r->start_us;
+        uint64_t target = elapsed_us * r->speed / r->tick_us;
+        uint32_t loops = target / r->duration_ticks;
+        if (loops != r->loops) {
+            r->loops = loops;
+            r->index = 0;
+        }
+        i = r->index = seek_ticks(r, target % r->duration_ticks);
+        loop_ticks = loops * r->duration_ticks;
+    }
+
+    const uint8_t *p = record(r, i);
+    if (p == NULL) {
+        return ESP_FAIL;
+    }
+    out->t_us = (int64_t)((loop_ticks + rd32(p)) * r->tick_us);
+    for (int c = 0; c < r->channels; c++) {
+        out->raw[c] = (int16_t)rd16(p + 4 + 2 * c);
+        out->value[c] = out->raw[c] * r->channel[c].scale + r->channel[c].offset;
+    }
+    r->reads++;
+    return ESP_OK;
+}
+
+void sensor_replay_rewind(sensor_replay_t *r)
+{
+    r->index = 0;
+    r->loops = 0;
+    r->start_us = esp_timer_get_time();
+}
+
+void sensor_replay_log(const sensor_replay_t *r)
+{
+    float rate_hz = r->records * 1e6f / ((float)r->duration_ticks * r->tick_us);
+    printf("SENSOR_REPLAY trace=%s source=%s mode=%s speed=%lu records=%lu "
+           "rate_hz=%.1f reads=%lu loops=%lu\n",
+           r->name, r->file ? "host" : "flash",
+           r->mode == SENSOR_REPLAY_STEP ? "step" : "realtime",
+           (unsigned long)r->speed, (unsigned long)r->records, rate_hz,
+           (unsigned long)r->reads, (unsigned long)r->loops);
+}
+
+void sensor_replay_close(sensor_replay_t *r)
+{
+    if (r->data) {
+        esp_partition_munmap(r->map);
+        r->data = NULL;
+    }
+    if (r->file) {
+        fclose(r->file);
+        r->file = NULL;
+    }
+    free(r->window);
+    r->window = NULL;
+}
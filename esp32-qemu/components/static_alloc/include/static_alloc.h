@@ -0,0 +1,140 @@
+/**
+ * Static allocation of FreeRTOS objects
+ * IoT Course - Spring 2026
+ *
+ * xTaskCreate(), xQueueCreate() and xEventGroupCreate() take their memory
+ * from the heap at run time. On a device that stays up for weeks this can
+ * fragment the heap, and every object is one more thing that can fail.
+ *
+ * The macros below reserve each object's memory at compile time instead:
+ *
+ *   STATIC_TASK_DEFINE(led, "led_task", 2048);
+ *   STATIC_QUEUE_DEFINE(events, 10, timer_event_t);
+ *
+ *   static_queue_create(&events);
+ *   static_task_create(&led, led_task, NULL, 5, TASK_ROLE_SENSING);
+ *
+ * With CONFIG_STATIC_ALLOC_ENABLE=n the same code uses the dynamic APIs.
+ *
+ * Every task created this way is tracked, so static_alloc_report_stacks()
+ * can print its measured stack high-water mark and a suggested size. A
+ * tracked task that ends must call static_task_exit(&def) instead of
+ * vTaskDelete(NULL): with dynamic allocation the idle task frees its TCB,
+ * and the report must not query the handle afterwards.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+#include "sdkconfig.h"
+
+#include "task_placement.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    const char *name;
+    uint32_t stack_bytes;
+    StackType_t *stack;     /* NULL in dynamic mode */
+    StaticTask_t *tcb;      /* NULL in dynamic mode */
+    TaskHandle_t handle;    /* NULL once the task has exited */
+    uint32_t exit_free_bytes; /* Stack high-water mark at static_task_exit() */
+} static_task_t;
+
+typedef struct {
+    UBaseType_t length;
+    UBaseType_t item_size;
+    uint8_t *storage;       /* NULL in dynamic mode */
+    StaticQueue_t *buffer;  /* NULL in dynamic mode */
+    QueueHandle_t handle;
+} static_queue_t;
+
+typedef struct {
+    StaticEventGroup_t *buffer; /* NULL in dynamic mode */
+    EventGroupHandle_t handle;
+} static_event_group_t;
+
+#if CONFIG_STATIC_ALLOC_ENABLE
+
+#define STATIC_TASK_DEFINE(var, task_name, bytes)                       \
+    static StackType_t var##_stack[(bytes) / sizeof(StackType_t)];      \
+    static StaticTask_t var##_tcb;                                      \
+    static static_task_t var = {                                        \
+        .name = (task_name), .stack_bytes = (bytes),                    \
+        .stack = var##_stack, .tcb = &var##_tcb,                        \
+    }
+
+#define STATIC_QUEUE_DEFINE(var, len, item_type)                        \
+    static uint8_t var##_storage[(len) * sizeof(item_type)];            \
+    static StaticQueue_t var##_buffer;                                  \
+    static static_queue_t var = {                                       \
+        .length = (len), .item_size = sizeof(item_type),                \
+        .storage = var##_storage, .buffer = &var##_buffer,              \
+    }
+
+#define STATIC_EVENT_GROUP_DEFINE(var)                                  \
+    static StaticEventGroup_t var##_buffer;                             \
+    static static_event_group_t var = { .buffer = &var##_buffer }
+
+#else
+
+#define STATIC_TASK_DEFINE(var, task_name, bytes)                       \
+    static static_task_t var = { .name = (task_name), .stack_bytes = (bytes) }
+
+#define STATIC_QUEUE_DEFINE(var, len, item_type)                        \
+    static static_queue_t var = { .length = (len), .item_size = sizeof(item_type) }
+
+#define STATIC_EVENT_GROUP_DEFINE(var)                                  \
+    static static_event_group_t var = { 0 }
+
+#endif /* CONFIG_STATIC_ALLOC_ENABLE */
+
+/**
+ * Create a task from its definition, pinned according to role
+ * (see task_placement.h). Returns the handle, or NULL on failure.
+ */
+TaskHandle_t static_task_create(static_task_t *t, TaskFunction_t fn, void *arg,
+                                UBaseType_t priority, task_role_t role);
+
+/**
+ * End the calling task, which was created from `t`. Records its stack
+ * high-water mark for the report and clears t->handle, then deletes the
+ * task. Does not return.
+ */
+void static_task_exit(static_task_t *t);
+
+/** Create a queue from its definition. Returns the handle, or NULL on failure. */
+QueueHandle_t static_queue_create(static_queue_t *q);
+
+/** Create an event group from its definition. Returns the handle, or NULL on failure. */
+EventGroupHandle_t static_event_group_create(static_event_group_t *eg);
+
+/**
+ * Print heap state and the bytes reserved statically so far:
+ *   MEM stage=<stage> mode=<static|dynamic> static_bytes=.. heap_free=..
+ *       heap_min_free=.. heap_largest=..
+ */
+void static_alloc_log_memory(const char *stage);
+
+/**
+ * Print one line per tracked task:
+ *   STACK <name> size=.. peak=.. free=.. suggest=..
+ * with " exited" appended for a task that ended with static_task_exit().
+ */
+void static_alloc_report_stacks(void);
+
+/**
+ * Print the stack report once, CONFIG_STATIC_ALLOC_REPORT_DELAY_MS from now.
+ * Uses a statically allocated FreeRTOS software timer.
+ */
+void static_alloc_report_stacks_later(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,169 @@
+/**
+ * Static allocation of FreeRTOS objects
+ * IoT Course - Spring 2026
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+#include "freertos/timers.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#include "static_alloc.h"
+
+static const char *TAG = "static_alloc";
+
+/* Tasks created through static_task_create(), for the stack report */
+static static_task_t *tracked_tasks[CONFIG_STATIC_ALLOC_MAX_TASKS];
+static int tracked_count = 0;
+static portMUX_TYPE tracked_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Bytes reserved in .bss by the objects created so far */
+static uint32_t static_bytes = 0;
+
+#if CONFIG_STATIC_ALLOC_ENABLE
+#define ALLOC_MODE "static"
+#else
+#define ALLOC_MODE "dynamic"
+#endif
+
+TaskHandle_t static_task_create(static_task_t *t, TaskFunction_t fn, void *arg,
+                                UBaseType_t priority, task_role_t role)
+{
+    BaseType_t core = task_placement_core(role);
+
+#if CONFIG_STATIC_ALLOC_ENABLE
+    t->handle = xTaskCreateStaticPinnedToCore(fn, t->name, t->stack_bytes, arg,
+                                              priority, t->stack, t->tcb, core);
+    if (t->handle != NULL) {
+        static_bytes += t->stack_bytes + sizeof(StaticTask_t);
+    }
+#else
+    if (xTaskCreatePinnedToCore(fn, t->name, t->stack_bytes, arg, priority,
+                                &t->handle, core) != pdPASS) {
+        t->handle = NULL;
+    }
+#endif
+
+    if (t->handle == NULL) {
+        ESP_LOGE(TAG, "Failed to create task %s", t->name);
+        return NULL;
+    }
+
+    portENTER_CRITICAL(&tracked_lock);
+    if (tracked_count < CONFIG_STATIC_ALLOC_MAX_TASKS) {
+        tracked_tasks[tracked_count++] = t;
+    }
+    portEXIT_CRITICAL(&tracked_lock);
+
+    if (core == tskNO_AFFINITY) {
+        ESP_LOGI(TAG, "Task %-12s %5u bytes -> any core", t->name,
+                 (unsigned)t->stack_bytes);
+    } else {
+        ESP_LOGI(TAG, "Task %-12s %5u bytes -> core %d", t->name,
+                 (unsigned)t->stack_bytes, (int)core);
+    }
+    return t->handle;
+}
+
+void static_task_exit(static_task_t *t)
+{
+    /* Under tracked_lock, so a report either sees the live task or the
+     * cleared handle, never a handle whose TCB the idle task freed */
+    portENTER_CRITICAL(&tracked_lock);
+    t->exit_free_bytes = uxTaskGetStackHighWaterMark(NULL) * sizeof(StackType_t);
+    t->handle = NULL;
+    portEXIT_CRITICAL(&tracked_lock);
+    vTaskDelete(NULL);
+}
+
+QueueHandle_t static_queue_create(static_queue_t *q)
+{
+#if CONFIG_STATIC_ALLOC_ENABLE
+    q->handle = xQueueCreateStatic(q->length, q->item_size, q->storage, q->buffer);
+    if (q->handle != NULL) {
+        static_bytes += q->length * q->item_size + sizeof(StaticQueue_t);
+    }
+#else
+    q->handle = xQueueCreate(q->length, q->item_size);
+#endif
+    if (q->handle == NULL) {
+        ESP_LOGE(TAG, "Failed to create queue (%u x %u bytes)",
+                 (unsigned)q->length, (unsigned)q->item_size);
+    }
+    return q->handle;
+}
+
+EventGroupHandle_t static_event_group_create(static_event_group_t *eg)
+{
+#if CONFIG_STATIC_ALLOC_ENABLE
+    eg->handle = xEventGroupCreateStatic(eg->buffer);
+    if (eg->handle != NULL) {
+        static_bytes += sizeof(StaticEventGroup_t);
+    }
+#else
+    eg->handle = xEventGroupCreate();
+#endif
+    if (eg->handle == NULL) {
+        ESP_LOGE(TAG, "Failed to create event group");
+    }
+    return eg->handle;
+}
+
+void static_alloc_log_memory(const char *stage)
+{
+    printf("MEM stage=%s mode=%s static_bytes=%u heap_free=%u heap_min_free=%u heap_largest=%u\n",
+           stage, ALLOC_MODE,
+           (unsigned)static_bytes,
+           (unsigned)heap_caps_get_free_size(MALLOC_CAP_8BIT),
+           (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+           (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+}
+
+void static_alloc_report_stacks(void)
+{
+    ESP_LOGI(TAG, "Stack high-water marks (%d tasks):", tracked_count);
+    for (int i = 0; i < tracked_count; i++) {
+        static_task_t *t = tracked_tasks[i];
+        /* On ESP-IDF the high-water mark is in bytes (StackType_t is uint8_t) */
+        portENTER_CRITICAL(&tracked_lock);
+        bool exited = t->handle == NULL;
+        uint32_t free_bytes = exited ? t->exit_free_bytes
+                                     : uxTaskGetStackHighWaterMark(t->handle) * sizeof(StackType_t);
+        portEXIT_CRITICAL(&tracked_lock);
+        uint32_t peak = t->stack_bytes - free_bytes;
+        uint32_t suggest = (peak + CONFIG_STATIC_ALLOC_STACK_MARGIN + 255) & ~255u;
+        printf("STACK %s size=%u peak=%u free=%u suggest=%u%s\n",
+               t->name, (unsigned)t->stack_bytes, (unsigned)peak,
+               (unsigned)free_bytes, (unsigned)suggest, exited ? " exited" : "");
+    }
+}
+
+#if CONFIG_STATIC_ALLOC_REPORT_DELAY_MS > 0
+static StaticTimer_t report_timer_buffer;
+
+static void report_timer_callback(TimerHandle_t timer)
+{
+    static_alloc_log_memory("steady");
+    static_alloc_report_stacks();
+}
+#endif
+
+void static_alloc_report_stacks_later(void)
+{
+#if CONFIG_STATIC_ALLOC_REPORT_DELAY_MS > 0
+    TimerHandle_t timer = xTimerCreateStatic("stack_report",
+                                             pdMS_TO_TICKS(CONFIG_STATIC_ALLOC_REPORT_DELAY_MS),
+                                             pdFALSE, NULL, report_timer_callback,
+                                             &report_timer_buffer);
+    if (timer == NULL || xTimerStart(timer, 0) != pdPASS) {
+        ESP_LOGW(TAG, "Could not schedule stack report");
+    }
+#endif
+}
@@ -0,0 +1,84 @@
+/**
+ * Task placement for the dual-core ESP32
+ * IoT Course - Spring 2026
+ *
+ * The ESP32 has two Xtensa cores:
+ *   - PRO_CPU (core 0): runs the Ethernet/Wi-Fi driver, lwIP and esp-mqtt
+ *   - APP_CPU (core 1): free for application work
+ *
+ * Tasks created with plain xTaskCreate() may run on either core, so a sensor
+ * task can be preempted by a burst of network traffic on whichever core it
+ * happens to land on. task_placement_create() instead pins each task to the
+ * core configured for its role (menuconfig -> Task Placement).
+ *
+ * The task_jitter_* helpers measure how far a periodic task drifts from its
+ * nominal period, so pinned and floating builds can be compared.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* What a task does decides which core it runs on */
+typedef enum {
+    TASK_ROLE_SENSING,  /* Sensor sampling and ISR-deferred handlers -> APP_CPU */
+    TASK_ROLE_NETWORK,  /* HTTP/MQTT clients, anything blocking on sockets -> PRO_CPU */
+    TASK_ROLE_LOGGING,  /* Reporters and bulk log output -> PRO_CPU */
+    TASK_ROLE_DISPLAY,  /* LED/display frame rendering -> PRO_CPU, clear of sensing */
+} task_role_t;
+
+/**
+ * Core a task of the given role is pinned to, or tskNO_AFFINITY when
+ * placement is disabled (CONFIG_TASK_PLACEMENT_ENABLE=n or unicore build).
+ */
+BaseType_t task_placement_core(task_role_t role);
+
+/**
+ * Drop-in replacement for xTaskCreate() that pins the task according to role.
+ * Stack size is in bytes, as with xTaskCreate() on ESP-IDF.
+ */
+BaseType_t task_placement_create(TaskFunction_t fn, const char *name,
+                                 uint32_t stack_bytes, void *arg,
+                                 UBaseType_t priority, TaskHandle_t *handle,
+                                 task_role_t role);
+
+/** Print the active placement (one line per role) */
+void task_placement_log_config(void);
+
+/* ----------------------------------------------------------------
+ * Period jitter measurement
+ * ---------------------------------------------------------------- */
+typedef struct {
+    const char *name;
+    int64_t period_us;      /* Nominal period */
+    int64_t last_us;        /* Timestamp of previous activation */
+    int64_t min_dev_us;     /* Most negative deviation from period */
+    int64_t max_dev_us;     /* Most positive deviation from period */
+    int64_t sum_abs_dev_us; /* For mean absolute deviation */
+    uint32_t samples;
+} task_jitter_t;
+
+/** Reset statistics for a task with the given nominal period */
+void task_jitter_init(task_jitter_t *j, const char *name, int64_t period_us);
+
+/**
+ * Record one activation at the current esp_timer time. Prints a JITTER
+ * line every CONFIG_TASK_PLACEMENT_JITTER_REPORT_EVERY activations.
+ */
+void task_jitter_record(task_jitter_t *j);
+
+/**
+ * Print one machine-readable line:
+ *   JITTER <name> core=<n> n=<samples> mad_us=<..> min_us=<..> max_us=<..>
+ */
+void task_jitter_log(const task_jitter_t *j);
+
+#ifdef __cplusplus
+}
+#endif
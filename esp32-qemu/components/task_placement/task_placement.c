@@ -0,0 +1,107 @@
+/**
+ * Task placement for the dual-core ESP32
+ * IoT Course - Spring 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#include "task_placement.h"
+
+static const char *TAG = "placement";
+
+BaseType_t task_placement_core(task_role_t role)
+{
+#if CONFIG_TASK_PLACEMENT_ENABLE
+    switch (role) {
+    case TASK_ROLE_SENSING:
+        return CONFIG_TASK_PLACEMENT_SENSING_CORE;
+    case TASK_ROLE_NETWORK:
+    case TASK_ROLE_LOGGING:
+    case TASK_ROLE_DISPLAY:
+        return CONFIG_TASK_PLACEMENT_NETWORK_CORE;
+    }
+#endif
+    return tskNO_AFFINITY;
+}
+
+BaseType_t task_placement_create(TaskFunction_t fn, const char *name,
+                                 uint32_t stack_bytes, void *arg,
+                                 UBaseType_t priority, TaskHandle_t *handle,
+                                 task_role_t role)
+{
+    BaseType_t core = task_placement_core(role);
+    BaseType_t ret = xTaskCreatePinnedToCore(fn, name, stack_bytes, arg,
+                                             priority, handle, core);
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create task %s", name);
+    } else if (core == tskNO_AFFINITY) {
+        ESP_LOGI(TAG, "Task %-12s -> any core", name);
+    } else {
+        ESP_LOGI(TAG, "Task %-12s -> core %d", name, (int)core);
+    }
+    return ret;
+}
+
+void task_placement_log_config(void)
+{
+#if CONFIG_TASK_PLACEMENT_ENABLE
+    ESP_LOGI(TAG, "Task placement: sensing -> core %d, network/logging/display -> core %d",
+             CONFIG_TASK_PLACEMENT_SENSING_CORE, CONFIG_TASK_PLACEMENT_NETWORK_CORE);
+#else
+    ESP_LOGI(TAG, "Task placement disabled: all tasks float across cores");
+#endif
+}
+
+/* ----------------------------------------------------------------
+ * Period jitter measurement
+ * ---------------------------------------------------------------- */
+void task_jitter_init(task_jitter_t *j, const char *name, int64_t period_us)
+{
+    j->name = name;
+    j->period_us = period_us;
+    j->last_us = 0;
+    j->min_dev_us = 0;
+    j->max_dev_us = 0;
+    j->sum_abs_dev_us = 0;
+    j->samples = 0;
+}
+
+void task_jitter_record(task_jitter_t *j)
+{
+    int64_t now = esp_timer_get_time();
+
+    /* The first activation only establishes the reference point */
+    if (j->last_us != 0) {
+        int64_t dev = (now - j->last_us) - j->period_us;
+        if (j->samples == 0 || dev < j->min_dev_us) {
+            j->min_dev_us = dev;
+        }
+        if (j->samples == 0 || dev > j->max_dev_us) {
+            j->max_dev_us = dev;
+        }
+        j->sum_abs_dev_us += llabs(dev);
+        j->samples++;
+
+#if CONFIG_TASK_PLACEMENT_JITTER_REPORT_EVERY > 0
+        if (j->samples % CONFIG_TASK_PLACEMENT_JITTER_REPORT_EVERY == 0) {
+            task_jitter_log(j);
+        }
+#endif
+    }
+    j->last_us = now;
+}
+
+void task_jitter_log(const task_jitter_t *j)
+{
+    int64_t mad = j->samples ? j->sum_abs_dev_us / j->samples : 0;
+    printf("JITTER %s core=%d n=%u mad_us=%lld min_us=%lld max_us=%lld\n",
+           j->name, xPortGetCoreID(), (unsigned)j->samples,
+           mad, j->min_dev_us, j->max_dev_us);
+}
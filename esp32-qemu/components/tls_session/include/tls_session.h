@@ -0,0 +1,91 @@
+/**
+ * TLS session cache: resumed handshakes and handshake timing
+ * IoT Course - Spring 2026
+ *
+ * A full TLS handshake costs the ESP32 a certificate chain verification
+ * and an RSA/ECDHE key exchange in software (QEMU emulates no crypto
+ * hardware): hundreds of milliseconds of CPU per connection. A client that
+ * saved the session of an earlier connection can offer it again, as a
+ * session ticket (RFC 5077) or a session ID. If the server still knows it,
+ * both sides skip the certificate and the key exchange: an abbreviated
+ * handshake of one round trip and a few hashes.
+ *
+ * tls_session_t holds the last session for one server, in RAM and
+ * optionally in NVS (CONFIG_TLS_SESSION_NVS), and counts handshakes:
+ *
+ *   TLS_HANDSHAKE name=mqtt kind=full ms=912
+ *   TLS_HANDSHAKE name=mqtt kind=resumed ms=87
+ *   TLS name=mqtt full=1 full_ms_avg=912 resumed=3 resumed_ms_avg=85 reused=0
+ *
+ * (ms includes the TCP connect.) Its esp_transport does the TLS itself
+ * with mbedTLS, so it can offer the cached session and tell the two kinds
+ * apart: the certificate is only verified in a full handshake. esp-mqtt
+ * takes it as a custom transport (.network.transport).
+ *
+ * esp_http_client (IDF 5.1) creates its own TLS transport and does not
+ * expose the session, so HTTP avoids handshakes by keeping one persistent
+ * connection instead; report those requests with tls_session_record_reuse().
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_transport.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "mbedtls/ssl.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    const char *name;             /* For log lines and the NVS key (<= 15 chars) */
+    mbedtls_ssl_session session;  /* Last session, offered on the next connect */
+    bool has_session;
+    uint32_t full;                /* Handshakes with certificate verification */
+    uint32_t resumed;             /* Abbreviated handshakes */
+    uint32_t reused;              /* Requests on an already open connection */
+    int64_t full_us;              /* Sum of full handshake times */
+    int64_t resumed_us;
+    SemaphoreHandle_t lock;
+} tls_session_t;
+
+/** PEM of the local CA (certs/ca.crt), or NULL when TLS mode is off */
+const char *tls_session_ca_pem(void);
+
+/**
+ * Set up a session cache. With CONFIG_TLS_SESSION_NVS, loads the session
+ * saved by the previous boot (nvs_flash_init() must have been called).
+ */
+esp_err_t tls_session_init(tls_session_t *s, const char *name);
+
+/**
+ * New esp_transport that connects over TLS with the local CA, offers the
+ * cached session, stores the new one and records the handshake. Owned by
+ * the caller (or by esp-mqtt once passed as .network.transport).
+ */
+esp_transport_handle_t tls_session_transport_new(tls_session_t *s);
+
+/** Record one handshake and print its TLS_HANDSHAKE line */
+void tls_session_record(tls_session_t *s, bool resumed, int64_t elapsed_us);
+
+/** Count one request that needed no handshake (persistent connection) */
+void tls_session_record_reuse(tls_session_t *s);
+
+/**
+ * Open and close `count` TLS connections to the host and port of `uri`
+ * (scheme://host:port/...) to measure resumed handshakes. Returns how many
+ * handshakes succeeded.
+ */
+int tls_session_probe(tls_session_t *s, const char *uri, int count);
+
+/** Print "TLS name=... full=... full_ms_avg=... resumed=... ..." */
+void tls_session_log(tls_session_t *s);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,471 @@
+/**
+ * TLS session cache: resumed handshakes and handshake timing
+ * IoT Course - Spring 2026
+ */
+
+#include "tls_session.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "lwip/netdb.h"
+#include "lwip/sockets.h"
+
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/x509_crt.h"
+
+static const char *TAG = "tls_session";
+
+#define NVS_NAMESPACE "tls_session"
+
+#if CONFIG_TLS_SESSION_ENABLE
+extern const char ca_crt_start[] asm("_binary_ca_crt_start");
+#endif
+
+const char *tls_session_ca_pem(void)
+{
+#if CONFIG_TLS_SESSION_ENABLE
+    return ca_crt_start;
+#else
+    return NULL;
+#endif
+}
+
+/* ----------------------------------------------------------------
+ * Session storage (RAM, optionally NVS)
+ * ---------------------------------------------------------------- */
+#if CONFIG_TLS_SESSION_NVS
+static void session_load_nvs(tls_session_t *s)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+    size_t len = 0;
+    unsigned char *buf = NULL;
+    if (nvs_get_blob(nvs, s->name, NULL, &len) == ESP_OK && len > 0 &&
+        (buf = malloc(len)) != NULL &&
+        nvs_get_blob(nvs, s->name, buf, &len) == ESP_OK) {
+        s->has_session = mbedtls_ssl_session_load(&s->session, buf, len) == 0;
+        ESP_LOGI(TAG, "%s: %s session from NVS (%u bytes)", s->name,
+                 s->has_session ? "loaded" : "ignored unreadable", (unsigned)len);
+    }
+    free(buf);
+    nvs_close(nvs);
+}
+
+static void session_save_nvs(tls_session_t *s)
+{
+    size_t len = 0;
+    mbedtls_ssl_session_save(&s->session, NULL, 0, &len);
+    unsigned char *buf = malloc(len);
+    if (buf == NULL) {
+        return;
+    }
+    nvs_handle_t nvs;
+    if (mbedtls_ssl_session_save(&s->session, buf, len, &len) == 0 &&
+        nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+        if (nvs_set_blob(nvs, s->name, buf, len) != ESP_OK || nvs_commit(nvs) != ESP_OK) {
+            ESP_LOGW(TAG, "%s: could not save session to NVS", s->name);
+        }
+        nvs_close(nvs);
+    }
+    free(buf);
+}
+#endif
+
+/* Offer the cached session to a new connection; false if there is none */
+static bool session_offer(tls_session_t *s, mbedtls_ssl_context *ssl)
+{
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    bool offered = s->has_session && mbedtls_ssl_set_session(ssl, &s->session) == 0;
+    xSemaphoreGive(s->lock);
+    return offered;
+}
+
+/* Keep the session of a completed handshake (it may carry a new ticket) */
+static void session_store(tls_session_t *s, mbedtls_ssl_context *ssl)
+{
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    mbedtls_ssl_session_free(&s->session);
+    mbedtls_ssl_session_init(&s->session);
+    s->has_session = mbedtls_ssl_get_session(ssl, &s->session) == 0;
+#if CONFIG_TLS_SESSION_NVS
+    if (s->has_session) {
+        session_save_nvs(s);
+    }
+#endif
+    xSemaphoreGive(s->lock);
+}
+
+esp_err_t tls_session_init(tls_session_t *s, const char *name)
+{
+    memset(s, 0, sizeof(*s));
+    s->name = name;
+    mbedtls_ssl_session_init(&s->session);
+    s->lock = xSemaphoreCreateMutex();
+    if (s->lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+#if CONFIG_TLS_SESSION_NVS
+    session_load_nvs(s);
+#endif
+    return ESP_OK;
+}
+
+/* ----------------------------------------------------------------
+ * Statistics
+ * ---------------------------------------------------------------- */
+void tls_session_record(tls_session_t *s, bool resumed, int64_t elapsed_us)
+{
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    if (resumed) {
+        s->resumed++;
+        s->resumed_us += elapsed_us;
+    } else {
+        s->full++;
+        s->full_us += elapsed_us;
+    }
+    xSemaphoreGive(s->lock);
+    printf("TLS_HANDSHAKE name=%s kind=%s ms=%lld\n", s->name,
+           resumed ? "resumed" : "full", elapsed_us / 1000);
+}
+
+void tls_session_record_reuse(tls_session_t *s)
+{
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    s->reused++;
+    xSemaphoreGive(s->lock);
+}
+
+void tls_session_log(tls_session_t *s)
+{
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    printf("TLS name=%s full=%u full_ms_avg=%lld resumed=%u resumed_ms_avg=%lld reused=%u\n",
+           s->name,
+           (unsigned)s->full, s->full ? s->full_us / s->full / 1000 : 0,
+           (unsigned)s->resumed, s->resumed ? s->resumed_us / s->resumed / 1000 : 0,
+           (unsigned)s->reused);
+    xSemaphoreGive(s->lock);
+}
+
+/* ----------------------------------------------------------------
+ * esp_transport over mbedTLS
+ * ---------------------------------------------------------------- */
+typedef struct {
+    tls_session_t *cache;
+    int sock;
+    mbedtls_net_context net;
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config conf;
+    mbedtls_x509_crt ca;
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context drbg;
+    bool verified;                /* Certificate checked: a full handshake */
+} tls_conn_t;
+
+/* Called for every certificate of the chain, i.e. only in a full handshake */
+static int verify_cb(void *ctx, mbedtls_x509_crt *crt, int depth, uint32_t *flags)
+{
+    ((tls_conn_t *)ctx)->verified = true;
+    return 0;
+}
+
+/* Wait until the socket is readable/writable: >0 ready, 0 timeout, <0 error */
+static int sock_poll(int sock, bool write, int timeout_ms)
+{
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(sock, &fds);
+    struct timeval tv = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+    return select(sock + 1, write ? NULL : &fds, write ? &fds : NULL, NULL, &tv);
+}
+
+static int tcp_connect(const char *host, int port, int timeout_ms)
+{
+    struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *res = NULL;
+    char port_str[8];
+    snprintf(port_str, sizeof(port_str), "%d", port);
+    if (getaddrinfo(host, port_str, &hints, &res) != 0 || res == NULL) {
+        ESP_LOGW(TAG, "Cannot resolve %s", host);
+        return -1;
+    }
+
+    int sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (sock < 0) {
+        freeaddrinfo(res);
+        return -1;
+    }
+
+    /* Non-blocking connect, so timeout_ms bounds it */
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+    int ret = connect(sock, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (ret < 0 && errno != EINPROGRESS) {
+        goto fail;
+    }
+    if (ret < 0) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (sock_poll(sock, true, timeout_ms) <= 0 ||
+            getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+            goto fail;
+        }
+    }
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) & ~O_NONBLOCK);
+    return sock;
+
+fail:
+    ESP_LOGW(TAG, "TCP connect to %s:%d failed", host, port);
+    close(sock);
+    return -1;
+}
+
+static int tls_close(esp_transport_handle_t t)
+{
+    tls_conn_t *c = esp_transport_get_context_data(t);
+    if (c->sock >= 0) {
+        mbedtls_ssl_close_notify(&c->ssl);
+        mbedtls_ssl_free(&c->ssl);
+        close(c->sock);
+        c->sock = -1;
+    }
+    return 0;
+}
+
+static int tls_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms)
+{
+    tls_conn_t *c = esp_transport_get_context_data(t);
+    tls_close(t);
+
+    int64_t start_us = esp_timer_get_time();
+    c->sock = tcp_connect(host, port, timeout_ms);
+    if (c->sock < 0) {
+        return -1;
+    }
+
+    mbedtls_ssl_init(&c->ssl);
+    int ret = mbedtls_ssl_setup(&c->ssl, &c->conf);
+    if (ret == 0) {
+        ret = mbedtls_ssl_set_hostname(&c->ssl, host);
+    }
+    if (ret != 0) {
+        goto fail;
+    }
+    c->net.fd = c->sock;
+    mbedtls_ssl_set_bio(&c->ssl, &c->net, mbedtls_net_send, NULL, mbedtls_net_recv_timeout);
+    mbedtls_ssl_conf_read_timeout(&c->conf, timeout_ms);
+
+    bool offered = session_offer(c->cache, &c->ssl);
+    c->verified = false;
+    while ((ret = mbedtls_ssl_handshake(&c->ssl)) != 0) {
+        if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            goto fail;
+        }
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+
+    if (offered && c->verified) {
+        ESP_LOGI(TAG, "%s: server declined the cached session", c->cache->name);
+    }
+    session_store(c->cache, &c->ssl);
+    tls_session_record(c->cache, !c->verified, elapsed_us);
+    return 0;
+
+fail:
+    ESP_LOGW(TAG, "%s: TLS handshake with %s:%d failed: -0x%04x",
+             c->cache->name, host, port, (unsigned)-ret);
+    uint32_t flags = mbedtls_ssl_get_verify_result(&c->ssl);
+    if (flags != 0 && flags != (uint32_t)-1) {
+        char buf[128];
+        mbedtls_x509_crt_verify_info(buf, sizeof(buf), "  ", flags);
+        ESP_LOGW(TAG, "Certificate: %s", buf);
+    }
+    tls_close(t);
+    return -1;
+}
+
+static int tls_poll_read(esp_transport_handle_t t, int timeout_ms)
+{
+    tls_conn_t *c = esp_transport_get_context_data(t);
+    if (c->sock < 0) {
+        return -1;
+    }
+    if (mbedtls_ssl_get_bytes_avail(&c->ssl) > 0) {
+        return 1;
+    }
+    return sock_poll(c->sock, false, timeout_ms);
+}
+
+static int tls_poll_write(esp_transport_handle_t t, int timeout_ms)
+{
+    tls_conn_t *c = esp_transport_get_context_data(t);
+    if (c->sock < 0) {
+        return -1;
+    }
+    return sock_poll(c->sock, true, timeout_ms);
+}
+
+static int tls_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    tls_conn_t *c = esp_transport_get_context_data(t);
+    int ready = tls_poll_read(t, timeout_ms);
+    if (ready <= 0) {
+        return ready;   /* 0 = ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT */
+    }
+
+    /* The socket is readable; bound the wait for the rest of the record */
+    mbedtls_ssl_conf_read_timeout(&c->conf, timeout_ms > 0 ? timeout_ms : 100);
+    int ret = mbedtls_ssl_read(&c->ssl, (unsigned char *)buffer, len);
+    if (ret > 0) {
+        return ret;
+    }
+    if (ret == MBEDTLS_ERR_SSL_TIMEOUT || ret == MBEDTLS_ERR_SSL_WANT_READ ||
+        ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    if (ret == 0 || ret == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
+        return ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN;
+    }
+    ESP_LOGW(TAG, "%s: read failed: -0x%04x", c->cache->name, (unsigned)-ret);
+    return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+}
+
+static int tls_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    tls_conn_t *c = esp_transport_get_context_data(t);
+    int ready = tls_poll_write(t, timeout_ms);
+    if (ready <= 0) {
+        return ready;
+    }
+    int ret = mbedtls_ssl_write(&c->ssl, (const unsigned char *)buffer, len);
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        return 0;
+    }
+    if (ret < 0) {
+        ESP_LOGW(TAG, "%s: write failed: -0x%04x", c->cache->name, (unsigned)-ret);
+        return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+    }
+    return ret;
+}
+
+static void conn_free(tls_conn_t *c)
+{
+    mbedtls_ssl_config_free(&c->conf);
+    mbedtls_x509_crt_free(&c->ca);
+    mbedtls_ctr_drbg_free(&c->drbg);
+    mbedtls_entropy_free(&c->entropy);
+    free(c);
+}
+
+static int tls_destroy(esp_transport_handle_t t)
+{
+    tls_conn_t *c = esp_transport_get_context_data(t);
+    tls_close(t);
+    conn_free(c);
+    return 0;
+}
+
+esp_transport_handle_t tls_session_transport_new(tls_session_t *s)
+{
+    const char *ca_pem = tls_session_ca_pem();
+    if (ca_pem == NULL) {
+        ESP_LOGE(TAG, "TLS mode is off (CONFIG_TLS_SESSION_ENABLE)");
+        return NULL;
+    }
+
+    tls_conn_t *c = calloc(1, sizeof(*c));
+    if (c == NULL) {
+        return NULL;
+    }
+    c->cache = s;
+    c->sock = -1;
+    mbedtls_net_init(&c->net);
+    mbedtls_ssl_config_init(&c->conf);
+    mbedtls_x509_crt_init(&c->ca);
+    mbedtls_entropy_init(&c->entropy);
+    mbedtls_ctr_drbg_init(&c->drbg);
+
+    /* One configuration per transport, reused by every connection */
+    int ret = mbedtls_ctr_drbg_seed(&c->drbg, mbedtls_entropy_func, &c->entropy,
+                                    (const unsigned char *)s->name, strlen(s->name));
+    if (ret == 0) {
+        ret = mbedtls_x509_crt_parse(&c->ca, (const unsigned char *)ca_pem,
+                                     strlen(ca_pem) + 1);
+    }
+    if (ret == 0) {
+        ret = mbedtls_ssl_config_defaults(&c->conf, MBEDTLS_SSL_IS_CLIENT,
+                                          MBEDTLS_SSL_TRANSPORT_STREAM,
+                                          MBEDTLS_SSL_PRESET_DEFAULT);
+    }
+    if (ret != 0) {
+        ESP_LOGE(TAG, "%s: TLS setup failed: -0x%04x", s->name, (unsigned)-ret);
+        conn_free(c);
+        return NULL;
+    }
+    mbedtls_ssl_conf_authmode(&c->conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    mbedtls_ssl_conf_ca_chain(&c->conf, &c->ca, NULL);
+    mbedtls_ssl_conf_rng(&c->conf, mbedtls_ctr_drbg_random, &c->drbg);
+    mbedtls_ssl_conf_verify(&c->conf, verify_cb, c);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    mbedtls_ssl_conf_session_tickets(&c->conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+
+    esp_transport_handle_t t = esp_transport_init();
+    if (t == NULL) {
+        conn_free(c);
+        return NULL;
+    }
+    esp_transport_set_context_data(t, c);
+    esp_transport_set_func(t, tls_connect, tls_read, tls_write, tls_close,
+                           tls_poll_read, tls_poll_write, tls_destroy);
+    return t;
+}
+
+/* ----------------------------------------------------------------
+ * Resumption probe
+ * ---------------------------------------------------------------- */
+int tls_session_probe(tls_session_t *s, const char *uri, int count)
+{
+    /* scheme://host:port/... */
+    const char *p = strstr(uri, "://");
+    p = p ? p + 3 : uri;
+    char host[64];
+    size_t n = strcspn(p, ":/");
+    if (n == 0 || n >= sizeof(host) || p[n] != ':') {
+        ESP_LOGW(TAG, "Probe needs scheme://host:port, got %s", uri);
+        return 0;
+    }
+    memcpy(host, p, n);
+    host[n] = '\0';
+    int port = atoi(p + n + 1);
+
+    esp_transport_handle_t t = tls_session_transport_new(s);
+    if (t == NULL) {
+        return 0;
+    }
+    int ok = 0;
+    for (int i = 0; i < count; i++) {
+        if (esp_transport_connect(t, host, port, 10000) == 0) {
+            ok++;
+        }
+        esp_transport_close(t);
+    }
+    esp_transport_destroy(t);
+    return ok;
+}
@@ -0,0 +1,74 @@
+"""
+Minimal SNTP server for QEMU devices
+IoT Course - Spring 2026
+
+Answers SNTP (RFC 4330) requests with this container's clock, which is the
+Docker host's clock, the same one the api-server stamps readings with. So
+a device synced here and the server agree on time to within the network
+delay, which is what latency tracing (components/latency_trace) needs.
+There is no upstream: the server claims stratum 1 with reference "LOCL".
+
+  docker compose up -d ntp-server
+  (the guest reaches it at 10.0.2.2:123/udp through the service forwarders)
+"""
+
+import os
+import socket
+import struct
+import time
+
+NTP_PORT = int(os.environ.get("NTP_PORT", "123"))
+NTP_EPOCH_OFFSET = 2208988800       # 1900-01-01 to 1970-01-01, in seconds
+NTP_PACKET = struct.Struct("!BBbb4s4s4s8s8s8s8s")
+
+
+def ntp_time(t):
+    """Unix time as a 64-bit NTP timestamp"""
+    secs = int(t)
+    frac = int((t - secs) * (1 << 32))
+    return struct.pack("!II", secs + NTP_EPOCH_OFFSET, frac)
+
+
+def reply(request, received):
+    if len(request) < NTP_PACKET.size:
+        return None
+    first = request[0]
+    version = (first >> 3) & 0x7
+    mode = first & 0x7
+    if mode != 3:                       # Only client requests
+        return None
+    client_transmit = request[40:48]
+    return NTP_PACKET.pack(
+        (0 << 6) | (version << 3) | 4,  # No leap warning, same version, server
+        1,                              # Stratum 1: primary reference
+        request[2],                     # Poll interval, as asked
+        -20,                            # Precision: about a microsecond
+        b"\0\0\0\0",                    # Root delay
+        b"\0\0\0\0",                    # Root dispersion
+        b"LOCL",                        # Reference: local clock
+        ntp_time(received),             # Reference timestamp
+        client_transmit,                # Originate: the client's transmit
+        ntp_time(received),             # Receive
+        ntp_time(time.time()),          # Transmit
+    )
+
+
+def main():
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("0.0.0.0", NTP_PORT))
+    print(f"SNTP server on udp/{NTP_PORT}", flush=True)
+    served = 0
+    while True:
+        request, addr = sock.recvfrom(512)
+        received = time.time()
+        response = reply(request, received)
+        if response is None:
+            continue
+        sock.sendto(response, addr)
+        served += 1
+        if served == 1 or served % 100 == 0:
+            print(f"[SNTP] {served} requests, last from {addr[0]}", flush=True)
+
+
+if __name__ == "__main__":
+    main()
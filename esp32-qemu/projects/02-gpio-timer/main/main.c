@@ -7,6 +7,9 @@
  * - Hardware timer usage
  * - Interrupt handling
  * - FreeRTOS queues for ISR communication
+ * - Pinning the ISR-deferred task to APP_CPU (see components/task_placement)
+ * - Statically allocated queue and task (see components/static_alloc)
+ * - Runtime CPU/stack/heap/ISR profiling (see components/resource_profiler)
  *
  * Note: In QEMU, GPIO states are simulated but not connected
  * to external peripherals. You'll see the state changes in logs.
@@ -19,6 +22,11 @@
 #include "driver/gpio.h"
 #include "driver/gptimer.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+
+#include "task_placement.h"
+#include "static_alloc.h"
+#include "resource_profiler.h"
 
 static const char *TAG = "GPIO_TIMER";
 
@@ -29,19 +37,37 @@ static const char *TAG = "GPIO_TIMER";
 #define TIMER_RESOLUTION_HZ   1000000  // 1MHz, 1us per tick
 #define TIMER_ALARM_PERIOD_US 500000   // 500ms
 
-// Queue for timer events
+// Timer event passed from the ISR to the LED task
+typedef struct {
+    uint64_t timer_count;  // gptimer count at the alarm
+    int64_t isr_time_us;   // esp_timer time when the ISR ran
+} timer_event_t;
+
+// Alarm interrupts, reported in PROFILE snapshots
+PROFILER_ISR_COUNTER_DEFINE(timer_isr_counter, "gptimer_alarm");
+
+// Queue for timer events (storage reserved at compile time)
+STATIC_QUEUE_DEFINE(timer_queue_def, 10, timer_event_t);
 static QueueHandle_t timer_queue = NULL;
 
+// LED task stack: see the STACK report printed after boot before changing
+#define LED_TASK_STACK_BYTES 2048
+STATIC_TASK_DEFINE(led_task_def, "led_task", LED_TASK_STACK_BYTES);
+
 // Timer callback
 static bool IRAM_ATTR timer_alarm_callback(gptimer_handle_t timer,
                                            const gptimer_alarm_event_data_t *edata,
                                            void *user_ctx)
 {
     BaseType_t high_task_wakeup = pdFALSE;
-    uint64_t timer_count = edata->count_value;
+    profiler_isr_hit(&timer_isr_counter);
+    timer_event_t evt = {
+        .timer_count = edata->count_value,
+        .isr_time_us = esp_timer_get_time(),
+    };
 
-    // Send timer count to queue
-    xQueueSendFromISR(timer_queue, &timer_count, &high_task_wakeup);
+    // Send timer event to queue
+    xQueueSendFromISR(timer_queue, &evt, &high_task_wakeup);
 
     return high_task_wakeup == pdTRUE;
 }
@@ -50,17 +76,29 @@ static bool IRAM_ATTR timer_alarm_callback(gptimer_handle_t timer,
 static void led_task(void *arg)
 {
     static int led_state = 0;
-    uint64_t timer_count;
+    timer_event_t evt;
+
+    // Period jitter of the deferred handler and ISR -> task wake-up latency
+    task_jitter_t jitter;
+    task_jitter_init(&jitter, "led_task", TIMER_ALARM_PERIOD_US);
+    int64_t latency_max_us = 0;
 
     while (1) {
         // Wait for timer event
-        if (xQueueReceive(timer_queue, &timer_count, portMAX_DELAY)) {
+        if (xQueueReceive(timer_queue, &evt, portMAX_DELAY)) {
+            task_jitter_record(&jitter);
+            int64_t latency_us = esp_timer_get_time() - evt.isr_time_us;
+            if (latency_us > latency_max_us) {
+                latency_max_us = latency_us;
+            }
+
             // Toggle LED
             led_state = !led_state;
             gpio_set_level(LED_GPIO, led_state);
 
-            ESP_LOGI(TAG, "LED %s (timer count: %llu)",
-                     led_state ? "ON" : "OFF", timer_count);
+            ESP_LOGI(TAG, "LED %s (timer count: %llu, ISR->task %lld us, max %lld us)",
+                     led_state ? "ON" : "OFF", evt.timer_count,
+                     latency_us, latency_max_us);
         }
     }
 }
@@ -71,9 +109,10 @@ void app_main(void)
     ESP_LOGI(TAG, "   GPIO & Timer Example");
     ESP_LOGI(TAG, "   Running in QEMU");
     ESP_LOGI(TAG, "========================================");
+    static_alloc_log_memory("boot");
 
     // Create timer event queue
-    timer_queue = xQueueCreate(10, sizeof(uint64_t));
+    timer_queue = static_queue_create(&timer_queue_def);
 
     // Configure LED GPIO
     ESP_LOGI(TAG, "Configuring GPIO %d as output", LED_GPIO);
@@ -104,7 +143,8 @@ void app_main(void)
     };
     ESP_ERROR_CHECK(gptimer_set_alarm_action(gptimer, &alarm_config));
 
-    // Register callback
+    // Register callback (and its ISR counter for the profiler)
+    resource_profiler_register_isr(&timer_isr_counter);
     gptimer_event_callbacks_t cbs = {
         .on_alarm = timer_alarm_callback,
     };
@@ -115,8 +155,16 @@ void app_main(void)
     ESP_ERROR_CHECK(gptimer_start(gptimer));
     ESP_LOGI(TAG, "Timer started with %d us period", TIMER_ALARM_PERIOD_US);
 
-    // Create LED task
-    xTaskCreate(led_task, "led_task", 2048, NULL, 5, NULL);
+    // Create LED task on the sensing core, away from PRO_CPU housekeeping
+    task_placement_log_config();
+    static_task_create(&led_task_def, led_task, NULL, 5, TASK_ROLE_SENSING);
+
+    // Memory report: heap left after init, then stack use once running
+    static_alloc_log_memory("init");
+    static_alloc_report_stacks_later();
+
+    // Print a PROFILE snapshot (CPU per task, stacks, heap, ISRs) periodically
+    resource_profiler_start(NULL, NULL);
 
     ESP_LOGI(TAG, "System running. Press Ctrl+A then X to exit QEMU.");
 }
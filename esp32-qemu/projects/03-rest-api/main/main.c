@@ -7,14 +7,42 @@
  * - HTTP GET and POST requests using esp_http_client
  * - JSON payload construction and response parsing
  * - Connecting to a local REST API server
+ * - Running the HTTP client task on PRO_CPU next to lwIP
+ * - Posting CPU/stack/heap telemetry (see components/resource_profiler)
+ * - Config cached in NVS and re-checked with conditional GETs
+ *   (see components/device_config)
+ * - Health check retried with jittered backoff over an ordered server
+ *   list (see components/conn_manager)
+ * - One persistent HTTP session for all requests; optional HTTPS with
+ *   handshake timing (see components/tls_session)
+ * - POST bodies built in place in fixed pool blocks and sent from there
+ *   (see components/msg_pool)
+ * - Sampling on its own schedule: a sensing task queues readings and POST
+ *   workers send them, so a slow server never delays the next sample
+ * - Readings timestamped with an SNTP-synced clock and a trace ID, for
+ *   end-to-end latency per hop (see components/latency_trace)
+ * - Firmware updates as delta patches from the api-server into the second
+ *   app slot, kept only once the new image reaches the server
+ *   (see components/delta_ota)
+ * - Readings replayed from a recorded trace when one is flashed
+ *   (see components/sensor_replay)
+ * - Recent readings, metrics and config served by the device itself on
+ *   port 80, for when the backend is down (see components/local_api)
  *
  * Network architecture:
  *   ESP32 (QEMU guest)  --[slirp]--> Docker host (10.0.2.2)
  *   Docker host         --[bridge]-> api-server container (:5000)
  *
+ * With QEMU_NET=bridge (scripts/vnet.sh) the guest is on a virtual switch
+ * instead; the switch's router also answers at 10.0.2.2 and forwards the
+ * service ports, so the same addresses work in both modes.
+ *
  * The QEMU slirp network gives ESP32 IP via DHCP (typically 10.0.2.15).
  * The host is reachable at 10.0.2.2. Since the api-server Docker container
  * exposes port 5000 on the host, ESP32 reaches it at http://10.0.2.2:5000.
+ *
+ * TLS mode (SDKCONFIG_OVERLAY=/workspace/scripts/sdkconfig.tls, after
+ * scripts/gen-certs.sh) uses https://10.0.2.2:5443 instead.
  */
 
 #include <stdio.h>
@@ -24,20 +52,39 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
 
 #include "esp_system.h"
 #include "esp_log.h"
 #include "esp_event.h"
 #include "esp_netif.h"
 #include "esp_eth.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
 
 #include "esp_http_client.h"
+#include "esp_app_desc.h"
+
+#include "task_placement.h"
+#include "resource_profiler.h"
+#include "device_config.h"
+#include "qemu_nic.h"
+#include "conn_manager.h"
+#include "tls_session.h"
+#include "msg_pool.h"
+#include "delta_ota.h"
+#include "latency_trace.h"
+#include "sensor_replay.h"
+#include "local_api.h"
 
 static const char *TAG = "rest-api";
 
-/* Event group to signal when we have an IP address */
+/* Event group for the IP address and the demo's progress */
 static EventGroupHandle_t eth_event_group;
 #define ETH_CONNECTED_BIT BIT0
+#define BACKEND_READY_BIT BIT1   /* Health check and config sync done */
+#define POSTS_DONE_BIT    BIT2   /* The POSTed readings are all sent or failed */
 
 /* ----------------------------------------------------------------
  * Server configuration
@@ -45,25 +92,99 @@ static EventGroupHandle_t eth_event_group;
  * The Docker api-server exposes port 5000 on the host.
  * ---------------------------------------------------------------- */
 #define API_SERVER_HOST "10.0.2.2"
+#if CONFIG_TLS_SESSION_ENABLE
+#define API_SCHEME      "https"
+#define API_SERVER_PORT "5443"
+#else
+#define API_SCHEME      "http"
 #define API_SERVER_PORT "5000"
-#define API_BASE_URL    "http://" API_SERVER_HOST ":" API_SERVER_PORT
+#endif
+#define API_BASE_URL    API_SCHEME "://" API_SERVER_HOST ":" API_SERVER_PORT
+
+#define DEVICE_ID       "esp32-qemu-01"
 
-/* Fallback: public httpbin.org (requires internet from Docker host) */
-#define HTTPBIN_BASE_URL "http://httpbin.org"
+/* How often to ask the server whether the config changed (a 304 costs a
+ * few hundred bytes, the full document is never re-sent unless it changed) */
+#define CFG_RECHECK_INTERVAL_MS 30000
+
+/* API servers in order of preference. The second is the compose service
+ * name, resolved by the DNS of slirp or the virtual switch; everything
+ * stays on the local network, there is no public fallback. */
+static const char *const api_servers[] = {
+    API_BASE_URL,
+    API_SCHEME "://api-server:" API_SERVER_PORT,
+};
+static conn_manager_t api_conn;
+
+/* Health check attempts before giving up (spread by the backoff) */
+#define HEALTH_CHECK_ATTEMPTS 8
+
+/* Full URL of `path` on the currently selected server */
+static void api_url(char *buf, size_t len, const char *path)
+{
+    snprintf(buf, len, "%s%s", conn_manager_current(&api_conn), path);
+}
+
+/* Readings are sent by POST_WORKERS tasks, each with its own connection,
+ * so that many requests can be outstanding at once. Up to
+ * POST_QUEUE_DEPTH more wait in the queue. */
+#define SENSOR_READINGS  5
+#define POST_WORKERS     2
+#define POST_QUEUE_DEPTH 4
+
+/* POST bodies: esp_http_client sends the post field from the caller's
+ * buffer, so a body formatted in a pool block goes out without a copy.
+ * The block is freed once the request returns. There is one block per
+ * queue slot and per worker: when none is free the queue is full. */
+#define BODY_POOL_BLOCKS (POST_QUEUE_DEPTH + POST_WORKERS)
+#define BODY_BYTES       256
+MSG_POOL_DEFINE(body_pool, "http_body", BODY_POOL_BLOCKS, BODY_BYTES);
 
 /* Buffer for HTTP response */
 #define MAX_HTTP_RESPONSE_SIZE 2048
 static char response_buffer[MAX_HTTP_RESPONSE_SIZE];
 static int response_len;
 
+/* ----------------------------------------------------------------
+ * HTTP sessions
+ * One esp_http_client serves the REST calls and telemetry; each POST
+ * worker has another. A session's connection stays open between
+ * requests (HTTP/1.1 keep-alive), so only a new connection pays for TCP
+ * and, in TLS mode, a handshake. The lock serializes the tasks sharing
+ * a session (the REST task and the profiler).
+ * ---------------------------------------------------------------- */
+typedef struct {
+    esp_http_client_handle_t client;
+    SemaphoreHandle_t lock;
+    bool keep_response;          /* Collect the body in response_buffer */
+    bool new_connection;         /* Connected during this request */
+    int64_t request_start_us;
+    uint32_t connects;
+    uint32_t reused;
+} http_session_t;
+
+static http_session_t api_session;
+static http_session_t post_sessions[POST_WORKERS];
+static tls_session_t api_tls;
+
 /* ----------------------------------------------------------------
  * HTTP event handler — collects response data
  * ---------------------------------------------------------------- */
 static esp_err_t http_event_handler(esp_http_client_event_t *evt)
 {
+    http_session_t *s = evt->user_data;
+
     switch (evt->event_id) {
+    case HTTP_EVENT_ON_CONNECTED:
+        /* Only sent for a new connection: TCP connect plus handshake */
+        s->new_connection = true;
+        s->connects++;
+#if CONFIG_TLS_SESSION_ENABLE
+        tls_session_record(&api_tls, false, esp_timer_get_time() - s->request_start_us);
+#endif
+        break;
     case HTTP_EVENT_ON_DATA:
-        if (!esp_http_client_is_chunked_response(evt->client)) {
+        if (s->keep_response && !esp_http_client_is_chunked_response(evt->client)) {
             int copy_len = evt->data_len;
             if (response_len + copy_len < MAX_HTTP_RESPONSE_SIZE - 1) {
                 memcpy(response_buffer + response_len, evt->data, copy_len);
@@ -136,7 +257,9 @@ static void init_ethernet(void)
     esp_netif_config_t netif_cfg = ESP_NETIF_DEFAULT_ETH();
     esp_netif_t *eth_netif = esp_netif_new(&netif_cfg);
 
-    /* OpenCores Ethernet MAC — the virtual NIC provided by QEMU */
+    /* OpenCores Ethernet MAC — the virtual NIC provided by QEMU. Take the
+     * NIC's address so instances sharing a virtual switch differ. */
+    qemu_nic_use_nic_mac();
     eth_mac_config_t mac_config = ETH_MAC_DEFAULT_CONFIG();
     esp_eth_mac_t *mac = esp_eth_mac_new_openeth(&mac_config);
 
@@ -166,70 +289,103 @@ static void init_ethernet(void)
 }
 
 /* ----------------------------------------------------------------
- * HTTP helper: perform GET request and print response
+ * HTTP session setup and requests
  * ---------------------------------------------------------------- */
-static esp_err_t http_get(const char *url)
+static void http_session_open(http_session_t *s, bool keep_response)
 {
-    ESP_LOGI(TAG, "GET %s", url);
-    response_len = 0;
-    memset(response_buffer, 0, sizeof(response_buffer));
+    s->lock = xSemaphoreCreateMutex();
+    s->keep_response = keep_response;
 
     esp_http_client_config_t config = {
-        .url = url,
+        .url = API_BASE_URL,
         .event_handler = http_event_handler,
+        .user_data = s,
+        .cert_pem = tls_session_ca_pem(),   /* NULL unless TLS mode */
         .timeout_ms = 10000,
     };
+    s->client = esp_http_client_init(&config);
+}
 
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    esp_err_t err = esp_http_client_perform(client);
+static void http_session_init(void)
+{
+    tls_session_init(&api_tls, "api");
+    http_session_open(&api_session, true);
+    for (int i = 0; i < POST_WORKERS; i++) {
+        http_session_open(&post_sessions[i], false);
+    }
+}
 
-    if (err == ESP_OK) {
-        int status = esp_http_client_get_status_code(client);
-        ESP_LOGI(TAG, "Response status=%d, length=%d", status, response_len);
+/* Perform one request on a session; body may be NULL (GET) */
+static esp_err_t http_request(http_session_t *s, esp_http_client_method_t method,
+                              const char *url, const char *body, int body_len,
+                              bool log_response)
+{
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+
+    esp_err_t err = ESP_FAIL;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (s->keep_response) {
+            response_len = 0;
+            memset(response_buffer, 0, sizeof(response_buffer));
+        }
+        esp_http_client_set_url(s->client, url);
+        esp_http_client_set_method(s->client, method);
+        if (body != NULL) {
+            esp_http_client_set_header(s->client, "Content-Type", "application/json");
+        }
+        esp_http_client_set_post_field(s->client, body, body != NULL ? body_len : 0);
+
+        s->new_connection = false;
+        s->request_start_us = esp_timer_get_time();
+        err = esp_http_client_perform(s->client);
+        if (err == ESP_OK || s->new_connection || s->connects == 0) {
+            break;
+        }
+        /* The server may have closed the idle kept-alive connection:
+         * retry once on a new one */
+        esp_http_client_close(s->client);
+    }
+
+    if (err == ESP_OK && !s->new_connection) {
+        s->reused++;
+        tls_session_record_reuse(&api_tls);
+    }
+    if (log_response && err == ESP_OK) {
+        ESP_LOGI(TAG, "Response status=%d, length=%d",
+                 esp_http_client_get_status_code(s->client), response_len);
         ESP_LOGI(TAG, "Body: %s", response_buffer);
-    } else {
-        ESP_LOGE(TAG, "HTTP GET failed: %s", esp_err_to_name(err));
     }
 
-    esp_http_client_cleanup(client);
+    xSemaphoreGive(s->lock);
     return err;
 }
 
 /* ----------------------------------------------------------------
- * HTTP helper: perform POST request with JSON body
+ * HTTP helper: perform GET request and print response
  * ---------------------------------------------------------------- */
-static esp_err_t http_post_json(const char *url, const char *json_body)
+static esp_err_t http_get(const char *url)
 {
-    ESP_LOGI(TAG, "POST %s", url);
-    ESP_LOGI(TAG, "Body: %s", json_body);
-    response_len = 0;
-    memset(response_buffer, 0, sizeof(response_buffer));
-
-    esp_http_client_config_t config = {
-        .url = url,
-        .event_handler = http_event_handler,
-        .method = HTTP_METHOD_POST,
-        .timeout_ms = 10000,
-    };
-
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_post_field(client, json_body, strlen(json_body));
-
-    esp_err_t err = esp_http_client_perform(client);
-
-    if (err == ESP_OK) {
-        int status = esp_http_client_get_status_code(client);
-        ESP_LOGI(TAG, "Response status=%d, length=%d", status, response_len);
-        ESP_LOGI(TAG, "Body: %s", response_buffer);
-    } else {
-        ESP_LOGE(TAG, "HTTP POST failed: %s", esp_err_to_name(err));
+    ESP_LOGI(TAG, "GET %s", url);
+    esp_err_t err = http_request(&api_session, HTTP_METHOD_GET, url, NULL, 0, true);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "HTTP GET failed: %s", esp_err_to_name(err));
     }
-
-    esp_http_client_cleanup(client);
     return err;
 }
 
+/* ----------------------------------------------------------------
+ * Profiler sink: POST each snapshot to the API server on the same session
+ * ---------------------------------------------------------------- */
+static void post_profile(const char *json, size_t len, void *ctx)
+{
+    char url[128];
+    api_url(url, sizeof(url), "/api/telemetry?device=" DEVICE_ID);
+    esp_err_t err = http_request(&api_session, HTTP_METHOD_POST, url, json, len, false);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Telemetry POST failed: %s", esp_err_to_name(err));
+    }
+}
+
 /* ----------------------------------------------------------------
  * Simulated sensor reading (since we don't have real ADC in QEMU)
  * ---------------------------------------------------------------- */
@@ -245,77 +401,319 @@ static float get_simulated_humidity(void)
     return 40.0f + (float)(esp_random() % 300) / 10.0f;
 }
 
+/* Readings from the "env" trace when a pack is flashed (SENSOR_TRACE,
+ * components/sensor_replay), one recorded minute per second; the
+ * simulated ones above otherwise */
+#define ENV_TRACE_SPEED 60
+static sensor_replay_t env_trace;
+static int env_temp_ch = -1;
+static int env_humidity_ch = -1;
+
+static void sensors_init(void)
+{
+    if (sensor_replay_open(&env_trace, "env", SENSOR_REPLAY_REALTIME,
+                           ENV_TRACE_SPEED) == ESP_OK) {
+        env_temp_ch = sensor_replay_channel(&env_trace, "temp");
+        env_humidity_ch = sensor_replay_channel(&env_trace, "humidity");
+        sensor_replay_log(&env_trace);
+    } else {
+        ESP_LOGI(TAG, "No sensor trace, readings are simulated");
+    }
+}
+
+/* One trace record per sample: both values come from the same record */
+static void read_sensors(float *temp, float *humidity)
+{
+    sensor_reading_t r;
+    bool replayed = (env_temp_ch >= 0 || env_humidity_ch >= 0) &&
+                    sensor_replay_next(&env_trace, &r) == ESP_OK;
+    *temp = replayed && env_temp_ch >= 0 ? r.value[env_temp_ch]
+                                         : get_simulated_temperature();
+    *humidity = replayed && env_humidity_ch >= 0 ? r.value[env_humidity_ch]
+                                                 : get_simulated_humidity();
+}
+
 /* ----------------------------------------------------------------
- * Main application
+ * Sampling and POST workers
+ * The sampler runs on the sensing core at the configured interval and
+ * never waits for the network: it formats each reading in a pool block
+ * and queues it. The POST workers on the network core send them, so a
+ * slow server makes readings wait in the queue, not the next sample.
+ * When every block is queued or in flight the reading is dropped and
+ * counted (backpressure) rather than the sampler blocking. Every reading
+ * also goes into the local API's ring (GET /readings on the device).
  * ---------------------------------------------------------------- */
-void app_main(void)
+typedef struct {
+    msg_t *body;
+    int reading_id;
+    int64_t queued_us;
+} post_job_t;
+
+static QueueHandle_t post_queue;
+static task_jitter_t sample_jitter;
+
+typedef struct {
+    uint32_t queued;
+    uint32_t sent;
+    uint32_t failed;
+    uint32_t dropped;
+    int waiting;                     /* Jobs in the queue */
+    int max_waiting;
+    int inflight;                    /* Requests being sent */
+    int max_inflight;
+    int64_t max_wait_us;             /* Longest time a job sat queued */
+    int64_t sum_request_us;
+    int64_t max_request_us;
+    bool sampling_done;
+} post_stats_t;
+
+static portMUX_TYPE post_lock = portMUX_INITIALIZER_UNLOCKED;
+static post_stats_t post_stats;
+
+/* Values of each reading, in the order local_api_record() gets them */
+static const char *const reading_names[] = { "temperature", "humidity" };
+
+/* Called under post_lock: true once, when the last reading is finished */
+static bool post_all_done(void)
 {
-    printf("\n");
-    printf("==========================================\n");
-    printf("  ESP32 REST API Client (QEMU)\n");
-    printf("  IoT Course - Spring 2026\n");
-    printf("==========================================\n\n");
+    return post_stats.sampling_done &&
+           post_stats.sent + post_stats.failed == post_stats.queued;
+}
 
-    /* Step 1: Initialize Ethernet and wait for IP */
-    init_ethernet();
+/* Print one machine-readable line:
+ *   POST_QUEUE workers=.. depth=.. queued=.. sent=.. failed=.. dropped=..
+ *       max_waiting=.. max_inflight=.. wait_ms_max=.. req_ms_avg=.. req_ms_max=.. */
+static void post_stats_log(void)
+{
+    portENTER_CRITICAL(&post_lock);
+    post_stats_t st = post_stats;
+    portEXIT_CRITICAL(&post_lock);
+
+    uint32_t done = st.sent + st.failed;
+    printf("POST_QUEUE workers=%d depth=%d queued=%u sent=%u failed=%u dropped=%u "
+           "max_waiting=%d max_inflight=%d wait_ms_max=%lld req_ms_avg=%lld req_ms_max=%lld\n",
+           POST_WORKERS, POST_QUEUE_DEPTH, (unsigned)st.queued, (unsigned)st.sent,
+           (unsigned)st.failed, (unsigned)st.dropped, st.max_waiting, st.max_inflight,
+           st.max_wait_us / 1000, done ? st.sum_request_us / done / 1000 : 0,
+           st.max_request_us / 1000);
+}
 
-    EventBits_t bits = xEventGroupWaitBits(eth_event_group,
-                                           ETH_CONNECTED_BIT,
-                                           pdFALSE, pdTRUE,
-                                           pdMS_TO_TICKS(30000));
+/* Extra lines for the device's own GET /metrics */
+static void local_metrics(local_api_writer_t *w, void *ctx)
+{
+    portENTER_CRITICAL(&post_lock);
+    post_stats_t st = post_stats;
+    portEXIT_CRITICAL(&post_lock);
+
+    local_api_metric(w, "post_queued_total", NULL, st.queued);
+    local_api_metric(w, "post_sent_total", NULL, st.sent);
+    local_api_metric(w, "post_failed_total", NULL, st.failed);
+    local_api_metric(w, "post_dropped_total", NULL, st.dropped);
+    local_api_metric(w, "post_request_seconds_max", NULL, st.max_request_us / 1e6);
+    local_api_metric(w, "sample_jitter_max_seconds", NULL, sample_jitter.max_dev_us / 1e6);
+}
 
-    if (!(bits & ETH_CONNECTED_BIT)) {
-        ESP_LOGE(TAG, "Failed to get IP address within 30 seconds!");
-        ESP_LOGE(TAG, "Make sure QEMU was started with: -nic user,model=open_eth");
+/* Format a reading in a pool block and queue it for the POST workers */
+static void queue_reading(int reading_id, float temp, float humidity,
+                          const latency_trace_t *trace)
+{
+    post_job_t job = { .body = msg_alloc(&body_pool), .reading_id = reading_id };
+    if (job.body == NULL) {
+        portENTER_CRITICAL(&post_lock);
+        post_stats.dropped++;
+        portEXIT_CRITICAL(&post_lock);
+        ESP_LOGW(TAG, "Reading %d dropped: all %d POST slots busy",
+                 reading_id, BODY_POOL_BLOCKS);
         return;
     }
+    if (msg_printf(job.body,
+                   "{\"device\":\"" DEVICE_ID "\","
+                   "\"temperature\":%.1f,"
+                   "\"humidity\":%.1f,"
+                   "\"reading_id\":%d,"
+                   LATENCY_TRACE_JSON_FMT "}",
+                   temp, humidity, reading_id, LATENCY_TRACE_JSON_ARGS(trace)) < 0) {
+        msg_free(job.body);
+        return;
+    }
+    job.queued_us = esp_timer_get_time();
+    portENTER_CRITICAL(&post_lock);
+    post_stats.queued++;
+    if (++post_stats.waiting > post_stats.max_waiting) {
+        post_stats.max_waiting = post_stats.waiting;
+    }
+    portEXIT_CRITICAL(&post_lock);
+    ESP_LOGI(TAG, "Reading %d queued: %s", reading_id, job.body->data);
+    xQueueSend(post_queue, &job, 0);   /* A worker owns it from here */
+}
 
-    /* Small delay to let the network stack fully initialize */
-    vTaskDelay(pdMS_TO_TICKS(2000));
+/* Samples for as long as the device runs. Every reading goes into the
+ * local API's ring; the first SENSOR_READINGS are also POSTed. */
+static void sampler_task(void *pvParameters)
+{
+    /* Timestamps need the synced clock (normally set by now) */
+    latency_trace_wait_sync(CONFIG_LATENCY_TRACE_SYNC_TIMEOUT_MS);
+
+    device_config_t cfg;
+    device_config_get(&cfg);
+    task_jitter_init(&sample_jitter, "sampler", cfg.sample_interval_ms * 1000LL);
+    TickType_t last_wake = xTaskGetTickCount();
+
+    for (int reading_id = 1; ; reading_id++) {
+        task_jitter_record(&sample_jitter);
+
+        float temp, humidity;
+        read_sensors(&temp, &humidity);
+        latency_trace_t trace;
+        latency_trace_begin(&trace);
+        local_api_record(trace.sample_us / 1000, (float[]){ temp, humidity });
+
+        if (reading_id <= SENSOR_READINGS) {
+            queue_reading(reading_id, temp, humidity, &trace);
+        }
+        if (reading_id == SENSOR_READINGS) {
+            task_jitter_log(&sample_jitter);
+            portENTER_CRITICAL(&post_lock);
+            post_stats.sampling_done = true;
+            bool done = post_all_done();
+            portEXIT_CRITICAL(&post_lock);
+            if (done) {
+                xEventGroupSetBits(eth_event_group, POSTS_DONE_BIT);
+            }
+        }
 
+        /* Config changes (fetched by the REST task) apply from the next
+         * period on */
+        device_config_get(&cfg);
+        sample_jitter.period_us = cfg.sample_interval_ms * 1000LL;
+        xTaskDelayUntil(&last_wake, pdMS_TO_TICKS(cfg.sample_interval_ms));
+    }
+}
+
+static void post_worker_task(void *pvParameters)
+{
+    http_session_t *session = pvParameters;
+    char url[128];
+    post_job_t job;
+
+    /* Readings taken before the server answered wait in the queue */
+    xEventGroupWaitBits(eth_event_group, BACKEND_READY_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+
+    while (1) {
+        xQueueReceive(post_queue, &job, portMAX_DELAY);
+        int64_t start_us = esp_timer_get_time();
+        portENTER_CRITICAL(&post_lock);
+        post_stats.waiting--;
+        if (++post_stats.inflight > post_stats.max_inflight) {
+            post_stats.max_inflight = post_stats.inflight;
+        }
+        if (start_us - job.queued_us > post_stats.max_wait_us) {
+            post_stats.max_wait_us = start_us - job.queued_us;
+        }
+        portEXIT_CRITICAL(&post_lock);
+
+        /* A failing server loses health score; once it drops below the
+         * next one, later requests go there. The publish time is stamped
+         * here, so time spent queued counts as sample->publish. */
+        conn_manager_select(&api_conn);
+        api_url(url, sizeof(url), "/api/sensors");
+        job.body->len = latency_trace_stamp_publish(job.body->data, job.body->len,
+                                                    msg_capacity(job.body));
+        esp_err_t err = http_request(session, HTTP_METHOD_POST, url,
+                                     job.body->data, job.body->len, false);
+        conn_manager_report(&api_conn, err == ESP_OK);
+        int64_t request_us = esp_timer_get_time() - start_us;
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG, "POST reading %d: status=%d in %lld ms (queued %lld ms)",
+                     job.reading_id, esp_http_client_get_status_code(session->client),
+                     request_us / 1000, (start_us - job.queued_us) / 1000);
+        } else {
+            ESP_LOGE(TAG, "POST reading %d failed: %s", job.reading_id, esp_err_to_name(err));
+        }
+        msg_free(job.body);
+
+        portENTER_CRITICAL(&post_lock);
+        post_stats.inflight--;
+        if (err == ESP_OK) {
+            post_stats.sent++;
+        } else {
+            post_stats.failed++;
+        }
+        post_stats.sum_request_us += request_us;
+        if (request_us > post_stats.max_request_us) {
+            post_stats.max_request_us = request_us;
+        }
+        bool done = post_all_done();
+        portEXIT_CRITICAL(&post_lock);
+        if (done) {
+            xEventGroupSetBits(eth_event_group, POSTS_DONE_BIT);
+        }
+    }
+}
+
+/* ----------------------------------------------------------------
+ * REST client task — all HTTP traffic runs on the network core
+ * ---------------------------------------------------------------- */
+static void rest_client_task(void *pvParameters)
+{
     /* Step 2: Health check — verify the API server is reachable */
     ESP_LOGI(TAG, "========================================");
     ESP_LOGI(TAG, "Step 1: Health check");
     ESP_LOGI(TAG, "========================================");
 
-    esp_err_t err = http_get(API_BASE_URL "/health");
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Local API server not reachable, trying httpbin.org...");
-        err = http_get(HTTPBIN_BASE_URL "/get");
-        if (err != ESP_OK) {
+    char url[128];
+    for (int attempt = 1; ; attempt++) {
+        conn_manager_select(&api_conn);
+        api_url(url, sizeof(url), "/health");
+        esp_err_t err = http_get(url);
+        conn_manager_report(&api_conn, err == ESP_OK);
+        if (err == ESP_OK) {
+            break;
+        }
+        if (attempt == HEALTH_CHECK_ATTEMPTS) {
             ESP_LOGE(TAG, "No server reachable. Check network configuration.");
-            return;
+            ESP_LOGE(TAG, "Readings are still sampled, see GET /readings on the device");
+            conn_manager_log(&api_conn);
+            vTaskDelete(NULL);
         }
-        ESP_LOGI(TAG, "Using httpbin.org as fallback");
+        vTaskDelay(pdMS_TO_TICKS(conn_manager_next_delay_ms(&api_conn)));
     }
 
-    /* Step 3: GET — fetch device configuration */
+    /* An updated image that got this far keeps its slot. Then ask for a
+     * newer release; applying one restarts into it */
+    delta_ota_confirm();
+    api_url(url, sizeof(url), "/api/ota/patch?project=");
+    strlcat(url, esp_app_get_description()->project_name, sizeof(url));
+    delta_ota_update(url);
+
+    /* Step 3: GET — sync device configuration (conditional on our version) */
     ESP_LOGI(TAG, "========================================");
     ESP_LOGI(TAG, "Step 2: GET device configuration");
     ESP_LOGI(TAG, "========================================");
 
-    http_get(API_BASE_URL "/api/config");
+    api_url(url, sizeof(url), "/api/config");
+    device_config_fetch(url);
+    int64_t last_config_check_us = esp_timer_get_time();
 
-    /* Step 4: POST — send simulated sensor data in a loop */
+    /* Step 4: POST — the sampler has been queueing readings since boot;
+     * the workers send them from now on. Meanwhile this task picks up
+     * config changes without rebooting. */
     ESP_LOGI(TAG, "========================================");
     ESP_LOGI(TAG, "Step 3: POST sensor readings (loop)");
     ESP_LOGI(TAG, "========================================");
-
-    for (int i = 0; i < 5; i++) {
-        float temp = get_simulated_temperature();
-        float humidity = get_simulated_humidity();
-
-        char json[256];
-        snprintf(json, sizeof(json),
-                 "{\"device\":\"esp32-qemu-01\","
-                 "\"temperature\":%.1f,"
-                 "\"humidity\":%.1f,"
-                 "\"reading_id\":%d}",
-                 temp, humidity, i + 1);
-
-        http_post_json(API_BASE_URL "/api/sensors", json);
-
-        vTaskDelay(pdMS_TO_TICKS(3000));
+    xEventGroupSetBits(eth_event_group, BACKEND_READY_BIT);
+
+    while (!(xEventGroupWaitBits(eth_event_group, POSTS_DONE_BIT, pdFALSE, pdTRUE,
+                                 pdMS_TO_TICKS(1000)) & POSTS_DONE_BIT)) {
+        if (esp_timer_get_time() - last_config_check_us >= CFG_RECHECK_INTERVAL_MS * 1000LL) {
+            api_url(url, sizeof(url), "/api/config");
+            device_config_fetch(url);
+            last_config_check_us = esp_timer_get_time();
+        }
+    }
+    post_stats_log();
+    if (env_temp_ch >= 0) {
+        sensor_replay_log(&env_trace);
     }
 
     /* Step 5: GET — verify all readings were stored */
@@ -323,23 +721,110 @@ void app_main(void)
     ESP_LOGI(TAG, "Step 4: GET all stored readings");
     ESP_LOGI(TAG, "========================================");
 
-    http_get(API_BASE_URL "/api/sensors");
+    api_url(url, sizeof(url), "/api/sensors");
+    http_get(url);
 
-    /* Step 6: GET latest reading */
+    /* Step 6: GET this device's latest reading */
     ESP_LOGI(TAG, "========================================");
     ESP_LOGI(TAG, "Step 5: GET latest reading");
     ESP_LOGI(TAG, "========================================");
 
-    http_get(API_BASE_URL "/api/sensors/latest");
+    api_url(url, sizeof(url), "/api/devices/" DEVICE_ID "/latest");
+    http_get(url);
+
+    conn_manager_log(&api_conn);
+    msg_pool_log(&body_pool);
+    local_api_log();
+    uint32_t connects = api_session.connects;
+    uint32_t reused = api_session.reused;
+    for (int i = 0; i < POST_WORKERS; i++) {
+        connects += post_sessions[i].connects;
+        reused += post_sessions[i].reused;
+    }
+    printf("HTTP_SESSION connects=%u reused=%u\n", (unsigned)connects, (unsigned)reused);
+#if CONFIG_TLS_SESSION_ENABLE
+    /* esp_http_client does not expose its TLS session; probe the same
+     * server with tls_session's transport to compare resumed handshakes */
+    tls_session_probe(&api_tls, conn_manager_current(&api_conn),
+                      CONFIG_TLS_SESSION_PROBES);
+    tls_session_log(&api_tls);
+#endif
 
     /* Done */
     printf("\n");
     printf("==========================================\n");
     printf("  Demo complete!\n");
+    printf("  The device still serves GET /readings, /metrics, /config\n");
     printf("  Press Ctrl+A then X to exit QEMU\n");
     printf("==========================================\n");
 
-    while (1) {
-        vTaskDelay(pdMS_TO_TICKS(1000));
+    vTaskDelete(NULL);
+}
+
+/* ----------------------------------------------------------------
+ * Main application
+ * ---------------------------------------------------------------- */
+void app_main(void)
+{
+    printf("\n");
+    printf("==========================================\n");
+    printf("  ESP32 REST API Client (QEMU)\n");
+    printf("  IoT Course - Spring 2026\n");
+    printf("==========================================\n\n");
+    delta_ota_log_boot();
+
+    /* Step 0: Load the cached config so sampling settings are known
+     * immediately, before the network is up */
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
     }
+    ESP_ERROR_CHECK(ret);
+    device_config_init();
+    device_config_set_ca_cert(tls_session_ca_pem());
+    delta_ota_set_ca_cert(tls_session_ca_pem());
+    conn_manager_init(&api_conn, "api", api_servers,
+                      sizeof(api_servers) / sizeof(api_servers[0]));
+    http_session_init();
+    msg_pool_init(&body_pool);
+    post_queue = xQueueCreate(BODY_POOL_BLOCKS, sizeof(post_job_t));
+    sensors_init();
+
+    /* Step 1: Initialize Ethernet and wait for IP */
+    init_ethernet();
+
+    EventBits_t bits = xEventGroupWaitBits(eth_event_group,
+                                           ETH_CONNECTED_BIT,
+                                           pdFALSE, pdTRUE,
+                                           pdMS_TO_TICKS(30000));
+
+    if (!(bits & ETH_CONNECTED_BIT)) {
+        ESP_LOGE(TAG, "Failed to get IP address within 30 seconds!");
+        ESP_LOGE(TAG, "Make sure QEMU was started with: -nic user,model=open_eth");
+        return;
+    }
+
+    /* Local pull: GET /readings, /metrics, /config on the device */
+    local_api_start(DEVICE_ID, reading_names,
+                    sizeof(reading_names) / sizeof(reading_names[0]), local_metrics, NULL);
+
+    /* Small delay to let the network stack fully initialize */
+    vTaskDelay(pdMS_TO_TICKS(2000));
+    latency_trace_start_sync();
+
+    /* Steps 2-6 run in their own task pinned next to lwIP (PRO_CPU), as
+     * do the POST workers. The sampler runs on APP_CPU whether or not a
+     * server answers. */
+    task_placement_log_config();
+    task_placement_create(rest_client_task, "rest_client", 6144, NULL, 5, NULL,
+                          TASK_ROLE_NETWORK);
+    for (int i = 0; i < POST_WORKERS; i++) {
+        task_placement_create(post_worker_task, "post_worker", 6144, &post_sessions[i], 5,
+                              NULL, TASK_ROLE_NETWORK);
+    }
+    task_placement_create(sampler_task, "sampler", 3072, NULL, 6, NULL, TASK_ROLE_SENSING);
+
+    /* Periodic CPU/stack/heap snapshots to POST /api/telemetry */
+    resource_profiler_start(post_profile, NULL);
 }
@@ -8,18 +8,52 @@
  * - Publishing simulated sensor data on a schedule
  * - Subscribing to command topics and reacting to messages
  * - QoS levels and last will testament (LWT)
+ * - Pinning sampling to APP_CPU and networking to PRO_CPU
+ * - Statically allocated event groups and task (see components/static_alloc)
+ * - Runtime CPU/stack/heap telemetry (see components/resource_profiler)
+ * - Config pushed as retained MQTT deltas, cached in NVS
+ *   (see components/device_config)
+ * - Reconnects with jittered backoff over an ordered broker list, and a
+ *   publish rate limit (see components/conn_manager)
+ * - Optional MQTT over TLS with resumed sessions and handshake timing
+ *   (see components/tls_session)
+ * - Outbound messages built in place in fixed pool blocks and handed to a
+ *   sender task by pointer (see components/msg_pool)
+ * - Readings timestamped with an SNTP-synced clock and a trace ID, for
+ *   end-to-end latency per hop (see components/latency_trace)
+ * - Firmware updates as delta patches from the api-server into the second
+ *   app slot, kept only once the new image reaches the broker
+ *   (see components/delta_ota)
+ * - The sampling period adapts to the temperature: the configured interval
+ *   while it is steady, down to a fifth of it while it moves, within a
+ *   radio byte budget (see components/adaptive_rate)
+ * - Readings replayed from a recorded trace when one is flashed
+ *   (see components/sensor_replay)
  *
  * Network architecture:
  *   ESP32 (QEMU guest)  --[slirp]--> Docker host (10.0.2.2)
  *   Docker host         --[bridge]-> Mosquitto container (:1883)
  *
+ * With QEMU_NET=bridge (scripts/vnet.sh) the guest is on a virtual switch
+ * instead; the switch's router also answers at 10.0.2.2 and forwards the
+ * service ports, so the same addresses work in both modes.
+ *
+ * TLS mode (SDKCONFIG_OVERLAY=/workspace/scripts/sdkconfig.tls, after
+ * scripts/gen-certs.sh) connects to mqtts://10.0.2.2:8883. Reconnects
+ * offer the previous session, so they skip the certificate check and key
+ * exchange; the session is kept in NVS for the next boot too.
+ *
  * Topics:
  *   esp32/sensors/temperature  - ESP32 publishes sensor readings here
  *   esp32/sensors/humidity     - ESP32 publishes humidity readings here
  *   esp32/commands             - ESP32 subscribes for incoming commands
  *   esp32/status               - ESP32 publishes online/offline status (LWT)
+ *   esp32/telemetry            - ESP32 publishes resource profiler snapshots
+ *   esp32/config               - ESP32 subscribes for config deltas (retained)
  */
 
+#include <stdarg.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -27,50 +61,154 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/queue.h"
 
 #include "esp_system.h"
 #include "esp_log.h"
 #include "esp_event.h"
 #include "esp_netif.h"
 #include "esp_eth.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
 
 #include "mqtt_client.h"
 
+#include "task_placement.h"
+#include "static_alloc.h"
+#include "resource_profiler.h"
+#include "device_config.h"
+#include "qemu_nic.h"
+#include "conn_manager.h"
+#include "tls_session.h"
+#include "msg_pool.h"
+#include "delta_ota.h"
+#include "latency_trace.h"
+#include "sensor_replay.h"
+#include "adaptive_rate.h"
+#include "esp_app_desc.h"
+
 static const char *TAG = "mqtt-demo";
 
 /* ----------------------------------------------------------------
  * Event bits
  * ---------------------------------------------------------------- */
+STATIC_EVENT_GROUP_DEFINE(eth_event_group_def);
 static EventGroupHandle_t eth_event_group;
 #define ETH_CONNECTED_BIT   BIT0
 
+STATIC_EVENT_GROUP_DEFINE(mqtt_event_group_def);
 static EventGroupHandle_t mqtt_event_group;
 #define MQTT_CONNECTED_BIT  BIT0
+#define CFG_RESYNC_BIT      BIT1   /* a config delta was missed */
+#define MQTT_RECONNECT_BIT  BIT2   /* disconnected, supervisor should retry */
+
+/* Publisher task stack: see the STACK report printed after boot */
+#define SENSOR_PUB_STACK_BYTES 4096
+STATIC_TASK_DEFINE(sensor_pub_def, "sensor_pub", SENSOR_PUB_STACK_BYTES);
+STATIC_TASK_DEFINE(mqtt_supervisor_def, "mqtt_sup", 3072);
+STATIC_TASK_DEFINE(mqtt_tx_def, "mqtt_tx", 3072);
+STATIC_TASK_DEFINE(ota_def, "ota", 4096);
+#if CONFIG_TLS_SESSION_ENABLE
+/* mbedTLS handshakes need more stack than the other tasks */
+STATIC_TASK_DEFINE(tls_probe_def, "tls_probe", 6144);
+#endif
 
 /* ----------------------------------------------------------------
  * MQTT configuration
  * In QEMU slirp, host is at 10.0.2.2.
  * Mosquitto Docker container exposes port 1883 on the host.
  * ---------------------------------------------------------------- */
-#define MQTT_BROKER_URI      "mqtt://10.0.2.2:1883"
-#define MQTT_BROKER_FALLBACK "mqtt://test.mosquitto.org:1883"
+#if CONFIG_TLS_SESSION_ENABLE
+#define MQTT_SCHEME          "mqtts"
+#define MQTT_PORT            "8883"
+#else
+#define MQTT_SCHEME          "mqtt"
+#define MQTT_PORT            "1883"
+#endif
+#define MQTT_BROKER_URI      MQTT_SCHEME "://10.0.2.2:" MQTT_PORT
+
+/* Brokers in order of preference. The second is the compose service name,
+ * resolved by the DNS of slirp or the virtual switch; everything stays on
+ * the local network, there is no public fallback. */
+static const char *const broker_uris[] = {
+    MQTT_BROKER_URI,
+    MQTT_SCHEME "://mqtt-broker:" MQTT_PORT,
+};
+static conn_manager_t broker_conn;
+
+#if CONFIG_TLS_SESSION_ENABLE
+/* Last TLS session with the broker, offered again on every reconnect */
+static tls_session_t broker_tls;
+#endif
+
+/* Publishes allowed in a burst, then one per PUBLISH_REFILL_MS. Keeps a
+ * device that just reconnected (or a too-small pushed interval) from
+ * flooding the broker. */
+#define PUBLISH_BURST        10
+#define PUBLISH_REFILL_MS    200
+static token_bucket_t publish_bucket;
 
 #define TOPIC_TEMPERATURE    "esp32/sensors/temperature"
 #define TOPIC_HUMIDITY       "esp32/sensors/humidity"
+#define TOPIC_SENSORS_PREFIX "esp32/sensors/"   /* Traced readings */
 #define TOPIC_COMMANDS       "esp32/commands"
 #define TOPIC_STATUS         "esp32/status"
+#define TOPIC_TELEMETRY      "esp32/telemetry"
+#define TOPIC_CONFIG         "esp32/config"
+
+/* Full config document, used only when a pushed delta cannot be applied */
+#if CONFIG_TLS_SESSION_ENABLE
+#define API_CONFIG_URL       "https://10.0.2.2:5443/api/config"
+#define API_OTA_URL          "https://10.0.2.2:5443/api/ota/patch?project="
+#else
+#define API_CONFIG_URL       "http://10.0.2.2:5000/api/config"
+#define API_OTA_URL          "http://10.0.2.2:5000/api/ota/patch?project="
+#endif
 
 #define CLIENT_ID            "esp32-qemu-01"
 
 static esp_mqtt_client_handle_t mqtt_client = NULL;
 static int publish_count = 0;
 
+/* Outbound messages: formatted directly in a pool block, queued by
+ * pointer, published by mqtt_tx_task on the network core and freed there.
+ * The queue holds as many pointers as the pool has blocks, so sending
+ * never blocks; an empty pool shows up as exhausted= in MSG_POOL. */
+#define TX_POOL_BLOCKS       8
+#define TX_MSG_BYTES         160
+MSG_POOL_DEFINE(tx_pool, "mqtt_tx", TX_POOL_BLOCKS, TX_MSG_BYTES);
+STATIC_QUEUE_DEFINE(tx_queue_def, TX_POOL_BLOCKS, msg_t *);
+static QueueHandle_t tx_queue;
+
+/* Adaptive sampling: the configured interval is the slowest period, a
+ * fifth of it the fastest. Each reading costs about SENSOR_READING_BYTES
+ * on the radio (temperature + humidity messages), and readings may not
+ * use more than SENSOR_RADIO_BPS on average. */
+#define SAMPLE_MIN_DIVISOR     5
+#define SENSOR_READING_BYTES   300
+#define SENSOR_RADIO_BPS       200
+#define TEMP_CHANGE_C_PER_S    0.2f
+#define TEMP_NOISE_C           0.3f
+static adaptive_budget_t radio_budget;
+static adaptive_rate_t sample_rate;
+
 /* ----------------------------------------------------------------
  * Simulated sensor readings
  * ---------------------------------------------------------------- */
+/* A random walk between 18 and 32 C with an occasional 1.5 C step */
 static float get_simulated_temperature(void)
 {
-    return 20.0f + (float)(esp_random() % 100) / 10.0f;
+    static float temp = 24.0f;
+    temp += (float)((int)(esp_random() % 21) - 10) / 100.0f;
+    if (esp_random() % 8 == 0) {
+        temp += (esp_random() & 1) ? 1.5f : -1.5f;
+    }
+    if (temp < 18.0f) {
+        temp = 18.0f;
+    } else if (temp > 32.0f) {
+        temp = 32.0f;
+    }
+    return temp;
 }
 
 static float get_simulated_humidity(void)
@@ -78,6 +216,38 @@ static float get_simulated_humidity(void)
     return 40.0f + (float)(esp_random() % 300) / 10.0f;
 }
 
+/* Readings from the "env" trace when a pack is flashed (SENSOR_TRACE,
+ * components/sensor_replay), one recorded minute per second; the
+ * simulated ones above otherwise */
+#define ENV_TRACE_SPEED 60
+static sensor_replay_t env_trace;
+static int env_temp_ch = -1;
+static int env_humidity_ch = -1;
+
+static void sensors_init(void)
+{
+    if (sensor_replay_open(&env_trace, "env", SENSOR_REPLAY_REALTIME,
+                           ENV_TRACE_SPEED) == ESP_OK) {
+        env_temp_ch = sensor_replay_channel(&env_trace, "temp");
+        env_humidity_ch = sensor_replay_channel(&env_trace, "humidity");
+        sensor_replay_log(&env_trace);
+    } else {
+        ESP_LOGI(TAG, "No sensor trace, readings are simulated");
+    }
+}
+
+/* One trace record per sample: both values come from the same record */
+static void read_sensors(float *temp, float *humidity)
+{
+    sensor_reading_t r;
+    bool replayed = (env_temp_ch >= 0 || env_humidity_ch >= 0) &&
+                    sensor_replay_next(&env_trace, &r) == ESP_OK;
+    *temp = replayed && env_temp_ch >= 0 ? r.value[env_temp_ch]
+                                         : get_simulated_temperature();
+    *humidity = replayed && env_humidity_ch >= 0 ? r.value[env_humidity_ch]
+                                                 : get_simulated_humidity();
+}
+
 /* ----------------------------------------------------------------
  * MQTT event handler
  * ---------------------------------------------------------------- */
@@ -89,7 +259,8 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
     switch (event_id) {
 
     case MQTT_EVENT_CONNECTED:
-        ESP_LOGI(TAG, "MQTT connected to broker");
+        ESP_LOGI(TAG, "MQTT connected to broker %s", conn_manager_current(&broker_conn));
+        conn_manager_report(&broker_conn, true);
         xEventGroupSetBits(mqtt_event_group, MQTT_CONNECTED_BIT);
 
         /* Publish online status */
@@ -102,11 +273,18 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
         /* Also subscribe to own sensor topics to see the echo */
         esp_mqtt_client_subscribe(mqtt_client, "esp32/sensors/#", 0);
         ESP_LOGI(TAG, "Subscribed to esp32/sensors/# (wildcard)");
+
+        /* Config deltas are retained: the broker replays the latest one now */
+        esp_mqtt_client_subscribe(mqtt_client, TOPIC_CONFIG, 1);
+        ESP_LOGI(TAG, "Subscribed to %s", TOPIC_CONFIG);
         break;
 
     case MQTT_EVENT_DISCONNECTED:
+        /* Also sent when a connection attempt fails. Auto-reconnect is
+         * off: the supervisor task picks the delay and the broker. */
         ESP_LOGW(TAG, "MQTT disconnected");
         xEventGroupClearBits(mqtt_event_group, MQTT_CONNECTED_BIT);
+        xEventGroupSetBits(mqtt_event_group, MQTT_RECONNECT_BIT);
         break;
 
     case MQTT_EVENT_SUBSCRIBED:
@@ -124,6 +302,17 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
         ESP_LOGI(TAG, "  Payload: %.*s", event->data_len, event->data);
         ESP_LOGI(TAG, "========================================");
 
+        /* Apply config deltas; fall back to a full fetch if one was missed */
+        if (event->topic_len == strlen(TOPIC_CONFIG) &&
+            strncmp(event->topic, TOPIC_CONFIG, event->topic_len) == 0) {
+            esp_err_t err = device_config_apply_delta(event->data, event->data_len);
+            if (err == ESP_ERR_INVALID_VERSION) {
+                /* Don't block the MQTT task on HTTP: the publisher resyncs */
+                xEventGroupSetBits(mqtt_event_group, CFG_RESYNC_BIT);
+            }
+            break;
+        }
+
         /* React to commands */
         if (event->topic_len > 0 &&
             strncmp(event->topic, TOPIC_COMMANDS, event->topic_len) == 0) {
@@ -131,11 +320,17 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
                 ESP_LOGI(TAG, "Command: toggle_led -> LED toggled (simulated)");
             } else if (strncmp(event->data, "get_status", event->data_len) == 0) {
                 ESP_LOGI(TAG, "Command: get_status -> publishing status");
-                char status_msg[128];
+                /* Status plus the latest profiler snapshot (static: too big
+                 * for the MQTT task's stack) */
+                static char profile[CONFIG_RESOURCE_PROFILER_SNAPSHOT_BYTES];
+                static char status_msg[CONFIG_RESOURCE_PROFILER_SNAPSHOT_BYTES + 64];
+                if (resource_profiler_last(profile, sizeof(profile)) == 0) {
+                    strcpy(profile, "null");
+                }
                 snprintf(status_msg, sizeof(status_msg),
-                         "{\"uptime_s\":%d,\"publish_count\":%d}",
+                         "{\"uptime_s\":%d,\"publish_count\":%d,\"profile\":%s}",
                          (int)(xTaskGetTickCount() / configTICK_RATE_HZ),
-                         publish_count);
+                         publish_count, profile);
                 esp_mqtt_client_publish(mqtt_client, TOPIC_STATUS, status_msg, 0, 0, 0);
             } else {
                 ESP_LOGW(TAG, "Unknown command: %.*s", event->data_len, event->data);
@@ -201,7 +396,7 @@ static esp_eth_handle_t eth_handle = NULL;
 
 static void init_ethernet(void)
 {
-    eth_event_group = xEventGroupCreate();
+    eth_event_group = static_event_group_create(&eth_event_group_def);
 
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
@@ -209,7 +404,9 @@ static void init_ethernet(void)
     esp_netif_config_t netif_cfg = ESP_NETIF_DEFAULT_ETH();
     esp_netif_t *eth_netif = esp_netif_new(&netif_cfg);
 
-    /* OpenCores Ethernet MAC — the virtual NIC provided by QEMU */
+    /* OpenCores Ethernet MAC — the virtual NIC provided by QEMU. Take the
+     * NIC's address so instances sharing a virtual switch differ. */
+    qemu_nic_use_nic_mac();
     eth_mac_config_t mac_config = ETH_MAC_DEFAULT_CONFIG();
     esp_eth_mac_t *mac = esp_eth_mac_new_openeth(&mac_config);
 
@@ -239,11 +436,18 @@ static void init_ethernet(void)
  * ---------------------------------------------------------------- */
 static void init_mqtt(void)
 {
-    mqtt_event_group = xEventGroupCreate();
+    mqtt_event_group = static_event_group_create(&mqtt_event_group_def);
+
+    conn_manager_init(&broker_conn, "mqtt", broker_uris,
+                      sizeof(broker_uris) / sizeof(broker_uris[0]));
+    token_bucket_init(&publish_bucket, PUBLISH_BURST, PUBLISH_REFILL_MS);
 
     esp_mqtt_client_config_t mqtt_cfg = {
-        .broker.address.uri = MQTT_BROKER_URI,
+        .broker.address.uri = conn_manager_select(&broker_conn),
         .credentials.client_id = CLIENT_ID,
+        /* esp-mqtt would retry every 10 s, in step with every other device
+         * that lost the same broker; mqtt_supervisor_task retries instead */
+        .network.disable_auto_reconnect = true,
         /* Last Will Testament: broker publishes this if we disconnect unexpectedly */
         .session.last_will = {
             .topic = TOPIC_STATUS,
@@ -254,12 +458,137 @@ static void init_mqtt(void)
         },
     };
 
+#if CONFIG_TLS_SESSION_ENABLE
+    /* TLS through tls_session's transport instead of esp-mqtt's own, so
+     * reconnects can resume the session (esp-mqtt owns it from here) */
+    tls_session_init(&broker_tls, "mqtt");
+    mqtt_cfg.network.transport = tls_session_transport_new(&broker_tls);
+#endif
+
     mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
     esp_mqtt_client_register_event(mqtt_client, ESP_EVENT_ANY_ID,
                                    mqtt_event_handler, NULL);
     esp_mqtt_client_start(mqtt_client);
 
-    ESP_LOGI(TAG, "MQTT client started, connecting to %s ...", MQTT_BROKER_URI);
+    ESP_LOGI(TAG, "MQTT client started, connecting to %s ...",
+             conn_manager_current(&broker_conn));
+}
+
+/* ----------------------------------------------------------------
+ * Reconnect supervisor
+ * After a disconnect or failed attempt: wait a jittered, rate-limited
+ * delay, then reconnect to the healthiest broker. A fleet that lost the
+ * same broker comes back spread over the backoff window instead of all
+ * at once.
+ * ---------------------------------------------------------------- */
+static void mqtt_supervisor_task(void *pvParameters)
+{
+    while (1) {
+        xEventGroupWaitBits(mqtt_event_group, MQTT_RECONNECT_BIT,
+                            pdTRUE, pdTRUE, portMAX_DELAY);
+        conn_manager_report(&broker_conn, false);
+
+        uint32_t delay_ms = conn_manager_next_delay_ms(&broker_conn);
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
+
+        const char *uri = conn_manager_select(&broker_conn);
+        ESP_LOGI(TAG, "Reconnecting to %s", uri);
+        esp_mqtt_client_set_uri(mqtt_client, uri);
+        esp_err_t err = esp_mqtt_client_reconnect(mqtt_client);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Reconnect not started: %s", esp_err_to_name(err));
+        }
+    }
+}
+
+#if CONFIG_TLS_SESSION_ENABLE
+/* ----------------------------------------------------------------
+ * Resumption probe: a few handshake-only connections to the broker, so
+ * the log shows resumed handshakes next to the full one of the first
+ * connect even when the connection never dropped
+ * ---------------------------------------------------------------- */
+static void tls_probe_task(void *pvParameters)
+{
+    tls_session_probe(&broker_tls, conn_manager_current(&broker_conn),
+                      CONFIG_TLS_SESSION_PROBES);
+    tls_session_log(&broker_tls);
+    static_task_exit(&tls_probe_def);
+}
+#endif
+
+/* ----------------------------------------------------------------
+ * Firmware update check, once the broker connection is up: an updated
+ * image that got this far keeps its slot, then a newer release is
+ * fetched as a patch (applying one restarts into it)
+ * ---------------------------------------------------------------- */
+static void ota_task(void *pvParameters)
+{
+    delta_ota_confirm();
+
+    char url[128];
+    snprintf(url, sizeof(url), "%s%s", API_OTA_URL,
+             esp_app_get_description()->project_name);
+    delta_ota_update(url);
+    static_task_exit(&ota_def);
+}
+
+/* ----------------------------------------------------------------
+ * Profiler sink: publish each snapshot as telemetry (QoS 0, fire and forget)
+ * ---------------------------------------------------------------- */
+static void publish_profile(const char *json, size_t len, void *ctx)
+{
+    if ((xEventGroupGetBits(mqtt_event_group) & MQTT_CONNECTED_BIT) &&
+        token_bucket_take(&publish_bucket, 1)) {
+        esp_mqtt_client_publish(mqtt_client, TOPIC_TELEMETRY, json, len, 0, 0);
+    }
+}
+
+/* ----------------------------------------------------------------
+ * Outbound queue
+ * ---------------------------------------------------------------- */
+
+/* Format a message in a pool block and pass it to mqtt_tx_task */
+static bool mqtt_enqueue(const char *topic, int qos, int retain, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static bool mqtt_enqueue(const char *topic, int qos, int retain, const char *fmt, ...)
+{
+    msg_t *m = msg_alloc(&tx_pool);
+    if (m == NULL) {
+        return false;
+    }
+    va_list args;
+    va_start(args, fmt);
+    int len = msg_vprintf(m, fmt, args);
+    va_end(args);
+    if (len < 0) {
+        msg_free(m);
+        return false;
+    }
+    m->topic = topic;
+    m->qos = qos;
+    m->retain = retain;
+    xQueueSend(tx_queue, &m, 0);   /* mqtt_tx_task owns it from here */
+    return true;
+}
+
+/* esp-mqtt writes QoS 0 messages straight into its send buffer. QoS 1
+ * messages are also copied into its outbox until the PUBACK arrives;
+ * that copy is esp-mqtt's, for retransmission. Readings get their publish
+ * time here, so the time spent queued counts as sample->publish. */
+static void mqtt_tx_task(void *pvParameters)
+{
+    msg_t *m;
+    while (1) {
+        xQueueReceive(tx_queue, &m, portMAX_DELAY);
+        if (strncmp(m->topic, TOPIC_SENSORS_PREFIX, sizeof(TOPIC_SENSORS_PREFIX) - 1) == 0) {
+            m->len = latency_trace_stamp_publish(m->data, m->len, msg_capacity(m));
+        }
+        int msg_id = esp_mqtt_client_publish(mqtt_client, m->topic, m->data,
+                                             m->len, m->qos, m->retain);
+        ESP_LOGI(TAG, "Sent %s (%u bytes, msg_id=%d)", m->topic, m->len, msg_id);
+        msg_free(m);
+    }
 }
 
 /* ----------------------------------------------------------------
@@ -271,14 +600,47 @@ static void sensor_publish_task(void *pvParameters)
     xEventGroupWaitBits(mqtt_event_group, MQTT_CONNECTED_BIT,
                         pdFALSE, pdTRUE, portMAX_DELAY);
 
+    /* Timestamps need the synced clock (normally set by now) */
+    latency_trace_wait_sync(CONFIG_LATENCY_TRACE_SYNC_TIMEOUT_MS);
+
+    /* The interval comes from the device config and may change while
+     * running (PATCH /api/config on the server pushes a delta) */
+    device_config_t cfg;
+    device_config_get(&cfg);
+
     ESP_LOGI(TAG, "========================================");
     ESP_LOGI(TAG, "Starting sensor publish loop");
     ESP_LOGI(TAG, "  Publishing to: %s, %s", TOPIC_TEMPERATURE, TOPIC_HUMIDITY);
-    ESP_LOGI(TAG, "  Interval: 5 seconds");
+    ESP_LOGI(TAG, "  Interval: %u ms (config v%u), down to %u ms while changing",
+             (unsigned)cfg.sample_interval_ms, (unsigned)cfg.version,
+             (unsigned)(cfg.sample_interval_ms / SAMPLE_MIN_DIVISOR));
     ESP_LOGI(TAG, "  Total readings: 10");
     ESP_LOGI(TAG, "========================================");
 
+    /* Measure how regular the sampling period stays while esp-mqtt and
+     * lwIP are busy sending on the other core */
+    task_jitter_t jitter;
+    task_jitter_init(&jitter, "sensor_pub", cfg.sample_interval_ms * 1000LL);
+
+    adaptive_budget_init(&radio_budget, "radio_bytes", SENSOR_RADIO_BPS);
+    adaptive_rate_config_t rate_cfg = {
+        .name = "sensor_pub",
+        .min_period_ms = cfg.sample_interval_ms / SAMPLE_MIN_DIVISOR,
+        .max_period_ms = cfg.sample_interval_ms,
+        .start_period_ms = cfg.sample_interval_ms,
+        .change_per_s = TEMP_CHANGE_C_PER_S,
+        .stddev = TEMP_NOISE_C,
+        .cost = SENSOR_READING_BYTES,
+        .budget = &radio_budget,
+    };
+    adaptive_rate_init(&sample_rate, &rate_cfg);
+    int64_t start_us = esp_timer_get_time();
+    TickType_t last_wake = xTaskGetTickCount();
+
     for (int i = 0; i < 10; i++) {
+        task_jitter_record(&jitter);
+        uint32_t period_ms = adaptive_rate_period_ms(&sample_rate);
+
         /* Check if still connected */
         EventBits_t bits = xEventGroupGetBits(mqtt_event_group);
         if (!(bits & MQTT_CONNECTED_BIT)) {
@@ -287,41 +649,89 @@ static void sensor_publish_task(void *pvParameters)
                                 pdFALSE, pdTRUE, pdMS_TO_TICKS(30000));
         }
 
-        float temp = get_simulated_temperature();
-        float humidity = get_simulated_humidity();
-
-        /* Publish temperature as JSON */
-        char temp_msg[128];
-        snprintf(temp_msg, sizeof(temp_msg),
-                 "{\"device\":\"%s\",\"value\":%.1f,\"unit\":\"C\",\"reading\":%d}",
-                 CLIENT_ID, temp, i + 1);
+        float temp, humidity;
+        read_sensors(&temp, &humidity);
+
+        if (cfg.temperature_enabled && !token_bucket_take(&publish_bucket, 1)) {
+            ESP_LOGW(TAG, "[%d/10] Publish rate limit, temperature skipped", i + 1);
+        } else if (cfg.temperature_enabled) {
+            period_ms = adaptive_rate_update(&sample_rate, temp);
+            latency_trace_t trace;
+            latency_trace_begin(&trace);
+
+            /* Publish temperature as JSON */
+            if (mqtt_enqueue(TOPIC_TEMPERATURE, 1, 0,
+                             "{\"device\":\"%s\",\"value\":%.1f,\"unit\":\"C\",\"reading\":%d,"
+                             "\"period_ms\":%lu," LATENCY_TRACE_JSON_FMT "}",
+                             CLIENT_ID, temp, i + 1, (unsigned long)period_ms,
+                             LATENCY_TRACE_JSON_ARGS(&trace))) {
+                ESP_LOGI(TAG, "[%d/10] Queued temperature=%.1f C", i + 1, temp);
+                publish_count++;
+            } else {
+                ESP_LOGW(TAG, "[%d/10] No message buffer, temperature dropped", i + 1);
+            }
+        }
 
-        int msg_id = esp_mqtt_client_publish(mqtt_client, TOPIC_TEMPERATURE,
-                                             temp_msg, 0, 1, 0);
-        ESP_LOGI(TAG, "[%d/10] Published temperature=%.1f C (msg_id=%d)",
-                 i + 1, temp, msg_id);
+        if (cfg.humidity_enabled && !token_bucket_take(&publish_bucket, 1)) {
+            ESP_LOGW(TAG, "[%d/10] Publish rate limit, humidity skipped", i + 1);
+        } else if (cfg.humidity_enabled) {
+            latency_trace_t trace;
+            latency_trace_begin(&trace);
+
+            /* Publish humidity as JSON */
+            if (mqtt_enqueue(TOPIC_HUMIDITY, 1, 0,
+                             "{\"device\":\"%s\",\"value\":%.1f,\"unit\":\"%%\",\"reading\":%d,"
+                             LATENCY_TRACE_JSON_FMT "}",
+                             CLIENT_ID, humidity, i + 1, LATENCY_TRACE_JSON_ARGS(&trace))) {
+                ESP_LOGI(TAG, "[%d/10] Queued humidity=%.1f %%", i + 1, humidity);
+                publish_count++;
+            } else {
+                ESP_LOGW(TAG, "[%d/10] No message buffer, humidity dropped", i + 1);
+            }
+        }
 
-        /* Publish humidity as JSON */
-        char hum_msg[128];
-        snprintf(hum_msg, sizeof(hum_msg),
-                 "{\"device\":\"%s\",\"value\":%.1f,\"unit\":\"%%\",\"reading\":%d}",
-                 CLIENT_ID, humidity, i + 1);
+        /* Missed a delta: fetch the full document (conditional GET) */
+        if (xEventGroupClearBits(mqtt_event_group, CFG_RESYNC_BIT) & CFG_RESYNC_BIT) {
+            device_config_fetch(API_CONFIG_URL);
+        }
 
-        msg_id = esp_mqtt_client_publish(mqtt_client, TOPIC_HUMIDITY,
-                                         hum_msg, 0, 1, 0);
-        ESP_LOGI(TAG, "[%d/10] Published humidity=%.1f %% (msg_id=%d)",
-                 i + 1, humidity, msg_id);
+        /* Pick up a new interval for the next period */
+        uint32_t prev_interval = cfg.sample_interval_ms;
+        device_config_get(&cfg);
+        if (cfg.sample_interval_ms != prev_interval) {
+            ESP_LOGI(TAG, "Interval changed: %u -> %u ms",
+                     (unsigned)prev_interval, (unsigned)cfg.sample_interval_ms);
+            adaptive_rate_set_bounds(&sample_rate,
+                                     cfg.sample_interval_ms / SAMPLE_MIN_DIVISOR,
+                                     cfg.sample_interval_ms);
+            period_ms = adaptive_rate_period_ms(&sample_rate);
+        }
+        jitter.period_us = period_ms * 1000LL;
 
-        publish_count += 2;
+        /* Delay until the next period boundary so time spent publishing
+         * does not stretch the sampling interval */
+        xTaskDelayUntil(&last_wake, pdMS_TO_TICKS(period_ms));
+    }
 
-        vTaskDelay(pdMS_TO_TICKS(5000));
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    task_jitter_log(&jitter);
+    adaptive_rate_log(&sample_rate);
+    adaptive_budget_log(&radio_budget);
+    if (env_temp_ch >= 0) {
+        sensor_replay_log(&env_trace);
     }
+    conn_manager_log(&broker_conn);
+    msg_pool_log(&tx_pool);
+#if CONFIG_TLS_SESSION_ENABLE
+    static_task_create(&tls_probe_def, tls_probe_task, NULL, 4, TASK_ROLE_NETWORK);
+#endif
+    printf("THROUGHPUT sensor_pub msgs=%d elapsed_ms=%lld msgs_per_s=%.2f\n",
+           publish_count, elapsed_us / 1000,
+           publish_count * 1e6 / (double)elapsed_us);
 
     /* Publish final status */
-    char final_msg[128];
-    snprintf(final_msg, sizeof(final_msg),
-             "{\"status\":\"complete\",\"total_published\":%d}", publish_count);
-    esp_mqtt_client_publish(mqtt_client, TOPIC_STATUS, final_msg, 0, 1, 0);
+    mqtt_enqueue(TOPIC_STATUS, 1, 0,
+                 "{\"status\":\"complete\",\"total_published\":%d}", publish_count);
 
     printf("\n");
     printf("==========================================\n");
@@ -330,7 +740,7 @@ static void sensor_publish_task(void *pvParameters)
     printf("  Press Ctrl+A then X to exit QEMU\n");
     printf("==========================================\n");
 
-    vTaskDelete(NULL);
+    static_task_exit(&sensor_pub_def);
 }
 
 /* ----------------------------------------------------------------
@@ -343,6 +753,21 @@ void app_main(void)
     printf("  ESP32 MQTT Pub/Sub Demo (QEMU)\n");
     printf("  IoT Course - Spring 2026\n");
     printf("==========================================\n\n");
+    static_alloc_log_memory("boot");
+    delta_ota_log_boot();
+
+    /* Step 0: Cached config from NVS, so the interval is known before the
+     * broker replays the retained delta */
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
+    device_config_init();
+    device_config_set_ca_cert(tls_session_ca_pem());
+    delta_ota_set_ca_cert(tls_session_ca_pem());
+    sensors_init();
 
     /* Step 1: Initialize Ethernet and wait for IP */
     init_ethernet();
@@ -358,6 +783,7 @@ void app_main(void)
     }
 
     vTaskDelay(pdMS_TO_TICKS(2000));
+    latency_trace_start_sync();
 
     /* Step 2: Initialize MQTT and connect to broker */
     ESP_LOGI(TAG, "========================================");
@@ -367,9 +793,16 @@ void app_main(void)
     ESP_LOGI(TAG, "  LWT topic: %s", TOPIC_STATUS);
     ESP_LOGI(TAG, "========================================");
 
+    msg_pool_init(&tx_pool);
+    tx_queue = static_queue_create(&tx_queue_def);
+
     init_mqtt();
+    static_task_create(&mqtt_tx_def, mqtt_tx_task, NULL, 5, TASK_ROLE_NETWORK);
+    static_task_create(&mqtt_supervisor_def, mqtt_supervisor_task, NULL, 6,
+                       TASK_ROLE_NETWORK);
 
-    /* Wait for MQTT connection */
+    /* Wait for MQTT connection (the supervisor keeps retrying after this;
+     * the publisher starts once it succeeds) */
     bits = xEventGroupWaitBits(mqtt_event_group,
                                MQTT_CONNECTED_BIT,
                                pdFALSE, pdTRUE,
@@ -377,16 +810,31 @@ void app_main(void)
     if (!(bits & MQTT_CONNECTED_BIT)) {
         ESP_LOGE(TAG, "Failed to connect to MQTT broker within 30 seconds!");
         ESP_LOGW(TAG, "Check that Mosquitto is running: docker compose up -d mqtt-broker");
-        return;
+    } else {
+        static_task_create(&ota_def, ota_task, NULL, 4, TASK_ROLE_NETWORK);
     }
 
-    /* Step 3: Launch sensor publishing task */
-    xTaskCreate(sensor_publish_task, "sensor_pub", 4096, NULL, 5, NULL);
+    /* Step 3: Launch sensor publishing task on the sensing core.
+     * The esp-mqtt and lwIP tasks are pinned to PRO_CPU in sdkconfig.defaults */
+    task_placement_log_config();
+    static_task_create(&sensor_pub_def, sensor_publish_task, NULL, 5, TASK_ROLE_SENSING);
+
+    /* Heap left once Ethernet, lwIP and esp-mqtt are up (those still
+     * allocate internally), then per-task stack use once publishing */
+    static_alloc_log_memory("init");
+    static_alloc_report_stacks_later();
+
+    /* Step 4: Periodic CPU/stack/heap snapshots on esp32/telemetry */
+    resource_profiler_start(publish_profile, NULL);
 
     ESP_LOGI(TAG, "========================================");
     ESP_LOGI(TAG, "MQTT demo running.");
     ESP_LOGI(TAG, "To send a command from your host:");
     ESP_LOGI(TAG, "  mosquitto_pub -h localhost -t esp32/commands -m toggle_led");
     ESP_LOGI(TAG, "  mosquitto_pub -h localhost -t esp32/commands -m get_status");
+    ESP_LOGI(TAG, "  mosquitto_sub -h localhost -t esp32/telemetry");
+    ESP_LOGI(TAG, "To change the publish interval at run time:");
+    ESP_LOGI(TAG, "  curl -X PATCH -H 'Content-Type: application/json' \\");
+    ESP_LOGI(TAG, "       -d '{\"sample_interval_ms\":2000}' localhost:5000/api/config");
     ESP_LOGI(TAG, "========================================");
 }
@@ -0,0 +1,588 @@
+/**
+ * Firmware Microbenchmarks for ESP32 QEMU
+ * IoT Course - Spring 2026
+ *
+ * Times the building blocks the other examples rely on, with the CPU cycle
+ * counter (see components/microbench):
+ * - Payload formatting: snprintf with %f (03/04) vs fixed-point, a
+ *   hand-written formatter and cJSON
+ * - Queue send/receive of a timer_event_t, as timer_queue in 02
+ * - Event-group polling and round trips, as MQTT_CONNECTED_BIT in 04
+ * - esp_random()-based sensor simulation, float vs integer, and the same
+ *   reading replayed from a flashed trace (components/sensor_replay)
+ * - Sample blocks (components/sample_block): per-row push cost vs
+ *   formatting each reading, and encoding a block into an upload frame
+ * - One accelerometer block through components/accel_dsp: naive float
+ *   loops vs the Q15 fixed-point kernels (cycles per block)
+ * - Continuous ADC (components/adc_stream): 5 s of 20 kHz conversions
+ *   delivered as sample blocks, one wake-up per frame; the ADC_STREAM line
+ *   has the sustained samples/s and the stream task's CPU share
+ *
+ * With a trace pack in flash (SENSOR_TRACE=traces/sensors.bin scripts/bench.sh)
+ * the DSP block is the first block of the recorded "accel" trace, so its
+ * features are identical on every run; without one it is a sine model with
+ * esp_random() noise, and replay_step is not run.
+ *
+ * Every result is a "BENCH {...}" line; "BENCH_DONE" ends the run.
+ * Compare a run against the stored baseline with scripts/bench.sh.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+#include "esp_random.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "hal/adc_types.h"
+#include "cJSON.h"
+
+#include "microbench.h"
+#include "sample_block.h"
+#include "accel_dsp.h"
+#include "sensor_replay.h"
+#include "adc_stream.h"
+
+static const char *TAG = "bench";
+
+#define DEVICE_ID "esp32-qemu-01"
+
+/* The benchmark task runs on APP_CPU; peers run on the same or other core */
+#define BENCH_CORE  1
+#define OTHER_CORE  0
+#define BENCH_PRIO  5
+
+/* Results land here so the compiler cannot drop the work */
+static char payload[128];
+static volatile uint32_t sink;
+
+/* ----------------------------------------------------------------
+ * Payload formatting
+ * The same JSON as 04-mqtt publishes:
+ *   {"device":"esp32-qemu-01","value":23.4,"unit":"C","reading":7}
+ * ---------------------------------------------------------------- */
+static void bench_loop_overhead(void *arg, uint32_t iters)
+{
+    for (uint32_t i = 0; i < iters; i++) {
+        sink = i;
+    }
+}
+
+static void bench_fmt_snprintf_float(void *arg, uint32_t iters)
+{
+    float value = 23.4f;
+    for (uint32_t i = 0; i < iters; i++) {
+        snprintf(payload, sizeof(payload),
+                 "{\"device\":\"%s\",\"value\":%.1f,\"unit\":\"C\",\"reading\":%d}",
+                 DEVICE_ID, value, (int)i);
+    }
+}
+
+/* Same output from an integer in tenths: no float formatting in newlib */
+static void bench_fmt_snprintf_fixed(void *arg, uint32_t iters)
+{
+    int tenths = 234;
+    for (uint32_t i = 0; i < iters; i++) {
+        snprintf(payload, sizeof(payload),
+                 "{\"device\":\"%s\",\"value\":%d.%d,\"unit\":\"C\",\"reading\":%d}",
+                 DEVICE_ID, tenths / 10, tenths % 10, (int)i);
+    }
+}
+
+static char *append_str(char *p, const char *s, size_t len)
+{
+    memcpy(p, s, len);
+    return p + len;
+}
+
+static char *append_uint(char *p, uint32_t v)
+{
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    while (n) {
+        *p++ = digits[--n];
+    }
+    return p;
+}
+
+#define APPEND_LIT(p, lit) append_str((p), (lit), sizeof(lit) - 1)
+
+/* Hand-written formatter: constant parts copied, numbers converted inline */
+static void bench_fmt_manual(void *arg, uint32_t iters)
+{
+    uint32_t tenths = 234;
+    for (uint32_t i = 0; i < iters; i++) {
+        char *p = payload;
+        p = APPEND_LIT(p, "{\"device\":\"" DEVICE_ID "\",\"value\":");
+        p = append_uint(p, tenths / 10);
+        *p++ = '.';
+        *p++ = '0' + tenths % 10;
+        p = APPEND_LIT(p, ",\"unit\":\"C\",\"reading\":");
+        p = append_uint(p, i);
+        *p++ = '}';
+        *p = '\0';
+    }
+}
+
+/* cJSON, as in components/device_config: builds a tree on the heap */
+static void bench_fmt_cjson(void *arg, uint32_t iters)
+{
+    for (uint32_t i = 0; i < iters; i++) {
+        cJSON *root = cJSON_CreateObject();
+        cJSON_AddStringToObject(root, "device", DEVICE_ID);
+        cJSON_AddNumberToObject(root, "value", 23.4);
+        cJSON_AddStringToObject(root, "unit", "C");
+        cJSON_AddNumberToObject(root, "reading", i);
+        cJSON_PrintPreallocated(root, payload, sizeof(payload), false);
+        cJSON_Delete(root);
+    }
+}
+
+/* ----------------------------------------------------------------
+ * Queues: the timer_event_t that 02-gpio-timer passes ISR -> task
+ * ---------------------------------------------------------------- */
+typedef struct {
+    uint64_t timer_count;
+    int64_t isr_time_us;
+} timer_event_t;
+
+typedef struct {
+    QueueHandle_t request;
+    QueueHandle_t response;
+} queue_pair_t;
+
+/* Send and receive in the same task: the cost of the queue itself */
+static void bench_queue_local(void *arg, uint32_t iters)
+{
+    QueueHandle_t q = ((queue_pair_t *)arg)->request;
+    timer_event_t evt = { 0 };
+    for (uint32_t i = 0; i < iters; i++) {
+        evt.timer_count = i;
+        xQueueSend(q, &evt, 0);
+        xQueueReceive(q, &evt, 0);
+    }
+    sink = (uint32_t)evt.timer_count;
+}
+
+static void queue_echo_task(void *arg)
+{
+    queue_pair_t *pair = arg;
+    timer_event_t evt;
+    while (1) {
+        xQueueReceive(pair->request, &evt, portMAX_DELAY);
+        xQueueSend(pair->response, &evt, portMAX_DELAY);
+    }
+}
+
+/* Send to a blocked task and wait for its reply: two context switches */
+static void bench_queue_pingpong(void *arg, uint32_t iters)
+{
+    queue_pair_t *pair = arg;
+    timer_event_t evt = { 0 };
+    for (uint32_t i = 0; i < iters; i++) {
+        evt.timer_count = i;
+        xQueueSend(pair->request, &evt, portMAX_DELAY);
+        xQueueReceive(pair->response, &evt, portMAX_DELAY);
+    }
+    sink = (uint32_t)evt.timer_count;
+}
+
+/* ----------------------------------------------------------------
+ * Event groups: MQTT_CONNECTED_BIT checks and handshakes in 04-mqtt
+ * ---------------------------------------------------------------- */
+#define REQUEST_BIT BIT0
+#define ACK_BIT     BIT1
+
+static void bench_event_get_bits(void *arg, uint32_t iters)
+{
+    EventGroupHandle_t eg = arg;
+    uint32_t connected = 0;
+    for (uint32_t i = 0; i < iters; i++) {
+        connected += (xEventGroupGetBits(eg) & REQUEST_BIT) ? 1 : 0;
+    }
+    sink = connected;
+}
+
+static void event_responder_task(void *arg)
+{
+    EventGroupHandle_t eg = arg;
+    while (1) {
+        xEventGroupWaitBits(eg, REQUEST_BIT, pdTRUE, pdTRUE, portMAX_DELAY);
+        xEventGroupSetBits(eg, ACK_BIT);
+    }
+}
+
+/* Set a bit another task waits on, then wait for its acknowledgement */
+static void bench_event_roundtrip(void *arg, uint32_t iters)
+{
+    EventGroupHandle_t eg = arg;
+    for (uint32_t i = 0; i < iters; i++) {
+        xEventGroupSetBits(eg, REQUEST_BIT);
+        xEventGroupWaitBits(eg, ACK_BIT, pdTRUE, pdTRUE, portMAX_DELAY);
+    }
+}
+
+/* ----------------------------------------------------------------
+ * Sensor simulation
+ * ---------------------------------------------------------------- */
+static void bench_esp_random(void *arg, uint32_t iters)
+{
+    uint32_t acc = 0;
+    for (uint32_t i = 0; i < iters; i++) {
+        acc ^= esp_random();
+    }
+    sink = acc;
+}
+
+/* get_simulated_temperature() as in 03/04 */
+static void bench_sim_temp_float(void *arg, uint32_t iters)
+{
+    float acc = 0;
+    for (uint32_t i = 0; i < iters; i++) {
+        acc += 20.0f + (float)(esp_random() % 100) / 10.0f;
+    }
+    sink = (uint32_t)acc;
+}
+
+/* The same reading in integer tenths of a degree */
+static void bench_sim_temp_fixed(void *arg, uint32_t iters)
+{
+    uint32_t acc = 0;
+    for (uint32_t i = 0; i < iters; i++) {
+        acc += 200 + esp_random() % 100;
+    }
+    sink = acc;
+}
+
+/* A recorded temperature instead: the next record of the "env" trace */
+static void bench_replay_step(void *arg, uint32_t iters)
+{
+    sensor_replay_t *trace = arg;
+    sensor_reading_t r;
+    float acc = 0;
+    for (uint32_t i = 0; i < iters; i++) {
+        sensor_replay_next(trace, &r);
+        acc += r.value[0];
+    }
+    sink = (uint32_t)acc;
+}
+
+/* ----------------------------------------------------------------
+ * Accelerometer DSP: one block, as espidf_multi_sensor processes it
+ * (slides/examples). One iteration = one block of ACCEL_DSP_N samples.
+ * ---------------------------------------------------------------- */
+static sample_block_t dsp_block;
+static uint8_t frame[SAMPLE_FRAME_HEADER_BYTES + ACCEL_DSP_N * (4 + ACCEL_AXES * 2)];
+static accel_dsp_t dsp_state;
+static accel_features_t dsp_features;
+static char dsp_json[192];
+
+/* 100 Hz: the recorded "accel" trace if there is one, else gravity on Z,
+ * 12 Hz on X, 31 Hz on Y and a little noise */
+static void fill_dsp_block(void)
+{
+    dsp_block.channels = ACCEL_AXES;
+    dsp_block.sample_rate_hz = 100;
+    sample_block_clear(&dsp_block);
+
+    sensor_replay_t trace;
+    if (sensor_replay_open(&trace, "accel", SENSOR_REPLAY_STEP, 0) == ESP_OK &&
+        trace.channels == ACCEL_AXES) {
+        sensor_reading_t r;
+        for (int n = 0; n < ACCEL_DSP_N && sensor_replay_next(&trace, &r) == ESP_OK; n++) {
+            sample_block_push(&dsp_block, r.t_us, r.raw);
+        }
+        sensor_replay_log(&trace);
+        sensor_replay_close(&trace);
+        return;
+    }
+    for (int n = 0; n < ACCEL_DSP_N; n++) {
+        float t = (float)n / 100.0f;
+        int noise = (int)(esp_random() % 21) - 10;
+        int16_t xyz[ACCEL_AXES] = {
+            (int16_t)(150.0f * sinf(2.0f * (float)M_PI * 12.0f * t) + noise),
+            (int16_t)(60.0f * sinf(2.0f * (float)M_PI * 31.0f * t) - noise),
+            (int16_t)(1000 + noise),
+        };
+        sample_block_push(&dsp_block, n * 10000LL, xyz);
+    }
+}
+
+/* One row into a block, as the sampling task does per reading */
+static void bench_block_push(void *arg, uint32_t iters)
+{
+    static sample_block_t block = { .channels = ACCEL_AXES };
+    int16_t xyz[ACCEL_AXES] = { 12, -7, 1000 };
+    for (uint32_t i = 0; i < iters; i++) {
+        if (sample_block_full(&block)) {
+            sample_block_clear(&block);
+        }
+        sample_block_push(&block, i * 10000LL, xyz);
+    }
+    sink = block.count;
+}
+
+/* What the examples did per reading before: format it as text */
+static void bench_row_snprintf(void *arg, uint32_t iters)
+{
+    for (uint32_t i = 0; i < iters; i++) {
+        snprintf(payload, sizeof(payload), "X=%d, Y=%d, Z=%d", 12, -7, 1000);
+    }
+}
+
+/* A whole block into one binary upload frame */
+static void bench_block_encode(void *arg, uint32_t iters)
+{
+    size_t len = 0;
+    for (uint32_t i = 0; i < iters; i++) {
+        len = sample_block_encode(&dsp_block, frame, sizeof(frame));
+    }
+    sink = len;
+}
+
+static void bench_dsp_block_float(void *arg, uint32_t iters)
+{
+    for (uint32_t i = 0; i < iters; i++) {
+        accel_dsp_process_float(&dsp_state, &dsp_block, &dsp_features);
+    }
+    sink = dsp_features.dominant_mg;
+}
+
+static void bench_dsp_block_q15(void *arg, uint32_t iters)
+{
+    for (uint32_t i = 0; i < iters; i++) {
+        accel_dsp_process(&dsp_state, &dsp_block, &dsp_features);
+    }
+    sink = dsp_features.dominant_mg;
+}
+
+/* Q15 against the float reference: amplitudes within 5% (at least 8 mg),
+ * the dominant frequency within one FFT bin, band shares within 2%.
+ * Prints a DSP_MISMATCH line per feature outside that, returns the count. */
+static int dsp_check_one(const char *name, int axis, int ref, int q15, int tol)
+{
+    if (abs(q15 - ref) <= tol) {
+        return 0;
+    }
+    printf("DSP_MISMATCH feature=%s axis=%d float=%d q15=%d tol=%d\n",
+           name, axis, ref, q15, tol);
+    return 1;
+}
+
+static int mg_tol(int ref)
+{
+    int pct = abs(ref) / 20;
+    return pct > 8 ? pct : 8;
+}
+
+static int dsp_compare(const accel_features_t *ref, const accel_features_t *q)
+{
+    int bad = 0;
+    for (int a = 0; a < ACCEL_AXES; a++) {
+        bad += dsp_check_one("gravity_mg", a, ref->gravity_mg[a], q->gravity_mg[a],
+                             mg_tol(ref->gravity_mg[a]));
+        bad += dsp_check_one("rms_mg", a, ref->rms_mg[a], q->rms_mg[a], mg_tol(ref->rms_mg[a]));
+        bad += dsp_check_one("peak_mg", a, ref->peak_mg[a], q->peak_mg[a], mg_tol(ref->peak_mg[a]));
+    }
+    bad += dsp_check_one("dominant_hz_x10", -1, ref->dominant_hz_x10, q->dominant_hz_x10,
+                         dsp_block.sample_rate_hz * 10 / ACCEL_DSP_N);
+    bad += dsp_check_one("dominant_mg", -1, ref->dominant_mg, q->dominant_mg,
+                         mg_tol(ref->dominant_mg));
+    for (int b = 0; b < ACCEL_DSP_BANDS; b++) {
+        bad += dsp_check_one("band_permille", b, ref->band_permille[b], q->band_permille[b], 20);
+    }
+    return bad;
+}
+
+/* ----------------------------------------------------------------
+ * Continuous ADC: sustained rate, not cycles per call. The consumer
+ * averages each block, about what a filter stage costs per sample.
+ * ---------------------------------------------------------------- */
+#define ADC_RATE_HZ  20000
+#define ADC_RUN_S    5
+
+static sample_block_t adc_blocks[4];
+static sample_pipe_t adc_pipe;
+
+static void stream_adc(void)
+{
+    static const uint8_t channels[] = { ADC_CHANNEL_6 };
+    adc_stream_config_t cfg = {
+        .channels = channels,
+        .num_channels = 1,
+        .sample_rate_hz = ADC_RATE_HZ,
+        .atten = ADC_ATTEN_DB_11,
+    };
+    if (sample_pipe_init(&adc_pipe, "adc", adc_blocks, 4, 0, 1, ADC_RATE_HZ) != ESP_OK ||
+        adc_stream_init(&cfg, &adc_pipe) != ESP_OK) {
+        return;
+    }
+    adc_stream_emulate_level(0, 2048);
+
+    int32_t mean = 0;
+    int64_t end = esp_timer_get_time() + ADC_RUN_S * 1000000LL;
+    adc_stream_start();
+    while (esp_timer_get_time() < end) {
+        sample_block_t *b = sample_pipe_receive(&adc_pipe, pdMS_TO_TICKS(100));
+        if (b == NULL) {
+            continue;
+        }
+        int32_t acc = 0;
+        for (int i = 0; i < b->count; i++) {
+            acc += b->data[0][i];
+        }
+        mean = acc / b->count;
+        sample_block_release(b);
+    }
+    adc_stream_stop();
+
+    adc_stream_log();
+    sample_pipe_log(&adc_pipe);
+    ESP_LOGI(TAG, "ADC mean of the last block: %ld", (long)mean);
+}
+
+/* ----------------------------------------------------------------
+ * Suite
+ * ---------------------------------------------------------------- */
+static queue_pair_t *make_queue_echo(const char *name, int core)
+{
+    static queue_pair_t pairs[2];
+    static int used = 0;
+    queue_pair_t *pair = &pairs[used++];
+    pair->request = xQueueCreate(1, sizeof(timer_event_t));
+    pair->response = xQueueCreate(1, sizeof(timer_event_t));
+    xTaskCreatePinnedToCore(queue_echo_task, name, 2048, pair, BENCH_PRIO + 1, NULL, core);
+    return pair;
+}
+
+static EventGroupHandle_t make_event_responder(const char *name, int core)
+{
+    EventGroupHandle_t eg = xEventGroupCreate();
+    xTaskCreatePinnedToCore(event_responder_task, name, 2048, eg, BENCH_PRIO + 1, NULL, core);
+    return eg;
+}
+
+/* Short pause between benchmarks so IDLE1 can run and logs can drain */
+static void settle(void)
+{
+    vTaskDelay(pdMS_TO_TICKS(20));
+}
+
+static void bench_task(void *arg)
+{
+    queue_pair_t local = { .request = xQueueCreate(1, sizeof(timer_event_t)) };
+    queue_pair_t *echo_same = make_queue_echo("echo_same", BENCH_CORE);
+    queue_pair_t *echo_cross = make_queue_echo("echo_cross", OTHER_CORE);
+    EventGroupHandle_t eg_poll = xEventGroupCreate();
+    EventGroupHandle_t eg_same = make_event_responder("evt_same", BENCH_CORE);
+    EventGroupHandle_t eg_cross = make_event_responder("evt_cross", OTHER_CORE);
+    settle();
+
+    ESP_LOGI(TAG, "Running on core %d", xPortGetCoreID());
+
+    bench_run("loop_overhead", bench_loop_overhead, NULL, 1000, NULL);
+    settle();
+
+    bench_run("fmt_snprintf_float", bench_fmt_snprintf_float, NULL, 200, NULL);
+    settle();
+    bench_run("fmt_snprintf_fixed", bench_fmt_snprintf_fixed, NULL, 200, NULL);
+    settle();
+    bench_run("fmt_manual", bench_fmt_manual, NULL, 200, NULL);
+    settle();
+    bench_run("fmt_cjson", bench_fmt_cjson, NULL, 200, NULL);
+    settle();
+    ESP_LOGI(TAG, "Payload: %s", payload);
+
+    bench_run("queue_local", bench_queue_local, &local, 500, NULL);
+    settle();
+    bench_run("queue_pingpong_same_core", bench_queue_pingpong, echo_same, 200, NULL);
+    settle();
+    bench_run("queue_pingpong_cross_core", bench_queue_pingpong, echo_cross, 200, NULL);
+    settle();
+
+    bench_run("event_get_bits", bench_event_get_bits, eg_poll, 1000, NULL);
+    settle();
+    bench_run("event_roundtrip_same_core", bench_event_roundtrip, eg_same, 200, NULL);
+    settle();
+    bench_run("event_roundtrip_cross_core", bench_event_roundtrip, eg_cross, 200, NULL);
+    settle();
+
+    bench_run("esp_random", bench_esp_random, NULL, 1000, NULL);
+    settle();
+    bench_run("sim_temp_float", bench_sim_temp_float, NULL, 1000, NULL);
+    settle();
+    bench_run("sim_temp_fixed", bench_sim_temp_fixed, NULL, 1000, NULL);
+    settle();
+    static sensor_replay_t env_trace;
+    if (sensor_replay_open(&env_trace, "env", SENSOR_REPLAY_STEP, 0) == ESP_OK) {
+        bench_run("replay_step", bench_replay_step, &env_trace, 1000, NULL);
+        sensor_replay_close(&env_trace);
+        settle();
+    }
+
+    fill_dsp_block();
+    bench_run("block_push", bench_block_push, NULL, 1000, NULL);
+    settle();
+    bench_run("row_snprintf", bench_row_snprintf, NULL, 200, NULL);
+    settle();
+    bench_run("block_encode", bench_block_encode, NULL, 100, NULL);
+    ESP_LOGI(TAG, "Frame: %u bytes for %d samples x %d axes",
+             (unsigned)sample_block_frame_size(&dsp_block), ACCEL_DSP_N, ACCEL_AXES);
+    settle();
+
+    /* Both pipelines must agree before their timings mean anything */
+    accel_dsp_init(&dsp_state);
+    bench_run("dsp_block_float", bench_dsp_block_float, NULL, 8, NULL);
+    accel_features_t float_features = dsp_features;
+    accel_features_to_json(&dsp_features, dsp_json, sizeof(dsp_json));
+    ESP_LOGI(TAG, "Float features: %s", dsp_json);
+    settle();
+    accel_dsp_init(&dsp_state);
+    bench_run("dsp_block_q15", bench_dsp_block_q15, NULL, 8, NULL);
+    accel_features_to_json(&dsp_features, dsp_json, sizeof(dsp_json));
+    ESP_LOGI(TAG, "Q15 features:   %s", dsp_json);
+    int mismatches = dsp_compare(&float_features, &dsp_features);
+    if (mismatches == 0) {
+        ESP_LOGI(TAG, "Q15 features agree with float");
+    } else {
+        ESP_LOGW(TAG, "%d Q15 features differ from float, dsp timings not comparable",
+                 mismatches);
+    }
+    settle();
+
+    stream_adc();
+
+    bench_done();
+
+    printf("\n");
+    printf("==========================================\n");
+    printf("  Benchmarks complete!\n");
+    printf("  Press Ctrl+A then X to exit QEMU\n");
+    printf("==========================================\n");
+
+    vTaskDelete(NULL);
+}
+
+/* ----------------------------------------------------------------
+ * Main application
+ * ---------------------------------------------------------------- */
+void app_main(void)
+{
+    printf("\n");
+    printf("==========================================\n");
+    printf("  ESP32 Firmware Benchmarks (QEMU)\n");
+    printf("  IoT Course - Spring 2026\n");
+    printf("==========================================\n\n");
+
+    /* Pinned: the cycle counter is per core */
+    xTaskCreatePinnedToCore(bench_task, "bench", 6144, NULL, BENCH_PRIO, NULL, BENCH_CORE);
+}
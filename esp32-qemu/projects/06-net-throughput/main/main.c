@@ -0,0 +1,351 @@
+/**
+ * Network Throughput Benchmark for ESP32 QEMU
+ * IoT Course - Spring 2026
+ *
+ * Measures the emulated network link against scripts/net-sink.py:
+ * - TCP connect time
+ * - Round-trip time of small messages (like an MQTT publish + ack)
+ * - Upload and download throughput of a bulk transfer
+ *
+ * Every result is a "NETBENCH ..." line and "NETBENCH_DONE" ends the run.
+ * scripts/net-bench.sh runs this once over slirp (QEMU_NET=1) and once on
+ * the virtual switch (QEMU_NET=bridge, scripts/vnet.sh), optionally with a
+ * shaped link, and prints both side by side.
+ *
+ * The sink listens on port 5001 of the esp32-dev container, which both
+ * modes reach at 10.0.2.2.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_eth.h"
+#include "esp_timer.h"
+
+#include "lwip/sockets.h"
+
+#include "task_placement.h"
+#include "qemu_nic.h"
+
+static const char *TAG = "net-bench";
+
+static EventGroupHandle_t eth_event_group;
+#define ETH_CONNECTED_BIT BIT0
+
+/* ----------------------------------------------------------------
+ * Benchmark configuration
+ * ---------------------------------------------------------------- */
+#define SINK_HOST       "10.0.2.2"
+#define SINK_PORT       5001
+
+#define RTT_ROUNDS      50
+#define RTT_MSG_SIZE    64
+#define TRANSFER_BYTES  (256 * 1024)
+#define CHUNK_SIZE      2920           /* Two full-sized TCP segments */
+#define SOCKET_TIMEOUT_S 30
+
+static uint8_t chunk[CHUNK_SIZE];
+
+/* ----------------------------------------------------------------
+ * Ethernet / network event handlers
+ * ---------------------------------------------------------------- */
+static void eth_event_handler(void *arg, esp_event_base_t event_base,
+                              int32_t event_id, void *event_data)
+{
+    switch (event_id) {
+    case ETHERNET_EVENT_CONNECTED:
+        ESP_LOGI(TAG, "Ethernet link up");
+        break;
+    case ETHERNET_EVENT_DISCONNECTED:
+        ESP_LOGW(TAG, "Ethernet link down");
+        xEventGroupClearBits(eth_event_group, ETH_CONNECTED_BIT);
+        break;
+    default:
+        break;
+    }
+}
+
+static void ip_event_handler(void *arg, esp_event_base_t event_base,
+                             int32_t event_id, void *event_data)
+{
+    if (event_id == IP_EVENT_ETH_GOT_IP) {
+        ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
+        ESP_LOGI(TAG, "Got IP address: " IPSTR, IP2STR(&event->ip_info.ip));
+        xEventGroupSetBits(eth_event_group, ETH_CONNECTED_BIT);
+    }
+}
+
+/* ----------------------------------------------------------------
+ * Initialize Ethernet for QEMU (OpenCores open_eth)
+ * Same pattern as 03-rest-api
+ * ---------------------------------------------------------------- */
+static esp_eth_handle_t eth_handle = NULL;
+
+static void init_ethernet(void)
+{
+    eth_event_group = xEventGroupCreate();
+
+    ESP_ERROR_CHECK(esp_netif_init());
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+
+    esp_netif_config_t netif_cfg = ESP_NETIF_DEFAULT_ETH();
+    esp_netif_t *eth_netif = esp_netif_new(&netif_cfg);
+
+    /* Per-instance MAC, so several instances can share the virtual switch */
+    qemu_nic_use_nic_mac();
+    eth_mac_config_t mac_config = ETH_MAC_DEFAULT_CONFIG();
+    esp_eth_mac_t *mac = esp_eth_mac_new_openeth(&mac_config);
+
+    eth_phy_config_t phy_config = ETH_PHY_DEFAULT_CONFIG();
+    phy_config.phy_addr = 0;
+    phy_config.reset_gpio_num = -1;
+    phy_config.autonego_timeout_ms = 100;
+    esp_eth_phy_t *phy = esp_eth_phy_new_dp83848(&phy_config);
+
+    esp_eth_config_t eth_config = ETH_DEFAULT_CONFIG(mac, phy);
+    ESP_ERROR_CHECK(esp_eth_driver_install(&eth_config, &eth_handle));
+    ESP_ERROR_CHECK(esp_netif_attach(eth_netif, esp_eth_new_netif_glue(eth_handle)));
+
+    ESP_ERROR_CHECK(esp_event_handler_register(ETH_EVENT, ESP_EVENT_ANY_ID,
+                                               &eth_event_handler, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_ETH_GOT_IP,
+                                               &ip_event_handler, NULL));
+
+    ESP_ERROR_CHECK(esp_eth_start(eth_handle));
+    ESP_LOGI(TAG, "Waiting for IP address from DHCP...");
+}
+
+/* ----------------------------------------------------------------
+ * Socket helpers
+ * ---------------------------------------------------------------- */
+
+/* Connect to the sink and send the command line; returns the socket or -1.
+ * *connect_us receives the time the TCP handshake took. */
+static int sink_open(const char *command, int64_t *connect_us)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(SINK_PORT),
+    };
+    inet_pton(AF_INET, SINK_HOST, &addr.sin_addr);
+
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "socket() failed: errno %d", errno);
+        return -1;
+    }
+    struct timeval tv = { .tv_sec = SOCKET_TIMEOUT_S };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    int64_t start = esp_timer_get_time();
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        ESP_LOGE(TAG, "connect to %s:%d failed: errno %d", SINK_HOST, SINK_PORT, errno);
+        close(sock);
+        return -1;
+    }
+    if (connect_us) {
+        *connect_us = esp_timer_get_time() - start;
+    }
+
+    if (send(sock, command, strlen(command), 0) < 0) {
+        ESP_LOGE(TAG, "send command failed: errno %d", errno);
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+static int recv_all(int sock, void *buf, size_t len)
+{
+    size_t got = 0;
+    while (got < len) {
+        int n = recv(sock, (uint8_t *)buf + got, len - got, 0);
+        if (n <= 0) {
+            return -1;
+        }
+        got += n;
+    }
+    return 0;
+}
+
+static int send_all(int sock, const void *buf, size_t len)
+{
+    size_t sent = 0;
+    while (sent < len) {
+        int n = send(sock, (const uint8_t *)buf + sent, len - sent, 0);
+        if (n < 0) {
+            return -1;
+        }
+        sent += n;
+    }
+    return 0;
+}
+
+static int cmp_i64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void print_rate(const char *test, int64_t bytes, int64_t us)
+{
+    if (us <= 0) {
+        us = 1;
+    }
+    printf("NETBENCH test=%s bytes=%lld ms=%lld kbps=%lld\n", test,
+           bytes, us / 1000, bytes * 8 * 1000 / us);
+}
+
+/* ----------------------------------------------------------------
+ * Benchmarks
+ * ---------------------------------------------------------------- */
+
+/* ECHO: small request/response round trips on one connection */
+static void bench_rtt(void)
+{
+    int64_t connect_us = 0;
+    int sock = sink_open("ECHO\n", &connect_us);
+    if (sock < 0) {
+        return;
+    }
+    printf("NETBENCH test=connect us=%lld\n", connect_us);
+
+    static int64_t rtt[RTT_ROUNDS];
+    char msg[RTT_MSG_SIZE];
+    memset(msg, 'x', sizeof(msg));
+    int rounds = 0;
+    for (int i = 0; i < RTT_ROUNDS; i++) {
+        int64_t start = esp_timer_get_time();
+        if (send_all(sock, msg, sizeof(msg)) != 0 || recv_all(sock, msg, sizeof(msg)) != 0) {
+            ESP_LOGE(TAG, "Echo round %d failed: errno %d", i, errno);
+            break;
+        }
+        rtt[rounds++] = esp_timer_get_time() - start;
+    }
+    close(sock);
+
+    if (rounds > 0) {
+        qsort(rtt, rounds, sizeof(rtt[0]), cmp_i64);
+        printf("NETBENCH test=rtt rounds=%d min_us=%lld med_us=%lld max_us=%lld\n",
+               rounds, rtt[0], rtt[rounds / 2], rtt[rounds - 1]);
+    }
+}
+
+/* UP <n>: send n bytes, the sink answers "OK <n>" once it has them all */
+static void bench_upload(void)
+{
+    char command[32];
+    snprintf(command, sizeof(command), "UP %d\n", TRANSFER_BYTES);
+    int sock = sink_open(command, NULL);
+    if (sock < 0) {
+        return;
+    }
+
+    memset(chunk, 0xA5, sizeof(chunk));
+    int64_t start = esp_timer_get_time();
+    int remaining = TRANSFER_BYTES;
+    while (remaining > 0) {
+        int n = remaining < CHUNK_SIZE ? remaining : CHUNK_SIZE;
+        if (send_all(sock, chunk, n) != 0) {
+            ESP_LOGE(TAG, "Upload failed after %d bytes: errno %d",
+                     TRANSFER_BYTES - remaining, errno);
+            close(sock);
+            return;
+        }
+        remaining -= n;
+    }
+
+    char reply[32] = { 0 };
+    int n = recv(sock, reply, sizeof(reply) - 1, 0);
+    int64_t us = esp_timer_get_time() - start;
+    close(sock);
+
+    if (n <= 0 || strncmp(reply, "OK ", 3) != 0) {
+        ESP_LOGE(TAG, "No acknowledgement from sink");
+        return;
+    }
+    print_rate("up", TRANSFER_BYTES, us);
+}
+
+/* DOWN <n>: the sink sends n bytes */
+static void bench_download(void)
+{
+    char command[32];
+    snprintf(command, sizeof(command), "DOWN %d\n", TRANSFER_BYTES);
+    int sock = sink_open(command, NULL);
+    if (sock < 0) {
+        return;
+    }
+
+    int64_t start = esp_timer_get_time();
+    int total = 0;
+    while (total < TRANSFER_BYTES) {
+        int n = recv(sock, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            ESP_LOGE(TAG, "Download failed after %d bytes: errno %d", total, errno);
+            close(sock);
+            return;
+        }
+        total += n;
+    }
+    int64_t us = esp_timer_get_time() - start;
+    close(sock);
+    print_rate("down", total, us);
+}
+
+static void bench_task(void *arg)
+{
+    ESP_LOGI(TAG, "Sink: %s:%d, transfer size %d bytes", SINK_HOST, SINK_PORT, TRANSFER_BYTES);
+
+    bench_rtt();
+    bench_upload();
+    bench_download();
+
+    printf("NETBENCH_DONE\n");
+    printf("\n");
+    printf("==========================================\n");
+    printf("  Network benchmark complete!\n");
+    printf("  Press Ctrl+A then X to exit QEMU\n");
+    printf("==========================================\n");
+
+    vTaskDelete(NULL);
+}
+
+/* ----------------------------------------------------------------
+ * Main application
+ * ---------------------------------------------------------------- */
+void app_main(void)
+{
+    printf("\n");
+    printf("==========================================\n");
+    printf("  ESP32 Network Throughput Benchmark (QEMU)\n");
+    printf("  IoT Course - Spring 2026\n");
+    printf("==========================================\n\n");
+
+    init_ethernet();
+
+    EventBits_t bits = xEventGroupWaitBits(eth_event_group, ETH_CONNECTED_BIT,
+                                           pdFALSE, pdTRUE, pdMS_TO_TICKS(30000));
+    if (!(bits & ETH_CONNECTED_BIT)) {
+        ESP_LOGE(TAG, "Failed to get IP address within 30 seconds!");
+        ESP_LOGE(TAG, "Start QEMU with QEMU_NET=1 or QEMU_NET=bridge");
+        return;
+    }
+
+    /* Socket work next to lwIP, as the HTTP/MQTT clients in 03/04 */
+    task_placement_create(bench_task, "net_bench", 4096, NULL, 5, NULL,
+                          TASK_ROLE_NETWORK);
+}
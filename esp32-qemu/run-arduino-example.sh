@@ -15,7 +15,7 @@ if [ ! -d "../arduino/${SKETCH}" ]; then
     echo "Error: Sketch '${SKETCH}' not found in arduino/"
     echo ""
     echo "Available sketches:"
-    ls -1 ../arduino/ | grep -v README
+    ls -1 ../arduino/ | grep -v -e README -e libraries
     exit 1
 fi
 
@@ -0,0 +1,46 @@
+#!/bin/bash
+# Build and run every example headless in QEMU and check its UART output
+# Usage: ./run-tests.sh [test-name-glob ...] [runner options]
+# Example: ./run-tests.sh
+#          ./run-tests.sh 0* -j 4
+#          ./run-tests.sh --list
+#          SENSOR_TRACE=traces/sensors.bin ./run-tests.sh   # replayed sensors
+#
+# Starts the backend services, runs scripts/qemu-test-runner.py inside the
+# container (tests are listed in scripts/qemu-tests.json) and stops the
+# services again. Logs end up in test-results/.
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+cd "${SCRIPT_DIR}"
+
+mkdir -p test-results
+
+echo "=========================================="
+echo "  QEMU test suite"
+echo "=========================================="
+
+# Network tests reach these through the runner's forwarder
+SERVICES="api-server mqtt-broker ntp-server"
+docker compose up -d ${SERVICES}
+
+# Trace pack for components/sensor_replay, a path under this directory
+TRACE_ARGS=()
+if [ -n "${SENSOR_TRACE:-}" ]; then
+    TRACE_ARGS=(--trace "/workspace/${SENSOR_TRACE}")
+fi
+
+STATUS=0
+docker compose run --rm \
+    esp32-dev \
+    python3 /workspace/scripts/qemu-test-runner.py \
+    --report /workspace/test-results/results.json "${TRACE_ARGS[@]}" "$@" || STATUS=$?
+
+echo ""
+echo "Stopping backend services..."
+for svc in ${SERVICES}; do
+    docker compose stop ${svc} 2>/dev/null || true
+done
+
+exit ${STATUS}
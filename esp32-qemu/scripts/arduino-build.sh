@@ -5,6 +5,9 @@
 
 set -e
 
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "${SCRIPT_DIR}/pipeline-lib.sh"
+
 SKETCH_PATH=${1:-.}
 SKETCH_NAME=$(basename "${SKETCH_PATH}")
 
@@ -28,11 +31,42 @@ echo "=========================================="
 BUILD_DIR="${SKETCH_PATH}/build"
 mkdir -p "${BUILD_DIR}"
 
-# Compile with arduino-cli for ESP32
-arduino-cli compile \
+# Compile with arduino-cli for ESP32. Reusing the same build path lets
+# arduino-cli skip unchanged sketch objects, and ARDUINO_BUILD_CACHE_PATH
+# (a named volume, see docker-compose.yml) keeps the compiled core between
+# containers. The verbose log is kept to count what was reused.
+COMPILE_LOG="${BUILD_DIR}/compile.log"
+
+# Course libraries (CoopScheduler, ...) live next to the sketches
+LIBRARIES_DIR=${ARDUINO_LIBRARIES:-$(dirname "${SKETCH_PATH}")/libraries}
+LIBRARY_ARGS=()
+if [ -d "${LIBRARIES_DIR}" ]; then
+    LIBRARY_ARGS=(--libraries "${LIBRARIES_DIR}")
+fi
+
+stage_begin build
+if ! arduino-cli compile --verbose \
     --fqbn esp32:esp32:esp32 \
     --build-path "${BUILD_DIR}" \
-    "${SKETCH_PATH}"
+    "${LIBRARY_ARGS[@]}" \
+    "${SKETCH_PATH}" > "${COMPILE_LOG}" 2>&1; then
+    cat "${COMPILE_LOG}"
+    exit 1
+fi
+stage_end
+
+grep -E "warning:|Sketch uses|Global variables use" "${COMPILE_LOG}" || true
+REUSED=$(grep -c "Using previously compiled file" "${COMPILE_LOG}" || true)
+COMPILED=$(grep -cE "xtensa-esp32-elf-g(cc|\+\+).* -c " "${COMPILE_LOG}" || true)
+CORE=built
+if grep -q "Using precompiled core" "${COMPILE_LOG}"; then
+    CORE=cached
+fi
+HIT_RATE=0
+if [ $(( REUSED + COMPILED )) -gt 0 ]; then
+    HIT_RATE=$(( REUSED * 100 / (REUSED + COMPILED) ))
+fi
+echo "BUILD_CACHE reused=${REUSED} compiled=${COMPILED} hit_rate=${HIT_RATE}% core=${CORE}"
 
 echo "=========================================="
 echo "Build complete!"
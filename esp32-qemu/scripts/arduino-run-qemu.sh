@@ -1,9 +1,13 @@
 #!/bin/bash
 # Run a compiled Arduino sketch in QEMU
 # Usage: ./arduino-run-qemu.sh <sketch_path>
+# Set QEMU_FRESH_FLASH=1 to rebuild the flash image from scratch
 
 set -e
 
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "${SCRIPT_DIR}/pipeline-lib.sh"
+
 SKETCH_PATH=${1:-.}
 SKETCH_NAME=$(basename "${SKETCH_PATH}")
 BUILD_DIR="${SKETCH_PATH}/build"
@@ -23,15 +27,14 @@ echo "=========================================="
 echo "Preparing Arduino binary for QEMU..."
 echo "=========================================="
 
-# Merge binaries into a single flash image for QEMU
-python3 -m esptool --chip esp32 merge_bin \
-    --fill-flash-size 4MB \
-    -o "${BUILD_DIR}/merged-qemu.bin" \
-    --flash_mode dio \
-    --flash_size 4MB \
+# Merge binaries into a single flash image for QEMU, only rewriting the
+# parts that changed since the last run
+stage_begin flash-image
+prepare_flash_image "${BUILD_DIR}/merged-qemu.bin" \
+    0x10000 "${APP_BIN}" \
     0x1000 "${BOOT_BIN}" \
-    0x8000 "${PART_BIN}" \
-    0x10000 "${APP_BIN}"
+    0x8000 "${PART_BIN}"
+stage_end
 
 echo "=========================================="
 echo "Starting QEMU ESP32 emulator..."
@@ -46,9 +49,11 @@ if [ "${QEMU_NET:-0}" = "1" ]; then
 fi
 
 # Run QEMU
+stage_begin qemu
 qemu-system-xtensa \
     -nographic \
     -machine esp32 \
     -drive file="${BUILD_DIR}/merged-qemu.bin",if=mtd,format=raw \
     -serial mon:stdio \
     ${NETWORK_ARGS}
+stage_end
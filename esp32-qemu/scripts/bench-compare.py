@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""
+Compare firmware benchmark results against a stored baseline
+IoT Course - Spring 2026
+
+Reads the "BENCH {...}" lines a firmware printed (components/microbench)
+from a UART log and compares each benchmark's median cycles per iteration
+with the baseline. A benchmark is a regression when it got slower by more
+than --threshold percent AND by more than --min-cycles (tiny benchmarks
+jitter by a few cycles in QEMU).
+
+Usage:
+  bench-compare.py <uart.log> [--baseline FILE] [--threshold PCT]
+  bench-compare.py <uart.log> --update    # store this run as the baseline
+
+Exit status: 0 = no regressions, 1 = regressions, 2 = no results in the log.
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+BENCH_LINE = re.compile(r"BENCH (\{.*\})")
+
+
+def parse_log(path):
+    """Last result of every benchmark in the log, in first-seen order"""
+    results = {}
+    with open(path, errors="replace") as f:
+        for line in f:
+            m = BENCH_LINE.search(line)
+            if not m:
+                continue
+            try:
+                r = json.loads(m.group(1))
+            except ValueError:
+                continue  # Line cut short on the UART
+            results[r["name"]] = r
+    return results
+
+
+def compare(current, baseline, threshold, min_cycles):
+    rows = []
+    regressions = 0
+    for name, r in current.items():
+        now = r["cyc_med"]
+        base = baseline.get(name, {}).get("cyc_med")
+        if base is None:
+            rows.append((name, "-", now, "", "new"))
+            continue
+        delta = now - base
+        pct = 100.0 * delta / base if base else 0.0
+        if delta > min_cycles and pct > threshold:
+            verdict = "REGRESSION"
+            regressions += 1
+        elif -delta > min_cycles and -pct > threshold:
+            verdict = "improved"
+        else:
+            verdict = "ok"
+        rows.append((name, base, now, "%+.1f%%" % pct, verdict))
+    for name in baseline:
+        if name not in current:
+            rows.append((name, baseline[name]["cyc_med"], "-", "", "missing"))
+    return rows, regressions
+
+
+def main():
+    script_dir = os.path.dirname(os.path.abspath(__file__))
+    default_baseline = os.path.join(os.path.dirname(script_dir),
+                                    "projects", "05-benchmarks", "bench-baseline.json")
+
+    parser = argparse.ArgumentParser(description="Compare BENCH results with a baseline")
+    parser.add_argument("log", help="UART log containing BENCH lines")
+    parser.add_argument("--baseline", default=default_baseline)
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="percent slowdown that counts as a regression (default 10)")
+    parser.add_argument("--min-cycles", type=int, default=20,
+                        help="ignore changes smaller than this many cycles (default 20)")
+    parser.add_argument("--update", action="store_true",
+                        help="write this run as the new baseline")
+    args = parser.parse_args()
+
+    current = parse_log(args.log)
+    if not current:
+        print("No BENCH lines found in %s" % args.log)
+        return 2
+
+    if args.update:
+        with open(args.baseline, "w") as f:
+            json.dump(current, f, indent=2, sort_keys=True)
+            f.write("\n")
+        print("Baseline with %d benchmarks written to %s" % (len(current), args.baseline))
+        return 0
+
+    baseline = {}
+    if os.path.exists(args.baseline):
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+    else:
+        print("No baseline at %s (record one with --update)" % args.baseline)
+
+    rows, regressions = compare(current, baseline, args.threshold, args.min_cycles)
+
+    print("%-28s %10s %10s %8s  %s" % ("BENCHMARK", "BASE cyc", "NOW cyc", "DELTA", ""))
+    print("-" * 70)
+    for name, base, now, pct, verdict in rows:
+        print("%-28s %10s %10s %8s  %s" % (name, base, now, pct, verdict))
+    print("-" * 70)
+    print("%d regression(s) above %.0f%% / %d cycles" %
+          (regressions, args.threshold, args.min_cycles))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
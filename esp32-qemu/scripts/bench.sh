@@ -0,0 +1,24 @@
+#!/bin/bash
+# Run the firmware benchmarks in QEMU and compare them with the baseline
+# Usage: ./bench.sh [--update] [--threshold PCT] [--min-cycles N]
+# Example: docker compose run --rm esp32-dev /workspace/scripts/bench.sh
+#
+# Builds and runs projects/05-benchmarks headless (qemu-test-runner.py),
+# then compares its BENCH lines with projects/05-benchmarks/bench-baseline.json.
+# Exits non-zero if a benchmark regressed.
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+WORKSPACE="$(dirname "${SCRIPT_DIR}")"
+
+# One instance only: parallel QEMUs would compete for host CPU
+python3 "${SCRIPT_DIR}/qemu-test-runner.py" -j 1 05-benchmarks || {
+    echo "Benchmark run failed, see ${WORKSPACE}/test-results/05-benchmarks.uart.log"
+    exit 1
+}
+
+python3 "${SCRIPT_DIR}/bench-compare.py" \
+    "${WORKSPACE}/test-results/05-benchmarks.uart.log" \
+    --baseline "${WORKSPACE}/projects/05-benchmarks/bench-baseline.json" \
+    "$@"
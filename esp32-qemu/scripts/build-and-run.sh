@@ -5,8 +5,14 @@
 set -e
 
 SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "${SCRIPT_DIR}/pipeline-lib.sh"
+
 PROJECT_PATH=${1:-.}
 
+# One timing summary for both steps, printed when QEMU exits
+export PIPELINE_TIMING_LOG=$(mktemp)
+trap 'timing_summary; rm -f "${PIPELINE_TIMING_LOG}"' EXIT
+
 # Build the project
 "${SCRIPT_DIR}/build.sh" "${PROJECT_PATH}"
 
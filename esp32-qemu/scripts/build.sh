@@ -1,9 +1,17 @@
 #!/bin/bash
 # Build an ESP32 project for QEMU
 # Usage: ./build.sh <project_path>
+#
+# SDKCONFIG_OVERLAY=<file> applies extra defaults on top of the project's
+# sdkconfig.defaults (e.g. scripts/sdkconfig.tls). sdkconfig only takes
+# defaults for options it does not have yet, so it is regenerated whenever
+# the overlay changes.
 
 set -e
 
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "${SCRIPT_DIR}/pipeline-lib.sh"
+
 PROJECT_PATH=${1:-.}
 
 if [ ! -f "${PROJECT_PATH}/CMakeLists.txt" ]; then
@@ -14,15 +22,51 @@ fi
 
 cd "${PROJECT_PATH}"
 
+DEFAULTS=""
+if [ -f sdkconfig.defaults ]; then
+    DEFAULTS="sdkconfig.defaults"
+fi
+if [ -n "${SDKCONFIG_OVERLAY:-}" ]; then
+    DEFAULTS="${DEFAULTS:+${DEFAULTS};}${SDKCONFIG_OVERLAY}"
+fi
+OVERLAY_STAMP=build/.sdkconfig-overlay
+if [ "$(cat "${OVERLAY_STAMP}" 2>/dev/null)" != "${SDKCONFIG_OVERLAY:-}" ]; then
+    echo "sdkconfig overlay changed (${SDKCONFIG_OVERLAY:-none}), regenerating sdkconfig"
+    rm -f sdkconfig
+fi
+if [ -n "${DEFAULTS}" ]; then
+    export SDKCONFIG_DEFAULTS="${DEFAULTS}"
+fi
+
 echo "=========================================="
 echo "Building ESP32 project: $(basename $(pwd))"
 echo "=========================================="
 
-# Set target to ESP32
-idf.py set-target esp32
+# Set target to ESP32. set-target deletes the build directory and
+# reconfigures from scratch, so only run it when the target is not set yet.
+stage_begin set-target
+if [ -f sdkconfig ] && grep -q '^CONFIG_IDF_TARGET="esp32"$' sdkconfig; then
+    echo "Target already esp32, skipping set-target"
+else
+    idf.py set-target esp32
+fi
+stage_end
+
+# Build the project (CMake only reconfigures when its inputs changed).
+# With ccache available, objects already compiled by any project with the
+# same sdkconfig come from the shared cache (see docker-compose.yml).
+CCACHE_ARGS=""
+if command -v ccache > /dev/null; then
+    CCACHE_ARGS="--ccache"
+fi
+CCACHE_BEFORE=$(ccache_snapshot)
+
+stage_begin build
+idf.py ${CCACHE_ARGS} build
+stage_end
 
-# Build the project
-idf.py build
+ccache_report "${CCACHE_BEFORE}"
+echo "${SDKCONFIG_OVERLAY:-}" > "${OVERLAY_STAMP}"
 
 echo "=========================================="
 echo "Build complete!"
@@ -0,0 +1,250 @@
+#!/usr/bin/env python3
+"""
+Fleet reconnect simulator: what a broker restart does to many devices
+IoT Course - Spring 2026
+
+Simulates N devices connected to one MQTT broker that restarts, and
+compares two reconnect policies:
+
+  fixed    esp-mqtt's built-in auto-reconnect: wait reconnect_timeout_ms
+           (10 s) after every disconnect or failed attempt
+  backoff  components/conn_manager as 04-mqtt uses it: jittered exponential
+           backoff plus a reconnect token bucket (same defaults as Kconfig)
+
+The broker accepts a limited number of CONNECTs per second (--capacity,
+session restore and auth are not free) with a listen backlog; attempts
+beyond that time out or are refused and must be retried. That is what turns
+a restart into a storm: a fleet that retries in lockstep keeps overrunning
+the broker, wave after wave.
+
+This is a discrete-event model (no sockets, runs in well under a second).
+To watch the real firmware instead, boot a fleet on the virtual switch and
+restart the broker from the host:
+
+  ./vnet-fleet.sh /workspace/projects/04-mqtt 8 120     # in the container
+  docker compose restart mqtt-broker                    # on the host
+
+Usage:
+  fleet-sim.py [--devices 500] [--downtime 5] [--capacity 100]
+               [--policy fixed|backoff|both] [--seed 1]
+"""
+
+import argparse
+import heapq
+import random
+import sys
+
+# Defaults of components/conn_manager/Kconfig
+BACKOFF_BASE_MS = 1000
+BACKOFF_MAX_MS = 60000
+BACKOFF_MIN_MS = 100
+RECONNECT_BURST = 3
+RECONNECT_REFILL_MS = 10000
+
+# esp-mqtt defaults
+FIXED_RECONNECT_MS = 10000
+NETWORK_TIMEOUT_MS = 10000
+
+
+class Backoff:
+    """conn_backoff_t + the reconnect token_bucket_t of conn_manager_t"""
+
+    def __init__(self, rng):
+        self.rng = rng
+        self.attempt = 0
+        self.tokens = RECONNECT_BURST
+        self.last_refill = 0.0
+
+    def reset(self):
+        self.attempt = 0
+
+    def _refill(self, now):
+        added = int((now - self.last_refill) * 1000 // RECONNECT_REFILL_MS)
+        if added <= 0:
+            return
+        if self.tokens + added >= RECONNECT_BURST:
+            self.tokens = RECONNECT_BURST
+            self.last_refill = now
+        else:
+            self.tokens += added
+            self.last_refill += added * RECONNECT_REFILL_MS / 1000.0
+
+    def next_delay(self, now):
+        cap = min(BACKOFF_MAX_MS, BACKOFF_BASE_MS << min(self.attempt, 32))
+        cap = max(cap, BACKOFF_MIN_MS)
+        self.attempt += 1
+        backoff_ms = BACKOFF_MIN_MS + self.rng.randint(0, cap - BACKOFF_MIN_MS)
+
+        self._refill(now)
+        bucket_ms = 0
+        if self.tokens < 1:
+            missing = 1 - self.tokens
+            bucket_ms = max(0, missing * RECONNECT_REFILL_MS -
+                            (now - self.last_refill) * 1000)
+        self.tokens -= 1
+        return (bucket_ms + backoff_ms) / 1000.0
+
+
+class Fixed:
+    def __init__(self, rng):
+        pass
+
+    def reset(self):
+        pass
+
+    def next_delay(self, now):
+        return FIXED_RECONNECT_MS / 1000.0
+
+
+def simulate(policy_cls, args):
+    rng = random.Random(args.seed)
+    devices = [policy_cls(rng) for _ in range(args.devices)]
+    connected = [True] * args.devices
+
+    restart_at = 1.0
+    up_at = restart_at + args.downtime
+    service_s = 1.0 / args.capacity
+    broker_free_at = up_at      # The broker works through CONNECTs in order
+    in_queue = []               # Finish times of CONNECTs waiting or in service
+
+    events = []                 # (time, seq, device)
+    seq = 0
+    attempts = []               # (time, ok)
+
+    # The restart drops every connection; devices notice within a few ms
+    for d in range(args.devices):
+        connected[d] = False
+        notice = restart_at + rng.uniform(0, 0.05)
+        heapq.heappush(events, (notice + devices[d].next_delay(notice), seq, d))
+        seq += 1
+
+    reconnected_at = [None] * args.devices
+    while events:
+        now, _, d = heapq.heappop(events)
+        if now > args.horizon:
+            break
+
+        ok = False
+        finish = now
+        if now >= up_at:
+            while in_queue and in_queue[0] <= now:
+                heapq.heappop(in_queue)
+            if len(in_queue) < args.backlog:
+                start = max(now, broker_free_at)
+                done = start + service_s
+                if done - now <= NETWORK_TIMEOUT_MS / 1000.0:
+                    broker_free_at = done
+                    heapq.heappush(in_queue, done)
+                    ok = True
+                    finish = done
+                else:
+                    # Still queued when the client gives up; the broker
+                    # wastes the work anyway
+                    broker_free_at = done
+                    heapq.heappush(in_queue, done)
+                    finish = now + NETWORK_TIMEOUT_MS / 1000.0
+        attempts.append((now, ok))
+
+        if ok:
+            connected[d] = True
+            reconnected_at[d] = finish
+            devices[d].reset()
+        else:
+            heapq.heappush(events, (finish + devices[d].next_delay(finish), seq, d))
+            seq += 1
+
+    return attempts, reconnected_at, restart_at, up_at
+
+
+def summarize(name, attempts, reconnected_at, restart_at, up_at, args):
+    per_s = {}
+    for t, _ in attempts:
+        s = int(t - restart_at)
+        per_s[s] = per_s.get(s, 0) + 1
+    # What the broker has to absorb once it is back: attempts while it is
+    # down are refused by the host's TCP stack and cost it nothing
+    per_s_up = {}
+    for t, _ in attempts:
+        if t >= up_at:
+            s = int(t - up_at)
+            per_s_up[s] = per_s_up.get(s, 0) + 1
+    done = sorted(t - restart_at for t in reconnected_at if t is not None)
+    failed = sum(1 for t, ok in attempts if not ok and t >= up_at)
+
+    def pct(p):
+        if len(done) < args.devices * p:
+            return None
+        return done[int(args.devices * p) - 1]
+
+    return {
+        "name": name,
+        "attempts": len(attempts),
+        "failed": failed,
+        "peak": max(per_s_up.values()) if per_s_up else 0,
+        "per_s": per_s,
+        "p50": pct(0.5),
+        "p99": pct(0.99),
+        "all": done[-1] if len(done) == args.devices else None,
+        "missing": args.devices - len(done),
+    }
+
+
+def histogram(result, width=50, seconds=60):
+    per_s = result["per_s"]
+    peak = max(per_s.values()) if per_s else 1
+    print("Connect attempts per second after the restart (%s)" % result["name"])
+    last = max(per_s) if per_s else 0
+    for s in range(0, min(last, seconds) + 1):
+        n = per_s.get(s, 0)
+        print("  %3ds %5d %s" % (s, n, "#" * int(round(n * width / peak))))
+    print()
+
+
+def fmt_s(v):
+    return "-" if v is None else "%.1fs" % v
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Broker restart reconnect-storm simulator")
+    parser.add_argument("--devices", type=int, default=500)
+    parser.add_argument("--downtime", type=float, default=5.0,
+                        help="seconds the broker is down (default 5)")
+    parser.add_argument("--capacity", type=float, default=100.0,
+                        help="CONNECTs the broker completes per second (default 100)")
+    parser.add_argument("--backlog", type=int, default=128,
+                        help="pending CONNECTs before new ones are refused (default 128)")
+    parser.add_argument("--horizon", type=float, default=600.0,
+                        help="seconds to simulate (default 600)")
+    parser.add_argument("--policy", choices=["fixed", "backoff", "both"], default="both")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--no-histogram", action="store_true")
+    args = parser.parse_args()
+
+    policies = {"fixed": Fixed, "backoff": Backoff}
+    names = ["fixed", "backoff"] if args.policy == "both" else [args.policy]
+
+    print("%d devices, broker down %.0fs, %.0f CONNECT/s, backlog %d\n" %
+          (args.devices, args.downtime, args.capacity, args.backlog))
+
+    results = []
+    for name in names:
+        r = summarize(name, *simulate(policies[name], args), args)
+        results.append(r)
+        if not args.no_histogram:
+            histogram(r)
+
+    print("%-8s %9s %8s %10s %8s %8s %8s" %
+          ("POLICY", "ATTEMPTS", "REJECTED", "PEAK/s", "P50", "P99", "ALL"))
+    print("-" * 66)
+    for r in results:
+        print("%-8s %9d %8d %10d %8s %8s %8s" %
+              (r["name"], r["attempts"], r["failed"], r["peak"],
+               fmt_s(r["p50"]), fmt_s(r["p99"]),
+               fmt_s(r["all"]) if not r["missing"] else "%d left" % r["missing"]))
+    print("REJECTED and PEAK/s count attempts once the broker is back up;")
+    print("P50/P99/ALL are times from the restart until devices are reconnected")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,83 @@
+#!/bin/bash
+# Generate a local CA and a server certificate for the TLS listeners
+# Usage: ./gen-certs.sh [--force]
+#
+# Writes esp32-qemu/certs/:
+#   ca.crt, ca.key          course CA (10 years); ca.crt is embedded in the
+#                           firmware when TLS mode is on (components/tls_session)
+#   server.crt, server.key  used by mosquitto (8883) and the api-server (5443)
+# and esp32-qemu/mosquitto/conf.d/tls.conf, which turns on the broker's TLS
+# listener (restart mqtt-broker to pick it up).
+#
+# The server certificate names every address the firmware uses: 10.0.2.2
+# (slirp and the virtual switch), the compose service names and localhost.
+# 10.0.2.2 is listed both as an IP and as a DNS name, because mbedTLS
+# matches the host of the URL against the DNS names only.
+#
+# Existing files are kept unless --force is given: firmware built with the
+# old ca.crt would no longer trust the services. This CA is for the local
+# test setup only; its key is not protected.
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+CERT_DIR="${CERT_DIR:-$(dirname "${SCRIPT_DIR}")/certs}"
+BROKER_CONF_DIR="$(dirname "${SCRIPT_DIR}")/mosquitto/conf.d"
+DAYS=3650
+
+if ! command -v openssl > /dev/null; then
+    echo "Error: openssl not found"
+    exit 1
+fi
+
+mkdir -p "${CERT_DIR}"
+cd "${CERT_DIR}"
+
+# The broker's TLS listener; paths are inside the mqtt-broker container.
+# OpenSSL's session cache and tickets let devices resume a session instead
+# of repeating the full handshake.
+write_broker_conf() {
+    mkdir -p "${BROKER_CONF_DIR}"
+    cat > "${BROKER_CONF_DIR}/tls.conf" <<EOF
+# Written by scripts/gen-certs.sh
+listener 8883
+cafile /mosquitto/certs/ca.crt
+certfile /mosquitto/certs/server.crt
+keyfile /mosquitto/certs/server.key
+EOF
+}
+
+if [ -f ca.crt ] && [ -f server.crt ] && [ "$1" != "--force" ]; then
+    echo "Certificates already exist in ${CERT_DIR} (use --force to replace)"
+    write_broker_conf
+    exit 0
+fi
+
+echo "Generating course CA..."
+openssl req -x509 -newkey rsa:2048 -nodes -days "${DAYS}" \
+    -keyout ca.key -out ca.crt \
+    -subj "/O=IoT Course/CN=IoT Course Local CA" 2> /dev/null
+
+echo "Generating server certificate..."
+cat > server.ext <<EOF
+basicConstraints = CA:FALSE
+keyUsage = digitalSignature, keyEncipherment
+extendedKeyUsage = serverAuth
+subjectAltName = DNS:mqtt-broker, DNS:api-server, DNS:localhost, DNS:10.0.2.2, IP:10.0.2.2, IP:127.0.0.1
+EOF
+openssl req -newkey rsa:2048 -nodes \
+    -keyout server.key -out server.csr \
+    -subj "/O=IoT Course/CN=mqtt-broker" 2> /dev/null
+openssl x509 -req -in server.csr -days "${DAYS}" \
+    -CA ca.crt -CAkey ca.key -CAcreateserial \
+    -extfile server.ext -out server.crt 2> /dev/null
+rm -f server.csr server.ext ca.srl
+
+# mosquitto runs as its own user inside its container
+chmod 644 server.key
+
+write_broker_conf
+
+openssl x509 -in server.crt -noout -subject -ext subjectAltName
+echo "Certificates written to ${CERT_DIR}"
+echo "Broker TLS listener: ${BROKER_CONF_DIR}/tls.conf"
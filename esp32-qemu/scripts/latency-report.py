@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""
+End-to-end latency report of traced sensor readings
+IoT Course - Spring 2026
+
+Readings from firmware with components/latency_trace carry a trace ID and
+device timestamps; the api-server adds its own hops (see GET
+/api/trace/report in api-server/app.py). This prints one line per stage
+and names the one with the largest p95, the stage to work on first:
+
+  LATENCY stage=sample_publish n=40 p50_ms=0.8 p95_ms=2.1 p99_ms=3.0 max_ms=3.4 skewed=0
+  LATENCY stage=publish_broker n=40 p50_ms=6.2 p95_ms=14.9 ...
+  LATENCY stage=broker_store ...
+  LATENCY stage=store_query ...
+  LATENCY_TOTAL traces=40 untimed=0 slowest=publish_broker
+
+store_query needs a client reading the data: --poll S queries
+GET /api/sensors/latest (GET /api/devices/<id>/latest with --device) every
+S seconds for --duration seconds before the report, like a dashboard would.
+
+Standard library only:
+
+  docker compose up -d api-server mqtt-broker ntp-server
+  ./run-tests.sh 04-mqtt                      # or any run of 03/04
+  python3 scripts/latency-report.py --transport mqtt
+"""
+
+import argparse
+import json
+import sys
+import time
+import urllib.error
+import urllib.parse
+import urllib.request
+
+STAGES = ("sample_publish", "publish_broker", "broker_store", "store_query")
+
+
+def get_json(url):
+    with urllib.request.urlopen(url, timeout=10) as resp:
+        return json.loads(resp.read())
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--url", default="http://localhost:5000",
+                        help="api-server base URL")
+    parser.add_argument("--device", help="only this device")
+    parser.add_argument("--transport", choices=("http", "mqtt"),
+                        help="only readings that came this way")
+    parser.add_argument("--poll", type=float, default=0,
+                        help="query the latest reading every POLL s first")
+    parser.add_argument("--duration", type=float, default=30,
+                        help="how long to poll (s)")
+    args = parser.parse_args()
+
+    if args.poll > 0:
+        latest = "/api/sensors/latest"
+        if args.device:
+            latest = "/api/devices/%s/latest" % urllib.parse.quote(args.device, safe="")
+        deadline = time.monotonic() + args.duration
+        while time.monotonic() < deadline:
+            try:
+                get_json(args.url + latest)
+            except urllib.error.HTTPError:
+                pass                    # 404 until the first reading
+            time.sleep(args.poll)
+
+    query = {k: v for k, v in (("device", args.device),
+                               ("transport", args.transport)) if v}
+    url = args.url + "/api/trace/report"
+    if query:
+        url += "?" + urllib.parse.urlencode(query)
+    try:
+        report = get_json(url)
+    except (urllib.error.URLError, OSError) as e:
+        print(f"Cannot get {url}: {e}", file=sys.stderr)
+        return 1
+
+    slowest = None
+    for name in STAGES:
+        stage = report["stages"][name]
+        if stage["n"] == 0:
+            print(f"LATENCY stage={name} n=0 skewed={stage['skewed']}")
+            continue
+        print(f"LATENCY stage={name} n={stage['n']} p50_ms={stage['p50_ms']} "
+              f"p95_ms={stage['p95_ms']} p99_ms={stage['p99_ms']} "
+              f"max_ms={stage['max_ms']} skewed={stage['skewed']}")
+        if slowest is None or stage["p95_ms"] > report["stages"][slowest]["p95_ms"]:
+            slowest = name
+    print(f"LATENCY_TOTAL traces={report['traces']} untimed={report['untimed']} "
+          f"slowest={slowest or '-'}")
+    if report["untimed"] or any(report["stages"][s]["skewed"] for s in STAGES):
+        print("Untimed or skewed readings: the device clock was not synced "
+              "(is ntp-server running?)", file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,61 @@
+#!/bin/bash
+# Request throughput of the on-device HTTP server (components/local_api)
+# Usage: ./local-api-bench.sh [local-api-load.py options]
+# Example: docker compose run --rm esp32-dev /workspace/scripts/local-api-bench.sh
+#          docker compose run --rm esp32-dev /workspace/scripts/local-api-bench.sh --clients 1,3,6
+#
+# Builds projects/03-rest-api and boots it headless over slirp, with guest
+# port 80 forwarded to LOCAL_API_HOST_PORT (default 8080) here. Once the
+# server is up it waits LOCAL_API_WARMUP seconds (default 30) so the ring
+# holds a few readings, then runs local-api-load.py against the device.
+#
+# The api-server does not need to run: the firmware keeps sampling into
+# the ring without it, which is the case local pull is for.
+# SENSOR_TRACE (see sensor-trace.py) is written into the image as usual.
+# UART log: projects/03-rest-api/build/local-api-bench.log
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+WORKSPACE="$(dirname "${SCRIPT_DIR}")"
+source "${SCRIPT_DIR}/pipeline-lib.sh"
+
+PROJECT="${WORKSPACE}/projects/03-rest-api"
+HOST_PORT=${LOCAL_API_HOST_PORT:-8080}
+WARMUP=${LOCAL_API_WARMUP:-30}
+TIMEOUT=${LOCAL_API_TIMEOUT:-120}
+if [ -n "${SENSOR_TRACE:-}" ]; then
+    SENSOR_TRACE=$(realpath "${SENSOR_TRACE}")
+fi
+
+"${SCRIPT_DIR}/build.sh" "${PROJECT}"
+
+cd "${PROJECT}"
+prepare_flash_image build/merged-qemu.bin \
+    0x10000 "build/$(python3 -c "import json;print(json.load(open('build/project_description.json'))['app_bin'])")" \
+    0x1000 build/bootloader/bootloader.bin \
+    0x8000 build/partition_table/partition-table.bin
+write_sensor_trace build/merged-qemu.bin
+
+cleanup() {
+    if [ -n "${QEMU_PID:-}" ]; then
+        kill "${QEMU_PID}" 2>/dev/null || true
+    fi
+}
+trap cleanup EXIT
+
+echo "=========================================="
+echo "Local API benchmark (port ${HOST_PORT} -> device :80)"
+echo "=========================================="
+log=build/local-api-bench.log
+qemu_start_headless build/merged-qemu.bin "${log}" \
+    $(qemu_net_args user "" "${HOST_PORT}:80")
+if ! wait_for_uart "${log}" "^LOCAL_API port=" "${TIMEOUT}"; then
+    echo "Server not up within ${TIMEOUT}s, see ${PROJECT}/${log}"
+    exit 1
+fi
+grep "^LOCAL_API port=" "${log}"
+echo "Sampling for ${WARMUP}s before the first request..."
+sleep "${WARMUP}"
+
+python3 "${SCRIPT_DIR}/local-api-load.py" --url "http://127.0.0.1:${HOST_PORT}" "$@"
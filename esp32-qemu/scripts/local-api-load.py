@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+"""
+Load generator for the on-device HTTP server (components/local_api)
+IoT Course - Spring 2026
+
+For each client count in --clients and each path in --paths, runs that
+many clients for --duration seconds. Every client keeps one connection
+open (HTTP/1.1 keep-alive) and sends its GETs back to back. One line each:
+
+  LOCAL_API_BENCH path=/readings clients=2 requests=412 rps=41.2
+      p50_ms=38.1 p95_ms=61.0 kbps=52.4 errors=0 reconnects=0
+
+With more clients than CONFIG_LOCAL_API_MAX_SOCKETS, the device closes
+the least recently used connection for each new one. Those show up as
+errors and reconnects, while the device's RAM stays the same. The device's
+own counters from GET /metrics follow at the end.
+
+Standard library only. local-api-bench.sh boots the firmware and runs
+this; against a device started by hand:
+
+  QEMU_NET=1 QEMU_HOSTFWD=8080:80 ./scripts/run-qemu.sh projects/03-rest-api
+  python3 scripts/local-api-load.py --url http://127.0.0.1:8080
+"""
+
+import argparse
+import http.client
+import threading
+import time
+import urllib.parse
+
+
+def client(host, port, path, deadline, results):
+    latencies = []
+    received = 0
+    errors = 0
+    connects = 0
+    conn = None
+    while time.monotonic() < deadline:
+        if conn is None:
+            conn = http.client.HTTPConnection(host, port, timeout=10)
+            connects += 1
+        start = time.monotonic()
+        try:
+            conn.request("GET", path)
+            resp = conn.getresponse()
+            body = resp.read()
+            if resp.status == 200:
+                latencies.append(time.monotonic() - start)
+                received += len(body)
+            else:
+                errors += 1
+            if resp.will_close:
+                conn.close()
+                conn = None
+        except (OSError, http.client.HTTPException):
+            errors += 1
+            conn.close()
+            conn = None
+            time.sleep(0.05)
+    if conn is not None:
+        conn.close()
+    results.append((latencies, received, errors, max(0, connects - 1)))
+
+
+def percentile(values, pct):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * pct / 100))]
+
+
+def run_step(host, port, path, clients, duration):
+    results = []
+    deadline = time.monotonic() + duration
+    threads = [threading.Thread(target=client, args=(host, port, path, deadline, results))
+               for _ in range(clients)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+
+    latencies = [x for r in results for x in r[0]]
+    received = sum(r[1] for r in results)
+    print("LOCAL_API_BENCH path=%s clients=%d requests=%d rps=%.1f p50_ms=%.1f p95_ms=%.1f "
+          "kbps=%.1f errors=%d reconnects=%d" % (
+              path, clients, len(latencies), len(latencies) / duration,
+              percentile(latencies, 50) * 1000, percentile(latencies, 95) * 1000,
+              received * 8 / 1000 / duration, sum(r[2] for r in results),
+              sum(r[3] for r in results)), flush=True)
+
+
+def print_device_metrics(host, port):
+    conn = http.client.HTTPConnection(host, port, timeout=10)
+    try:
+        conn.request("GET", "/metrics")
+        text = conn.getresponse().read().decode()
+    except (OSError, http.client.HTTPException) as e:
+        print("GET /metrics failed: %s" % e)
+        return
+    finally:
+        conn.close()
+    print("Device counters (GET /metrics):")
+    for line in text.splitlines():
+        if line.startswith(("local_api_", "readings_", "heap_")):
+            print("  " + line)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--url", default="http://127.0.0.1:8080")
+    parser.add_argument("--clients", default="1,2,3,6",
+                        help="comma-separated client counts (default 1,2,3,6)")
+    parser.add_argument("--paths", default="/readings,/readings?limit=10,/metrics,/config",
+                        help="comma-separated request paths")
+    parser.add_argument("--duration", type=float, default=10.0,
+                        help="seconds per step (default 10)")
+    args = parser.parse_args()
+
+    url = urllib.parse.urlsplit(args.url)
+    for path in args.paths.split(","):
+        for clients in (int(c) for c in args.clients.split(",")):
+            run_step(url.hostname, url.port or 80, path, clients, args.duration)
+    print_device_metrics(url.hostname, url.port or 80)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,117 @@
+#!/bin/bash
+# Compare QEMU networking modes: TCP connect, round trip and throughput
+# Usage: ./net-bench.sh [shaping options]
+# Example: docker compose run --rm esp32-dev /workspace/scripts/net-bench.sh
+#          docker compose run --rm esp32-dev /workspace/scripts/net-bench.sh --delay 20 --loss 1
+#
+# Builds projects/06-net-throughput and runs it once over slirp
+# (QEMU_NET=1) and once on the virtual switch (QEMU_NET=bridge, vnet.sh),
+# both against net-sink.py in this container, then prints the NETBENCH
+# results side by side. Shaping options (see vnet.sh) apply to the bridged
+# link; slirp cannot shape.
+#
+# NETBENCH_MODES="user bridge" selects the modes, NETBENCH_TIMEOUT (s) caps
+# each run. UART logs: projects/06-net-throughput/build/netbench-<mode>.log
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+WORKSPACE="$(dirname "${SCRIPT_DIR}")"
+source "${SCRIPT_DIR}/pipeline-lib.sh"
+
+PROJECT="${WORKSPACE}/projects/06-net-throughput"
+MODES=${NETBENCH_MODES:-"user bridge"}
+TIMEOUT=${NETBENCH_TIMEOUT:-180}
+TAP=qemu99
+SINK_PORT=5001
+
+"${SCRIPT_DIR}/build.sh" "${PROJECT}"
+
+cd "${PROJECT}"
+prepare_flash_image build/merged-qemu.bin \
+    0x10000 "build/$(python3 -c "import json;print(json.load(open('build/project_description.json'))['app_bin'])")" \
+    0x1000 build/bootloader/bootloader.bin \
+    0x8000 build/partition_table/partition-table.bin
+
+SINK_PID=""
+CREATED_SWITCH=0
+cleanup() {
+    if [ -n "${QEMU_PID:-}" ]; then
+        kill "${QEMU_PID}" 2>/dev/null || true
+    fi
+    if [ -n "${SINK_PID}" ]; then
+        kill "${SINK_PID}" 2>/dev/null || true
+    fi
+    if [ -d "/sys/class/net/${TAP}" ]; then
+        "${SCRIPT_DIR}/vnet.sh" del "${TAP}" > /dev/null
+    fi
+    if [ "${CREATED_SWITCH}" = "1" ]; then
+        "${SCRIPT_DIR}/vnet.sh" down > /dev/null
+    fi
+}
+trap cleanup EXIT
+
+python3 "${SCRIPT_DIR}/net-sink.py" --port "${SINK_PORT}" > build/net-sink.log 2>&1 &
+SINK_PID=$!
+
+for mode in ${MODES}; do
+    if [ "${mode}" = "bridge" ]; then
+        if [ ! -d "/sys/class/net/${VNET_BRIDGE:-br-qemu}" ]; then
+            "${SCRIPT_DIR}/vnet.sh" up
+            CREATED_SWITCH=1
+        fi
+        "${SCRIPT_DIR}/vnet.sh" add "${TAP}" "$@"
+    fi
+
+    echo "=========================================="
+    echo "Network benchmark: ${mode}"
+    echo "=========================================="
+    log="build/netbench-${mode}.log"
+    qemu_start_headless build/merged-qemu.bin "${log}" $(qemu_net_args "${mode}" "${TAP}")
+    if wait_for_uart "${log}" "^NETBENCH_DONE" "${TIMEOUT}"; then
+        grep "^NETBENCH test=" "${log}" || true
+    else
+        echo "No result within ${TIMEOUT}s, see ${PROJECT}/${log}"
+    fi
+    kill "${QEMU_PID}" 2>/dev/null || true
+    wait "${QEMU_PID}" 2>/dev/null || true
+    QEMU_PID=""
+
+    if [ "${mode}" = "bridge" ]; then
+        "${SCRIPT_DIR}/vnet.sh" del "${TAP}" > /dev/null
+    fi
+done
+
+# ----------------------------------------------------------------
+# Side-by-side summary
+# ----------------------------------------------------------------
+echo "=========================================="
+echo "Results (shaping: ${*:-none})"
+echo "=========================================="
+awk -v modes="${MODES}" '
+    BEGIN {
+        n = split(modes, m, " ")
+        split("connect_us rtt_med_us rtt_max_us up_kbps down_kbps", metrics, " ")
+    }
+    FNR == 1 { mode = FILENAME; sub(/.*netbench-/, "", mode); sub(/\.log$/, "", mode) }
+    /^NETBENCH test=/ {
+        delete kv
+        for (i = 2; i <= NF; i++) { split($i, p, "="); kv[p[1]] = p[2] }
+        t = kv["test"]
+        if (t == "connect") v[mode, "connect_us"] = kv["us"]
+        if (t == "rtt") { v[mode, "rtt_med_us"] = kv["med_us"]; v[mode, "rtt_max_us"] = kv["max_us"] }
+        if (t == "up" || t == "down") v[mode, t "_kbps"] = kv["kbps"]
+    }
+    END {
+        printf "  %-12s", "METRIC"
+        for (i = 1; i <= n; i++) printf " %12s", (m[i] == "user" ? "slirp" : m[i])
+        printf "\n"
+        for (j = 1; j <= 5; j++) {
+            printf "  %-12s", metrics[j]
+            for (i = 1; i <= n; i++) {
+                x = v[m[i], metrics[j]]
+                printf " %12s", (x == "" ? "-" : x)
+            }
+            printf "\n"
+        }
+    }' $(for mode in ${MODES}; do echo "build/netbench-${mode}.log"; done)
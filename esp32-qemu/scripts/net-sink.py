@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""
+TCP sink/source for the network throughput benchmark
+IoT Course - Spring 2026
+
+projects/06-net-throughput connects here and sends one command line:
+
+  ECHO\\n      echo everything back (round-trip test)
+  UP <n>\\n    read n bytes, then answer "OK <n>\\n"
+  DOWN <n>\\n  send n bytes
+
+Runs in the esp32-dev container (scripts/net-bench.sh starts it), where
+both slirp and the virtual switch reach it at 10.0.2.2.
+
+Usage: net-sink.py [--port 5001]
+"""
+
+import argparse
+import socketserver
+import sys
+
+CHUNK = 64 * 1024
+
+
+class SinkHandler(socketserver.StreamRequestHandler):
+    def handle(self):
+        line = self.rfile.readline(64).decode(errors="replace").split()
+        if not line:
+            return
+        cmd = line[0]
+        n = int(line[1]) if len(line) > 1 and line[1].isdigit() else 0
+
+        if cmd == "ECHO":
+            while True:
+                data = self.rfile.read1(CHUNK)
+                if not data:
+                    break
+                self.wfile.write(data)
+                self.wfile.flush()
+        elif cmd == "UP":
+            remaining = n
+            while remaining > 0:
+                data = self.rfile.read1(min(CHUNK, remaining))
+                if not data:
+                    break
+                remaining -= len(data)
+            if remaining == 0:
+                self.wfile.write(b"OK %d\n" % n)
+        elif cmd == "DOWN":
+            block = b"\x5a" * CHUNK
+            remaining = n
+            while remaining > 0:
+                part = block[:min(CHUNK, remaining)]
+                self.wfile.write(part)
+                remaining -= len(part)
+        else:
+            return
+        print("%s %s %s" % (self.client_address[0], cmd, n or ""), flush=True)
+
+
+class Server(socketserver.ThreadingTCPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+
+
+def main():
+    parser = argparse.ArgumentParser(description="TCP sink for 06-net-throughput")
+    parser.add_argument("--port", type=int, default=5001)
+    args = parser.parse_args()
+
+    with Server(("0.0.0.0", args.port), SinkHandler) as server:
+        print("net-sink listening on port %d" % args.port, flush=True)
+        try:
+            server.serve_forever()
+        except KeyboardInterrupt:
+            pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
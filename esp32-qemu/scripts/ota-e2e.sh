@@ -0,0 +1,123 @@
+#!/bin/bash
+# Delta OTA end to end: one device updates itself from the api-server
+# Usage: ./ota-e2e.sh [project]
+# Example: docker compose up -d api-server mqtt-broker
+#          docker compose run --rm esp32-dev /workspace/scripts/ota-e2e.sh 03-rest-api
+#
+# Builds the project twice: release 1 as it is, release 2 with
+# scripts/sdkconfig.ota-v2 (a new version string). Release 1 is uploaded as
+# well, so the server can build a delta for it. Release 2 is uploaded
+# last (it becomes the latest). QEMU then boots a fresh flash image with
+# release 1, which must:
+#   1. download the delta and restart into ota_1     DELTA_OTA result=applied
+#   2. confirm release 2 after reaching the server  DELTA_OTA confirmed
+#   3. find nothing newer                           DELTA_OTA result=up_to_date
+#
+# API_URL (default http://api-server:5000) is where releases are uploaded;
+# the guest reaches the same server at 10.0.2.2. OTA_TIMEOUT (s) caps the
+# run. UART log: projects/<project>/build/ota-e2e.log
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+WORKSPACE="$(dirname "${SCRIPT_DIR}")"
+source "${SCRIPT_DIR}/pipeline-lib.sh"
+
+PROJECT="${WORKSPACE}/projects/${1:-03-rest-api}"
+API_URL=${API_URL:-http://api-server:5000}
+TIMEOUT=${OTA_TIMEOUT:-180}
+
+app_bin() {
+    echo "build/$(python3 -c "import json;print(json.load(open('build/project_description.json'))['app_bin'])")"
+}
+
+upload() {
+    local file=$1
+    local version=$2
+    python3 - "${file}" "${API_URL}/api/ota/images?project=${NAME}&version=${version}" <<'PY'
+import sys, urllib.request
+
+with open(sys.argv[1], "rb") as f:
+    req = urllib.request.Request(sys.argv[2], data=f.read(), method="POST",
+                                 headers={"Content-Type": "application/octet-stream"})
+print(urllib.request.urlopen(req).read().decode().strip())
+PY
+}
+
+# ----------------------------------------------------------------
+# Two releases
+# ----------------------------------------------------------------
+stage_begin build-v1
+SDKCONFIG_OVERLAY="" "${SCRIPT_DIR}/build.sh" "${PROJECT}"
+stage_end
+cd "${PROJECT}"
+NAME=$(python3 -c "import json;print(json.load(open('build/project_description.json'))['project_name'])")
+cp "$(app_bin)" build/ota-v1.bin
+
+stage_begin build-v2
+SDKCONFIG_OVERLAY="${SCRIPT_DIR}/sdkconfig.ota-v2" "${SCRIPT_DIR}/build.sh" "${PROJECT}"
+stage_end
+cp "$(app_bin)" build/ota-v2.bin
+
+echo "Uploading releases of ${NAME} to ${API_URL}"
+upload build/ota-v1.bin 1.0.0
+upload build/ota-v2.bin 2.0.0
+
+# ----------------------------------------------------------------
+# Boot release 1 and watch it update. The guest's 10.0.2.2 is this
+# container, so the api-server ports are relayed to the compose service
+# (the same forwarder as qemu-test-runner.py)
+# ----------------------------------------------------------------
+FWD_PID=""
+cleanup() {
+    if [ -n "${QEMU_PID:-}" ]; then
+        kill "${QEMU_PID}" 2>/dev/null || true
+    fi
+    if [ -n "${FWD_PID}" ]; then
+        kill "${FWD_PID}" 2>/dev/null || true
+    fi
+}
+trap cleanup EXIT
+
+python3 - "${SCRIPT_DIR}/qemu-test-runner.py" <<'PY' &
+import importlib.util, sys, time
+
+spec = importlib.util.spec_from_file_location("runner", sys.argv[1])
+runner = importlib.util.module_from_spec(spec)
+spec.loader.exec_module(runner)
+runner.start_service_forwarders({"5000": "api-server:5000", "5443": "api-server:5443"})
+while True:
+    time.sleep(3600)
+PY
+FWD_PID=$!
+
+log=build/ota-e2e.log
+stage_begin ota-run
+QEMU_FRESH_FLASH=1 prepare_flash_image build/ota-e2e.bin \
+    0x10000 build/ota-v1.bin \
+    0x1000 build/bootloader/bootloader.bin \
+    0x8000 build/partition_table/partition-table.bin
+qemu_start_headless build/ota-e2e.bin "${log}" $(qemu_net_args user)
+
+result=FAIL
+for step in "^DELTA_OTA result=applied" "^DELTA_OTA confirmed" "^DELTA_OTA result=up_to_date"; do
+    if ! wait_for_uart "${log}" "${step}" "${TIMEOUT}"; then
+        echo "No '${step}' within ${TIMEOUT}s, see ${PROJECT}/${log}"
+        break
+    fi
+    if [ "${step}" = "^DELTA_OTA result=up_to_date" ]; then
+        result=PASS
+    fi
+done
+stage_end
+
+grep "^DELTA_OTA" "${log}" || true
+awk -v result="${result}" -v project="${NAME}" '
+    /^DELTA_OTA result=applied/ {
+        for (i = 2; i <= NF; i++) { split($i, p, "="); kv[p[1]] = p[2] }
+    }
+    END {
+        printf "OTA_E2E project=%s result=%s patch_bytes=%s image_bytes=%s ms=%s\n",
+               project, result, kv["patch_bytes"], kv["image_bytes"], kv["ms"]
+    }' "${log}"
+[ "${result}" = "PASS" ]
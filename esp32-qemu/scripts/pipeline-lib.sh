@@ -0,0 +1,324 @@
+#!/bin/bash
+# Shared helpers for the build/run scripts (sourced, not executed)
+#
+#   stage_begin / stage_end     time a pipeline stage
+#   timing_summary              print all stages timed so far
+#   prepare_flash_image         build or update merged-qemu.bin incrementally
+#   write_sensor_trace          put the SENSOR_TRACE pack into a flash image
+#   ccache_snapshot / _report   compiler cache hit rate of one build
+#   qemu_net_args / vnet_mac    QEMU NIC options for QEMU_NET
+#   qemu_start_headless         background QEMU instance with a UART log
+
+# ----------------------------------------------------------------
+# Stage timing
+# Each stage prints "TIMING stage=<name> ms=<n>". When PIPELINE_TIMING_LOG
+# names a file, the stage is also appended there so a wrapper script
+# (build-and-run.sh) can print one summary for build + run.
+# ----------------------------------------------------------------
+now_ms() {
+    echo $(( $(date +%s%N) / 1000000 ))
+}
+
+stage_begin() {
+    STAGE_NAME=$1
+    STAGE_START_MS=$(now_ms)
+}
+
+stage_end() {
+    local ms=$(( $(now_ms) - STAGE_START_MS ))
+    echo "TIMING stage=${STAGE_NAME} ms=${ms}"
+    if [ -n "${PIPELINE_TIMING_LOG:-}" ]; then
+        echo "${STAGE_NAME} ${ms}" >> "${PIPELINE_TIMING_LOG}"
+    fi
+}
+
+timing_summary() {
+    local log=${1:-${PIPELINE_TIMING_LOG:-}}
+    if [ -z "${log}" ] || [ ! -s "${log}" ]; then
+        return 0
+    fi
+    echo "=========================================="
+    echo "Stage timing"
+    echo "=========================================="
+    awk '{ printf "  %-14s %8d ms\n", $1, $2; total += $2 }
+         END { printf "  %-14s %8d ms\n", "total", total }' "${log}"
+}
+
+# ----------------------------------------------------------------
+# Flash image for QEMU
+#
+# Usage: prepare_flash_image <image> <app_offset> <app_bin> <offset> <file> ...
+#
+# The <offset> <file> pairs are the parts that rarely change (bootloader,
+# partition table). A full 4 MB merge_bin only runs when one of them
+# changes or there is no image yet. When only the app changed, it is
+# written in place at <app_offset>, and whatever a larger previous app left
+# behind is erased to 0xFF (the merge_bin fill value).
+#
+# Patching in place keeps anything QEMU wrote to the other partitions (NVS,
+# for example) across runs, like reflashing only the app on real hardware
+# does. The exception is the otadata partition of a two-slot table
+# (components/delta_ota): it is erased, so the bootloader starts the new
+# build in ota_0 rather than an image an earlier run installed in ota_1,
+# as "idf.py flash" does. Set QEMU_FRESH_FLASH=1 to start from a freshly
+# merged image.
+#
+# The checksums of the inputs are kept in <image>.inputs.
+# ----------------------------------------------------------------
+file_sum() {
+    sha256sum < "$1" | cut -d' ' -f1
+}
+
+# Erase otadata (data partition, subtype ota) if the table at 0x8000 has one
+erase_otadata() {
+    python3 - "$1" <<'EOF'
+import struct, sys
+
+with open(sys.argv[1], "r+b") as f:
+    f.seek(0x8000)
+    table = f.read(0xC00)
+    for i in range(0, len(table), 32):
+        magic, ptype, subtype, offset, size = struct.unpack_from("<HBBII", table, i)
+        if magic != 0x50AA:
+            break
+        if ptype == 0x01 and subtype == 0x00:
+            f.seek(offset)
+            f.write(b"\xff" * size)
+            print(f"Flash image: erased otadata at 0x{offset:x}")
+EOF
+}
+
+prepare_flash_image() {
+    local image=$1
+    local app_offset=$2
+    local app_bin=$3
+    shift 3
+
+    local parts=()
+    local fixed=""
+    while [ $# -gt 0 ]; do
+        parts+=("$1" "$2")
+        fixed="${fixed}$1 $(file_sum "$2");"
+        shift 2
+    done
+
+    local fixed_sum app_sum app_size
+    fixed_sum=$(printf '%s' "${fixed}" | sha256sum | cut -d' ' -f1)
+    app_sum=$(file_sum "${app_bin}")
+    app_size=$(stat -c %s "${app_bin}")
+
+    local stamp="${image}.inputs"
+    local old_fixed="" old_app="" old_size=0
+    if [ -f "${image}" ] && [ -f "${stamp}" ] && [ "${QEMU_FRESH_FLASH:-0}" != "1" ]; then
+        read -r old_fixed old_app old_size < "${stamp}"
+    fi
+
+    if [ "${old_fixed}" != "${fixed_sum}" ]; then
+        echo "Flash image: full merge (new image or bootloader/partition table changed)"
+        python3 -m esptool --chip esp32 merge_bin \
+            --fill-flash-size 4MB \
+            -o "${image}" \
+            --flash_mode dio \
+            --flash_size 4MB \
+            "${parts[@]}" \
+            "${app_offset}" "${app_bin}" > /dev/null
+        # merge_bin left the trace partition erased (write_sensor_trace)
+        echo "none" > "${image}.trace"
+    elif [ "${old_app}" != "${app_sum}" ]; then
+        # merge_bin only rewrites the bootloader header, so the app bytes
+        # can be copied as they are
+        echo "Flash image: patching app at ${app_offset} (${app_size} bytes)"
+        dd if="${app_bin}" of="${image}" bs=64K \
+            oflag=seek_bytes seek=$(( app_offset )) conv=notrunc status=none
+        if [ "${old_size}" -gt "${app_size}" ]; then
+            head -c $(( old_size - app_size )) /dev/zero | tr '\0' '\377' | \
+                dd of="${image}" bs=64K \
+                    oflag=seek_bytes seek=$(( app_offset + app_size )) \
+                    conv=notrunc status=none
+        fi
+        erase_otadata "${image}"
+    else
+        echo "Flash image: up to date"
+    fi
+
+    echo "${fixed_sum} ${app_sum} ${app_size}" > "${stamp}"
+}
+
+# ----------------------------------------------------------------
+# Sensor traces (components/sensor_replay)
+#
+# Usage: write_sensor_trace <image>
+#
+# Writes the trace pack named by SENSOR_TRACE (scripts/sensor-trace.py)
+# at the trace partition and erases the rest of it. Without SENSOR_TRACE
+# the range is only erased, so a pack from an earlier run never leaks into
+# one that did not ask for it; the firmware then falls back to simulated
+# readings. Only for ESP-IDF images: the Arduino table has SPIFFS there.
+#
+# The checksum of the pack (or "none") is kept in <image>.trace, and the
+# partition is only rewritten when it changes; prepare_flash_image resets
+# it to "none" after a full merge.
+# ----------------------------------------------------------------
+SENSOR_TRACE_OFFSET=0x310000
+SENSOR_TRACE_BYTES=$(( 0xF0000 ))
+
+write_sensor_trace() {
+    local image=$1
+    local size=0
+    local sum="none" old_sum=""
+
+    if [ -n "${SENSOR_TRACE:-}" ]; then
+        if [ ! -f "${SENSOR_TRACE}" ]; then
+            echo "Error: no trace pack ${SENSOR_TRACE}" >&2
+            echo "Create one with: python3 scripts/sensor-trace.py generate -o ${SENSOR_TRACE}" >&2
+            return 1
+        fi
+        size=$(stat -c %s "${SENSOR_TRACE}")
+        if [ "${size}" -gt "${SENSOR_TRACE_BYTES}" ]; then
+            echo "Error: ${SENSOR_TRACE} is ${size} bytes, the trace partition ${SENSOR_TRACE_BYTES}" >&2
+            return 1
+        fi
+        sum=$(file_sum "${SENSOR_TRACE}")
+    fi
+
+    local stamp="${image}.trace"
+    if [ -f "${stamp}" ]; then
+        read -r old_sum < "${stamp}"
+    fi
+    if [ "${old_sum}" = "${sum}" ]; then
+        return 0
+    fi
+
+    if [ "${size}" -gt 0 ]; then
+        echo "Flash image: sensor trace ${SENSOR_TRACE} at ${SENSOR_TRACE_OFFSET} (${size} bytes)"
+    else
+        echo "Flash image: erasing sensor trace partition"
+    fi
+    { [ "${size}" -eq 0 ] || cat "${SENSOR_TRACE}"
+      head -c $(( SENSOR_TRACE_BYTES - size )) /dev/zero | tr '\0' '\377'
+    } | dd of="${image}" bs=64K iflag=fullblock \
+           oflag=seek_bytes seek=$(( SENSOR_TRACE_OFFSET )) conv=notrunc status=none
+    echo "${sum}" > "${stamp}"
+}
+
+# ----------------------------------------------------------------
+# Compiler cache statistics
+# The ccache counters are shared by every build using the cache (the test
+# runner builds in parallel), so a build reports the difference between a
+# snapshot taken before and after it instead of zeroing them.
+# ----------------------------------------------------------------
+ccache_snapshot() {
+    if ! command -v ccache > /dev/null; then
+        return 0
+    fi
+    ccache --print-stats 2>/dev/null | awk '
+        { v[$1] = $2 }
+        END { print v["direct_cache_hit"] + v["preprocessed_cache_hit"],
+                    v["cache_miss"] + 0, v["cache_size_kibibyte"] + 0 }'
+}
+
+ccache_report() {
+    local before=$1
+    if [ -z "${before}" ]; then
+        return 0
+    fi
+    local h0 m0 h1 m1 size_kib
+    read -r h0 m0 _ <<< "${before}"
+    read -r h1 m1 size_kib <<< "$(ccache_snapshot)"
+
+    local hits=$(( h1 - h0 ))
+    local misses=$(( m1 - m0 ))
+    local total=$(( hits + misses ))
+    local rate=0
+    if [ "${total}" -gt 0 ]; then
+        rate=$(( hits * 100 / total ))
+    fi
+    echo "CCACHE hits=${hits} misses=${misses} hit_rate=${rate}% cache_mb=$(( size_kib / 1024 ))"
+}
+
+# ----------------------------------------------------------------
+# QEMU networking
+#
+# Usage: qemu_net_args <mode> [tap] [forwards]
+#   0       no NIC
+#   1|user  slirp: private NAT network per instance, host at 10.0.2.2
+#   bridge  the tap <tap> (default qemu0) on the scripts/vnet.sh switch
+#
+# forwards ("8080:80 ...", host:guest TCP ports) makes guest servers
+# reachable on this machine's ports under slirp. On the switch the guest
+# has its own address, so there is nothing to forward.
+#
+# On the switch every instance needs its own MAC. vnet_mac derives it from
+# the number in the tap name: qemu3 -> 02:00:00:00:00:03.
+# ----------------------------------------------------------------
+vnet_mac() {
+    local n=${1//[!0-9]/}
+    n=$(( 10#${n:-0} ))
+    printf '02:00:00:00:%02x:%02x\n' $(( n / 256 % 256 )) $(( n % 256 ))
+}
+
+qemu_net_args() {
+    local mode=${1:-0}
+    local tap=${2:-qemu0}
+    local forwards=${3:-}
+    case "${mode}" in
+        0)
+            ;;
+        1|user)
+            local nic="user,model=open_eth"
+            local fwd
+            for fwd in ${forwards}; do
+                nic="${nic},hostfwd=tcp::${fwd%%:*}-:${fwd##*:}"
+            done
+            echo "-nic ${nic}"
+            ;;
+        bridge)
+            if [ ! -d "/sys/class/net/${tap}" ]; then
+                echo "Error: no link ${tap}, create it with: scripts/vnet.sh add ${tap}" >&2
+                return 1
+            fi
+            echo "-nic tap,model=open_eth,ifname=${tap},script=no,downscript=no,mac=$(vnet_mac "${tap}")"
+            ;;
+        *)
+            echo "Error: unknown QEMU_NET mode '${mode}' (0, 1, bridge)" >&2
+            return 1
+            ;;
+    esac
+}
+
+# ----------------------------------------------------------------
+# Headless QEMU instances (net-bench.sh, vnet-fleet.sh)
+#
+# Usage: qemu_start_headless <image> <uart.log> [qemu args...]
+# Starts QEMU in the background with the UART in <uart.log> and sets
+# QEMU_PID. The flash image is opened copy-on-write (snapshot=on), so any
+# number of instances can boot the same image.
+#
+# Usage: wait_for_uart <uart.log> <regex> <timeout_s>
+# Returns 0 once a line matches, 1 on timeout.
+# ----------------------------------------------------------------
+qemu_start_headless() {
+    local image=$1
+    local log=$2
+    shift 2
+    qemu-system-xtensa \
+        -machine esp32 \
+        -display none -monitor none \
+        -drive file="${image}",if=mtd,format=raw,snapshot=on \
+        -serial stdio \
+        "$@" < /dev/null > "${log}" 2>&1 &
+    QEMU_PID=$!
+}
+
+wait_for_uart() {
+    local log=$1
+    local regex=$2
+    local deadline=$(( $(date +%s) + $3 ))
+    while [ "$(date +%s)" -lt "${deadline}" ]; do
+        if grep -qE "${regex}" "${log}" 2>/dev/null; then
+            return 0
+        fi
+        sleep 1
+    done
+    return 1
+}
@@ -0,0 +1,89 @@
+#!/bin/bash
+# Compare sampling jitter with pinned vs floating task placement
+# Usage: ./placement-bench.sh <project_path> [seconds]
+# Example: ./placement-bench.sh /workspace/projects/04-mqtt 70
+#
+# Builds the project twice (build-pinned/, build-floating/), runs each in
+# QEMU for the given time and compares the JITTER / THROUGHPUT lines the
+# firmware prints (see components/task_placement).
+# Network projects need their backend services running (QEMU_NET=1).
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "${SCRIPT_DIR}/pipeline-lib.sh"
+PROJECT_PATH=${1:-.}
+DURATION=${2:-60}
+
+if [ ! -f "${PROJECT_PATH}/CMakeLists.txt" ]; then
+    echo "Error: No CMakeLists.txt found in ${PROJECT_PATH}"
+    echo "Usage: ./placement-bench.sh <project_path> [seconds]"
+    exit 1
+fi
+
+cd "${PROJECT_PATH}"
+PROJECT_NAME=$(basename "$(pwd)")
+
+NETWORK_ARGS=""
+if [ "${QEMU_NET:-0}" = "1" ]; then
+    NETWORK_ARGS="-nic user,model=open_eth"
+fi
+
+# Project defaults first, then the variant overlay
+BASE_DEFAULTS=""
+if [ -f sdkconfig.defaults ]; then
+    BASE_DEFAULTS="sdkconfig.defaults;"
+fi
+
+run_variant() {
+    local variant=$1
+    local defaults=$2
+    local build="build-${variant}"
+
+    echo "=========================================="
+    echo "[${variant}] Building ${PROJECT_NAME}"
+    echo "=========================================="
+    idf.py -B "${build}" \
+        -D SDKCONFIG="${build}/sdkconfig" \
+        -D SDKCONFIG_DEFAULTS="${defaults}" \
+        build > "${build}.build.log" 2>&1 || {
+            echo "Build failed, see ${build}.build.log"
+            exit 1
+        }
+
+    local app_bin
+    app_bin=$(python3 -c "import json;print(json.load(open('${build}/project_description.json'))['app_bin'])")
+    prepare_flash_image "${build}/merged-qemu.bin" \
+        0x10000 "${build}/${app_bin}" \
+        0x1000 "${build}/bootloader/bootloader.bin" \
+        0x8000 "${build}/partition_table/partition-table.bin" > /dev/null
+
+    echo "[${variant}] Running in QEMU for ${DURATION}s..."
+    timeout "${DURATION}" qemu-system-xtensa \
+        -nographic \
+        -machine esp32 \
+        -drive file="${build}/merged-qemu.bin",if=mtd,format=raw \
+        -serial stdio \
+        -monitor none \
+        ${NETWORK_ARGS} > "${build}.run.log" 2>&1 || true
+}
+
+run_variant pinned "${BASE_DEFAULTS%;}"
+run_variant floating "${BASE_DEFAULTS}${SCRIPT_DIR}/sdkconfig.placement-off"
+
+# Keep the last report per task from each run
+summarize() {
+    grep -a -E '^(JITTER|THROUGHPUT) ' "$1" | \
+        awk '{ last[$1 " " $2] = $0 } END { for (k in last) print last[k] }' | sort
+}
+
+echo ""
+echo "=========================================="
+echo "Placement benchmark: ${PROJECT_NAME} (${DURATION}s per run)"
+echo "=========================================="
+echo "--- pinned (sensing on APP_CPU, network on PRO_CPU) ---"
+summarize build-pinned.run.log
+echo "--- floating (tskNO_AFFINITY everywhere) ---"
+summarize build-floating.run.log
+echo "=========================================="
+echo "mad_us = mean absolute deviation from the nominal period"
@@ -0,0 +1,474 @@
+#!/usr/bin/env python3
+"""
+Headless parallel QEMU test runner
+IoT Course - Spring 2026
+
+Builds every ESP-IDF project and Arduino sketch listed in qemu-tests.json,
+boots each one in its own QEMU instance and checks the UART output against
+the expected patterns, in order, with a timeout.
+
+  - Builds run in parallel (--build-jobs) through build.sh / arduino-build.sh,
+    so they are incremental like interactive builds.
+  - Each test boots a private copy-on-write view of its flash image
+    (snapshot=on), so parallel runs never see each other's NVS writes.
+  - Network tests get their own slirp stack (-nic user). The firmware talks
+    to 10.0.2.2, which slirp maps to this container's loopback; one shared
+    forwarder relays those ports to the compose services.
+  - "hostfwd" guest ports get a free host port per instance.
+  - "helpers" (e.g. net-sink.py for 06-net-throughput) are started once,
+    before the first test that lists them, and stopped at the end.
+  - ESP-IDF images get the sensor trace pack named by --trace (default
+    $SENSOR_TRACE) at the trace partition, so firmware with
+    components/sensor_replay replays the same readings on every run.
+
+Usage (inside the container, see ../run-tests.sh for the host wrapper):
+  python3 /workspace/scripts/qemu-test-runner.py              # all tests
+  python3 /workspace/scripts/qemu-test-runner.py 0* espidf_*  # by name (glob)
+  python3 /workspace/scripts/qemu-test-runner.py --list
+  Options: -j N (QEMU instances), --build-jobs N, --no-build,
+           --report results.json, --log-dir DIR, --trace PACK
+
+Logs: <log-dir>/<name>.build.log and <name>.uart.log (lines prefixed with
+ms since QEMU start). Exit status is 0 only if every selected test passed.
+"""
+
+import argparse
+import concurrent.futures
+import fnmatch
+import json
+import os
+import re
+import shutil
+import signal
+import socket
+import subprocess
+import sys
+import threading
+import time
+
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+WORKSPACE = os.path.dirname(SCRIPT_DIR)
+
+IDF_BOOT_MARKER = r"main_task: Calling app_main\(\)"
+
+# Offsets of the flash image parts (same as run-qemu.sh)
+APP_OFFSET = "0x10000"
+BOOT_OFFSET = "0x1000"
+PART_OFFSET = "0x8000"
+
+
+# ----------------------------------------------------------------
+# Manifest
+# ----------------------------------------------------------------
+def load_manifest(path):
+    with open(path) as f:
+        manifest = json.load(f)
+    defaults = manifest.get("defaults", {})
+    tests = []
+    for entry in manifest["tests"]:
+        test = dict(defaults)
+        test.update(entry)
+        test.setdefault("net", False)
+        test.setdefault("hostfwd", [])
+        test.setdefault("helpers", [])
+        if "boot" not in test:
+            test["boot"] = IDF_BOOT_MARKER if test["kind"] == "idf" else test["expect"][0]
+        tests.append(test)
+    return manifest, tests
+
+
+def select_tests(tests, patterns):
+    if not patterns:
+        return tests
+    return [t for t in tests if any(fnmatch.fnmatch(t["name"], p) for p in patterns)]
+
+
+# ----------------------------------------------------------------
+# Build
+# ----------------------------------------------------------------
+class Result:
+    def __init__(self, name):
+        self.name = name
+        self.status = "PENDING"
+        self.detail = ""
+        self.build_ms = None
+        self.boot_ms = None
+        self.run_ms = None
+        self.image = None
+
+    def as_dict(self):
+        return {
+            "name": self.name,
+            "status": self.status,
+            "detail": self.detail,
+            "build_ms": self.build_ms,
+            "boot_ms": self.boot_ms,
+            "run_ms": self.run_ms,
+        }
+
+
+def sketch_dir_for(test, work_dir):
+    """arduino-cli wants <dir>/<dir>.ino; loose .ino files get a staging dir"""
+    path = os.path.join(WORKSPACE, test["path"])
+    if os.path.isdir(path):
+        return path
+    stem = os.path.splitext(os.path.basename(path))[0]
+    sketch_dir = os.path.join(work_dir, "sketches", stem)
+    os.makedirs(sketch_dir, exist_ok=True)
+    staged = os.path.join(sketch_dir, stem + ".ino")
+    # Only copy when changed, so arduino-cli can reuse its objects
+    if not os.path.exists(staged) or open(staged, "rb").read() != open(path, "rb").read():
+        shutil.copyfile(path, staged)
+    return sketch_dir
+
+
+def image_parts(test, work_dir):
+    """(project_dir, app_bin, bootloader, partition table) for a built test"""
+    if test["kind"] == "idf":
+        project = os.path.join(WORKSPACE, test["path"])
+        build = os.path.join(project, "build")
+        with open(os.path.join(build, "project_description.json")) as f:
+            app_bin = json.load(f)["app_bin"]
+        return (project,
+                os.path.join(build, app_bin),
+                os.path.join(build, "bootloader", "bootloader.bin"),
+                os.path.join(build, "partition_table", "partition-table.bin"))
+    sketch = sketch_dir_for(test, work_dir)
+    name = os.path.basename(sketch)
+    build = os.path.join(sketch, "build")
+    return (sketch,
+            os.path.join(build, name + ".ino.bin"),
+            os.path.join(build, name + ".ino.bootloader.bin"),
+            os.path.join(build, name + ".ino.partitions.bin"))
+
+
+def build_test(test, result, args):
+    log_path = os.path.join(args.log_dir, test["name"] + ".build.log")
+    start = time.monotonic()
+    with open(log_path, "w") as log:
+        if not args.no_build:
+            if test["kind"] == "idf":
+                cmd = [os.path.join(SCRIPT_DIR, "build.sh"), os.path.join(WORKSPACE, test["path"])]
+            else:
+                cmd = [os.path.join(SCRIPT_DIR, "arduino-build.sh"), sketch_dir_for(test, args.work_dir)]
+            if subprocess.call(cmd, stdout=log, stderr=subprocess.STDOUT) != 0:
+                result.status = "BUILD-FAIL"
+                result.detail = "see " + log_path
+                result.build_ms = int((time.monotonic() - start) * 1000)
+                return
+
+        try:
+            project, app, boot, part = image_parts(test, args.work_dir)
+        except (OSError, KeyError) as e:
+            result.status = "BUILD-FAIL"
+            result.detail = "no build output: %s" % e
+            return
+
+        # Separate from merged-qemu.bin: tests always boot a pristine image
+        # (interactive runs write NVS into theirs). Still incremental.
+        image = os.path.join(os.path.dirname(app), "qemu-test.bin")
+        script = ('source "%s/pipeline-lib.sh" && '
+                  'prepare_flash_image "$0" %s "$1" %s "$2" %s "$3"'
+                  % (SCRIPT_DIR, APP_OFFSET, BOOT_OFFSET, PART_OFFSET))
+        env = dict(os.environ, SENSOR_TRACE=args.trace or "")
+        if test["kind"] == "idf":
+            script += ' && write_sensor_trace "$0"'
+        if subprocess.call(["bash", "-c", script, image, app, boot, part],
+                           stdout=log, stderr=subprocess.STDOUT, env=env) != 0:
+            result.status = "BUILD-FAIL"
+            result.detail = "flash image failed, see " + log_path
+            return
+
+    result.build_ms = int((time.monotonic() - start) * 1000)
+    result.image = image
+    result.status = "BUILT"
+
+
+# ----------------------------------------------------------------
+# Backend services: 10.0.2.2:<port> in the guest is 127.0.0.1:<port> here
+# ("<port>/udp" entries are relayed as datagrams, e.g. SNTP)
+# ----------------------------------------------------------------
+def _pump(src, dst):
+    try:
+        while True:
+            data = src.recv(4096)
+            if not data:
+                break
+            dst.sendall(data)
+    except OSError:
+        pass
+    finally:
+        for s in (src, dst):
+            try:
+                s.shutdown(socket.SHUT_RDWR)
+            except OSError:
+                pass
+
+
+def _forward(listener, host, port):
+    while True:
+        client, _ = listener.accept()
+        try:
+            upstream = socket.create_connection((host, port), timeout=5)
+            upstream.settimeout(None)
+        except OSError:
+            client.close()
+            continue
+        threading.Thread(target=_pump, args=(client, upstream), daemon=True).start()
+        threading.Thread(target=_pump, args=(upstream, client), daemon=True).start()
+
+
+def _udp_replies(upstream, listener, client):
+    while True:
+        try:
+            data = upstream.recv(2048)
+        except OSError:
+            return
+        listener.sendto(data, client)
+
+
+def _forward_udp(listener, host, port):
+    # One upstream socket per guest address, so replies find their way back
+    upstreams = {}
+    while True:
+        data, client = listener.recvfrom(2048)
+        upstream = upstreams.get(client)
+        if upstream is None:
+            upstream = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            try:
+                upstream.connect((host, port))
+            except OSError:
+                upstream.close()
+                continue
+            upstreams[client] = upstream
+            threading.Thread(target=_udp_replies, args=(upstream, listener, client),
+                             daemon=True).start()
+        try:
+            upstream.send(data)
+        except OSError:
+            pass
+
+
+def start_service_forwarders(services):
+    for local, target in services.items():
+        local_port, _, proto = local.partition("/")
+        udp = proto == "udp"
+        host, port = target.rsplit(":", 1)
+        listener = socket.socket(socket.AF_INET,
+                                 socket.SOCK_DGRAM if udp else socket.SOCK_STREAM)
+        listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        try:
+            listener.bind(("127.0.0.1", int(local_port)))
+        except OSError:
+            print("  port %s already in use, assuming %s is reachable there" % (local, target))
+            listener.close()
+            continue
+        if udp:
+            threading.Thread(target=_forward_udp, args=(listener, host, int(port)),
+                             daemon=True).start()
+        else:
+            listener.listen(64)
+            threading.Thread(target=_forward, args=(listener, host, int(port)),
+                             daemon=True).start()
+        print("  10.0.2.2:%s -> %s" % (local, target))
+
+
+def start_helpers(helpers, names, log_dir):
+    """Start the named helper commands; returns their processes"""
+    procs = []
+    for name in sorted(names):
+        log = open(os.path.join(log_dir, "helper-%s.log" % name), "w")
+        procs.append(subprocess.Popen(helpers[name], cwd=WORKSPACE, stdout=log,
+                                      stderr=subprocess.STDOUT))
+        print("  %s: %s" % (name, " ".join(helpers[name])))
+    time.sleep(1 if procs else 0)     # Let servers bind before guests connect
+    return procs
+
+
+def free_port():
+    with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+# ----------------------------------------------------------------
+# Run
+# ----------------------------------------------------------------
+def run_test(test, result, args):
+    cmd = ["qemu-system-xtensa",
+           "-machine", "esp32",
+           "-display", "none",
+           "-monitor", "none",
+           "-serial", "stdio",
+           "-drive", "file=%s,if=mtd,format=raw,snapshot=on" % result.image]
+    if test["net"] or test["hostfwd"]:
+        nic = "user,model=open_eth"
+        forwards = []
+        for guest_port in test["hostfwd"]:
+            host_port = free_port()
+            nic += ",hostfwd=tcp:127.0.0.1:%d-:%d" % (host_port, guest_port)
+            forwards.append("%d->%d" % (host_port, guest_port))
+        cmd += ["-nic", nic]
+        if forwards:
+            result.detail = "hostfwd " + " ".join(forwards)
+    else:
+        cmd += ["-nic", "none"]
+
+    expect = [re.compile(p) for p in test["expect"]]
+    fail = [re.compile(p) for p in test.get("fail", [])]
+    boot = re.compile(test["boot"])
+    next_expect = 0
+
+    log_path = os.path.join(args.log_dir, test["name"] + ".uart.log")
+    start = time.monotonic()
+    # Own process group, so teardown also reaps anything QEMU started
+    proc = subprocess.Popen(cmd, stdin=subprocess.DEVNULL,
+                            stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                            start_new_session=True)
+    timed_out = threading.Event()
+
+    def kill(sig):
+        try:
+            os.killpg(proc.pid, sig)
+        except ProcessLookupError:
+            pass
+
+    def on_timeout():
+        timed_out.set()
+        kill(signal.SIGKILL)
+
+    watchdog = threading.Timer(test["timeout_s"], on_timeout)
+    watchdog.start()
+
+    status = None
+    detail = ""
+    with open(log_path, "w") as log:
+        for raw in proc.stdout:
+            ms = int((time.monotonic() - start) * 1000)
+            line = raw.decode("utf-8", errors="replace").rstrip("\r\n")
+            log.write("%8d %s\n" % (ms, line))
+
+            if result.boot_ms is None and boot.search(line):
+                result.boot_ms = ms
+            for pattern in fail:
+                if pattern.search(line):
+                    status, detail = "FAIL", line.strip()
+                    break
+            if status:
+                break
+            if expect[next_expect].search(line):
+                next_expect += 1
+                if next_expect == len(expect):
+                    status = "PASS"
+                    break
+
+    watchdog.cancel()
+    result.run_ms = int((time.monotonic() - start) * 1000)
+    kill(signal.SIGTERM)
+    try:
+        proc.wait(timeout=5)
+    except subprocess.TimeoutExpired:
+        kill(signal.SIGKILL)
+        proc.wait()
+
+    if status is None:
+        status = "TIMEOUT" if timed_out.is_set() else "FAIL"
+        detail = "waiting for /%s/" % test["expect"][next_expect]
+        if not timed_out.is_set():
+            detail = "QEMU exited (%d) %s" % (proc.returncode, detail)
+    result.status = status
+    if detail:
+        result.detail = (result.detail + "; " if result.detail else "") + detail
+
+
+# ----------------------------------------------------------------
+# Report
+# ----------------------------------------------------------------
+def fmt_ms(ms):
+    return "-" if ms is None else "%.1fs" % (ms / 1000.0)
+
+
+def print_report(results):
+    print("")
+    print("=" * 78)
+    print("%-26s %-10s %8s %8s %8s  %s" % ("TEST", "RESULT", "BUILD", "BOOT", "RUN", "DETAIL"))
+    print("-" * 78)
+    for r in results:
+        print("%-26s %-10s %8s %8s %8s  %s" % (r.name, r.status, fmt_ms(r.build_ms),
+                                              fmt_ms(r.boot_ms), fmt_ms(r.run_ms), r.detail))
+    print("=" * 78)
+    passed = sum(1 for r in results if r.status == "PASS")
+    print("%d/%d passed" % (passed, len(results)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Headless parallel QEMU test runner")
+    parser.add_argument("patterns", nargs="*", help="test names to run (glob)")
+    parser.add_argument("--manifest", default=os.path.join(SCRIPT_DIR, "qemu-tests.json"))
+    parser.add_argument("-j", "--jobs", type=int, default=os.cpu_count() or 2,
+                        help="QEMU instances at once")
+    parser.add_argument("--build-jobs", type=int, default=2,
+                        help="builds at once (each build is already parallel)")
+    parser.add_argument("--no-build", action="store_true", help="use existing build output")
+    parser.add_argument("--list", action="store_true", help="list tests and exit")
+    parser.add_argument("--log-dir", default=os.path.join(WORKSPACE, "test-results"))
+    parser.add_argument("--work-dir", default="/tmp/qemu-tests")
+    parser.add_argument("--report", help="also write results as JSON")
+    parser.add_argument("--trace", default=os.environ.get("SENSOR_TRACE"),
+                        help="sensor trace pack for the flash images (scripts/sensor-trace.py)")
+    args = parser.parse_args()
+    if args.trace:
+        args.trace = os.path.abspath(args.trace)
+
+    manifest, tests = load_manifest(args.manifest)
+    tests = select_tests(tests, args.patterns)
+    if args.list:
+        for t in tests:
+            print("%-26s %-8s %-4s %s" % (t["name"], t["kind"], "net" if t["net"] else "", t["path"]))
+        return 0
+    if not tests:
+        print("No tests match %s" % " ".join(args.patterns))
+        return 1
+
+    os.makedirs(args.log_dir, exist_ok=True)
+    os.makedirs(args.work_dir, exist_ok=True)
+    results = {t["name"]: Result(t["name"]) for t in tests}
+
+    print("Building %d tests (%d at a time)..." % (len(tests), args.build_jobs))
+    with concurrent.futures.ThreadPoolExecutor(args.build_jobs) as pool:
+        futures = {pool.submit(build_test, t, results[t["name"]], args): t for t in tests}
+        for future in concurrent.futures.as_completed(futures):
+            future.result()
+            r = results[futures[future]["name"]]
+            print("  %-26s %-10s %s" % (r.name, r.status, fmt_ms(r.build_ms)))
+
+    runnable = [t for t in tests if results[t["name"]].status == "BUILT"]
+    if any(t["net"] for t in runnable):
+        print("Forwarding backend services:")
+        start_service_forwarders(manifest.get("services", {}))
+    helper_names = {h for t in runnable for h in t["helpers"]}
+    if helper_names:
+        print("Starting helpers:")
+    helpers = start_helpers(manifest.get("helpers", {}), helper_names, args.log_dir)
+
+    print("Running %d tests (%d at a time)..." % (len(runnable), args.jobs))
+    with concurrent.futures.ThreadPoolExecutor(args.jobs) as pool:
+        futures = {pool.submit(run_test, t, results[t["name"]], args): t for t in runnable}
+        for future in concurrent.futures.as_completed(futures):
+            future.result()
+            r = results[futures[future]["name"]]
+            print("  %-26s %-10s %s" % (r.name, r.status, fmt_ms(r.run_ms)))
+    for proc in helpers:
+        proc.terminate()
+
+    ordered = [results[t["name"]] for t in tests]
+    print_report(ordered)
+    if args.report:
+        with open(args.report, "w") as f:
+            json.dump([r.as_dict() for r in ordered], f, indent=2)
+
+    return 0 if all(r.status == "PASS" for r in ordered) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
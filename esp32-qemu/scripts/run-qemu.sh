@@ -1,20 +1,41 @@
 #!/bin/bash
 # Run an ESP32 project in QEMU
 # Usage: ./run-qemu.sh <project_path>
+# Set QEMU_FRESH_FLASH=1 to rebuild the flash image from scratch (erases NVS)
+#
+# Networking (QEMU_NET):
+#   QEMU_NET=1                            slirp, one private network per instance
+#   QEMU_NET=bridge QEMU_TAP=qemu1        tap on the virtual switch (scripts/vnet.sh)
+#   QEMU_HOSTFWD="8080:80"                host:guest TCP ports forwarded (slirp only),
+#                                         e.g. 03-rest-api's local API
+#
+# Sensor traces (components/sensor_replay):
+#   SENSOR_TRACE=traces/sensors.bin       trace pack written into the flash image
+#   QEMU_SEMIHOST=1                       let the firmware open host files
+#                                         (CONFIG_SENSOR_REPLAY_SEMIHOST)
 
 set -e
 
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "${SCRIPT_DIR}/pipeline-lib.sh"
+
 PROJECT_PATH=${1:-.}
 PROJECT_NAME=$(basename "${PROJECT_PATH}")
+if [ -n "${SENSOR_TRACE:-}" ]; then
+    SENSOR_TRACE=$(realpath "${SENSOR_TRACE}")
+fi
+HOST_DIR=$(pwd)
 
-# Find the binary
-if [ -f "${PROJECT_PATH}/build/${PROJECT_NAME}.bin" ]; then
-    BINARY="${PROJECT_PATH}/build/${PROJECT_NAME}.bin"
-elif [ -f "${PROJECT_PATH}/build/app.bin" ]; then
-    BINARY="${PROJECT_PATH}/build/app.bin"
+cd "${PROJECT_PATH}"
+
+# Find the binary: project_description.json names the app exactly
+if [ -f build/project_description.json ]; then
+    BINARY="build/$(python3 -c "import json;print(json.load(open('build/project_description.json'))['app_bin'])")"
+elif [ -f "build/${PROJECT_NAME}.bin" ]; then
+    BINARY="build/${PROJECT_NAME}.bin"
 else
-    # Try to find any .bin file
-    BINARY=$(find "${PROJECT_PATH}/build" -name "*.bin" -type f | head -1)
+    # Try to find any app .bin file
+    BINARY=$(find build -maxdepth 1 -name "*.bin" -type f ! -name "merged-qemu.bin" 2>/dev/null | head -1)
 fi
 
 if [ -z "${BINARY}" ] || [ ! -f "${BINARY}" ]; then
@@ -23,33 +44,19 @@ if [ -z "${BINARY}" ] || [ ! -f "${BINARY}" ]; then
     exit 1
 fi
 
-# Merge binaries for QEMU (bootloader + partition table + app)
-MERGED_BIN="${PROJECT_PATH}/build/merged-qemu.bin"
-
 echo "=========================================="
 echo "Preparing binary for QEMU..."
 echo "=========================================="
 
-cd "${PROJECT_PATH}"
-
-# Create merged binary using esptool
-python3 -m esptool --chip esp32 merge_bin \
-    --fill-flash-size 4MB \
-    -o build/merged-qemu.bin \
-    --flash_mode dio \
-    --flash_size 4MB \
+# Merge binaries for QEMU (bootloader + partition table + app). Only the
+# parts that changed since the last run are rewritten.
+stage_begin flash-image
+prepare_flash_image build/merged-qemu.bin \
+    0x10000 "${BINARY}" \
     0x1000 build/bootloader/bootloader.bin \
-    0x8000 build/partition_table/partition-table.bin \
-    0x10000 build/*.bin 2>/dev/null || \
-python3 -m esptool --chip esp32 merge_bin \
-    --fill-flash-size 4MB \
-    -o build/merged-qemu.bin \
-    --flash_mode dio \
-    --flash_size 4MB \
-    0x1000 build/bootloader/bootloader.bin \
-    0x8000 build/partition_table/partition-table.bin \
-    0x10000 build/app-template.bin 2>/dev/null || \
-echo "Using existing binary..."
+    0x8000 build/partition_table/partition-table.bin
+write_sensor_trace build/merged-qemu.bin
+stage_end
 
 echo "=========================================="
 echo "Starting QEMU ESP32 emulator..."
@@ -57,16 +64,28 @@ echo "Press Ctrl+A then X to exit QEMU"
 echo "=========================================="
 
 # Check if networking is requested
-NETWORK_ARGS=""
-if [ "${QEMU_NET:-0}" = "1" ]; then
-    echo "Networking enabled (open_eth via slirp)"
-    NETWORK_ARGS="-nic user,model=open_eth"
+NETWORK_ARGS=$(qemu_net_args "${QEMU_NET:-0}" "${QEMU_TAP:-qemu0}" "${QEMU_HOSTFWD:-}")
+case "${QEMU_NET:-0}" in
+    1|user) echo "Networking enabled (open_eth via slirp)" ;;
+    bridge) echo "Networking enabled (open_eth on virtual switch, ${QEMU_TAP:-qemu0})" ;;
+esac
+
+# Semihosting paths are relative to QEMU's working directory, so QEMU
+# starts where this script was started: /host/traces/... is ./traces/...
+IMAGE="$(pwd)/build/merged-qemu.bin"
+SEMIHOST_ARGS=""
+if [ "${QEMU_SEMIHOST:-0}" = "1" ]; then
+    SEMIHOST_ARGS="-semihosting-config enable=on,target=native"
+    echo "Semihosting enabled (host files under ${HOST_DIR})"
+    cd "${HOST_DIR}"
 fi
 
 # Run QEMU
+stage_begin qemu
 qemu-system-xtensa \
     -nographic \
     -machine esp32 \
-    -drive file=build/merged-qemu.bin,if=mtd,format=raw \
+    -drive file="${IMAGE}",if=mtd,format=raw \
     -serial mon:stdio \
-    ${NETWORK_ARGS}
+    ${NETWORK_ARGS} ${SEMIHOST_ARGS}
+stage_end
@@ -0,0 +1,273 @@
+#!/usr/bin/env python3
+"""
+Sensor trace packs for components/sensor_replay
+IoT Course - Spring 2026
+
+A pack holds named traces that firmware replays in place of simulated
+readings, so benchmarks and tests see the same realistic data every run:
+
+  python3 scripts/sensor-trace.py generate -o traces/sensors.bin
+  python3 scripts/sensor-trace.py import -o traces/sensors.bin --name env \\
+      recording.csv
+  python3 scripts/sensor-trace.py info traces/sensors.bin
+
+  SENSOR_TRACE=traces/sensors.bin ./run-tests.sh
+  SENSOR_TRACE=/workspace/traces/sensors.bin \\
+      /workspace/scripts/run-qemu.sh projects/04-mqtt     # in the container
+
+generate writes the built-in traces. They are synthetic but shaped like
+the real thing, and the same seed always gives the same bytes:
+
+  env    temp (C), humidity (%)  every 10 s for 24 h: day/night swing,
+                                 a thermostat cycling, doors, a shower
+  accel  x, y, z (mg)            100 Hz for 60 s: a motor with 12 Hz and
+                                 31 Hz vibration, start/stop, knocks
+  light  adc (counts)            every 1 s for 3 h: daylight through
+                                 clouds, lights switched on and off
+
+import adds a CSV recording (first column the time in seconds, then one
+column per channel, "name[unit]" headers) under --name, replacing a trace
+of that name. run-qemu.sh and the test runner write SENSOR_TRACE into the
+flash image at the trace partition (0x310000).
+
+Standard library only.
+"""
+
+import argparse
+import csv
+import math
+import os
+import random
+import struct
+import sys
+
+MAGIC = b"SRPL"
+VERSION = 1
+HEADER = struct.Struct("<4sHH16sIIII")
+CHANNEL = struct.Struct("<12s4sff")
+MAX_CHANNELS = 4
+PARTITION_BYTES = 0xF0000
+
+
+class Trace:
+    def __init__(self, name, tick_us, channels):
+        self.name = name
+        self.tick_us = tick_us
+        self.channels = channels      # [(name, unit, scale, offset)]
+        self.rows = []                # [(ticks, [raw, ...])]
+
+    def add(self, ticks, values):
+        raw = []
+        for v, (_, _, scale, offset) in zip(values, self.channels):
+            raw.append(max(-32768, min(32767, round((v - offset) / scale))))
+        self.rows.append((ticks, raw))
+
+    def encode(self):
+        n = len(self.channels)
+        record_bytes = (4 + 2 * n + 3) & ~3
+        body = bytearray()
+        for name, unit, scale, offset in self.channels:
+            body += CHANNEL.pack(name.encode(), unit.encode(), scale, offset)
+        t0 = self.rows[0][0]
+        for ticks, raw in self.rows:
+            rec = struct.pack("<I%dh" % n, ticks - t0, *raw)
+            body += rec.ljust(record_bytes, b"\0")
+        total = HEADER.size + len(body)
+        return HEADER.pack(MAGIC, VERSION, n, self.name.encode(), len(self.rows),
+                           self.tick_us, record_bytes, total) + body
+
+
+def decode_pack(data):
+    traces = []
+    off = 0
+    while off + HEADER.size <= len(data):
+        magic, version, n, name, records, tick_us, record_bytes, total = \
+            HEADER.unpack_from(data, off)
+        if magic != MAGIC or total < HEADER.size:
+            break
+        channels = [CHANNEL.unpack_from(data, off + HEADER.size + i * CHANNEL.size)
+                    for i in range(n)]
+        first = off + HEADER.size + n * CHANNEL.size
+        last_t = struct.unpack_from("<I", data, first + (records - 1) * record_bytes)[0]
+        traces.append({
+            "name": name.rstrip(b"\0").decode(), "version": version,
+            "tick_us": tick_us, "records": records, "record_bytes": record_bytes,
+            "channels": [(c[0].rstrip(b"\0").decode(), c[1].rstrip(b"\0").decode(),
+                          c[2], c[3]) for c in channels],
+            "seconds": last_t * tick_us / 1e6, "blob": data[off:off + total],
+        })
+        off += total
+    return traces
+
+
+def write_pack(path, blobs):
+    data = b"".join(blobs)
+    if len(data) > PARTITION_BYTES:
+        sys.exit("%s: %d bytes, the trace partition holds %d" % (path, len(data), PARTITION_BYTES))
+    os.makedirs(os.path.dirname(os.path.abspath(path)), exist_ok=True)
+    with open(path, "wb") as f:
+        f.write(data)
+    print("%s: %d traces, %d bytes" % (path, len(blobs), len(data)))
+
+
+# ----------------------------------------------------------------
+# Built-in traces
+# ----------------------------------------------------------------
+def gen_env(rng):
+    """A living room over a day, one reading every 10 s"""
+    trace = Trace("env", 1000000, [("temp", "C", 0.01, 0.0), ("humidity", "%", 0.01, 0.0)])
+    outside = 0.0
+    temp = 20.5
+    heating = False
+    vapour = 10.5                 # g/m3, roughly constant indoors
+    door = 0.0                    # cooling from an open door, decays
+    for k in range(8640):
+        t = k * 10
+        hour = t / 3600.0
+        outside = 12.0 + 6.0 * math.sin((hour - 9.0) / 24.0 * 2 * math.pi)
+        # Thermostat: 21 C from 6 to 23 h, 18 C at night, 1 C hysteresis
+        setpoint = 21.0 if 6 <= hour < 23 else 18.0
+        if temp < setpoint - 0.5:
+            heating = True
+        elif temp > setpoint + 0.5:
+            heating = False
+        temp += (outside - temp) * 0.0004 + (0.012 if heating else 0.0)
+        if 7 <= hour < 22 and rng.random() < 0.004:
+            door += rng.uniform(0.8, 2.0)
+        door *= 0.97
+        # Shower at 7:30 next door, cooking at 19:00
+        if 7.5 <= hour < 7.75 or 19.0 <= hour < 19.5:
+            vapour += 0.02
+        vapour += (10.5 - vapour) * 0.002
+        reading = temp - door + rng.gauss(0, 0.03)
+        saturation = 5.018 + 0.32321 * reading + 0.0081847 * reading ** 2 + \
+            0.00031243 * reading ** 3
+        humidity = min(100.0, 100.0 * vapour / saturation + rng.gauss(0, 0.2))
+        # Sensor resolution: 0.01 C, 0.1 %
+        trace.add(t, [round(reading, 2), round(humidity, 1)])
+    return trace
+
+
+def gen_accel(rng):
+    """A motor on a table at 100 Hz; gravity on Z"""
+    trace = Trace("accel", 1000, [("x", "mg", 1.0, 0.0), ("y", "mg", 1.0, 0.0),
+                                  ("z", "mg", 1.0, 0.0)])
+    amp = 0.0
+    phase12 = phase31 = 0.0
+    knock = 0.0
+    for n in range(6000):
+        t = n / 100.0
+        running = (t % 30.0) < 22.0          # 22 s on, 8 s off
+        amp += ((1.0 if running else 0.0) - amp) * 0.02   # spin up / down
+        f12 = 12.0 * (0.8 + 0.2 * amp)
+        phase12 += 2 * math.pi * f12 / 100.0
+        phase31 += 2 * math.pi * 31.0 / 100.0
+        if rng.random() < 0.002:
+            knock = rng.uniform(200, 500)
+        knock *= 0.6
+        x = 150.0 * amp * math.sin(phase12) + knock + rng.gauss(0, 4)
+        y = 60.0 * amp * math.sin(phase31) + 20.0 * amp * math.sin(2 * phase12) + rng.gauss(0, 4)
+        z = 1000.0 + 8.0 * amp * math.sin(phase12 + 1.0) - 0.3 * knock + rng.gauss(0, 4)
+        trace.add(n * 10, [x, y, z])
+    return trace
+
+
+def gen_light(rng):
+    """A light sensor by a window, 12-bit ADC, every second for 3 h"""
+    trace = Trace("light", 1000000, [("adc", "cnt", 1.0, 0.0)])
+    cloud = 1.0
+    lamp = False
+    for t in range(10800):
+        daylight = 2600.0 * math.sin(min(math.pi, (t + 3600) / 18000.0 * math.pi))
+        cloud += rng.gauss(0, 0.004) + (0.85 - cloud) * 0.002
+        cloud = min(1.0, max(0.2, cloud))
+        if rng.random() < 0.0015:
+            lamp = not lamp
+        value = daylight * cloud + (900 if lamp else 0) + 40 + rng.gauss(0, 6)
+        trace.add(t, [min(4095, max(0, round(value)))])
+    return trace
+
+
+BUILTIN = {"env": gen_env, "accel": gen_accel, "light": gen_light}
+
+
+# ----------------------------------------------------------------
+# Commands
+# ----------------------------------------------------------------
+def cmd_generate(args):
+    names = args.traces.split(",") if args.traces else list(BUILTIN)
+    blobs = []
+    for name in names:
+        if name not in BUILTIN:
+            sys.exit("unknown trace %s (have %s)" % (name, ", ".join(BUILTIN)))
+        # One generator per trace, so selecting traces does not change them
+        blobs.append(BUILTIN[name](random.Random("%s-%d" % (name, args.seed))).encode())
+    write_pack(args.output, blobs)
+
+
+def auto_scale(values):
+    peak = max((abs(v) for v in values), default=1.0) or 1.0
+    return 10.0 ** math.ceil(math.log10(peak / 32767.0))
+
+
+def cmd_import(args):
+    with open(args.csv, newline="") as f:
+        rows = [r for r in csv.reader(f) if r and not r[0].startswith("#")]
+    header, rows = rows[0], rows[1:]
+    if not 2 <= len(header) <= MAX_CHANNELS + 1:
+        sys.exit("%s: need a time column and 1-%d channels" % (args.csv, MAX_CHANNELS))
+    columns = list(zip(*[[float(v) for v in r] for r in rows]))
+    channels = []
+    for title, values in zip(header[1:], columns[1:]):
+        name, _, unit = title.partition("[")
+        channels.append((name.strip()[:12], unit.rstrip("]").strip()[:4], auto_scale(values), 0.0))
+    trace = Trace(args.name, args.tick_us, channels)
+    for i, t in enumerate(columns[0]):
+        trace.add(round(t * 1e6 / args.tick_us), [c[i] for c in columns[1:]])
+
+    blobs = []
+    if os.path.exists(args.output):
+        with open(args.output, "rb") as f:
+            blobs = [t["blob"] for t in decode_pack(f.read()) if t["name"] != args.name]
+    blobs.append(trace.encode())
+    write_pack(args.output, blobs)
+
+
+def cmd_info(args):
+    with open(args.pack, "rb") as f:
+        for t in decode_pack(f.read()):
+            rate = (t["records"] - 1) / t["seconds"] if t["seconds"] else 0
+            print("%-8s %6d records %8.1f s %7.2f Hz  %s" % (
+                t["name"], t["records"], t["seconds"], rate,
+                ", ".join("%s[%s] x%g" % (c[0], c[1], c[2]) for c in t["channels"])))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    p = sub.add_parser("generate", help="write the built-in traces")
+    p.add_argument("-o", "--output", default="traces/sensors.bin")
+    p.add_argument("--traces", help="comma-separated subset of %s" % ",".join(BUILTIN))
+    p.add_argument("--seed", type=int, default=1)
+    p.set_defaults(func=cmd_generate)
+
+    p = sub.add_parser("import", help="add a CSV recording to a pack")
+    p.add_argument("csv")
+    p.add_argument("-o", "--output", default="traces/sensors.bin")
+    p.add_argument("--name", required=True)
+    p.add_argument("--tick-us", type=int, default=1000,
+                   help="time resolution of the trace (default 1 ms)")
+    p.set_defaults(func=cmd_import)
+
+    p = sub.add_parser("info", help="list the traces in a pack")
+    p.add_argument("pack")
+    p.set_defaults(func=cmd_info)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,180 @@
+#!/usr/bin/env python3
+"""
+Live stream benchmark: how many SSE subscribers one api-server sustains
+IoT Course - Spring 2026
+
+For each subscriber count in --steps, opens that many GET /api/stream
+connections (filtered to the benchmark's own device), then POSTs readings
+to /api/sensors at --rate per second for --duration seconds. Every reading
+carries its reading_id; a subscriber that receives it records the delay
+since the POST started. One line per step:
+
+  SSE subscribers=100 readings=200 expected=20000 received=20000 pct=100.0
+      p50_ms=4.2 p99_ms=31.0 max_ms=58.3 dropped=0
+
+A step is sustained when at least 99% of the events arrive with a p99
+delay under --max-p99-ms; the last line gives the largest sustained count.
+dropped= is the server's count of events dropped from full subscriber
+queues (GET /api/stream/stats).
+
+Standard library only. Run it on the host against the compose service:
+
+  docker compose up -d api-server
+  python3 scripts/sse-bench.py --steps 10,50,100,200,400 --rate 20
+
+Many subscribers need many sockets: raise the open-file limit first
+(ulimit -n 4096) for steps in the thousands.
+"""
+
+import argparse
+import asyncio
+import json
+import sys
+import time
+import urllib.parse
+import urllib.request
+
+DEVICE = "sse-bench"
+
+
+class Results:
+    def __init__(self):
+        self.sent = {}         # reading_id -> monotonic time of the POST
+        self.latencies = []
+        self.received = 0
+
+
+def http_json(url, body=None):
+    data = json.dumps(body).encode() if body is not None else None
+    req = urllib.request.Request(url, data=data,
+                                 headers={"Content-Type": "application/json"})
+    with urllib.request.urlopen(req, timeout=10) as resp:
+        return json.loads(resp.read() or b"null")
+
+
+async def subscriber(host, port, path, results, ready):
+    reader, writer = await asyncio.open_connection(host, port)
+    # HTTP/1.0: the server streams the body as is, without chunked framing
+    writer.write(f"GET {path} HTTP/1.0\r\nHost: {host}\r\n"
+                 "Accept: text/event-stream\r\n\r\n".encode())
+    await writer.drain()
+    try:
+        while True:
+            line = await reader.readline()
+            if not line:
+                return
+            if line.startswith(b": connected"):
+                ready.release()
+            elif line.startswith(b"data: "):
+                event = json.loads(line[6:])
+                sent = results.sent.get(event.get("reading_id"))
+                if sent is not None:
+                    results.latencies.append(time.monotonic() - sent)
+                    results.received += 1
+    finally:
+        writer.close()
+
+
+async def publisher(base, rate, duration, results, next_id):
+    loop = asyncio.get_running_loop()
+    count = int(rate * duration)
+    start = time.monotonic()
+    for i in range(count):
+        reading_id = next_id + i
+        results.sent[reading_id] = time.monotonic()
+        body = {"device": DEVICE, "temperature": 21.5, "humidity": 40.0,
+                "reading_id": reading_id}
+        await loop.run_in_executor(None, http_json, base + "/api/sensors", body)
+        delay = start + (i + 1) / rate - time.monotonic()
+        if delay > 0:
+            await asyncio.sleep(delay)
+    return count
+
+
+def percentile(values, pct):
+    if not values:
+        return float("nan")
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * pct / 100))]
+
+
+async def run_step(args, subscribers, next_id):
+    url = urllib.parse.urlparse(args.url)
+    host, port = url.hostname, url.port or 80
+    path = f"/api/stream?device={DEVICE}"
+    results = Results()
+    ready = asyncio.Semaphore(0)
+    dropped_before = http_json(args.url + "/api/stream/stats")["dropped"]
+
+    tasks = [asyncio.create_task(subscriber(host, port, path, results, ready))
+             for _ in range(subscribers)]
+    try:
+        for _ in range(subscribers):
+            await asyncio.wait_for(ready.acquire(), timeout=30)
+    except asyncio.TimeoutError:
+        print(f"SSE subscribers={subscribers} error=connect_timeout")
+        for t in tasks:
+            t.cancel()
+        return None
+
+    readings = await publisher(args.url, args.rate, args.duration,
+                               results, next_id)
+    # Let the last events drain
+    await asyncio.sleep(args.drain)
+    for t in tasks:
+        t.cancel()
+    await asyncio.gather(*tasks, return_exceptions=True)
+
+    dropped = http_json(args.url + "/api/stream/stats")["dropped"] - dropped_before
+    expected = readings * subscribers
+    pct = 100.0 * results.received / expected if expected else 0.0
+    lat = [x * 1000 for x in results.latencies]
+    p99 = percentile(lat, 99)
+    print(f"SSE subscribers={subscribers} readings={readings} "
+          f"expected={expected} received={results.received} pct={pct:.1f} "
+          f"p50_ms={percentile(lat, 50):.1f} p99_ms={p99:.1f} "
+          f"max_ms={max(lat, default=float('nan')):.1f} dropped={dropped}",
+          flush=True)
+    return pct >= 99.0 and p99 <= args.max_p99_ms, readings
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--url", default="http://localhost:5000")
+    parser.add_argument("--steps", default="10,50,100,200",
+                        help="comma-separated subscriber counts")
+    parser.add_argument("--rate", type=float, default=20,
+                        help="readings POSTed per second")
+    parser.add_argument("--duration", type=float, default=10,
+                        help="seconds of publishing per step")
+    parser.add_argument("--drain", type=float, default=2,
+                        help="seconds to wait for late events")
+    parser.add_argument("--max-p99-ms", type=float, default=1000)
+    args = parser.parse_args()
+    args.url = args.url.rstrip("/")
+
+    try:
+        http_json(args.url + "/health")
+    except OSError as e:
+        print(f"api-server not reachable at {args.url}: {e}", file=sys.stderr)
+        return 2
+
+    sustained = 0
+    next_id = int(time.time())   # distinct ids across runs
+    for n in (int(s) for s in args.steps.split(",")):
+        result = await run_step(args, n, next_id)
+        if result is None:
+            break
+        ok, readings = result
+        next_id += readings
+        if not ok:
+            break
+        sustained = n
+
+    print(f"SSE_MAX_SUSTAINED subscribers={sustained} rate={args.rate:g}/s")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(asyncio.run(main()))
@@ -0,0 +1,84 @@
+#!/bin/bash
+# Boot several instances of one project on the virtual switch
+# Usage: ./vnet-fleet.sh <project_path> <count> [seconds] [shaping options]
+# Example: ./vnet-fleet.sh /workspace/projects/04-mqtt 5 120 --delay 50 --loss 2
+#
+# Every instance gets its own link (qemu1 .. qemuN, see vnet.sh) with the
+# same shaping, its own MAC and DHCP address, and boots a copy-on-write view
+# of the project's flash image. After <seconds> (default 60) all instances
+# are stopped and their links removed; the switch stays up for the next run
+# (vnet.sh down removes it).
+#
+# UART logs: <project>/build/fleet/qemuN.log
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "${SCRIPT_DIR}/pipeline-lib.sh"
+
+if [ $# -lt 2 ]; then
+    sed -n '3,4p' "$0" | sed 's/^# //'
+    exit 1
+fi
+
+PROJECT_PATH=$1
+COUNT=$2
+SECONDS_TO_RUN=60
+shift 2
+if [ $# -gt 0 ] && [ "${1#--}" = "$1" ]; then
+    SECONDS_TO_RUN=$1
+    shift
+fi
+
+cd "${PROJECT_PATH}"
+if [ ! -f build/project_description.json ]; then
+    echo "Error: ${PROJECT_PATH} is not built. Run: ./build.sh ${PROJECT_PATH}"
+    exit 1
+fi
+
+prepare_flash_image build/merged-qemu.bin \
+    0x10000 "build/$(python3 -c "import json;print(json.load(open('build/project_description.json'))['app_bin'])")" \
+    0x1000 build/bootloader/bootloader.bin \
+    0x8000 build/partition_table/partition-table.bin
+
+"${SCRIPT_DIR}/vnet.sh" up
+mkdir -p build/fleet
+
+PIDS=()
+TAPS=()
+cleanup() {
+    local pid tap
+    for pid in "${PIDS[@]}"; do
+        kill "${pid}" 2>/dev/null || true
+    done
+    wait 2>/dev/null || true
+    for tap in "${TAPS[@]}"; do
+        "${SCRIPT_DIR}/vnet.sh" del "${tap}" > /dev/null
+    done
+}
+trap cleanup EXIT
+
+for i in $(seq 1 "${COUNT}"); do
+    tap="qemu${i}"
+    "${SCRIPT_DIR}/vnet.sh" add "${tap}" "$@" > /dev/null
+    TAPS+=("${tap}")
+    qemu_start_headless build/merged-qemu.bin "build/fleet/${tap}.log" \
+        $(qemu_net_args bridge "${tap}")
+    PIDS+=("${QEMU_PID}")
+    echo "Started ${tap} (MAC $(vnet_mac "${tap}"), pid ${QEMU_PID})"
+done
+
+echo "Running ${COUNT} instance(s) for ${SECONDS_TO_RUN}s (shaping: ${*:-none})"
+sleep "${SECONDS_TO_RUN}"
+
+echo "=========================================="
+echo "Fleet summary"
+echo "=========================================="
+for tap in "${TAPS[@]}"; do
+    log="build/fleet/${tap}.log"
+    ip=$(sed -n 's/.*Got IP address: \([0-9.]*\).*/\1/p' "${log}" | tail -1)
+    errors=$(grep -cE " E \(|Guru Meditation" "${log}" || true)
+    printf "  %-8s ip=%-12s lines=%-6s errors=%s\n" \
+        "${tap}" "${ip:--}" "$(wc -l < "${log}")" "${errors}"
+done
+"${SCRIPT_DIR}/vnet.sh" status
@@ -0,0 +1,252 @@
+#!/bin/bash
+# Virtual switch for several QEMU ESP32 instances
+#
+# Usage:
+#   ./vnet.sh up                      create the switch, DHCP and service forwarding
+#   ./vnet.sh add <tap> [shaping]     add a device link (tap for QEMU)
+#   ./vnet.sh shape <tap> [shaping]   change the shaping of a link
+#   ./vnet.sh del <tap>               remove a device link
+#   ./vnet.sh status                  links, shaping and DHCP leases
+#   ./vnet.sh down                    remove everything
+#
+# Shaping options (each applies to both directions of the link):
+#   --delay MS     one-way latency (round trip = 2 x MS)
+#   --jitter MS    random variation of the latency
+#   --loss PCT     frame loss, e.g. 0.5
+#   --rate KBIT    bandwidth limit
+# No options = an unshaped link.
+#
+# Topology (run inside the esp32-dev container, needs NET_ADMIN):
+#
+#   QEMU --tap qemuN-- [qbrN] --veth qvN/qsN-- [br-qemu 10.0.2.2/24] --NAT-- services
+#
+# The switch owns 10.0.2.2, the address slirp gives the host, and forwards
+# the service ports from there, so firmware written for slirp runs unchanged.
+# dnsmasq hands out 10.0.2.15 and up. Devices on the switch reach each other
+# directly. Every device gets a small bridge of its own so downlink shaping
+# sits on the tap and uplink shaping on the veth towards the switch.
+#
+# Start QEMU on a link with QEMU_NET=bridge QEMU_TAP=<tap> ./run-qemu.sh.
+# The tap name should end in a number: it becomes the NIC's MAC address
+# (see vnet_mac in pipeline-lib.sh and components/qemu_nic).
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+source "${SCRIPT_DIR}/pipeline-lib.sh"
+
+BRIDGE=${VNET_BRIDGE:-br-qemu}
+ROUTER_IP=10.0.2.2
+SUBNET=10.0.2.0/24
+DHCP_RANGE=10.0.2.15,10.0.2.254,255.255.255.0,12h
+RUN_DIR=/run/vnet
+
+# <guest port>[/udp]=<service host>:<port>, as in qemu-tests.json
+SERVICES=${VNET_SERVICES:-"5000=api-server:5000 1883=mqtt-broker:1883 5443=api-server:5443 8883=mqtt-broker:8883 123/udp=ntp-server:123"}
+
+# ----------------------------------------------------------------
+# Switch
+# ----------------------------------------------------------------
+vnet_up() {
+    if [ -d "/sys/class/net/${BRIDGE}" ]; then
+        echo "Switch ${BRIDGE} is already up"
+        return 0
+    fi
+
+    ip link add "${BRIDGE}" type bridge
+    ip addr add "${ROUTER_IP}/24" dev "${BRIDGE}"
+    ip link set "${BRIDGE}" up
+
+    # Service ports on 10.0.2.2 go to the compose services
+    iptables -t nat -N VNET_DNAT
+    iptables -t nat -A PREROUTING -i "${BRIDGE}" -d "${ROUTER_IP}" -j VNET_DNAT
+    local svc port proto target host tport ip
+    for svc in ${SERVICES}; do
+        port=${svc%%=*}
+        proto=tcp
+        if [ "${port%/udp}" != "${port}" ]; then
+            port=${port%/udp}
+            proto=udp
+        fi
+        target=${svc#*=}
+        host=${target%:*}
+        tport=${target##*:}
+        ip=$(getent hosts "${host}" | awk '{ print $1; exit }')
+        if [ -z "${ip}" ]; then
+            echo "Warning: ${host} does not resolve, port ${port} not forwarded"
+            continue
+        fi
+        iptables -t nat -A VNET_DNAT -p "${proto}" --dport "${port}" \
+            -j DNAT --to-destination "${ip}:${tport}"
+        echo "Forwarding ${ROUTER_IP}:${port}/${proto} -> ${host} (${ip}:${tport})"
+    done
+    iptables -t nat -A POSTROUTING -s "${SUBNET}" ! -o "${BRIDGE}" -j MASQUERADE
+
+    if [ "$(cat /proc/sys/net/ipv4/ip_forward)" != "1" ]; then
+        echo "Warning: IP forwarding is off, services are not reachable"
+        echo "         (docker-compose.yml sets net.ipv4.ip_forward=1)"
+    fi
+
+    # DHCP, and DNS so devices can also use service names
+    mkdir -p "${RUN_DIR}"
+    dnsmasq \
+        --interface="${BRIDGE}" --bind-interfaces --except-interface=lo \
+        --dhcp-range="${DHCP_RANGE}" \
+        --dhcp-option=option:router,"${ROUTER_IP}" \
+        --dhcp-option=option:dns-server,"${ROUTER_IP}" \
+        --dhcp-leasefile="${RUN_DIR}/leases" \
+        --pid-file="${RUN_DIR}/dnsmasq.pid" \
+        --log-facility="${RUN_DIR}/dnsmasq.log" --log-dhcp
+
+    echo "Switch ${BRIDGE} up at ${ROUTER_IP}/24"
+}
+
+vnet_down() {
+    local tap
+    for tap in $(vnet_links); do
+        vnet_del "${tap}"
+    done
+    if [ -f "${RUN_DIR}/dnsmasq.pid" ]; then
+        kill "$(cat "${RUN_DIR}/dnsmasq.pid")" 2>/dev/null || true
+        rm -f "${RUN_DIR}/dnsmasq.pid"
+    fi
+    iptables -t nat -D POSTROUTING -s "${SUBNET}" ! -o "${BRIDGE}" -j MASQUERADE 2>/dev/null || true
+    iptables -t nat -D PREROUTING -i "${BRIDGE}" -d "${ROUTER_IP}" -j VNET_DNAT 2>/dev/null || true
+    iptables -t nat -F VNET_DNAT 2>/dev/null || true
+    iptables -t nat -X VNET_DNAT 2>/dev/null || true
+    ip link del "${BRIDGE}" 2>/dev/null || true
+    echo "Switch ${BRIDGE} down"
+}
+
+# ----------------------------------------------------------------
+# Device links
+# qemuN: tap for QEMU, qbrN: per-device bridge, qvN/qsN: veth to the switch
+# ----------------------------------------------------------------
+link_names() {
+    local n=${1//[!0-9]/}
+    LINK_BR="qbr${n}"
+    LINK_VETH="qv${n}"
+    LINK_PEER="qs${n}"
+}
+
+vnet_links() {
+    local dev
+    for dev in /sys/class/net/*; do
+        dev=$(basename "${dev}")
+        if [ -d "/sys/class/net/${dev}/brport" ] && \
+           [ "$(basename "$(readlink "/sys/class/net/${dev}/brport/bridge")")" = "qbr${dev//[!0-9]/}" ] && \
+           [ -f "/sys/class/net/${dev}/tun_flags" ]; then
+            echo "${dev}"
+        fi
+    done
+}
+
+vnet_add() {
+    local tap=$1
+    shift
+    if [ -z "${tap//[!0-9]/}" ]; then
+        echo "Error: tap name must end in a number (e.g. qemu0)"
+        exit 1
+    fi
+    if [ ! -d "/sys/class/net/${BRIDGE}" ]; then
+        vnet_up
+    fi
+    link_names "${tap}"
+
+    ip tuntap add dev "${tap}" mode tap
+    ip link add "${LINK_BR}" type bridge
+    ip link add "${LINK_VETH}" type veth peer name "${LINK_PEER}"
+    ip link set "${tap}" master "${LINK_BR}"
+    ip link set "${LINK_VETH}" master "${LINK_BR}"
+    ip link set "${LINK_PEER}" master "${BRIDGE}"
+    local dev
+    for dev in "${tap}" "${LINK_VETH}" "${LINK_PEER}" "${LINK_BR}"; do
+        ip link set "${dev}" up
+    done
+
+    vnet_shape "${tap}" "$@"
+    echo "Link ${tap} added (MAC $(vnet_mac "${tap}"))"
+}
+
+vnet_del() {
+    local tap=$1
+    link_names "${tap}"
+    ip link del "${tap}" 2>/dev/null || true
+    ip link del "${LINK_VETH}" 2>/dev/null || true
+    ip link del "${LINK_BR}" 2>/dev/null || true
+    echo "Link ${tap} removed"
+}
+
+vnet_shape() {
+    local tap=$1
+    shift
+    local delay="" jitter="" loss="" rate=""
+    while [ $# -gt 0 ]; do
+        case "$1" in
+            --delay)  delay=$2; shift 2 ;;
+            --jitter) jitter=$2; shift 2 ;;
+            --loss)   loss=$2; shift 2 ;;
+            --rate)   rate=$2; shift 2 ;;
+            *) echo "Unknown shaping option: $1"; exit 1 ;;
+        esac
+    done
+    link_names "${tap}"
+
+    local netem=""
+    if [ -n "${delay}" ] || [ -n "${jitter}" ]; then
+        netem="delay ${delay:-0}ms"
+        if [ -n "${jitter}" ]; then
+            netem="${netem} ${jitter}ms distribution normal"
+        fi
+    fi
+    if [ -n "${loss}" ]; then
+        netem="${netem} loss ${loss}%"
+    fi
+    if [ -n "${rate}" ]; then
+        netem="${netem} rate ${rate}kbit"
+    fi
+
+    # tap egress = towards the device, veth egress = towards the switch
+    local dev
+    for dev in "${tap}" "${LINK_VETH}"; do
+        tc qdisc del dev "${dev}" root 2>/dev/null || true
+        if [ -n "${netem}" ]; then
+            tc qdisc add dev "${dev}" root netem limit 10000 ${netem} || {
+                echo "Error: netem failed; the Docker host needs the sch_netem module"
+                echo "       (sudo modprobe sch_netem)"
+                exit 1
+            }
+        fi
+    done
+    echo "Link ${tap} shaping: ${netem:-none}"
+}
+
+vnet_status() {
+    if [ ! -d "/sys/class/net/${BRIDGE}" ]; then
+        echo "Switch ${BRIDGE} is down"
+        return 0
+    fi
+    echo "Switch ${BRIDGE} at ${ROUTER_IP}/24"
+    local tap shaping
+    for tap in $(vnet_links); do
+        shaping=$(tc qdisc show dev "${tap}" root | sed -n 's/.*limit [0-9]* //p')
+        printf "  %-8s %s  %s\n" "${tap}" "$(vnet_mac "${tap}")" "${shaping:-unshaped}"
+    done
+    if [ -s "${RUN_DIR}/leases" ]; then
+        echo "DHCP leases:"
+        awk '{ printf "  %-16s %s\n", $3, $2 }' "${RUN_DIR}/leases"
+    fi
+}
+
+case "${1:-}" in
+    up)     vnet_up ;;
+    down)   vnet_down ;;
+    add)    shift; vnet_add "$@" ;;
+    shape)  shift; vnet_shape "$@" ;;
+    del)    vnet_del "$2" ;;
+    status) vnet_status ;;
+    *)
+        sed -n '2,17p' "$0" | sed 's/^# \{0,1\}//'
+        exit 1
+        ;;
+esac
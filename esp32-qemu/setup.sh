@@ -24,6 +24,18 @@ if ! docker info &> /dev/null; then
     exit 1
 fi
 
+# Local CA and server certificate, optional: they only enable the TLS
+# listeners (mqtt-broker on 8883, api-server on 5443). Without them both
+# services run plaintext on 1883 and 5000.
+if command -v openssl &> /dev/null; then
+    ./scripts/gen-certs.sh
+else
+    echo "Warning: openssl not found, TLS listeners stay off; generate certificates later with:"
+    echo "  docker compose run --rm esp32-dev /workspace/scripts/gen-certs.sh"
+    echo "  docker compose restart mqtt-broker api-server"
+fi
+echo ""
+
 echo "Building Docker image (this may take 15-20 minutes on first run)..."
 echo ""
 
@@ -4,6 +4,9 @@
  *
  * This example demonstrates GPIO input reading
  * using the ESP-IDF framework with interrupt handling.
+ *
+ * The event queue and task are allocated statically (no heap use)
+ * and the ISR-deferred task is pinned to APP_CPU.
  */
 
 #include <stdio.h>
@@ -13,10 +16,16 @@
 #include "driver/gpio.h"
 #include "esp_log.h"
 
+#include "static_alloc.h"
+
 #define BUTTON_PIN GPIO_NUM_4  // Button input pin
 #define LED_PIN GPIO_NUM_2     // Built-in LED
 
 static const char *TAG = "GPIO_READ";
+
+// Queue and task memory reserved at compile time
+STATIC_QUEUE_DEFINE(gpio_evt_queue_def, 10, uint32_t);
+STATIC_TASK_DEFINE(gpio_task_def, "gpio_task", 2048);
 static QueueHandle_t gpio_evt_queue = NULL;
 
 // Interrupt service routine
@@ -49,6 +58,7 @@ static void gpio_task(void *arg)
 void app_main(void)
 {
     ESP_LOGI(TAG, "ESP32 GPIO Read Example Starting...");
+    static_alloc_log_memory("boot");
 
     // Configure LED output
     gpio_config_t led_conf = {
@@ -71,12 +81,14 @@ void app_main(void)
     gpio_config(&btn_conf);
 
     // Create event queue and start task
-    gpio_evt_queue = xQueueCreate(10, sizeof(uint32_t));
-    xTaskCreate(gpio_task, "gpio_task", 2048, NULL, 10, NULL);
+    gpio_evt_queue = static_queue_create(&gpio_evt_queue_def);
+    static_task_create(&gpio_task_def, gpio_task, NULL, 10, TASK_ROLE_SENSING);
 
     // Install ISR service and add handler
     gpio_install_isr_service(0);
     gpio_isr_handler_add(BUTTON_PIN, gpio_isr_handler, (void *)BUTTON_PIN);
 
     ESP_LOGI(TAG, "GPIO configured. Press button to toggle LED.");
+    static_alloc_log_memory("init");
+    static_alloc_report_stacks_later();
 }
@@ -15,6 +15,28 @@
  * - delay() wait:  ~80mA (CPU still running!)
  * - Light sleep:   ~0.8mA (100x more efficient)
  * - Deep sleep:    ~10µA (but loses RAM state)
+ *
+ * Adaptive sleep (components/adaptive_rate):
+ * - Each wake-up costs roughly WAKE_CHARGE_UC of charge, so the sleep
+ *   length is what sets the battery life
+ * - The sleep length is picked after each reading: short while the value
+ *   changes, growing while it is flat, between SLEEP_MIN_MS and SLEEP_MAX_MS
+ * - Wake-ups never add more than CURRENT_BUDGET_UA to the average current
+ * - An ADAPTIVE_RATE line every 5 readings shows the effective rate
+ *
+ * Recorded light sensor (components/sensor_replay):
+ * - With a trace pack in flash (SENSOR_TRACE=.../traces/sensors.bin
+ *   run_qemu.sh), read_sensor() returns the "light" trace at the current
+ *   time; without one it falls back to the simulated signal
+ *
+ * Burst ADC reads (components/adc_stream):
+ * - read_sensor() runs the ADC in continuous mode for one DMA frame
+ *   (128 conversions at 20 kHz, 6.4 ms) and returns their average:
+ *   random noise drops by sqrt(128) = 11x, for one task wake-up
+ * - The stream is stopped again before sleeping, leaving the ADC idle
+ * - In QEMU the frames are emulated around the replayed or simulated
+ *   level; on a board (CONFIG_ADC_STREAM_EMULATED=n) they are GPIO34
+ * - An ADC_STREAM line every 5 readings shows the conversions and CPU cost
  */
 
 #include <stdio.h>
@@ -24,25 +46,143 @@
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "driver/gpio.h"
+#include "hal/adc_types.h"
+#include "adaptive_rate.h"
+#include "sensor_replay.h"
+#include "sample_block.h"
+#include "adc_stream.h"
 
 #define SENSOR_PIN GPIO_NUM_34      // ADC pin for sensor (simulated)
-#define SLEEP_DURATION_US 10000000  // 10 seconds in microseconds
+#define SENSOR_ADC_CHANNEL ADC_CHANNEL_6   // GPIO34 on ADC1
+#define BURST_RATE_HZ 20000         // Lowest continuous-mode rate on the ESP32
+#define SLEEP_DURATION_US 10000000  // First sleep: 10 seconds in microseconds
 #define SLEEP_DURATION_SEC 10
 
+// Bounds of the adaptive sleep length
+#define SLEEP_MIN_MS        1000
+#define SLEEP_MAX_MS        60000
+#define SENSOR_CHANGE_PER_S 10.0f   // ADC counts/s that count as a change
+#define SENSOR_NOISE        20.0f   // ... or this much std dev
+// Charge of one wake-up: ~80mA for ~20ms = 1600 uC. The budget is the
+// average current the wake-ups may add (uC/s = uA): 800uA allows at most
+// one reading every 2 seconds.
+#define WAKE_CHARGE_UC      1600
+#define CURRENT_BUDGET_UA   800
+
 static const char *TAG = "LOW_POWER";
 
 // Simulated sensor reading counter (for demo purposes)
 static int reading_count = 0;
 
+static adaptive_budget_t current_budget;
+static adaptive_rate_t sleep_rate;
+
+// Recorded light sensor, replayed in real time (-1: none flashed)
+static sensor_replay_t light_trace;
+static int light_ch = -1;
+
+// One block per burst; the second lets the stream start filling the next
+static sample_block_t light_blocks[2];
+static sample_pipe_t light_pipe;
+static bool light_stream_ok = false;
+
+/**
+ * Simulated light level, or the replayed one
+ *
+ * A light sensor: steady around 1200 with some noise, except for one
+ * minute out of every three, when it rises by 1200 counts and falls back.
+ */
+static int simulated_light(void)
+{
+    sensor_reading_t r;
+    if (light_ch >= 0 && sensor_replay_next(&light_trace, &r) == ESP_OK) {
+        return r.raw[light_ch];
+    }
+
+    static uint32_t seed = 2026;
+    seed = seed * 1103515245u + 12345u;
+    int noise = (int)((seed >> 16) % 17) - 8;
+
+    int t = (int)((esp_timer_get_time() / 1000000) % 180);
+    int offset = 0;
+    if (t >= 120 && t < 150) {
+        offset = (t - 120) * 40;
+    } else if (t >= 150) {
+        offset = (180 - t) * 40;
+    }
+    return 1200 + offset + noise;  // Simulated ADC value 0-4095
+}
+
 /**
- * Simulate reading a sensor value
- * In a real application, this would read from ADC, I2C sensor, etc.
+ * Read the sensor: one burst of continuous conversions, averaged
+ *
+ * Instead of adc1_get_raw() once, the ADC converts a whole DMA frame on
+ * its own and the task wakes once to average it.
  */
 static int read_sensor(void)
 {
-    // Simulate sensor reading with a counter
-    // In real code: return adc1_get_raw(ADC1_CHANNEL_6);
-    return (reading_count * 17 + 42) % 4096;  // Simulated ADC value 0-4095
+    int level = simulated_light();
+    if (!light_stream_ok) {
+        return level;
+    }
+
+    adc_stream_emulate_level(0, level);  // No effect on a real board
+    adc_stream_start();
+    sample_block_t *block = sample_pipe_receive(&light_pipe, pdMS_TO_TICKS(100));
+    adc_stream_stop();
+    if (block == NULL) {
+        return level;
+    }
+
+    int32_t sum = 0;
+    for (int i = 0; i < block->count; i++) {
+        sum += block->data[0][i];
+    }
+    int value = sum / block->count;
+    sample_block_release(block);
+    return value;
+}
+
+static void light_stream_init(void)
+{
+    static const uint8_t channels[] = { SENSOR_ADC_CHANNEL };
+    adc_stream_config_t cfg = {
+        .channels = channels,
+        .num_channels = 1,
+        .sample_rate_hz = BURST_RATE_HZ,
+        .atten = ADC_ATTEN_DB_11,
+    };
+    light_stream_ok =
+        sample_pipe_init(&light_pipe, "light", light_blocks, 2, 0, 1, BURST_RATE_HZ) == ESP_OK &&
+        adc_stream_init(&cfg, &light_pipe) == ESP_OK;
+}
+
+static void sleep_rate_init(void)
+{
+    adaptive_budget_init(&current_budget, "wake_ua", CURRENT_BUDGET_UA);
+    adaptive_rate_config_t cfg = {
+        .name = "sensor",
+        .min_period_ms = SLEEP_MIN_MS,
+        .max_period_ms = SLEEP_MAX_MS,
+        .start_period_ms = SLEEP_DURATION_SEC * 1000,
+        .change_per_s = SENSOR_CHANGE_PER_S,
+        .stddev = SENSOR_NOISE,
+        .cost = WAKE_CHARGE_UC,
+        .budget = &current_budget,
+    };
+    adaptive_rate_init(&sleep_rate, &cfg);
+}
+
+/** Feed the reading to the controller; returns how long to sleep */
+static uint32_t next_sleep_ms(int sensor_value)
+{
+    uint32_t sleep_ms = adaptive_rate_update(&sleep_rate, (float)sensor_value);
+    if (reading_count % 5 == 0) {
+        adaptive_rate_log(&sleep_rate);
+        adaptive_budget_log(&current_budget);
+        adc_stream_log();
+    }
+    return sleep_ms;
 }
 
 void app_main(void)
@@ -50,9 +190,16 @@ void app_main(void)
     ESP_LOGI(TAG, "========================================");
     ESP_LOGI(TAG, "Low Power Periodic Sensor Reading Demo");
     ESP_LOGI(TAG, "========================================");
-    ESP_LOGI(TAG, "Sleep duration: %d seconds", SLEEP_DURATION_SEC);
+    ESP_LOGI(TAG, "Sleep duration: %d seconds, then %d-%d (adaptive)",
+             SLEEP_DURATION_SEC, SLEEP_MIN_MS / 1000, SLEEP_MAX_MS / 1000);
     ESP_LOGI(TAG, "Power mode: Light Sleep (RAM preserved)");
     ESP_LOGI(TAG, "");
+    sleep_rate_init();
+    light_stream_init();
+    if (sensor_replay_open(&light_trace, "light", SENSOR_REPLAY_REALTIME, 1) == ESP_OK) {
+        light_ch = sensor_replay_channel(&light_trace, "adc");
+        sensor_replay_log(&light_trace);
+    }
 
     // Configure timer wake-up
     esp_err_t ret = esp_sleep_enable_timer_wakeup(SLEEP_DURATION_US);
@@ -65,11 +212,12 @@ void app_main(void)
             reading_count++;
             int sensor_value = read_sensor();
             ESP_LOGI(TAG, "[Reading #%d] Sensor value: %d", reading_count, sensor_value);
-            ESP_LOGI(TAG, "  (In real hardware, would sleep here for %ds)", SLEEP_DURATION_SEC);
+            uint32_t sleep_ms = next_sleep_ms(sensor_value);
+            ESP_LOGI(TAG, "  (In real hardware, would sleep here for %lums)",
+                     (unsigned long)sleep_ms);
             ESP_LOGI(TAG, "  Using vTaskDelay instead (QEMU mode)...");
 
-            // Use shorter delay in QEMU for demo purposes
-            vTaskDelay(pdMS_TO_TICKS(3000));  // 3 seconds for demo
+            vTaskDelay(pdMS_TO_TICKS(sleep_ms));
 
             ESP_LOGI(TAG, "  Woke up! Ready for next reading.");
             ESP_LOGI(TAG, "");
@@ -94,8 +242,10 @@ void app_main(void)
         // Process the data (in real app: send to cloud, store, etc.)
         ESP_LOGI(TAG, "  Processing data...");
 
-        // Enter light sleep
-        ESP_LOGI(TAG, "  Going to light sleep for %d seconds...", SLEEP_DURATION_SEC);
+        // Enter light sleep, for as long as the signal allows
+        uint32_t sleep_ms = next_sleep_ms(sensor_value);
+        esp_sleep_enable_timer_wakeup(sleep_ms * 1000ULL);
+        ESP_LOGI(TAG, "  Going to light sleep for %lums...", (unsigned long)sleep_ms);
         ESP_LOGI(TAG, "  (Power drops from ~80mA to ~0.8mA)");
 
         // Actually enter light sleep
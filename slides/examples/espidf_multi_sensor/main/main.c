@@ -9,7 +9,7 @@
  * 2. ESP Timers - Hardware timers call callbacks at precise intervals
  *
  * Problem Scenario:
- * - Sensor A (Accelerometer): Read every 100ms (simulated, scaled for demo)
+ * - Sensor A (Accelerometer): Sampled at 100 Hz, analysed in blocks
  * - Sensor B (Temperature): Read every 200ms
  * - Both must run independently without blocking each other
  *
@@ -22,89 +22,286 @@
  * - FreeRTOS tasks run concurrently (preemptive multitasking)
  * - ESP timers provide hardware-level precision
  * - Clean, maintainable code that scales to many sensors
+ *
+ * Core Placement:
+ * - Sensor tasks are pinned to APP_CPU (core 1) via task_placement_create()
+ * - The esp_timer task is pinned to core 1 in sdkconfig.defaults
+ * - Each task/timer prints JITTER lines: how far each period drifted
+ *
+ * Accelerometer DSP (task approach):
+ * - accel_task pushes each X/Y/Z row into a sample_block_t, one column
+ *   per axis plus a timestamp column (components/sample_block)
+ * - Full blocks are handed to accel_dsp_task by pointer through a
+ *   sample_pipe_t: two static blocks circulate, nothing is copied
+ * - accel_dsp_task prints only the features, one VIBRATION line per block
+ *   (gravity, RMS, peak, dominant frequency, band energies), and a
+ *   VIBRATION_STATS line comparing raw and feature bytes
+ *
+ * Memory:
+ * - Task stacks and TCBs are reserved at compile time (STATIC_TASK_DEFINE)
+ * - MEM/STACK lines at boot show heap state and measured stack use
+ *
+ * Adaptive temperature rate (components/adaptive_rate):
+ * - The temperature task and timer pick their next period from the
+ *   readings: fast while the temperature moves, slow while it is flat,
+ *   between TEMP_MIN_PERIOD_MS and TEMP_MAX_PERIOD_MS
+ * - Both share one CPU budget (TEMP_READ_COST_US per read), so together
+ *   they never read faster than TEMP_BUDGET_US_PER_S allows
+ * - The accelerometer stays at a fixed 100 Hz: the FFT needs evenly
+ *   spaced samples
+ * - ADAPTIVE_RATE / ADAPTIVE_BUDGET lines every 10 s show the effective rate
+ *
+ * Recorded accelerometer (components/sensor_replay):
+ * - With a trace pack in flash (SENSOR_TRACE=.../traces/sensors.bin
+ *   run_qemu.sh), accel_task replays the 100 Hz "accel" trace one record
+ *   per sample, so the VIBRATION lines are the same on every run
+ * - Without one, read_accelerometer() falls back to the sine model
  */
 
+#include <math.h>
 #include <stdio.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_timer.h"
 #include "esp_log.h"
 
+#include "task_placement.h"
+#include "static_alloc.h"
+#include "sample_block.h"
+#include "accel_dsp.h"
+#include "adaptive_rate.h"
+#include "sensor_replay.h"
+
 static const char *TAG_MAIN = "MULTI_SENSOR";
 static const char *TAG_ACCEL = "ACCEL";
 static const char *TAG_TEMP = "TEMP";
 
 // Demo timing (scaled up for visibility in QEMU)
 // Real values would be 10ms and 20ms
-#define ACCEL_PERIOD_MS  500   // Accelerometer: every 500ms (demo)
-#define TEMP_PERIOD_MS   1000  // Temperature: every 1000ms (demo)
+#define ACCEL_PERIOD_MS  500   // Accelerometer timer: every 500ms (demo)
+#define TEMP_PERIOD_MS   1000  // Temperature: starts every 1000ms (demo)
+
+// The temperature period adapts to the signal within these bounds
+#define TEMP_MIN_PERIOD_MS      200
+#define TEMP_MAX_PERIOD_MS      5000
+#define TEMP_CHANGE_C_PER_S     0.1f   // Faster above this rate of change
+#define TEMP_NOISE_C            0.1f   // ... or above this std dev
+// CPU cost of one read (an I2C transaction on real hardware) and what the
+// temperature task and timer may spend together
+#define TEMP_READ_COST_US       500
+#define TEMP_BUDGET_US_PER_S    4000
+
+// The accelerometer task samples at the real rate; it logs nothing per
+// sample, the DSP task prints one line per block instead
+#define ACCEL_SAMPLE_HZ  100
+#define ACCEL_SAMPLE_MS  (1000 / ACCEL_SAMPLE_HZ)
 
 // Counters for demonstration
 static int accel_count = 0;
 static int temp_count = 0;
 
+// Task stacks, reserved at compile time. Right-size them from the
+// STACK lines printed ~15 s after boot.
+#define SENSOR_TASK_STACK_BYTES 2048
+STATIC_TASK_DEFINE(accel_task_def, "accel_task", SENSOR_TASK_STACK_BYTES);
+STATIC_TASK_DEFINE(temp_task_def, "temp_task", SENSOR_TASK_STACK_BYTES);
+
+// Block handoff: accel_task fills one block while accel_dsp_task processes
+// the other. Only pointers go through the pipe.
+#define DSP_TASK_STACK_BYTES 3072
+#define ACCEL_SOURCE_ID      1
+STATIC_TASK_DEFINE(dsp_task_def, "accel_dsp", DSP_TASK_STACK_BYTES);
+static sample_block_t accel_blocks[2];
+static sample_pipe_t accel_pipe;
+static accel_dsp_t accel_dsp;
+static int accel_dropped = 0;    // Samples lost while no block was free
+
+// Recorded accelerometer trace, one record per sample (STEP mode)
+static sensor_replay_t accel_trace;
+static bool accel_replay = false;
+
+// Period jitter for each task and timer
+static task_jitter_t accel_task_jitter;
+static task_jitter_t temp_task_jitter;
+static task_jitter_t accel_timer_jitter;
+static task_jitter_t temp_timer_jitter;
+
+// Sampling rate for the temperature task and timer, one shared budget
+static adaptive_budget_t temp_budget;
+static adaptive_rate_t temp_task_rate;
+static adaptive_rate_t temp_timer_rate;
+
+static void temp_rate_init(adaptive_rate_t *r, const char *name)
+{
+    adaptive_rate_config_t cfg = {
+        .name = name,
+        .min_period_ms = TEMP_MIN_PERIOD_MS,
+        .max_period_ms = TEMP_MAX_PERIOD_MS,
+        .start_period_ms = TEMP_PERIOD_MS,
+        .change_per_s = TEMP_CHANGE_C_PER_S,
+        .stddev = TEMP_NOISE_C,
+        .cost = TEMP_READ_COST_US,
+        .budget = &temp_budget,
+    };
+    adaptive_rate_init(r, &cfg);
+}
+
 /* ============================================================
  * APPROACH 1: FreeRTOS Tasks
  * Each sensor runs in its own task with independent timing
  * ============================================================ */
 
+/** A few mg of sensor noise (small LCG, deterministic across runs) */
+static int accel_noise(void)
+{
+    static uint32_t seed = 12345;
+    seed = seed * 1103515245u + 12345u;
+    return (int)((seed >> 16) % 21) - 10;
+}
+
 /**
- * Simulated accelerometer reading
+ * Simulated accelerometer reading, in milli-g
  * In real code: read from I2C/SPI accelerometer
+ *
+ * A machine on a table: gravity on Z, a 12 Hz vibration on X and a
+ * weaker 31 Hz one on Y.
  */
-static void read_accelerometer(void)
+static void read_accelerometer(int16_t xyz[ACCEL_AXES])
 {
+    sensor_reading_t r;
+    if (accel_replay && sensor_replay_next(&accel_trace, &r) == ESP_OK) {
+        accel_count++;
+        for (int axis = 0; axis < ACCEL_AXES; axis++) {
+            xyz[axis] = (int16_t)r.value[axis];
+        }
+        return;
+    }
+
+    // Both tones repeat every second, so the phase stays small
+    float t = (float)(accel_count % ACCEL_SAMPLE_HZ) / ACCEL_SAMPLE_HZ;
     accel_count++;
-    // Simulate X, Y, Z acceleration values
-    int x = (accel_count * 13) % 2000 - 1000;  // -1000 to 1000
-    int y = (accel_count * 17) % 2000 - 1000;
-    int z = 1000 + (accel_count * 7) % 100;    // ~1000 (gravity)
 
-    ESP_LOGI(TAG_ACCEL, "[Task] Reading #%d: X=%d, Y=%d, Z=%d",
-             accel_count, x, y, z);
+    xyz[0] = (int16_t)(150.0f * sinf(2.0f * (float)M_PI * 12.0f * t) + accel_noise());
+    xyz[1] = (int16_t)(60.0f * sinf(2.0f * (float)M_PI * 31.0f * t) + accel_noise());
+    xyz[2] = (int16_t)(1000 + accel_noise());
 }
 
 /**
- * Simulated temperature reading
+ * Simulated room temperature in Celsius
  * In real code: read from I2C temperature sensor
+ *
+ * Flat at 25 C with a little noise, except once a minute: 10 s warming up
+ * by 3 C, 10 s warm, 10 s cooling down again.
  */
-static void read_temperature(void)
+static float simulated_temperature(void)
 {
-    temp_count++;
-    // Simulate temperature in Celsius (25.0 to 26.0)
-    float temp = 25.0 + (float)(temp_count % 10) / 10.0;
+    static uint32_t seed = 54321;
+    seed = seed * 1103515245u + 12345u;
+    float noise = (float)((int)((seed >> 16) % 11) - 5) / 100.0f;
+
+    float t = (float)((esp_timer_get_time() / 1000) % 60000) / 1000.0f;
+    float offset = 0;
+    if (t >= 20 && t < 30) {
+        offset = 0.3f * (t - 20);
+    } else if (t >= 30 && t < 40) {
+        offset = 3.0f;
+    } else if (t >= 40 && t < 50) {
+        offset = 0.3f * (50 - t);
+    }
+    return 25.0f + offset + noise;
+}
 
-    ESP_LOGI(TAG_TEMP, "[Task] Reading #%d: Temperature = %.1f C",
-             temp_count, temp);
+static float read_temperature(void)
+{
+    temp_count++;
+    return simulated_temperature();
 }
 
 /**
- * Accelerometer task - runs at ACCEL_PERIOD_MS interval
+ * Accelerometer task - samples every ACCEL_SAMPLE_MS into a block
  */
 static void accelerometer_task(void *arg)
 {
-    ESP_LOGI(TAG_ACCEL, "Accelerometer task started (period: %dms)", ACCEL_PERIOD_MS);
+    ESP_LOGI(TAG_ACCEL, "Accelerometer task started (%d Hz, %d-sample blocks)",
+             ACCEL_SAMPLE_HZ, ACCEL_DSP_N);
+    TickType_t last_wake = xTaskGetTickCount();
+    sample_block_t *block = NULL;
 
     while (1) {
-        read_accelerometer();
+        task_jitter_record(&accel_task_jitter);
+        int16_t xyz[ACCEL_AXES];
+        read_accelerometer(xyz);
+
+        // Never wait for a block here: a late sample is worse than a lost one
+        if (block == NULL) {
+            block = sample_pipe_acquire(&accel_pipe, 0);
+        }
+        if (block == NULL) {
+            accel_dropped++;
+        } else {
+            sample_block_push(block, esp_timer_get_time(), xyz);
+            if (block->count == ACCEL_DSP_N) {
+                sample_pipe_submit(&accel_pipe, block);
+                block = NULL;
+            }
+        }
 
         // Non-blocking delay - other tasks can run during this time!
-        vTaskDelay(pdMS_TO_TICKS(ACCEL_PERIOD_MS));
+        // DelayUntil keeps a fixed period regardless of how long the read took
+        xTaskDelayUntil(&last_wake, pdMS_TO_TICKS(ACCEL_SAMPLE_MS));
+    }
+}
+
+/**
+ * DSP task - turns each full block into features and returns the block
+ */
+static void accel_dsp_task(void *arg)
+{
+    accel_features_t features;
+    char json[192];
+
+    while (1) {
+        sample_block_t *block = sample_pipe_receive(&accel_pipe, portMAX_DELAY);
+
+        int64_t start = esp_timer_get_time();
+        accel_dsp_process(&accel_dsp, block, &features);
+        int64_t dsp_us = esp_timer_get_time() - start;
+
+        // Raw upload size: the block as one binary frame with timestamps
+        unsigned seq = block->seq;
+        int64_t t0_us = block->t0_us;
+        size_t raw_bytes = sample_block_frame_size(block);
+        sample_block_release(block);
+
+        int len = accel_features_to_json(&features, json, sizeof(json));
+        printf("VIBRATION %s\n", json);
+        printf("VIBRATION_STATS seq=%u t0_ms=%lld samples=%d raw_bytes=%u "
+               "feature_bytes=%d dsp_us=%lld dropped=%d\n",
+               seq, t0_us / 1000, ACCEL_DSP_N, (unsigned)raw_bytes,
+               len, dsp_us, accel_dropped);
     }
 }
 
 /**
- * Temperature task - runs at TEMP_PERIOD_MS interval
+ * Temperature task - period chosen by temp_task_rate after each reading
  */
 static void temperature_task(void *arg)
 {
-    ESP_LOGI(TAG_TEMP, "Temperature task started (period: %dms)", TEMP_PERIOD_MS);
+    ESP_LOGI(TAG_TEMP, "Temperature task started (period: %d-%dms)",
+             TEMP_MIN_PERIOD_MS, TEMP_MAX_PERIOD_MS);
+    TickType_t last_wake = xTaskGetTickCount();
 
     while (1) {
-        read_temperature();
+        task_jitter_record(&temp_task_jitter);
+        float temp = read_temperature();
+        uint32_t period_ms = adaptive_rate_update(&temp_task_rate, temp);
+        temp_task_jitter.period_us = period_ms * 1000LL;
+
+        ESP_LOGI(TAG_TEMP, "[Task] Reading #%d: Temperature = %.2f C (next in %lums)",
+                 temp_count, temp, (unsigned long)period_ms);
 
         // Non-blocking delay - accelerometer task runs during this time!
-        vTaskDelay(pdMS_TO_TICKS(TEMP_PERIOD_MS));
+        xTaskDelayUntil(&last_wake, pdMS_TO_TICKS(period_ms));
     }
 }
 
@@ -124,6 +321,7 @@ static int temp_timer_count = 0;
  */
 static void accel_timer_callback(void *arg)
 {
+    task_jitter_record(&accel_timer_jitter);
     accel_timer_count++;
     int x = (accel_timer_count * 13) % 2000 - 1000;
     int y = (accel_timer_count * 17) % 2000 - 1000;
@@ -135,14 +333,19 @@ static void accel_timer_callback(void *arg)
 
 /**
  * Timer callback for temperature
+ * A one-shot timer, re-armed with the period temp_timer_rate picks
  */
 static void temp_timer_callback(void *arg)
 {
+    task_jitter_record(&temp_timer_jitter);
     temp_timer_count++;
-    float temp = 25.0 + (float)(temp_timer_count % 10) / 10.0;
+    float temp = simulated_temperature();
+    uint32_t period_ms = adaptive_rate_update(&temp_timer_rate, temp);
+    temp_timer_jitter.period_us = period_ms * 1000LL;
+    esp_timer_start_once(temp_timer, period_ms * 1000ULL);
 
-    ESP_LOGI(TAG_TEMP, "[Timer] Reading #%d: Temperature = %.1f C",
-             temp_timer_count, temp);
+    ESP_LOGI(TAG_TEMP, "[Timer] Reading #%d: Temperature = %.2f C (next in %lums)",
+             temp_timer_count, temp, (unsigned long)period_ms);
 }
 
 /**
@@ -151,6 +354,8 @@ static void temp_timer_callback(void *arg)
 static void setup_timers(void)
 {
     ESP_LOGI(TAG_MAIN, "Setting up ESP timers...");
+    task_jitter_init(&accel_timer_jitter, "accel_timer", ACCEL_PERIOD_MS * 1000LL);
+    task_jitter_init(&temp_timer_jitter, "temp_timer", TEMP_PERIOD_MS * 1000LL);
 
     // Create accelerometer timer
     esp_timer_create_args_t accel_timer_args = {
@@ -168,11 +373,13 @@ static void setup_timers(void)
 
     // Start timers (period in microseconds)
     ESP_ERROR_CHECK(esp_timer_start_periodic(accel_timer, ACCEL_PERIOD_MS * 1000));
-    ESP_ERROR_CHECK(esp_timer_start_periodic(temp_timer, TEMP_PERIOD_MS * 1000));
+    temp_rate_init(&temp_timer_rate, "temp_timer");
+    ESP_ERROR_CHECK(esp_timer_start_once(temp_timer, TEMP_PERIOD_MS * 1000));
 
     ESP_LOGI(TAG_MAIN, "Timers started!");
     ESP_LOGI(TAG_MAIN, "  Accelerometer: every %dms", ACCEL_PERIOD_MS);
-    ESP_LOGI(TAG_MAIN, "  Temperature: every %dms", TEMP_PERIOD_MS);
+    ESP_LOGI(TAG_MAIN, "  Temperature: every %d-%dms (adaptive)",
+             TEMP_MIN_PERIOD_MS, TEMP_MAX_PERIOD_MS);
 }
 
 /* ============================================================
@@ -184,12 +391,14 @@ void app_main(void)
     ESP_LOGI(TAG_MAIN, "================================================");
     ESP_LOGI(TAG_MAIN, "Multi-Sensor Demo: FreeRTOS Tasks vs ESP Timers");
     ESP_LOGI(TAG_MAIN, "================================================");
+    static_alloc_log_memory("boot");
     ESP_LOGI(TAG_MAIN, "");
     ESP_LOGI(TAG_MAIN, "This demo shows two approaches for reading");
     ESP_LOGI(TAG_MAIN, "multiple sensors at different rates:");
     ESP_LOGI(TAG_MAIN, "");
     ESP_LOGI(TAG_MAIN, "  Accelerometer: every %dms", ACCEL_PERIOD_MS);
-    ESP_LOGI(TAG_MAIN, "  Temperature:   every %dms", TEMP_PERIOD_MS);
+    ESP_LOGI(TAG_MAIN, "  Temperature:   every %d-%dms (adaptive)",
+             TEMP_MIN_PERIOD_MS, TEMP_MAX_PERIOD_MS);
     ESP_LOGI(TAG_MAIN, "");
 
     // ==== PHASE 1: Demonstrate FreeRTOS Tasks ====
@@ -197,26 +406,43 @@ void app_main(void)
     ESP_LOGI(TAG_MAIN, "Creating independent tasks for each sensor...");
     ESP_LOGI(TAG_MAIN, "");
 
-    // Create accelerometer task
-    xTaskCreate(
+    task_placement_log_config();
+    task_jitter_init(&accel_task_jitter, "accel_task", ACCEL_SAMPLE_MS * 1000LL);
+    accel_replay = sensor_replay_open(&accel_trace, "accel", SENSOR_REPLAY_STEP, 0) == ESP_OK &&
+                   accel_trace.channels == ACCEL_AXES;
+    ESP_LOGI(TAG_ACCEL, "Accelerometer data: %s",
+             accel_replay ? "recorded trace" : "simulated (no sensor trace)");
+
+    // Both blocks start out free
+    accel_dsp_init(&accel_dsp);
+    ESP_ERROR_CHECK(sample_pipe_init(&accel_pipe, "accel", accel_blocks, 2,
+                                     ACCEL_SOURCE_ID, ACCEL_AXES, ACCEL_SAMPLE_HZ));
+    static_task_create(&dsp_task_def, accel_dsp_task, NULL, 4, TASK_ROLE_SENSING);
+    task_jitter_init(&temp_task_jitter, "temp_task", TEMP_PERIOD_MS * 1000LL);
+    adaptive_budget_init(&temp_budget, "temp_cpu_us", TEMP_BUDGET_US_PER_S);
+    temp_rate_init(&temp_task_rate, "temp_task");
+
+    // Create accelerometer task in its static stack, pinned to the sensing core
+    static_task_create(
+        &accel_task_def,       // Static definition (name + stack size)
         accelerometer_task,    // Task function
-        "accel_task",          // Task name (for debugging)
-        2048,                  // Stack size (bytes)
         NULL,                  // Parameters
         5,                     // Priority (5 = medium)
-        NULL                   // Task handle (not needed)
+        TASK_ROLE_SENSING      // Role decides the core
     );
 
     // Create temperature task
-    xTaskCreate(
+    static_task_create(
+        &temp_task_def,
         temperature_task,
-        "temp_task",
-        2048,
         NULL,
         5,
-        NULL
+        TASK_ROLE_SENSING
     );
 
+    static_alloc_log_memory("tasks");
+    static_alloc_report_stacks_later();
+
     // Let tasks run for a while
     ESP_LOGI(TAG_MAIN, "Tasks are running concurrently...");
     ESP_LOGI(TAG_MAIN, "Watch how readings interleave naturally!");
@@ -244,5 +470,12 @@ void app_main(void)
         ESP_LOGI(TAG_MAIN, "Main task still alive. Total readings:");
         ESP_LOGI(TAG_MAIN, "  Tasks  - Accel: %d, Temp: %d", accel_count, temp_count);
         ESP_LOGI(TAG_MAIN, "  Timers - Accel: %d, Temp: %d", accel_timer_count, temp_timer_count);
+        sample_pipe_log(&accel_pipe);
+        if (accel_replay) {
+            sensor_replay_log(&accel_trace);
+        }
+        adaptive_rate_log(&temp_task_rate);
+        adaptive_rate_log(&temp_timer_rate);
+        adaptive_budget_log(&temp_budget);
     }
 }
@@ -3,6 +3,10 @@
 # IoT Course - Spring 2026
 #
 # Usage: ./run_qemu.sh
+#        SENSOR_TRACE=../../../esp32-qemu/traces/sensors.bin ./run_qemu.sh
+#
+# SENSOR_TRACE is a pack from esp32-qemu/scripts/sensor-trace.py; it is
+# written at 0x310000, where components/sensor_replay looks for it.
 #
 # This demo shows:
 # - FreeRTOS tasks for concurrent sensor reading
@@ -35,6 +39,12 @@ esptool.py --chip esp32 merge_bin \
     0x8000 build/partition_table/partition-table.bin \
     0x10000 "$APP_BIN"
 
+if [ -n "$SENSOR_TRACE" ]; then
+    echo "Writing sensor trace ${SENSOR_TRACE} at 0x310000..."
+    dd if="$SENSOR_TRACE" of=build/flash.bin bs=4096 seek=$((0x310000 / 4096)) \
+        conv=notrunc status=none
+fi
+
 echo ""
 echo "Starting QEMU..."
 echo "Exit with: Ctrl+A, X"